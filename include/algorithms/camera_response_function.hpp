@@ -42,6 +42,79 @@ namespace pic {
 
 enum IMG_LIN {IL_LIN, IL_2_2, IL_LUT_8_BIT, IL_POLYNOMIAL};
 
+/**
+ * @brief The CRFInverseLUT struct inverts a tabulated inverse CRF, i.e. it
+ * maps a linear value to its 8-bit code in constant time. The range of the
+ * table is split into bins, and each bin stores the first code it can map to;
+ * a short scan from there gives the same result of std::lower_bound on the
+ * first 255 entries of the table.
+ */
+struct CRFInverseLUT
+{
+    static const int nBins = 4096;
+
+    float *table;
+    float minValue, scale;
+    unsigned char first[nBins];
+
+    /**
+     * @brief CRFInverseLUT
+     */
+    CRFInverseLUT()
+    {
+        table = NULL;
+        minValue = 0.0f;
+        scale = 0.0f;
+    }
+
+    /**
+     * @brief compute
+     * @param table is a non-decreasing table of 256 values.
+     */
+    void compute(float *table)
+    {
+        this->table = table;
+
+        if(table == NULL) {
+            return;
+        }
+
+        minValue = table[0];
+        float range = table[254] - minValue;
+        scale = range > 0.0f ? float(nBins) / range : 0.0f;
+
+        for(int i = 0; i < nBins; i++) {
+            float x = scale > 0.0f ? minValue + float(i) / scale : minValue;
+            first[i] = (unsigned char)(std::lower_bound(table, table + 255, x) - table);
+        }
+    }
+
+    /**
+     * @brief get
+     * @param x is a value in the linear domain.
+     * @return It returns the 8-bit code of x.
+     */
+    inline int get(float x)
+    {
+        if(!(x > minValue)) {
+            return 0;
+        }
+
+        float t = (x - minValue) * scale;
+        int c = first[t < float(nBins) ? int(t) : (nBins - 1)];
+
+        while((c > 0) && (table[c - 1] >= x)) {
+            c--;
+        }
+
+        while((c < 255) && (table[c] < x)) {
+            c++;
+        }
+
+        return c;
+    }
+};
+
 /**
  * @brief The CameraResponseFunction class
  */
@@ -137,6 +210,7 @@ protected:
         icrf.clear();
         crf.clear();
         poly.clear();
+        icrf_lut.clear();
     }
 
     /**
@@ -165,13 +239,67 @@ protected:
                 tmp[j] = polynomialVal(poly[i], x);
             }
 
-            crf.push_back(tmp);
+            icrf.push_back(tmp);
         }
     }
 
-    SubSampleStack          stackOut;
-    IMG_LIN                 type_linearization;
-    float                   w[256];
+    /**
+     * @brief ApplyLowerBound applies the CRF of a tabulated type
+     * with a binary search in the inverse CRF.
+     * @param x
+     * @param channel
+     * @return
+     */
+    inline float ApplyLowerBound(float x, int channel)
+    {
+        float *ptr = std::lower_bound(&icrf[channel][0], &icrf[channel][255], x);
+        int offset = CLAMPi((int)(ptr - icrf[channel]), 0, 255);
+
+        return float(offset) / 255.0f;
+    }
+
+    /**
+     * @brief RemoveBuffer
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     */
+    template<IMG_LIN type>
+    void RemoveBuffer(float *dataIn, float *dataOut, int nPixels, int channels)
+    {
+        for(int i = 0; i < nPixels; i++) {
+            int index = i * channels;
+
+            for(int k = 0; k < channels; k++) {
+                dataOut[index + k] = RemoveT<type>(dataIn[index + k], k);
+            }
+        }
+    }
+
+    /**
+     * @brief ApplyBuffer
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     */
+    template<IMG_LIN type>
+    void ApplyBuffer(float *dataIn, float *dataOut, int nPixels, int channels)
+    {
+        for(int i = 0; i < nPixels; i++) {
+            int index = i * channels;
+
+            for(int k = 0; k < channels; k++) {
+                dataOut[index + k] = ApplyT<type>(dataIn[index + k], k);
+            }
+        }
+    }
+
+    SubSampleStack              stackOut;
+    IMG_LIN                     type_linearization;
+    float                       w[256];
+    std::vector<CRFInverseLUT>  icrf_lut;
 
 public:
 
@@ -193,6 +321,87 @@ public:
         Destroy();
     }
 
+    /**
+     * @brief RemoveT linearizes a camera value using the inverse CRF;
+     * the linearization type is a template parameter, so the selection
+     * is resolved at compile time.
+     * @param x is an intensity value in [0,1].
+     * @param channel
+     * @return It returns x in the linear domain.
+     */
+    template<IMG_LIN type>
+    inline float RemoveT(float x, int channel)
+    {
+        switch(type) {
+            case IL_LIN: {
+                return x;
+            }
+            break;
+
+            case IL_LUT_8_BIT: {
+                int index =  CLAMP(int(roundf(x * 255.0f)), 256);
+                return icrf[channel][index];
+            }
+            break;
+
+            case IL_2_2: {
+                return powf(x, 2.2f);
+            }
+            break;
+
+            case IL_POLYNOMIAL: {
+                return polynomialVal(poly[channel], x);
+            }
+            break;
+
+            default:
+                break;
+        }
+
+        return x;
+    }
+
+    /**
+     * @brief ApplyT applies the CRF; the linearization type is a template
+     * parameter. Tabulated types require valid inverse LUTs; see
+     * isInverseLUTValid.
+     * @param x a value in [0, 1]
+     * @param channel
+     * @return
+     */
+    template<IMG_LIN type>
+    inline float ApplyT(float x, int channel)
+    {
+        switch(type) {
+            case IL_LIN: {
+                return x;
+            }
+            break;
+
+            case IL_2_2: {
+               #ifdef PIC_WIN32
+                  float inv_gamma = 1.0f / 2.2f;
+               #else
+                  constexpr float inv_gamma = 1.0f / 2.2f;
+               #endif
+
+               return powf(x, inv_gamma);
+            }
+            break;
+
+            case IL_LUT_8_BIT:
+            case IL_POLYNOMIAL: {
+                return float(icrf_lut[channel].get(x)) / 255.0f;
+            }
+            break;
+
+            default:
+                break;
+        }
+
+        return x;
+    }
+
     /**
      * @brief Remove linearizes a camera value using the inverse CRF.
      * @param x is an intensity value in [0,1].
@@ -214,12 +423,12 @@ public:
             break;
 
             case IL_2_2: {
-                return powf(x, 2.2f);
+                return RemoveT<IL_2_2>(x, channel);
             }
             break;
 
             case IL_POLYNOMIAL: {
-                return polynomialVal(poly[channel], x);
+                return RemoveT<IL_POLYNOMIAL>(x, channel);
             }
             break;
 
@@ -244,38 +453,139 @@ public:
             }
             break;
 
-            case IL_LUT_8_BIT: {
-                float *ptr = std::lower_bound(&icrf[channel][0], &icrf[channel][255], x);
-                int offset = CLAMPi((int)(ptr - icrf[channel]), 0, 255);
+            case IL_2_2: {
+                return ApplyT<IL_2_2>(x, channel);
+            }
+            break;
 
-                return float(offset) / 255.0f;
+            case IL_LUT_8_BIT:
+            case IL_POLYNOMIAL: {
+                if(isInverseLUTValid(channel)) {
+                    return ApplyT<IL_LUT_8_BIT>(x, channel);
+                } else {
+                    return ApplyLowerBound(x, channel);
+                }
+            }
+            break;
+
+            default:
+                break;
+        }
+
+        return x;
+    }
+
+    /**
+     * @brief Remove linearizes a buffer of interleaved camera values;
+     * the linearization type is selected once for the whole buffer.
+     * @param dataIn
+     * @param dataOut can be dataIn.
+     * @param nPixels
+     * @param channels
+     */
+    void Remove(float *dataIn, float *dataOut, int nPixels, int channels)
+    {
+        switch(type_linearization) {
+            case IL_LIN: {
+                if(dataOut != dataIn) {
+                    memcpy(dataOut, dataIn, sizeof(float) * nPixels * channels);
+                }
+            }
+            break;
+
+            case IL_LUT_8_BIT: {
+                RemoveBuffer<IL_LUT_8_BIT>(dataIn, dataOut, nPixels, channels);
             }
             break;
 
             case IL_2_2: {
-               #ifdef PIC_WIN32
-                  float inv_gamma = 1.0f / 2.2f;
-               #else
-                  constexpr float inv_gamma = 1.0f / 2.2f;
-               #endif
+                RemoveBuffer<IL_2_2>(dataIn, dataOut, nPixels, channels);
+            }
+            break;
 
-               return powf(x, inv_gamma);
+            case IL_POLYNOMIAL: {
+                RemoveBuffer<IL_POLYNOMIAL>(dataIn, dataOut, nPixels, channels);
+            }
+            break;
+
+            default:
+                break;
+        }
+    }
+
+    /**
+     * @brief Apply applies the CRF to a buffer of interleaved linear values;
+     * the linearization type is selected once for the whole buffer.
+     * @param dataIn
+     * @param dataOut can be dataIn.
+     * @param nPixels
+     * @param channels
+     */
+    void Apply(float *dataIn, float *dataOut, int nPixels, int channels)
+    {
+        switch(type_linearization) {
+            case IL_LIN: {
+                if(dataOut != dataIn) {
+                    memcpy(dataOut, dataIn, sizeof(float) * nPixels * channels);
+                }
+            }
+            break;
+
+            case IL_2_2: {
+                ApplyBuffer<IL_2_2>(dataIn, dataOut, nPixels, channels);
             }
             break;
 
+            case IL_LUT_8_BIT:
             case IL_POLYNOMIAL: {
-                float *ptr = std::lower_bound(&icrf[channel][0], &icrf[channel][255], x);
-                int offset = CLAMPi((int)(ptr - icrf[channel]), 0, 255);
+                bool bValid = true;
 
-                return float(offset) / 255.0f;
+                for(int k = 0; k < channels; k++) {
+                    bValid = bValid && isInverseLUTValid(k);
+                }
+
+                if(bValid) {
+                    ApplyBuffer<IL_LUT_8_BIT>(dataIn, dataOut, nPixels, channels);
+                } else {
+                    for(int i = 0; i < (nPixels * channels); i++) {
+                        dataOut[i] = ApplyLowerBound(dataIn[i], i % channels);
+                    }
+                }
             }
             break;
 
             default:
                 break;
         }
+    }
 
-        return x;
+    /**
+     * @brief computeInverseLUT computes the tables used by Apply for
+     * tabulated CRFs. Estimation methods call it; it has to be called again
+     * when icrf is modified by hand.
+     */
+    void computeInverseLUT()
+    {
+        icrf_lut.resize(icrf.size());
+
+        for(unsigned int i = 0; i < icrf.size(); i++) {
+            icrf_lut[i].compute(icrf[i]);
+        }
+    }
+
+    /**
+     * @brief isInverseLUTValid
+     * @param channel
+     * @return It returns true if the table of channel matches icrf.
+     */
+    bool isInverseLUTValid(int channel)
+    {
+        if((channel < 0) || (channel >= int(icrf_lut.size())) ||
+           (channel >= int(icrf.size()))) {
+            return false;
+        }
+
+        return (icrf[channel] != NULL) && (icrf_lut[channel].table == icrf[channel]);
     }
 
     /**
@@ -375,6 +685,10 @@ public:
                 icrf.push_back(ret_c);
             }
         }
+
+        delete[] crf;
+
+        computeInverseLUT();
     }
 
     /**
@@ -430,6 +744,8 @@ public:
 
             icrf.push_back(icrf_channel);
         }
+
+        computeInverseLUT();
     }
 
     /**
@@ -524,6 +840,7 @@ public:
 
         if(bOk) {
             CreateTabledICRF();
+            computeInverseLUT();
         }
 
         return bOk;
@@ -804,6 +1121,8 @@ public:
 
         delete[] lower;
         delete[] higher;
+
+        computeInverseLUT();
     }
 };
 
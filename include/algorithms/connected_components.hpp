@@ -25,6 +25,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../base.hpp"
 
 #include "../image.hpp"
+#include "../util/array.hpp"
+#include "../util/std_util.hpp"
 #include "../filtering/filter_luminance.hpp"
 
 namespace pic {
@@ -46,16 +48,23 @@ class LabelOutput
 {
 public:
     float id;
+    int area;
+    BBox box;
     std::vector<int> coords;
 
     LabelOutput()
     {
+        area = 0;
     }
 
-    LabelOutput(float id, int i)
+    LabelOutput(float id, int i, bool bCoords = true)
     {
         this->id = id;
-        coords.push_back(i);
+        area = 1;
+
+        if(bCoords) {
+            coords.push_back(i);
+        }
     }
 
     void add(int i)
@@ -70,16 +79,62 @@ public:
 };
 
 
+/**
+ * @brief findRootUF finds the root of i in a union-find forest;
+ * paths are compressed by halving.
+ * @param parent is the union-find forest.
+ * @param i is an element of the forest.
+ * @return It returns the root of i.
+ */
+PIC_INLINE int findRootUF(int *parent, int i)
+{
+    while(parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+
+    return i;
+}
+
+/**
+ * @brief unionUF merges the trees of a and b in a union-find forest.
+ * The root with the larger index is linked to the one with the smaller
+ * index, so parent[i] <= i always holds.
+ * @param parent is the union-find forest.
+ * @param a is an element of the forest.
+ * @param b is an element of the forest.
+ * @return It returns the root of the merged tree.
+ */
+PIC_INLINE int unionUF(int *parent, int a, int b)
+{
+    a = findRootUF(parent, a);
+    b = findRootUF(parent, b);
+
+    if(a < b) {
+        parent[b] = a;
+        return a;
+    } else {
+        parent[a] = b;
+        return b;
+    }
+}
+
 /**
  * @brief computeConnectedComponents computes connected components in an image
+ * using a two-pass union-find labeling. The first pass runs in parallel over
+ * horizontal strips, and equivalences across strip boundaries are merged
+ * afterwards. Labels start from 1.
  * @param img
- * @param ret
+ * @param ret is a vector where, for each component, its label, bounding
+ * box, area, and optionally its pixels are appended.
  * @param comp
- * @param channel
+ * @param thr
+ * @param bCoords if true the coordinates of all pixels of each component
+ * are stored in ret.
  * @return
  */
 PIC_INLINE Image *computeConnectedComponents(Image *img, std::vector<LabelOutput> &ret,
-                              Image *comp = NULL, float thr = 0.05f)
+                              Image *comp = NULL, float thr = 0.05f, bool bCoords = true)
 {
     //Check input paramters
     if(img == NULL) {
@@ -96,196 +151,140 @@ PIC_INLINE Image *computeConnectedComponents(Image *img, std::vector<LabelOutput
         comp = new Image(1, width, height, 1);
     }
 
-    comp->setZero();
+    float thr_sq = thr * thr;
 
-    //First pass: assigning basics labels
-    // and generating the list of neighbors
-    int label = 1;
+    //squared norms are computed once per pixel
+    float *normSq = new float[n];
 
-    std::set<LabelInfo> labelEq;
-    std::set<LabelInfo>::iterator it;
-
-    for(int j = 0; j < height; j++) {
-        int indY = j * width;
+    #pragma omp parallel for
 
-        for(int i = 0; i < width; i++) {
-            int ind = (indY + i);
+    for(int i = 0; i < n; i++) {
+        normSq[i] = Array<float>::dot(&data[i * channels], &data[i * channels], channels);
+    }
 
-            int ind_img = ind * channels;
+    //edges: bit 0 is set if connected to the left neighbor,
+    //bit 1 is set if connected to the top neighbor
+    unsigned char *edges = new unsigned char[n];
 
-            //neighbors
-            int neighbors[2];
-            int nNeighbors = 0;
+    #pragma omp parallel for
 
-            if((i - 1) > -1) {
-                int ind_img_prev = ind_img - channels;
+    for(int j = 0; j < height; j++) {
+        for(int i = 0; i < width; i++) {
+            int ind = j * width + i;
+            float *p = &data[ind * channels];
+            unsigned char e = 0;
 
-                float n1 = Array<float>::norm(&data[ind_img], channels);
-                float n2 = Array<float>::norm(&data[ind_img_prev], channels);
-                float dist = sqrtf(Array<float>::distanceSq(&data[ind_img], &data[ind_img_prev], channels));
+            if(i > 0) {
+                float distSq = Array<float>::distanceSq(p, p - channels, channels);
 
-                if(dist <= (thr * MAX(n1, n2))) {
-                    neighbors[0] = ind - 1;
-                    nNeighbors++;
+                if(distSq <= (thr_sq * MAX(normSq[ind], normSq[ind - 1]))) {
+                    e |= 1;
                 }
             }
 
-            if((j - 1) > -1) {
-                int ind_img_prev = ind_img - (width * channels);
-
-                float n1 = Array<float>::norm(&data[ind_img], channels);
-                float n2 = Array<float>::norm(&data[ind_img_prev], channels);
-                float dist = sqrtf(Array<float>::distanceSq(&data[ind_img], &data[ind_img_prev], channels));
+            if(j > 0) {
+                float distSq = Array<float>::distanceSq(p, p - width * channels, channels);
 
-                if(dist <= (thr * MAX(n1, n2))) {
-                    neighbors[nNeighbors] = ind - width;
-                    nNeighbors++;
+                if(distSq <= (thr_sq * MAX(normSq[ind], normSq[ind - width]))) {
+                    e |= 2;
                 }
             }
 
-            //No neighbors?
-            if(nNeighbors == 0) {
-                comp->data[ind] = float(label);
-                label++;
-            }
+            edges[ind] = e;
+        }
+    }
 
-            if(nNeighbors == 1) {
-                comp->data[ind] = comp->data[neighbors[0]];
-            }
+    delete[] normSq;
 
-            if(nNeighbors == 2) {
-                //Assigning the label of neighbors
-                float minVal, t1, t2;
-                t1 = comp->data[neighbors[0]];
-                t2 = comp->data[neighbors[1]];
-                minVal = MIN(t1, t2);
+    //First pass: provisional labels are pixel indices; each strip only
+    //links pixels inside itself
+    int *parent = new int[n];
+    int nStrips = MAX(MIN(getNumberOfThreads(), height), 1);
 
-                //Tracking neighbors
-                LabelInfo tmpLI;
-                bool test = true;
+    #pragma omp parallel for
 
-                while(test) {
-                    test = false;
-                    tmpLI.id = minVal;
-                    it = labelEq.find(tmpLI);
+    for(int s = 0; s < nStrips; s++) {
+        int y0 = (height * s) / nStrips;
+        int y1 = (height * (s + 1)) / nStrips;
 
-                    if(it != labelEq.end()) {
-                        float tmpMinLabel = it->minLabel;
+        for(int j = y0; j < y1; j++) {
+            for(int i = 0; i < width; i++) {
+                int ind = j * width + i;
+                bool bLeft = (edges[ind] & 1) != 0;
+                bool bTop = ((edges[ind] & 2) != 0) && (j > y0);
 
-                        if(minVal > tmpMinLabel) {
-                            minVal = tmpMinLabel;
-                            test = true;
+                if(bLeft && bTop) {
+                    parent[ind] = ind;
+                    parent[ind] = unionUF(parent, ind - 1, ind - width);
+                } else {
+                    if(bLeft) {
+                        parent[ind] = parent[ind - 1];
+                    } else {
+                        if(bTop) {
+                            parent[ind] = parent[ind - width];
+                        } else {
+                            parent[ind] = ind;
                         }
                     }
                 }
-
-                comp->data[ind] = minVal;
-
-                //Tracking T1
-                test = true;
-                tmpLI.id = t1;
-                it = labelEq.find(tmpLI);
-
-                if(it != labelEq.end()) {
-                    LabelInfo tmp_it;
-                    tmp_it.id = it->id;
-                    tmp_it.minLabel = minVal;
-
-                    labelEq.erase(it);
-                    labelEq.insert(tmp_it);
-                } else {
-                    LabelInfo tmpLabelInfo;
-                    tmpLabelInfo.id = t1;
-                    tmpLabelInfo.minLabel = minVal;
-                    labelEq.insert(tmpLabelInfo);
-                }
-
-                //T2
-                tmpLI.id = t2;
-                it = labelEq.find(tmpLI);
-
-                if(it != labelEq.end()) {
-                    LabelInfo tmp_it;
-                    tmp_it.id = it->id;
-                    tmp_it.minLabel = minVal;
-
-                    labelEq.erase(it);
-                    labelEq.insert(tmp_it);
-                } else {
-                    LabelInfo tmpLabelInfo;
-                    tmpLabelInfo.id = t2;
-                    tmpLabelInfo.minLabel = minVal;
-                    labelEq.insert(tmpLabelInfo);
-                }
             }
         }
     }
 
-    //Label Search
-    LabelInfo tmpLI;
-    std::set<LabelInfo>::iterator it2;
-
-    std::set<LabelInfo> labelEq_new;
+    //Merge step across strip boundaries
+    for(int s = 1; s < nStrips; s++) {
+        int j = (height * s) / nStrips;
 
-    for(it2 = labelEq.begin() ; it2 != labelEq.end(); it2++) {
-        float minVal = it2->minLabel;
-        bool test = true;
-
-        while(test) {
-            test = false;
-            tmpLI.id = minVal;
-            it = labelEq.find(tmpLI);
-
-            if(it != labelEq.end()) {
-                float tmpMinLabel = (*it).minLabel;
+        for(int i = 0; i < width; i++) {
+            int ind = j * width + i;
 
-                if(minVal > tmpMinLabel) {
-                    minVal = tmpMinLabel;
-                    test = true;
-                }
+            if(edges[ind] & 2) {
+                unionUF(parent, ind, ind - width);
             }
         }
-
-        LabelInfo tmp_it;
-        tmp_it.id = it2->id;
-        tmp_it.minLabel = minVal;
-        labelEq_new.insert(tmp_it);
     }
 
-    //Second pass: using tracked neighbors
-    //for assigning the correct labels
-    //TO DO: optimizing outside this loop
-    std::set<float> unique;
-    std::set<float>::iterator uniqueIt;
-    std::map<float, int> mapping;
+    delete[] edges;
 
+    //Second pass: flattening into consecutive labels; since parent[i] <= i,
+    //parent[parent[i]] already stores the final label of the component
+    int offset = int(ret.size());
     int counter = 0;
 
-    for(int i=0; i < n; i++) {
-        tmpLI.id = comp->data[i];
-        it = labelEq_new.find(tmpLI);
-
-        if(it != labelEq_new.end()) {
-            comp->data[i] = it->minLabel;
-        }
+    for(int j = 0; j < height; j++) {
+        for(int i = 0; i < width; i++) {
+            int ind = j * width + i;
+            int label;
 
-        //store coordiantes of the connected components
-        float id = comp->data[i];
-        uniqueIt = unique.find(id);
+            if(parent[ind] < ind) {
+                label = parent[parent[ind]];
+                parent[ind] = label;
 
-        if(uniqueIt != unique.end()) {
-            ret[mapping[id]].add(i);
-        } else {
-            std::pair<float, int> tmp = std::make_pair(id, counter);
-            mapping.insert(tmp);
+                LabelOutput &lo = ret[offset + label];
+                lo.area++;
+                lo.box.x0 = MIN(lo.box.x0, i);
+                lo.box.x1 = MAX(lo.box.x1, i + 1);
+                lo.box.y1 = j + 1;
 
-            LabelOutput tmpRet(id, i);
-            ret.push_back(tmpRet);
+                if(bCoords) {
+                    lo.add(ind);
+                }
+            } else {
+                label = counter;
+                parent[ind] = label;
+                counter++;
+
+                LabelOutput tmpRet(float(label + 1), ind, bCoords);
+                tmpRet.box.SetBox(i, i + 1, j, j + 1, 0, 1, width, height, 1);
+                ret.push_back(tmpRet);
+            }
 
-            unique.insert(id);
-            counter++;
+            comp->data[ind] = float(label + 1);
         }
     }
+
+    delete[] parent;
+
     return comp;
 }
 
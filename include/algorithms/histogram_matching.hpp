@@ -48,15 +48,12 @@ PIC_INLINE Image *matchHistograms(Image* img_source, Image* img_target, int nBin
 
     int channels = img_source->channels;
 
-    Histogram *h_source = new Histogram[channels];
-    Histogram *h_target = new Histogram[channels];
+    Histogram *h_source = Histogram::calculateAll(img_source, VS_LIN, nBin);
+    Histogram *h_target = Histogram::calculateAll(img_target, VS_LIN, nBin);
 
     std::vector<int *> lut;
 
     for(int i=0; i<channels; i++) {
-        h_source[i].calculate(img_source, VS_LIN, nBin, i);
-        h_target[i].calculate(img_target, VS_LIN, nBin, i);
-
         h_source[i].cumulativef(true);
         h_target[i].cumulativef(true);
 
@@ -89,6 +86,13 @@ PIC_INLINE Image *matchHistograms(Image* img_source, Image* img_target, int nBin
         }
     }
 
+    for(unsigned int i = 0; i < lut.size(); i++) {
+        delete[] lut[i];
+    }
+
+    delete[] h_source;
+    delete[] h_target;
+
     return out;
 }
 
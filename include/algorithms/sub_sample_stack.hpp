@@ -45,12 +45,12 @@ protected:
 
         Histogram *h = new Histogram[exposures * channels];
 
-        int c = 0;
-        for(int j = 0; j < channels; j++) {
-            for(int i = 0; i < exposures; i++) {
-                h[c].calculate(stack[i], VS_LDR, 256, j);
-                h[c].cumulativef(true);
-                c++;
+        for(int i = 0; i < exposures; i++) {
+            Histogram *h_i = &h[i * channels];
+            Histogram::calculateAll(stack[i], VS_LDR, 256, h_i);
+
+            for(int j = 0; j < channels; j++) {
+                h_i[j].cumulativef(true);
             }
         }
 
@@ -66,7 +66,7 @@ protected:
         #endif
 
         float div = float(nSamples - 1);
-        c = 0;
+        int c = 0;
         for(int k = 0; k < channels; k++) {
             for(int i = 0; i < nSamples; i++) {
 
@@ -74,7 +74,7 @@ protected:
 
                 for(int j = 0; j < exposures; j++) {
 
-                    int ind = k * exposures + j;
+                    int ind = j * channels + k;
 
                     float *bin_c = h[ind].getCumulativef();
 
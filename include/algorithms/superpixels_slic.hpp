@@ -19,6 +19,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_ALGORITHMS_SUPERPIXELS_SLIC_HPP
 
 #include "../image.hpp"
+#include "../util/std_util.hpp"
 #include "../filtering/filter_laplacian.hpp"
 
 namespace pic {
@@ -32,17 +33,21 @@ struct SlicoCenter {
 };
 
 /**
- * @brief The Slic class
+ * @brief The Slic class computes SLICO super-pixels. The assignment step
+ * is run in parallel over the clusters' grid using a 3x3 colouring: each
+ * cluster owns the 3x3 block of grid cells around its own cell, and clusters
+ * of the same colour own disjoint blocks, so they can write labels without
+ * conflicts.
  */
 class Slic
 {
 protected:
 
-    int             nSuperPixels;
+    int             nSuperPixels, nX, nY, S;
     Image           *labels_distance, *lap_img;
     SlicoCenter     *centers;
     unsigned int    *prevX, *prevY, *counter;
-    float           *col_values, *mPixel;
+    float           *mPixel;
     int             width, height, channels;
 
     /**
@@ -80,196 +85,391 @@ protected:
     }
 
     /**
-     * @brief pass
+     * @brief assignCluster assigns the pixels in the 2S x 2S window
+     * of a cluster; the window is clipped to the cluster's ownership
+     * region, i.e. the 3x3 block of grid cells around (gx, gy).
      * @param img
-     * @param S
-     * @return
+     * @param i is the index of the cluster.
+     * @param gx is the horizontal grid coordinate of the cluster.
+     * @param gy is the vertical grid coordinate of the cluster.
      */
-    bool pass(Image *img, int S)
+    void assignCluster(Image *img, int i, int gx, int gy)
     {
-        float Sf = float(S);
-        float Sf2 = Sf * Sf;
+        int cx = int(centers[i].x);
+        int cy = int(centers[i].y);
+
+        int ox0 = gx > 0 ? (gx - 1) * S : 0;
+        int ox1 = gx < (nX - 1) ? (gx + 2) * S : width;
+        int oy0 = gy > 0 ? (gy - 1) * S : 0;
+        int oy1 = gy < (nY - 1) ? (gy + 2) * S : height;
+
+        int x0 = MAX(cx - S, ox0);
+        int x1 = MIN(cx + S, ox1);
+        int y0 = MAX(cy - S, oy0);
+        int y1 = MIN(cy + S, oy1);
+
+        float i_f = float(i);
+        float inv_Sf2 = 1.0f / float(S * S);
+        float inv_m = 1.0f / mPixel[i];
+        float *value = centers[i].value;
+
+        for(int y = y0; y < y1; y++) {
+            float *pixel = img->data + y * img->ystride + x0 * channels;
+            float *l_d = labels_distance->data + (y * width + x0) * 3;
+
+            for(int x = x0; x < x1; x++) {
+                float dC = distanceC(pixel, value, channels);
+                float dS = float(distanceS(x, y, cx, cy)) * inv_Sf2;
+                float D = dC * inv_m + dS;
+
+                if(D < l_d[1]) {
+                    l_d[0] = i_f;
+                    l_d[1] = D;
+                    l_d[2] = dC;
+                }
 
-        for(int i = 0; i < nSuperPixels; i++) {
-            prevX[i] = centers[i].x;
-            prevY[i] = centers[i].y;
+                pixel += channels;
+                l_d += 3;
+            }
         }
+    }
 
-        //for each cluster
-        for(int i = 0; i < nSuperPixels; i++) {
-            float i_f = float(i);
+    /**
+     * @brief assignment runs the assignment step.
+     * @param img
+     */
+    void assignment(Image *img)
+    {
+        int n = width * height;
 
-            //Search in Sx2 radius
-            for(int j = -S; j < S; j++) {
-                int vY = centers[i].y + j;
+        #pragma omp parallel for
 
-                for(int k = -S; k < S; k++) {
-                    int vX = centers[i].x + k;
+        for(int i = 0; i < n; i++) {
+            labels_distance->data[i * 3 + 1] = FLT_MAX;
+        }
 
-                    float *pixel = (*img)(vX, vY);
-                    float *l_d   = (*labels_distance)(vX, vY);
+        for(int c = 0; c < 9; c++) {
+            int cx = c % 3;
+            int cy = c / 3;
+            int nCX = (nX - cx + 2) / 3;
+            int nCY = (nY - cy + 2) / 3;
+            int nC = nCX * nCY;
 
-                    float dS = float(distanceS(vX, vY, centers[i].x, centers[i].y)) / Sf2;
-                    float dC = distanceC(pixel, centers[i].value, img->channels) / mPixel[i];
-                    float D = dC + dS;
+            #pragma omp parallel for
 
-                    if(D < l_d[1]) {
-                        l_d[0] = i_f;
-                        l_d[1] = D;
-                        l_d[2] = dC;
-                    }
-                }
+            for(int k = 0; k < nC; k++) {
+                int gx = cx + (k % nCX) * 3;
+                int gy = cy + (k / nCX) * 3;
+                assignCluster(img, gy * nX + gx, gx, gy);
             }
         }
+    }
 
-        //update mPixel
-        for(int i = 0; i < labels_distance->size(); i += labels_distance->channels) {
-            int label = int(labels_distance->data[i]);
+    /**
+     * @brief update computes the new centers from the current labels using
+     * per-thread partial sums over horizontal bands of the image.
+     * @param img
+     * @return This function returns the mean motion in pixels of the centers.
+     */
+    float update(Image *img)
+    {
+        int nBands = MIN(getNumberOfThreads(), height);
+        int stride = 3 + channels;
+        int nP = nSuperPixels * stride;
 
-            if(label < 0) {
-                continue;
+        double *partials = new double[nBands * nP];
+        float *partialsMax = new float[nBands * nSuperPixels];
+
+        #pragma omp parallel for
+
+        for(int b = 0; b < nBands; b++) {
+            double *acc = &partials[b * nP];
+            float *maxDC = &partialsMax[b * nSuperPixels];
+
+            for(int i = 0; i < nP; i++) {
+                acc[i] = 0.0;
             }
 
-            if(mPixel[label] < labels_distance->data[i + 2]) {
-                mPixel[label] = labels_distance->data[i + 2];
+            for(int i = 0; i < nSuperPixels; i++) {
+                maxDC[i] = 0.0f;
+            }
+
+            int y0 = (height * b) / nBands;
+            int y1 = (height * (b + 1)) / nBands;
+
+            for(int y = y0; y < y1; y++) {
+                float *col = img->data + y * img->ystride;
+                float *l_d = labels_distance->data + y * width * 3;
+
+                for(int x = 0; x < width; x++) {
+                    int label = int(l_d[0]);
+
+                    if(label > -1) {
+                        double *acc_l = &acc[label * stride];
+                        acc_l[0] += double(x);
+                        acc_l[1] += double(y);
+                        acc_l[2] += 1.0;
+
+                        for(int p = 0; p < channels; p++) {
+                            acc_l[3 + p] += double(col[p]);
+                        }
+
+                        maxDC[label] = MAX(maxDC[label], l_d[2]);
+                    }
+
+                    col += channels;
+                    l_d += 3;
+                }
             }
         }
 
-        //update clusters
+        double E = 0.0;
+
         for(int i = 0; i < nSuperPixels; i++) {
-            centers[i].x = 0;
-            centers[i].y = 0;
-            counter[i]   = 0;
+            double acc_l[3] = {0.0, 0.0, 0.0};
+            int ind = i * stride;
+
+            for(int b = 0; b < nBands; b++) {
+                double *acc = &partials[b * nP + ind];
 
-            int ind = i * img->channels;
+                for(int p = 0; p < 3; p++) {
+                    acc_l[p] += acc[p];
+                }
 
-            for(int j = 0; j < img->channels; j++) {
-                col_values[ind + j] = 0.0f;
+                mPixel[i] = MAX(mPixel[i], partialsMax[b * nSuperPixels + i]);
             }
-        }
 
-        for(int j = 0; j < img->height; j++) {
-            for(int k = 0; k < img->width; k++) {
-                float *l_d = (*labels_distance)(k, j);
-                int label = int(l_d[0]);
+            prevX[i] = centers[i].x;
+            prevY[i] = centers[i].y;
+            counter[i] = (unsigned int) acc_l[2];
 
-                if(label > -1) {
-                    centers[label].x += k;
-                    centers[label].y += j;
-                    counter[label]++;
+            if(counter[i] == 0) {
+                continue;
+            }
 
-                    int ind = label * img->channels;
-                    float *col = (*img)(k, j);
+            double inv_cnt = 1.0 / acc_l[2];
+            centers[i].x = (unsigned int) (acc_l[0] * inv_cnt + 0.5);
+            centers[i].y = (unsigned int) (acc_l[1] * inv_cnt + 0.5);
 
-                    for(int p = 0; p < img->channels; p++) {
-                        col_values[ind + p] += col[p];
-                    }
+            for(int p = 0; p < channels; p++) {
+                double col = 0.0;
+
+                for(int b = 0; b < nBands; b++) {
+                    col += partials[b * nP + ind + 3 + p];
                 }
+
+                centers[i].value[p] = float(col * inv_cnt);
             }
+
+            int tx = int(prevX[i]) - int(centers[i].x);
+            int ty = int(prevY[i]) - int(centers[i].y);
+            E += sqrt(double(tx * tx + ty * ty));
         }
 
-        float E = 0.0f;
+        delete[] partials;
+        delete[] partialsMax;
 
-        for(int i = 0; i < nSuperPixels; i++) {
-            if(counter[i] <= 0) {
+        return float(E / double(MAX(nSuperPixels, 1)));
+    }
+
+    /**
+     * @brief enforceConnectivity relabels super-pixels such that each label is
+     * a 4-connected region. Regions smaller than minSize are merged into an
+     * adjacent region. Centers are recomputed afterwards.
+     * @param img
+     * @param minSize
+     */
+    void enforceConnectivity(Image *img, int minSize)
+    {
+        int n = width * height;
+        int *oldLabels = getLabelsBuffer(NULL);
+        int *newLabels = new int[n];
+
+        for(int i = 0; i < n; i++) {
+            newLabels[i] = -1;
+        }
+
+        const int dx[4] = {-1, 0, 1, 0};
+        const int dy[4] = {0, -1, 0, 1};
+
+        std::vector<int> region;
+        int label = 0;
+
+        for(int i = 0; i < n; i++) {
+            if(newLabels[i] > -1) {
                 continue;
             }
 
-            centers[i].x /= counter[i];
-            centers[i].y /= counter[i];
-            int ind = i * img->channels;
+            int x = i % width;
+            int y = i / width;
 
-            for(int j = 0; j < img->channels; j++) {
-                centers[i].value[j] = col_values[ind + j] / float(counter[i]);
+            //a label of an already visited neighbour
+            int adjLabel = -1;
+
+            for(int k = 0; k < 4; k++) {
+                int nx = x + dx[k];
+                int ny = y + dy[k];
+
+                if(nx > -1 && nx < width && ny > -1 && ny < height) {
+                    int j = ny * width + nx;
+
+                    if(newLabels[j] > -1) {
+                        adjLabel = newLabels[j];
+                    }
+                }
             }
 
-            //Error
-            int tx = prevX[i] - centers[i].x;
-            int ty = prevY[i] - centers[i].y;
-            float tmpErr = sqrtf(float(tx * tx + ty * ty));
-            E += tmpErr;
+            //flood fill
+            region.clear();
+            region.push_back(i);
+            newLabels[i] = label;
+
+            for(unsigned int c = 0; c < region.size(); c++) {
+                int xc = region[c] % width;
+                int yc = region[c] / width;
+
+                for(int k = 0; k < 4; k++) {
+                    int nx = xc + dx[k];
+                    int ny = yc + dy[k];
+
+                    if(nx > -1 && nx < width && ny > -1 && ny < height) {
+                        int j = ny * width + nx;
+
+                        if(newLabels[j] < 0 && oldLabels[j] == oldLabels[i]) {
+                            newLabels[j] = label;
+                            region.push_back(j);
+                        }
+                    }
+                }
+            }
+
+            if((int(region.size()) <= minSize) && (adjLabel > -1)) {
+                for(unsigned int c = 0; c < region.size(); c++) {
+                    newLabels[region[c]] = adjLabel;
+                }
+            } else {
+                label++;
+            }
         }
 
-        return (E > (0.0001f * float(nSuperPixels)));
-    }
+        for(int i = 0; i < n; i++) {
+            labels_distance->data[i * 3] = float(newLabels[i]);
+        }
 
+        delete[] oldLabels;
+        delete[] newLabels;
 
+        allocateCenters(label, channels);
+
+        for(int i = 0; i < nSuperPixels; i++) {
+            centers[i].x = 0;
+            centers[i].y = 0;
+        }
+
+        update(img);
+    }
 
     /**
-     * @brief allocate
+     * @brief allocateCenters
      * @param nSuperPixels
      * @param channels
      */
-    void allocate(int nSuperPixels, int channels)
+    void allocateCenters(int nSuperPixels, int channels)
     {
+        releaseCenters();
 
         this->nSuperPixels = nSuperPixels;
 
-        release();
-
         centers		= new SlicoCenter[nSuperPixels];
         prevX		= new unsigned int [nSuperPixels];
         prevY		= new unsigned int [nSuperPixels];
         counter		= new unsigned int [nSuperPixels];
         mPixel		= new float [nSuperPixels];
-        col_values	= new float [nSuperPixels * channels];
+
+        for(int i = 0; i < nSuperPixels; i++) {
+            centers[i].value = new float[channels];
+            mPixel[i] = 0.35f * 0.35f;    //10.0f*10.0f;
+        }
     }
 
     /**
-     * @brief release
+     * @brief releaseCenters
      */
-    void release()
+    void releaseCenters()
     {
-        if(lap_img != NULL) {
-            delete lap_img;
-        }
-
-        if(labels_distance != NULL) {
-            delete labels_distance;
-        }
-
         if(centers != NULL) {
+            for(int i = 0; i < nSuperPixels; i++) {
+                delete[] centers[i].value;
+            }
+
             delete[] centers;
+            centers = NULL;
         }
 
         if(prevX != NULL) {
             delete[] prevX;
+            prevX = NULL;
         }
 
         if(prevY != NULL) {
             delete[] prevY;
+            prevY = NULL;
         }
 
         if(counter != NULL) {
             delete[] counter;
-        }
-
-        if(col_values != NULL) {
-            delete[] col_values;
+            counter = NULL;
         }
 
         if(mPixel != NULL) {
             delete[] mPixel;
+            mPixel = NULL;
         }
     }
 
-public:
+    /**
+     * @brief release
+     */
+    void release()
+    {
+        if(lap_img != NULL) {
+            delete lap_img;
+            lap_img = NULL;
+        }
+
+        if(labels_distance != NULL) {
+            delete labels_distance;
+            labels_distance = NULL;
+        }
+
+        releaseCenters();
+    }
 
     /**
-     * @brief Slic
+     * @brief setNULL
      */
-    Slic()
+    void setNULL()
     {
+        nSuperPixels = 0;
         lap_img = NULL;
         labels_distance = NULL;
         centers = NULL;
         prevX = NULL;
         prevY = NULL;
         counter = NULL;
-        col_values = NULL;
         mPixel = NULL;
     }
 
+public:
+
+    /**
+     * @brief Slic
+     */
+    Slic()
+    {
+        setNULL();
+    }
+
     /**
      * @brief Slic
      * @param img
@@ -277,14 +477,7 @@ public:
      */
     Slic(Image *img, int nSuperPixels = 64)
     {
-        lap_img = NULL;
-        labels_distance = NULL;
-        centers = NULL;
-        prevX = NULL;
-        prevY = NULL;
-        counter = NULL;
-        col_values = NULL;
-        mPixel = NULL;
+        setNULL();
 
         execute(img, nSuperPixels);
     }
@@ -298,27 +491,33 @@ public:
      * @brief execute
      * @param img
      * @param nSuperPixels
+     * @param maxIterations is the maximum number of iterations.
+     * @param threshold is the mean motion of the centers, in pixels, below
+     * which iterations stop.
+     * @param bConnectivity enforces connectivity of the super-pixels.
      */
-    void execute(Image *img, int nSuperPixels = 64)
+    void execute(Image *img, int nSuperPixels = 64, int maxIterations = 10,
+                 float threshold = 0.25f, bool bConnectivity = true)
     {
         if(img == NULL) {
             return;
         }
 
         //Init
-        int S = int(sqrtf(img->widthf * img->heightf) / float(nSuperPixels));
+        S = int(sqrtf(img->widthf * img->heightf) / float(nSuperPixels));
 
         if(S < 1) {
             return;
         }
 
-        nSuperPixels = (img->width / S) * (img->height / S);
+        release();
+
+        nX = img->width / S;
+        nY = img->height / S;
 
-        allocate(nSuperPixels, img->channels);
+        allocateCenters(nX * nY, img->channels);
 
-        if(labels_distance == NULL) {
-            labels_distance = new Image(1, img->width, img->height, 3);
-        }
+        labels_distance = new Image(1, img->width, img->height, 3);
 
         for(int i = 0; i < labels_distance->size(); i += labels_distance->channels) {
             labels_distance->data[i    ] = -1.0f;
@@ -333,67 +532,66 @@ public:
         FilterLaplacian lap;
         lap_img = lap.ProcessP(Single(img), lap_img);
 
-        for(int i = 0; i < nSuperPixels; i++) {
-            mPixel[i] = 0.35f * 0.35f;    //10.0f*10.0f;
-        }
-
         #ifdef PIC_DEBUG
-            printf("nSuperPixels: %d S: %d\n", nSuperPixels, S);
+            printf("nSuperPixels: %d S: %d\n", this->nSuperPixels, S);
         #endif
         
-        int ind = 0;
         int S_half = S >> 1;
 
-        for(int i = S_half; i < (img->height - S_half + 1); i += S) {
-            for(int j = S_half; j < (img->width - S_half + 1); j += S) {
+        #pragma omp parallel for
 
-                float bValue = FLT_MAX;
-                int bX, bY;
+        for(int ind = 0; ind < this->nSuperPixels; ind++) {
+            int i = S_half + (ind / nX) * S;
+            int j = S_half + (ind % nX) * S;
 
-                for(int y = -1; y <= 1; y++) {
-                    for(int x = -1; x <= 1; x++) {
-                        int ix = (j + x);
-                        int iy = (i + y);
-                        float *data = (*lap_img)(ix, iy);
+            float bValue = FLT_MAX;
+            int bX = j;
+            int bY = i;
 
-                        float acc = 0.0f;
+            for(int y = -1; y <= 1; y++) {
+                for(int x = -1; x <= 1; x++) {
+                    int ix = (j + x);
+                    int iy = (i + y);
+                    float *data = (*lap_img)(ix, iy);
 
-                        for(int c = 0; c < img->channels; c++) {
-                            acc += fabsf(data[c]);
-                        }
+                    float acc = 0.0f;
 
-                        if(acc < bValue) {
-                            bValue = acc;
-                            bX = ix;
-                            bY = iy;
-                        }
+                    for(int c = 0; c < img->channels; c++) {
+                        acc += fabsf(data[c]);
+                    }
+
+                    if(acc < bValue) {
+                        bValue = acc;
+                        bX = ix;
+                        bY = iy;
                     }
                 }
+            }
 
-                centers[ind].x = bX;
-                centers[ind].y = bY;
-                centers[ind].value = new float [img->channels];
+            centers[ind].x = bX;
+            centers[ind].y = bY;
 
-                BBox box(centers[ind].x - S_half, centers[ind].x + S_half + 1,
-                         centers[ind].y - S_half, centers[ind].y + S_half + 1);
+            BBox box(centers[ind].x - S_half, centers[ind].x + S_half + 1,
+                     centers[ind].y - S_half, centers[ind].y + S_half + 1);
 
-                img->getMeanVal(&box, centers[ind].value);
-                ind++;
-            }
+            img->getMeanVal(&box, centers[ind].value);
         }
 
         //For each pass
         int iter = 0;
-        bool bCheck = true;
 
-        while(bCheck) {
-            bCheck = pass(img, S);
+        while(iter < maxIterations) {
+            assignment(img);
+            float E = update(img);
+            iter++;
 
-            if(!bCheck && iter <= 10) {
-                bCheck = true;
+            if(E < threshold) {
+                break;
             }
+        }
 
-            iter++;
+        if(bConnectivity) {
+            enforceConnectivity(img, (S * S) >> 2);
         }
 
         #ifdef PIC_DEBUG
@@ -401,6 +599,15 @@ public:
         #endif
     }
 
+    /**
+     * @brief getNumberOfSuperPixels
+     * @return This function returns the number of super-pixels.
+     */
+    int getNumberOfSuperPixels()
+    {
+        return nSuperPixels;
+    }
+
     /**
      * @brief getLabelsBuffer
      * @param out
@@ -423,7 +630,7 @@ public:
         }
 
         for(int i = 0; i < size; i++) {
-            out[i] = int(labels_distance->data[i << 1]);
+            out[i] = int(labels_distance->data[i * 3]);
         }
 
         return out;
@@ -440,11 +647,13 @@ public:
             imgOut = new Image(1, width, height, channels);
         }
 
+        #pragma omp parallel for
+
         for(int i = 0; i < height; i++) {
-            for(int j = 0; j < width; j++) {
-                float *pixel = (*imgOut)(j, i);
-                float *l_d   = (*labels_distance)(j, i);
+            float *pixel = imgOut->data + i * imgOut->ystride;
+            float *l_d   = labels_distance->data + i * width * 3;
 
+            for(int j = 0; j < width; j++) {
                 int label = int(l_d[0]);
 
                 if(label > -1) {
@@ -452,6 +661,9 @@ public:
                         pixel[k] = centers[label].value[k];
                     }
                 }
+
+                pixel += channels;
+                l_d += 3;
             }
         }
 
@@ -462,4 +674,3 @@ public:
 } // end namespace pic
 
 #endif /* PIC_ALGORITHMS_SUPERPIXELS_SLIC_HPP */
-
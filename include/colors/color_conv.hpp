@@ -18,6 +18,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_COLORS_COLOR_CONV_HPP
 #define PIC_COLORS_COLOR_CONV_HPP
 
+#include "../util/math.hpp"
+
 namespace pic {
 
 /**
@@ -62,6 +64,83 @@ public:
         }
     }
 
+    /**
+     * @brief getMatrix returns the 3x3 matrix of a linear conversion,
+     * so that chains of linear conversions can be composed.
+     * @param mtx is an array of 9 values in row order.
+     * @param bDirection
+     * @return It returns false if the conversion is not linear.
+     */
+    virtual bool getMatrix(float *, bool)
+    {
+        return false;
+    }
+
+    /**
+     * @brief directSpan converts a span of pixels; only the first three
+     * channels are converted. dataIn and dataOut can be the same buffer.
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast enables polynomial or tabulated approximations of
+     * transcendental functions, when a conversion has them.
+     */
+    virtual void directSpan(float *dataIn, float *dataOut, int nPixels,
+                            int channels, bool = false)
+    {
+        for(int i = 0; i < nPixels; i++) {
+            float tmp[3];
+            float *col = &dataIn[i * channels];
+            tmp[0] = col[0];
+            tmp[1] = col[1];
+            tmp[2] = col[2];
+
+            direct(tmp, &dataOut[i * channels]);
+        }
+    }
+
+    /**
+     * @brief inverseSpan is the inverse of directSpan.
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast
+     */
+    virtual void inverseSpan(float *dataIn, float *dataOut, int nPixels,
+                             int channels, bool = false)
+    {
+        for(int i = 0; i < nPixels; i++) {
+            float tmp[3];
+            float *col = &dataIn[i * channels];
+            tmp[0] = col[0];
+            tmp[1] = col[1];
+            tmp[2] = col[2];
+
+            inverse(tmp, &dataOut[i * channels]);
+        }
+    }
+
+    /**
+     * @brief transformSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bDirection
+     * @param bFast
+     */
+    void transformSpan(float *dataIn, float *dataOut, int nPixels,
+                       int channels, bool bDirection, bool bFast = false)
+    {
+        if(bDirection) {
+            directSpan(dataIn, dataOut, nPixels, channels, bFast);
+        } else {
+            inverseSpan(dataIn, dataOut, nPixels, channels, bFast);
+        }
+    }
+
     /**
      * @brief apply
      * @param mtx
@@ -82,6 +161,60 @@ public:
         colOut[2] = tmp[0] * mtx[6] + tmp[1] * mtx[7] + tmp[2] * mtx[8];
     }
 
+    /**
+     * @brief applySpan applies a matrix to a span of pixels; only the first
+     * three channels are converted. dataIn and dataOut can be the same buffer.
+     * @param mtx
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     */
+    static void applySpan(const float *mtx, float *dataIn, float *dataOut,
+                          int nPixels, int channels)
+    {
+        float m0 = mtx[0], m1 = mtx[1], m2 = mtx[2];
+        float m3 = mtx[3], m4 = mtx[4], m5 = mtx[5];
+        float m6 = mtx[6], m7 = mtx[7], m8 = mtx[8];
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float c0 = colIn[0];
+            float c1 = colIn[1];
+            float c2 = colIn[2];
+
+            colOut[0] = c0 * m0 + c1 * m1 + c2 * m2;
+            colOut[1] = c0 * m3 + c1 * m4 + c2 * m5;
+            colOut[2] = c0 * m6 + c1 * m7 + c2 * m8;
+        }
+    }
+
+    /**
+     * @brief multiply composes two matrices: applying out is the same
+     * as applying B and then A.
+     * @param A
+     * @param B
+     * @param out is an array of 9 values; it can be A or B.
+     */
+    static void multiply(const float *A, const float *B, float *out)
+    {
+        float tmp[9];
+
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 3; j++) {
+                tmp[i * 3 + j] = A[i * 3    ] * B[j    ] +
+                                 A[i * 3 + 1] * B[j + 3] +
+                                 A[i * 3 + 2] * B[j + 6];
+            }
+        }
+
+        for(int i = 0; i < 9; i++) {
+            out[i] = tmp[i];
+        }
+    }
+
     /**
      * @brief apply_s a safe apply
      * @param mtx
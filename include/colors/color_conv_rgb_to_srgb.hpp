@@ -31,6 +31,60 @@ protected:
 
     float a, a_plus_1, gamma, gamma_inv;
 
+    static const int lutSize = 65536;
+
+    /**
+     * @brief getLUT returns a table of lutSize + 1 samples of the encoding
+     * (bDirection = true) or decoding curve in [0, 1]; tables are computed
+     * once in double precision.
+     * @param bDirection
+     * @return
+     */
+    static const float *getLUT(bool bDirection)
+    {
+        struct LUT {
+            float data[lutSize + 1];
+
+            LUT(bool bDirection)
+            {
+                for(int i = 0; i <= lutSize; i++) {
+                    double x = double(i) / double(lutSize);
+
+                    if(bDirection) {
+                        data[i] = float((x > 0.0031308) ?
+                                  (1.055 * pow(x, 1.0 / 2.4) - 0.055) :
+                                  (12.92 * x));
+                    } else {
+                        data[i] = float((x > 0.04045) ?
+                                  pow((x + 0.055) / 1.055, 2.4) :
+                                  (x / 12.92));
+                    }
+                }
+            }
+        };
+
+        static const LUT lutEncode(true);
+        static const LUT lutDecode(false);
+
+        return bDirection ? lutEncode.data : lutDecode.data;
+    }
+
+    /**
+     * @brief applyLUT evaluates a curve in [0, 1] with linear interpolation
+     * of its table; values outside [0, 1] are left untouched.
+     * @param lut
+     * @param x
+     * @return
+     */
+    static inline float applyLUT(const float *lut, float x)
+    {
+        float t = x * float(lutSize);
+        int i = int(t);
+        i = CLAMPi(i, 0, lutSize - 1);
+        float w = t - float(i);
+        return lut[i] + (lut[i + 1] - lut[i]) * w;
+    }
+
 public:
 
     /**
@@ -75,6 +129,82 @@ public:
             }
         }
     }
+
+    /**
+     * @brief directSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses a 16-bit table with linear interpolation in [0, 1].
+     */
+    void directSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                    bool bFast = false)
+    {
+        if(!bFast) {
+            for(int i = 0; i < nPixels; i++) {
+                ColorConvRGBtosRGB::direct(&dataIn[i * channels], &dataOut[i * channels]);
+            }
+            return;
+        }
+
+        const float *lut = getLUT(true);
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            for(int k = 0; k < 3; k++) {
+                float x = colIn[k];
+
+                if(x > 0.0031308f && x <= 1.0f) {
+                    colOut[k] = applyLUT(lut, x);
+                } else {
+                    colOut[k] = (x > 0.0031308f) ?
+                                (a_plus_1 * powf(x, gamma_inv) - a) :
+                                (12.92f * x);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief inverseSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses a 16-bit table with linear interpolation in [0, 1].
+     */
+    void inverseSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                     bool bFast = false)
+    {
+        if(!bFast) {
+            for(int i = 0; i < nPixels; i++) {
+                ColorConvRGBtosRGB::inverse(&dataIn[i * channels], &dataOut[i * channels]);
+            }
+            return;
+        }
+
+        const float *lut = getLUT(false);
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            for(int k = 0; k < 3; k++) {
+                float x = colIn[k];
+
+                if(x >= 0.0f && x <= 1.0f) {
+                    colOut[k] = applyLUT(lut, x);
+                } else {
+                    colOut[k] = (x > 0.04045f) ?
+                                powf((x + a) / a_plus_1, gamma) :
+                                (x / 12.92f);
+                }
+            }
+        }
+    }
 };
 
 } // end namespace pic
@@ -65,6 +65,49 @@ public:
     {
         apply(mtxXYZtoRGB, colIn, colOut);
     }
+
+    /**
+     * @brief getMatrix
+     * @param mtx
+     * @param bDirection
+     * @return
+     */
+    bool getMatrix(float *mtx, bool bDirection)
+    {
+        const float *src = bDirection ? mtxRGBtoXYZ : mtxXYZtoRGB;
+
+        for(int i = 0; i < 9; i++) {
+            mtx[i] = src[i];
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief directSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     */
+    void directSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                    bool = false)
+    {
+        applySpan(mtxRGBtoXYZ, dataIn, dataOut, nPixels, channels);
+    }
+
+    /**
+     * @brief inverseSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     */
+    void inverseSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                     bool = false)
+    {
+        applySpan(mtxXYZtoRGB, dataIn, dataOut, nPixels, channels);
+    }
 };
 
 } // end namespace pic
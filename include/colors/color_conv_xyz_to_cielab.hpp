@@ -79,6 +79,71 @@ public:
         colOut[2] = white_point[2] * f_inv(tmp - colIn[2] / 200.0f);
     }
 
+    /**
+     * @brief directSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses fastCbrtf instead of powf.
+     */
+    void directSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                    bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::directSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        float wp_inv[3];
+        for(int k = 0; k < 3; k++) {
+            wp_inv[k] = 1.0f / white_point[k];
+        }
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float fX = f_fast(colIn[0] * wp_inv[0]);
+            float fY = f_fast(colIn[1] * wp_inv[1]);
+            float fZ = f_fast(colIn[2] * wp_inv[2]);
+
+            colOut[0] = 116.0f * fY - 16.0f;
+            colOut[1] = 500.0f * (fX - fY);
+            colOut[2] = 200.0f * (fY - fZ);
+        }
+    }
+
+    /**
+     * @brief inverseSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses products instead of powf.
+     */
+    void inverseSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                     bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::inverseSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float tmp = (colIn[0] + 16.0f) / 116.0f;
+            float a = colIn[1] / 500.0f;
+            float b = colIn[2] / 200.0f;
+
+            colOut[0] = white_point[0] * f_inv_fast(tmp + a);
+            colOut[1] = white_point[1] * f_inv_fast(tmp);
+            colOut[2] = white_point[2] * f_inv_fast(tmp - b);
+        }
+    }
+
     /**
      * @brief f
      * @param t
@@ -107,6 +172,31 @@ public:
             return (t - C_FOUR_OVER_TWENTY_NINE) * C_CIELAB_C1_INV;
         }
     }
+
+    /**
+     * @brief f_fast is f with fastCbrtf; the relative error of
+     * the cubic root is below 3e-7.
+     * @param t
+     * @return
+     */
+    static inline float f_fast(float t)
+    {
+        float c = fastCbrtf(t);
+        float l = C_CIELAB_C1 * t + C_FOUR_OVER_TWENTY_NINE;
+        return (t > C_SIX_OVER_TWENTY_NINE_CUBIC) ? c : l;
+    }
+
+    /**
+     * @brief f_inv_fast
+     * @param t
+     * @return
+     */
+    static inline float f_inv_fast(float t)
+    {
+        float c = t * t * t;
+        float l = (t - C_FOUR_OVER_TWENTY_NINE) * C_CIELAB_C1_INV;
+        return (t > C_SIX_OVER_TWENTY_NINE) ? c : l;
+    }
 };
 
 } // end namespace pic
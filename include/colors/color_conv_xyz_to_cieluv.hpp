@@ -19,38 +19,188 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_COLORS_COLOR_CONV_XYZ_TO_CIELUV_HPP
 
 #include "../colors/color_conv.hpp"
+#include "../colors/color_conv_xyz_to_cielab.hpp"
 
 namespace pic {
 
+/**
+ * @brief The ColorConvXYZtoCIELUV class
+ */
 class ColorConvXYZtoCIELUV: public ColorConv
 {
 protected:
 
     float		white_point[3];
+    float		u_n, v_n;
+
+    /**
+     * @brief getChromaticity computes the (u', v') chromaticity of a color;
+     * black is mapped to the white point.
+     * @param col
+     * @param u
+     * @param v
+     */
+    inline void getChromaticity(float *col, float &u, float &v)
+    {
+        float den = col[0] + 15.0f * col[1] + 3.0f * col[2];
+
+        if(den > 0.0f) {
+            u = (4.0f * col[0]) / den;
+            v = (9.0f * col[1]) / den;
+        } else {
+            u = u_n;
+            v = v_n;
+        }
+    }
+
+    /**
+     * @brief fromLuv computes XYZ from L*, and the (u', v') chromaticity.
+     * @param Y
+     * @param u
+     * @param v
+     * @param colOut
+     */
+    static inline void fromLuv(float Y, float u, float v, float *colOut)
+    {
+        if(v > 0.0f) {
+            float tmp = Y / (4.0f * v);
+            colOut[0] = 9.0f * u * tmp;
+            colOut[1] = Y;
+            colOut[2] = (12.0f - 3.0f * u - 20.0f * v) * tmp;
+        } else {
+            colOut[0] = 0.0f;
+            colOut[1] = 0.0f;
+            colOut[2] = 0.0f;
+        }
+    }
 
 public:
 
+    /**
+     * @brief ColorConvXYZtoCIELUV
+     */
     ColorConvXYZtoCIELUV()
     {
         white_point[0] = 1.0f;
         white_point[1] = 1.0f;
         white_point[2] = 1.0f;
+
+        getChromaticity(white_point, u_n, v_n);
     }
 
-    //from XYZ to CIE LUV
+    /**
+     * @brief direct converts from XYZ to CIE L*u*v*.
+     * @param colIn
+     * @param colOut
+     */
     void direct(float *colIn, float *colOut)
     {
+        float u, v;
+        getChromaticity(colIn, u, v);
 
+        float L = 116.0f * ColorConvXYZtoCIELAB::f(colIn[1] / white_point[1]) - 16.0f;
+
+        colOut[0] = L;
+        colOut[1] = 13.0f * L * (u - u_n);
+        colOut[2] = 13.0f * L * (v - v_n);
     }
 
-    //from CIE LUV to XYZ
+    /**
+     * @brief inverse converts from CIE L*u*v* to XYZ.
+     * @param colIn
+     * @param colOut
+     */
     void inverse(float *colIn, float *colOut)
     {
+        float L = colIn[0];
+
+        if(L <= 0.0f) {
+            colOut[0] = 0.0f;
+            colOut[1] = 0.0f;
+            colOut[2] = 0.0f;
+            return;
+        }
+
+        float L13_inv = 1.0f / (13.0f * L);
+        float u = colIn[1] * L13_inv + u_n;
+        float v = colIn[2] * L13_inv + v_n;
+        float Y = white_point[1] * ColorConvXYZtoCIELAB::f_inv((L + 16.0f) / 116.0f);
 
+        fromLuv(Y, u, v, colOut);
+    }
+
+    /**
+     * @brief directSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses fastCbrtf instead of powf.
+     */
+    void directSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                    bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::directSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        float wp_inv = 1.0f / white_point[1];
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float u, v;
+            getChromaticity(colIn, u, v);
+
+            float L = 116.0f * ColorConvXYZtoCIELAB::f_fast(colIn[1] * wp_inv) - 16.0f;
+
+            colOut[0] = L;
+            colOut[1] = 13.0f * L * (u - u_n);
+            colOut[2] = 13.0f * L * (v - v_n);
+        }
+    }
+
+    /**
+     * @brief inverseSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses products instead of powf.
+     */
+    void inverseSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                     bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::inverseSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float L = colIn[0];
+
+            if(L <= 0.0f) {
+                colOut[0] = 0.0f;
+                colOut[1] = 0.0f;
+                colOut[2] = 0.0f;
+                continue;
+            }
+
+            float L13_inv = 1.0f / (13.0f * L);
+            float u = colIn[1] * L13_inv + u_n;
+            float v = colIn[2] * L13_inv + v_n;
+            float Y = white_point[1] * ColorConvXYZtoCIELAB::f_inv_fast((L + 16.0f) / 116.0f);
+
+            fromLuv(Y, u, v, colOut);
+        }
     }
 };
 
 } // end namespace pic
 
-#endif /* PIC_COLORS_COLOR_SPACE_CIELUV_HPP */
-
+#endif /* PIC_COLORS_COLOR_CONV_XYZ_TO_CIELUV_HPP */
@@ -48,7 +48,8 @@ public:
         Ys = 0.5f;
         Yabs = 1.0f;
 
-        two_e = powf(2.0f, computeEpsilon(Ys, Yabs));
+        epsilon = computeEpsilon(Ys, Yabs);
+        two_e = powf(2.0f, epsilon);
     }
 
     /**
@@ -98,6 +99,71 @@ public:
         colOut[2] = whitePoint[2] * f_inv( colIn[0] - colIn[2]/2.0f );
     }
 
+    /**
+     * @brief directSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses fastPowf instead of powf.
+     */
+    void directSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                    bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::directSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        float wp_inv[3];
+        for(int k = 0; k < 3; k++) {
+            wp_inv[k] = 1.0f / whitePoint[k];
+        }
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float fX = f_fast(colIn[0] * wp_inv[0]);
+            float fY = f_fast(colIn[1] * wp_inv[1]);
+            float fZ = f_fast(colIn[2] * wp_inv[2]);
+
+            colOut[0] = fY;
+            colOut[1] = 5.0f * (fX - fY);
+            colOut[2] = 2.0f * (fY - fZ);
+        }
+    }
+
+    /**
+     * @brief inverseSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses fastPowf instead of powf.
+     */
+    void inverseSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                     bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::inverseSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float L = colIn[0];
+            float a = colIn[1] / 5.0f;
+            float b = colIn[2] / 2.0f;
+
+            colOut[0] = whitePoint[0] * f_inv_fast(L + a);
+            colOut[1] = whitePoint[1] * f_inv_fast(L);
+            colOut[2] = whitePoint[2] * f_inv_fast(L - b);
+        }
+    }
+
     /**
      * @brief WhitePointD65
      * @param whitePoint
@@ -138,6 +204,28 @@ public:
         return powf(omega_e, 1.0f / epsilon);
     }
 
+    /**
+     * @brief f_fast is f with fastPowf; non-positive values map to 0.02.
+     * @param omega
+     * @return
+     */
+    inline float f_fast(float omega)
+    {
+        float omega_e = fastPowf(omega, epsilon);
+        return (247.0f * omega_e) / (omega_e + two_e) + 0.02f;
+    }
+
+    /**
+     * @brief f_inv_fast
+     * @param x
+     * @return
+     */
+    inline float f_inv_fast(float x)
+    {
+        float omega_e = ( (x - 0.02f) * two_e ) / (247.0f + 0.02f - x);
+        return fastPowf(omega_e, 1.0f / epsilon);
+    }
+
     /**
      * @brief computeEpsilon
      * @param Ys
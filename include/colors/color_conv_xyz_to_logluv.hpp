@@ -82,6 +82,74 @@ public:
         colOut[1] = Y;
         colOut[2] = z * norm;
     }
+
+    /**
+     * @brief directSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses fastLogf instead of logf.
+     */
+    void directSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                    bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::directSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float X = colIn[0];
+            float Y = colIn[1];
+            float Z = colIn[2];
+
+            //u' = 4X / (X + 15Y + 3Z), v' = 9Y / (X + 15Y + 3Z)
+            float norm_uv = X + 15.0f * Y + 3.0f * Z;
+
+            colOut[0] = fastLogf(Y + epsilon);
+            colOut[1] = 4.0f * X / norm_uv;
+            colOut[2] = 9.0f * Y / norm_uv;
+        }
+    }
+
+    /**
+     * @brief inverseSpan
+     * @param dataIn
+     * @param dataOut
+     * @param nPixels
+     * @param channels
+     * @param bFast uses fastExpf instead of expf.
+     */
+    void inverseSpan(float *dataIn, float *dataOut, int nPixels, int channels,
+                     bool bFast = false)
+    {
+        if(!bFast) {
+            ColorConv::inverseSpan(dataIn, dataOut, nPixels, channels, false);
+            return;
+        }
+
+        for(int i = 0; i < nPixels; i++) {
+            float *colIn = &dataIn[i * channels];
+            float *colOut = &dataOut[i * channels];
+
+            float norm = 6.0f * colIn[1] - 16.0f * colIn[2] + 12.0f;
+
+            float x = 9.0f * colIn[1] / norm;
+            float y = 4.0f * colIn[2] / norm;
+            float z = 1.0f - x - y;
+
+            float Y = MAX(fastExpf(colIn[0]) - epsilon, 0.0f);
+            norm = Y / y;
+
+            colOut[0] = x * norm;
+            colOut[1] = Y;
+            colOut[2] = z * norm;
+        }
+    }
 };
 
 } // end namespace pic
@@ -26,6 +26,9 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 *
 **/
 
+#include <math.h>
+#include <string.h>
+
 #include "../base.hpp"
 
 namespace pic {
@@ -121,6 +124,169 @@ PIC_INLINE void fromRGBEToFloat(unsigned char *colRGBE, float *colFloat)
     *(colFloat + 2) = (float(*(colRGBE + 2)) + 0.5f) * f;
 }
 
+/**
+ * @brief convertFloatToRGBEAux is convertFloatToRGBE with a constant number
+ * of channels, C, when C > 0.
+ * @param dataIn
+ * @param dataOut
+ * @param nPixels
+ * @param channels
+ */
+template<int C>
+PIC_INLINE void convertFloatToRGBEAux(float *dataIn, unsigned char *dataOut,
+                                      int nPixels, int channels)
+{
+    if(C > 0) {
+        channels = C;
+    }
+
+    int offset1 = channels > 2 ? 1 : 0;
+    int offset2 = channels > 2 ? 2 : 0;
+
+    for(int i = 0; i < nPixels; i++) {
+        float *col = &dataIn[i * channels];
+        unsigned char *colRGBE = &dataOut[i * 4];
+
+        float r = col[0];
+        float g = col[offset1];
+        float b = col[offset2];
+
+        float v = r;
+
+        if(v < g) {
+            v = g;
+        }
+
+        if(v < b) {
+            v = b;
+        }
+
+        if(v < 1e-32f) { //is it too small?
+            colRGBE[0] = 0;
+            colRGBE[1] = 0;
+            colRGBE[2] = 0;
+            colRGBE[3] = 0;
+            continue;
+        }
+
+        //v = m * 2^e with m in [0.5, 1); e = E - 126
+        int bits;
+        memcpy(&bits, &v, sizeof(float));
+        int E = bits >> 23;
+
+        //2^(8 - e); this is exactly frexp(v, &e) * 256.0f / v
+        int scale_bits = (261 - E) << 23;
+        float scale;
+        memcpy(&scale, &scale_bits, sizeof(float));
+
+        colRGBE[0] = int(r * scale);
+        colRGBE[1] = int(g * scale);
+        colRGBE[2] = int(b * scale);
+        colRGBE[3] = E + 2;
+    }
+}
+
+/**
+ * @brief convertFloatToRGBE encodes a span of pixels into RGBE; the output
+ * is the same of fromFloatToRGBE (or fromSingleFloatToRGBE for channels = 1),
+ * but the exponent and the scale factor 2^(8 - e) are computed on the bits
+ * of the maximum instead of calling frexp and dividing.
+ * @param dataIn is an array of nPixels * channels values; only the first
+ * three channels are encoded.
+ * @param dataOut is an array of nPixels * 4 values.
+ * @param nPixels
+ * @param channels
+ */
+PIC_INLINE void convertFloatToRGBE(float *dataIn, unsigned char *dataOut,
+                                   int nPixels, int channels = 3)
+{
+    switch(channels) {
+    case 1:
+        convertFloatToRGBEAux<1>(dataIn, dataOut, nPixels, channels);
+        break;
+
+    case 3:
+        convertFloatToRGBEAux<3>(dataIn, dataOut, nPixels, channels);
+        break;
+
+    case 4:
+        convertFloatToRGBEAux<4>(dataIn, dataOut, nPixels, channels);
+        break;
+
+    default:
+        convertFloatToRGBEAux<0>(dataIn, dataOut, nPixels, channels);
+    }
+}
+
+/**
+ * @brief convertRGBEToFloatAux is convertRGBEToFloat with a constant number
+ * of channels, C, when C > 0.
+ * @param dataIn
+ * @param dataOut
+ * @param nPixels
+ * @param channels
+ */
+template<int C>
+PIC_INLINE void convertRGBEToFloatAux(unsigned char *dataIn, float *dataOut,
+                                      int nPixels, int channels)
+{
+    if(C > 0) {
+        channels = C;
+    }
+
+    for(int i = 0; i < nPixels; i++) {
+        unsigned char *col = &dataIn[i * 4];
+
+        int E = col[3];
+        int E0 = E >> 1;
+        int E1 = E - E0;
+
+        //2^(E0 - 68) * 2^(E1 - 68)
+        int f0_bits = (E0 + 59) << 23;
+        int f1_bits = (E1 + 59) << 23;
+
+        float f0, f1;
+        memcpy(&f0, &f0_bits, sizeof(float));
+        memcpy(&f1, &f1_bits, sizeof(float));
+
+        float mask = ((col[0] | col[1] | col[2]) != 0) ? 1.0f : 0.0f;
+        f0 *= mask;
+
+        float *out = &dataOut[i * channels];
+        out[0] = ((float(col[0]) + 0.5f) * f0) * f1;
+        out[1] = ((float(col[1]) + 0.5f) * f0) * f1;
+        out[2] = ((float(col[2]) + 0.5f) * f0) * f1;
+    }
+}
+
+/**
+ * @brief convertRGBEToFloat decodes a span of RGBE pixels; the output is the
+ * same of fromRGBEToFloat. 2^(E - 136) is applied as two factors built from
+ * bits, which are normal floats for any E, so the loop has no calls to ldexpf
+ * and no branches.
+ * @param dataIn is an array of nPixels * 4 values.
+ * @param dataOut is an array of nPixels * channels values, with channels
+ * greater or equal than 3; only the first three channels are written.
+ * @param nPixels
+ * @param channels
+ */
+PIC_INLINE void convertRGBEToFloat(unsigned char *dataIn, float *dataOut,
+                                   int nPixels, int channels = 3)
+{
+    switch(channels) {
+    case 3:
+        convertRGBEToFloatAux<3>(dataIn, dataOut, nPixels, channels);
+        break;
+
+    case 4:
+        convertRGBEToFloatAux<4>(dataIn, dataOut, nPixels, channels);
+        break;
+
+    default:
+        convertRGBEToFloatAux<0>(dataIn, dataOut, nPixels, channels);
+    }
+}
+
 } // end namespace pic
 
 #endif /* PIC_COLORS_RGBE_HPP */
@@ -18,6 +18,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_COMPUTER_VISION_HPP
 #define PIC_COMPUTER_VISION_HPP
 
+#include "computer_vision/ransac.hpp"
 #include "computer_vision/homography_matrix.hpp"
 #include "computer_vision/fundamental_matrix.hpp"
 #include "computer_vision/triangulation.hpp"
@@ -27,6 +28,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "computer_vision/rectification.hpp"
 
+#include "computer_vision/stereo_cost_volume.hpp"
 #include "computer_vision/stereo.hpp"
 
 #include "computer_vision/nelder_mead_opt_homography.hpp"
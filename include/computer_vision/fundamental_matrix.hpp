@@ -20,6 +20,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <vector>
 #include <random>
+#include <algorithm>
 #include <stdlib.h>
 
 #include "../base.hpp"
@@ -32,6 +33,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../util/math.hpp"
 #include "../util/eigen_util.hpp"
 
+#include "../computer_vision/ransac.hpp"
 #include "../computer_vision/nelder_mead_opt_fundamental.hpp"
 
 #ifndef PIC_DISABLE_EIGEN
@@ -137,11 +139,257 @@ PIC_INLINE Eigen::Matrix3d estimateFundamental(std::vector< Eigen::Vector2f > &p
 }
 
 /**
- * @brief estimateFundamentalRansac
+ * @brief estimateFundamentalMinimal estimates the fundamental matrix from exactly
+ * eight point correspondences using the normalized eight-point algorithm; it only
+ * uses arrays and fixed-size matrices, so it does not allocate memory.
+ * @param points0 is an array of eight points computed from image 1.
+ * @param points1 is an array of eight points computed from image 2.
+ * @param F is the output fundamental matrix, F_{1,2}.
+ * @return It returns false if the configuration is degenerate.
+ */
+PIC_INLINE bool estimateFundamentalMinimal(Eigen::Vector2f *points0,
+                                           Eigen::Vector2f *points1,
+                                           Eigen::Matrix3d &F)
+{
+    const int n = 8;
+
+    //shift and scale points for numerical stability
+    double c0[2] = {0.0, 0.0};
+    double c1[2] = {0.0, 0.0};
+
+    for(int i = 0; i < n; i++) {
+        c0[0] += points0[i][0];
+        c0[1] += points0[i][1];
+        c1[0] += points1[i][0];
+        c1[1] += points1[i][1];
+    }
+
+    c0[0] /= double(n);
+    c0[1] /= double(n);
+    c1[0] /= double(n);
+    c1[1] /= double(n);
+
+    double s0 = 0.0;
+    double s1 = 0.0;
+
+    for(int i = 0; i < n; i++) {
+        double dx0 = points0[i][0] - c0[0];
+        double dy0 = points0[i][1] - c0[1];
+        double dx1 = points1[i][0] - c1[0];
+        double dy1 = points1[i][1] - c1[1];
+
+        s0 += sqrt(dx0 * dx0 + dy0 * dy0);
+        s1 += sqrt(dx1 * dx1 + dy1 * dy1);
+    }
+
+    s0 /= double(n) * C_SQRT_2;
+    s1 /= double(n) * C_SQRT_2;
+
+    if((s0 <= 0.0) || (s1 <= 0.0)) {
+        return false;
+    }
+
+    double A[n][9];
+
+    //set up the linear system
+    for(int i = 0; i < n; i++) {
+        double x0 = (points0[i][0] - c0[0]) / s0;
+        double y0 = (points0[i][1] - c0[1]) / s0;
+        double x1 = (points1[i][0] - c1[0]) / s1;
+        double y1 = (points1[i][1] - c1[1]) / s1;
+
+        A[i][0] = x0 * x1;
+        A[i][1] = x0 * y1;
+        A[i][2] = x0;
+        A[i][3] = y0 * x1;
+        A[i][4] = y0 * y1;
+        A[i][5] = y0;
+        A[i][6] = x1;
+        A[i][7] = y1;
+        A[i][8] = 1.0;
+    }
+
+    //the solution is the kernel of the 8 x 9 system; it is computed with
+    //Gauss-Jordan elimination with full pivoting
+    int col[9];
+    for(int j = 0; j < 9; j++) {
+        col[j] = j;
+    }
+
+    double pivot0 = 0.0;
+
+    for(int r = 0; r < n; r++) {
+        int pi = r;
+        int pj = r;
+        double maxVal = 0.0;
+
+        for(int i = r; i < n; i++) {
+            for(int j = r; j < 9; j++) {
+                if(fabs(A[i][j]) > maxVal) {
+                    maxVal = fabs(A[i][j]);
+                    pi = i;
+                    pj = j;
+                }
+            }
+        }
+
+        if(r == 0) {
+            pivot0 = maxVal;
+        }
+
+        //the kernel has more than one dimension
+        if(maxVal <= (pivot0 * 1e-12)) {
+            return false;
+        }
+
+        for(int j = 0; j < 9; j++) {
+            std::swap(A[r][j], A[pi][j]);
+        }
+
+        for(int i = 0; i < n; i++) {
+            std::swap(A[i][r], A[i][pj]);
+        }
+
+        std::swap(col[r], col[pj]);
+
+        for(int i = 0; i < n; i++) {
+            if(i == r) {
+                continue;
+            }
+
+            double t = A[i][r] / A[r][r];
+
+            for(int j = r; j < 9; j++) {
+                A[i][j] -= t * A[r][j];
+            }
+        }
+    }
+
+    //the last unknown is free
+    double f[9];
+    f[col[8]] = 1.0;
+
+    for(int r = 0; r < n; r++) {
+        f[col[r]] = -A[r][8] / A[r][r];
+    }
+
+    F(0, 0) = f[0];
+    F(1, 0) = f[1];
+    F(2, 0) = f[2];
+
+    F(0, 1) = f[3];
+    F(1, 1) = f[4];
+    F(2, 1) = f[5];
+
+    F(0, 2) = f[6];
+    F(1, 2) = f[7];
+    F(2, 2) = f[8];
+
+    //compute the final F matrix
+    Eigen::Matrix3d mat_0, mat_1_t;
+    mat_0 << 1.0 / s0, 0.0, -c0[0] / s0,
+             0.0, 1.0 / s0, -c0[1] / s0,
+             0.0, 0.0, 1.0;
+
+    mat_1_t << 1.0 / s1, 0.0, 0.0,
+               0.0, 1.0 / s1, 0.0,
+               -c1[0] / s1, -c1[1] / s1, 1.0;
+
+    F = mat_1_t * F * mat_0;
+
+    //enforce singularity
+    Eigen::JacobiSVD< Eigen::Matrix3d > svdF(F, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Matrix3d Uf = svdF.matrixU();
+    Eigen::Matrix3d Vf = svdF.matrixV();
+    Eigen::Vector3d Df = svdF.singularValues();
+    Df[2] = 0.0;
+
+    double norm = MAX(Df[0], Df[1]);
+
+    if(norm <= 0.0) {
+        return false;
+    }
+
+    Eigen::Matrix3d F_new = Uf * DiagonalMatrix(Df) * Eigen::Transpose< Eigen::Matrix3d >(Vf);
+    F = F_new / norm;
+
+    return true;
+}
+
+/**
+ * @brief countFundamentalInliers counts the points whose distance from the epipolar
+ * line F * points0 is lower than threshold without allocating memory.
+ * @param F
+ * @param points0
+ * @param points1
+ * @param n is the number of points.
+ * @param threshold
+ * @param bestCount if greater than zero, scoring stops as soon as F cannot
+ * have more than bestCount inliers.
+ * @param inliers is an optional vector where inliers' indices are stored.
+ * @return It returns the number of inliers, or a value lower or equal than
+ * bestCount if scoring was stopped early.
+ */
+PIC_INLINE int countFundamentalInliers(Eigen::Matrix3d &F,
+                                       Eigen::Vector2f *points0,
+                                       Eigen::Vector2f *points1,
+                                       int n, double threshold,
+                                       int bestCount = 0,
+                                       std::vector< unsigned int > *inliers = NULL)
+{
+    double f00 = F(0, 0), f01 = F(0, 1), f02 = F(0, 2);
+    double f10 = F(1, 0), f11 = F(1, 1), f12 = F(1, 2);
+    double f20 = F(2, 0), f21 = F(2, 1), f22 = F(2, 2);
+
+    int count = 0;
+
+    for(int j = 0; j < n; j++) {
+        double x = points0[j][0];
+        double y = points0[j][1];
+
+        double l0 = f00 * x + f01 * y + f02;
+        double l1 = f10 * x + f11 * y + f12;
+        double l2 = f20 * x + f21 * y + f22;
+
+        double err = fabs(l0 * points1[j][0] + l1 * points1[j][1] + l2);
+        double n0 = sqrt(l0 * l0 + l1 * l1);
+
+        if(n0 > 0.0) {
+            err /= n0;
+        }
+
+        if(err < threshold) {
+            count++;
+
+            if(inliers != NULL) {
+                inliers->push_back(j);
+            }
+        } else {
+            if((bestCount > 0) && ((count + n - j - 1) <= bestCount)) {
+                return count;
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief estimateFundamentalRansac estimates the fundamental matrix using an adaptive
+ * RANSAC. Hypotheses are computed with an allocation-free eight-point solver and
+ * evaluated in parallel in batches; each hypothesis has its own random number
+ * generator, so the result does not depend on the number of threads. The number of
+ * iterations is updated from the inlier ratio of the best hypothesis, and scoring
+ * of a hypothesis stops as soon as it cannot beat the best one.
  * @param points0
  * @param points1
  * @param inliers
- * @param maxIterations
+ * @param maxIterations is the maximum number of iterations.
+ * @param threshold
+ * @param seed
+ * @param confidence is the probability of drawing at least an outlier-free sample.
+ * @param bPreTest enables the T(1,1) test: a hypothesis is fully scored only if
+ * a random point is an inlier.
  * @return
  */
 PIC_INLINE Eigen::Matrix3d estimateFundamentalRansac(std::vector< Eigen::Vector2f > &points0,
@@ -149,65 +397,89 @@ PIC_INLINE Eigen::Matrix3d estimateFundamentalRansac(std::vector< Eigen::Vector2
                                           std::vector< unsigned int > &inliers,
                                           unsigned int maxIterations = 100,
                                           double threshold = 0.01,
-                                          unsigned int seed = 1)
+                                          unsigned int seed = 1,
+                                          double confidence = 0.99,
+                                          bool bPreTest = false)
 {
     if(points0.size() < 9) {
         return estimateFundamental(points0, points1);
     }
 
     Eigen::Matrix3d F;
-    int nSubSet = 8;
+    F.setZero();
+
+    const int nSubSet = 8;
+    const int nBatch = 64;
 
-    std::mt19937 m(seed);
+    int n = int(points0.size());
+    Eigen::Vector2f *p0 = &points0[0];
+    Eigen::Vector2f *p1 = &points1[0];
 
-    unsigned int n = int(points0.size());
+    Eigen::Matrix3d F_batch[nBatch];
+    int count_batch[nBatch];
 
-    unsigned int *subSet = new unsigned int [nSubSet];
+    int bestCount = 0;
+    unsigned int nIterations = maxIterations;
 
     inliers.clear();
 
-    for(unsigned int i = 0; i < maxIterations; i++) {
-        getRandomPermutation(m, subSet, nSubSet, n);
+    for(unsigned int i = 0; i < nIterations; i += nBatch) {
+        int nb = int(MIN(unsigned(nBatch), nIterations - i));
 
-        std::vector< Eigen::Vector2f > sub_points0;
-        std::vector< Eigen::Vector2f > sub_points1;
+        #pragma omp parallel for
 
-        for(int j = 0; j < nSubSet; j++) {
-            unsigned int k = subSet[j];
-            sub_points0.push_back(points0[k]);
-            sub_points1.push_back(points1[k]);
-        }
+        for(int b = 0; b < nb; b++) {
+            count_batch[b] = -1;
+
+            std::minstd_rand m = getRansacGenerator(seed, i + b);
+
+            unsigned int subSet[nSubSet];
+            getRansacSample(m, subSet, nSubSet, n);
+
+            Eigen::Vector2f sub_points0[nSubSet], sub_points1[nSubSet];
 
-        Eigen::Matrix3d tmpF = estimateFundamental(sub_points0, sub_points1);
+            for(int j = 0; j < nSubSet; j++) {
+                sub_points0[j] = p0[subSet[j]];
+                sub_points1[j] = p1[subSet[j]];
+            }
 
-        //is it a good one?
-        std::vector< unsigned int > tmp_inliers;
+            if(!estimateFundamentalMinimal(sub_points0, sub_points1, F_batch[b])) {
+                continue;
+            }
 
-        for(unsigned int j = 0; j < n; j++) {
-            Eigen::Vector3d p0 = Eigen::Vector3d(points0[j][0], points0[j][1], 1.0);
-            Eigen::Vector3d p1 = Eigen::Vector3d(points1[j][0], points1[j][1], 1.0);
+            if(bPreTest) {
+                unsigned int k = m() % n;
 
-            Eigen::Vector3d tmpF_p0 = tmpF * p0;
-            double n0 = sqrt(tmpF_p0[0] * tmpF_p0[0] + tmpF_p0[1] * tmpF_p0[1]);
-            if(n0 >  0.0) {
-                tmpF_p0 /= n0;
+                if(countFundamentalInliers(F_batch[b], &p0[k], &p1[k], 1, threshold) == 0) {
+                    continue;
+                }
             }
 
-            double err = fabs(tmpF_p0.dot(p1));
+            count_batch[b] = countFundamentalInliers(F_batch[b], p0, p1, n, threshold, bestCount);
+        }
+
+        //the first best hypothesis of the batch wins
+        int bestB = -1;
 
-            if(err < threshold){
-                tmp_inliers.push_back(j);
+        for(int b = 0; b < nb; b++) {
+            if(count_batch[b] > bestCount) {
+                bestCount = count_batch[b];
+                bestB = b;
             }
         }
 
-        //get the inliers
-        if(tmp_inliers.size() > inliers.size()) {
-            F = tmpF;
-            inliers.clear();
-            inliers.assign(tmp_inliers.begin(), tmp_inliers.end());
+        if(bestB > -1) {
+            F = F_batch[bestB];
+            nIterations = getRansacIterations(double(bestCount) / double(n),
+                                              bPreTest ? (nSubSet + 1) : nSubSet,
+                                              confidence, maxIterations);
         }
     }
 
+    if(bestCount > 0) {
+        countFundamentalInliers(F, p0, p1, n, threshold, 0, &inliers);
+    }
+
     //improve estimate with inliers only
     if(inliers.size() > 7) {
 
@@ -41,6 +41,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #endif
 
+#include "../computer_vision/ransac.hpp"
 #include "../computer_vision/nelder_mead_opt_homography.hpp"
 
 namespace pic {
@@ -131,12 +132,161 @@ PIC_INLINE Eigen::Matrix3d estimateHomography(std::vector< Eigen::Vector2f > &po
     return H / H(2, 2);
 }
 
+/**
+ * @brief getSquareToQuad computes the projective mapping from the unit square
+ * to a quadrilateral in closed form; (0,0), (1,0), (1,1), and (0,1) are mapped
+ * to p[0], p[1], p[2], and p[3] respectively.
+ * @param p is an array of four points.
+ * @param S is the output matrix.
+ * @return It returns false if the quadrilateral is degenerate.
+ */
+PIC_INLINE bool getSquareToQuad(Eigen::Vector2f *p, Eigen::Matrix3d &S)
+{
+    double x0 = p[0][0], y0 = p[0][1];
+    double x1 = p[1][0], y1 = p[1][1];
+    double x2 = p[2][0], y2 = p[2][1];
+    double x3 = p[3][0], y3 = p[3][1];
+
+    double sx = x0 - x1 + x2 - x3;
+    double sy = y0 - y1 + y2 - y3;
+
+    double dx1 = x1 - x2;
+    double dx2 = x3 - x2;
+    double dy1 = y1 - y2;
+    double dy2 = y3 - y2;
+
+    double den = dx1 * dy2 - dx2 * dy1;
+
+    if(fabs(den) < 1e-12) {
+        return false;
+    }
+
+    double g = (sx * dy2 - dx2 * sy) / den;
+    double h = (dx1 * sy - sx * dy1) / den;
+
+    S(0, 0) = x1 - x0 + g * x1;
+    S(0, 1) = x3 - x0 + h * x3;
+    S(0, 2) = x0;
+
+    S(1, 0) = y1 - y0 + g * y1;
+    S(1, 1) = y3 - y0 + h * y3;
+    S(1, 2) = y0;
+
+    S(2, 0) = g;
+    S(2, 1) = h;
+    S(2, 2) = 1.0;
+
+    return true;
+}
+
+/**
+ * @brief estimateHomographyMinimal estimates an homography matrix H from exactly
+ * four point correspondences in closed form, H = S_1 * S_0^-1, where S_i maps
+ * the unit square onto the points of image i.
+ * @param points0 is an array of four points computed from image 1.
+ * @param points1 is an array of four points computed from image 2.
+ * @param H is the output homography matrix.
+ * @return It returns false if the configuration is degenerate.
+ */
+PIC_INLINE bool estimateHomographyMinimal(Eigen::Vector2f *points0,
+                                          Eigen::Vector2f *points1,
+                                          Eigen::Matrix3d &H)
+{
+    Eigen::Matrix3d S0, S1;
+
+    if(!getSquareToQuad(points0, S0) || !getSquareToQuad(points1, S1)) {
+        return false;
+    }
+
+    //the adjugate is the inverse up to a scale factor
+    Eigen::Matrix3d S0_adj;
+    S0_adj(0, 0) = S0(1, 1) * S0(2, 2) - S0(1, 2) * S0(2, 1);
+    S0_adj(0, 1) = S0(0, 2) * S0(2, 1) - S0(0, 1) * S0(2, 2);
+    S0_adj(0, 2) = S0(0, 1) * S0(1, 2) - S0(0, 2) * S0(1, 1);
+    S0_adj(1, 0) = S0(1, 2) * S0(2, 0) - S0(1, 0) * S0(2, 2);
+    S0_adj(1, 1) = S0(0, 0) * S0(2, 2) - S0(0, 2) * S0(2, 0);
+    S0_adj(1, 2) = S0(0, 2) * S0(1, 0) - S0(0, 0) * S0(1, 2);
+    S0_adj(2, 0) = S0(1, 0) * S0(2, 1) - S0(1, 1) * S0(2, 0);
+    S0_adj(2, 1) = S0(0, 1) * S0(2, 0) - S0(0, 0) * S0(2, 1);
+    S0_adj(2, 2) = S0(0, 0) * S0(1, 1) - S0(0, 1) * S0(1, 0);
+
+    H = S1 * S0_adj;
+
+    if(fabs(H(2, 2)) < 1e-12) {
+        return false;
+    }
+
+    H /= H(2, 2);
+    return true;
+}
+
+/**
+ * @brief countHomographyInliers counts the points such that
+ * ||points1 - H * points0||^2 < threshold without allocating memory.
+ * @param H
+ * @param points0
+ * @param points1
+ * @param n is the number of points.
+ * @param threshold
+ * @param bestCount if greater than zero, scoring stops as soon as H cannot
+ * have more than bestCount inliers.
+ * @param inliers is an optional vector where inliers' indices are stored.
+ * @return It returns the number of inliers, or a value lower or equal than
+ * bestCount if scoring was stopped early.
+ */
+PIC_INLINE int countHomographyInliers(Eigen::Matrix3d &H,
+                                      Eigen::Vector2f *points0,
+                                      Eigen::Vector2f *points1,
+                                      int n, double threshold,
+                                      int bestCount = 0,
+                                      std::vector< unsigned int > *inliers = NULL)
+{
+    double h00 = H(0, 0), h01 = H(0, 1), h02 = H(0, 2);
+    double h10 = H(1, 0), h11 = H(1, 1), h12 = H(1, 2);
+    double h20 = H(2, 0), h21 = H(2, 1), h22 = H(2, 2);
+
+    int count = 0;
+
+    for(int j = 0; j < n; j++) {
+        double x = points0[j][0];
+        double y = points0[j][1];
+
+        double w = h20 * x + h21 * y + h22;
+        double dx = points1[j][0] - (h00 * x + h01 * y + h02) / w;
+        double dy = points1[j][1] - (h10 * x + h11 * y + h12) / w;
+
+        if(((dx * dx) + (dy * dy)) < threshold) {
+            count++;
+
+            if(inliers != NULL) {
+                inliers->push_back(j);
+            }
+        } else {
+            if((bestCount > 0) && ((count + n - j - 1) <= bestCount)) {
+                return count;
+            }
+        }
+    }
+
+    return count;
+}
+
 /**
  * @brief estimateHomographyRansac computes the homography such that: points1 = H * points0
+ * using an adaptive RANSAC. Hypotheses are computed with a closed-form four-point solver
+ * and evaluated in parallel in batches; each hypothesis has its own random number
+ * generator, so the result does not depend on the number of threads. The number of
+ * iterations is updated from the inlier ratio of the best hypothesis, and scoring
+ * of a hypothesis stops as soon as it cannot beat the best one.
  * @param points0
  * @param points1
  * @param inliers
- * @param maxIterations
+ * @param maxIterations is the maximum number of iterations.
+ * @param threshold
+ * @param seed
+ * @param confidence is the probability of drawing at least an outlier-free sample.
+ * @param bPreTest enables the T(1,1) test: a hypothesis is fully scored only if
+ * a random point is an inlier.
  * @return
  */
 PIC_INLINE Eigen::Matrix3d estimateHomographyRansac(std::vector< Eigen::Vector2f > &points0,
@@ -144,62 +294,87 @@ PIC_INLINE Eigen::Matrix3d estimateHomographyRansac(std::vector< Eigen::Vector2f
                                          std::vector< unsigned int > &inliers,
                                          unsigned int maxIterations = 100,
                                          double threshold = 4.0,
-                                         unsigned int seed = 1)
+                                         unsigned int seed = 1,
+                                         double confidence = 0.99,
+                                         bool bPreTest = false)
 {
     if(points0.size() < 5) {
         return estimateHomography(points0, points1);
     }
 
-    Eigen::Matrix3d H;
-    int nSubSet = 4;
+    Eigen::Matrix3d H = Eigen::Matrix3d::Identity();
+    const int nSubSet = 4;
+    const int nBatch = 64;
 
-    std::mt19937 m(seed);
+    int n = int(points0.size());
+    Eigen::Vector2f *p0 = &points0[0];
+    Eigen::Vector2f *p1 = &points1[0];
 
-    unsigned int n = int(points0.size());
+    Eigen::Matrix3d H_batch[nBatch];
+    int count_batch[nBatch];
 
-    unsigned int *subSet = new unsigned int [nSubSet];
+    int bestCount = 0;
+    unsigned int nIterations = maxIterations;
 
     inliers.clear();
 
-    for(unsigned int i = 0; i < maxIterations; i++) {       
+    for(unsigned int i = 0; i < nIterations; i += nBatch) {
+        int nb = int(MIN(unsigned(nBatch), nIterations - i));
 
-        getRandomPermutation(m, subSet, nSubSet, n);
+        #pragma omp parallel for
 
-        std::vector< Eigen::Vector2f > sub_points0;
-        std::vector< Eigen::Vector2f > sub_points1;
+        for(int b = 0; b < nb; b++) {
+            count_batch[b] = -1;
 
-        for(int j = 0; j < nSubSet; j++) {
-            sub_points0.push_back(points0[subSet[j]]);
-            sub_points1.push_back(points1[subSet[j]]);
-        }
+            std::minstd_rand m = getRansacGenerator(seed, i + b);
+
+            unsigned int subSet[nSubSet];
+            getRansacSample(m, subSet, nSubSet, n);
+
+            Eigen::Vector2f sub_points0[nSubSet], sub_points1[nSubSet];
+
+            for(int j = 0; j < nSubSet; j++) {
+                sub_points0[j] = p0[subSet[j]];
+                sub_points1[j] = p1[subSet[j]];
+            }
 
-        Eigen::Matrix3d tmpH = estimateHomography(sub_points0, sub_points1);
+            if(!estimateHomographyMinimal(sub_points0, sub_points1, H_batch[b])) {
+                continue;
+            }
 
-        //is it a good one?
-        std::vector< unsigned int > tmp_inliers;
+            if(bPreTest) {
+                unsigned int k = m() % n;
 
-        for(unsigned int j = 0; j < n; j++) {
-            Eigen::Vector3d point_hom = Eigen::Vector3d(points0[j][0], points0[j][1], 1.0);
-            Eigen::Vector3d pp = tmpH * point_hom;
-            pp /= pp[2];
+                if(countHomographyInliers(H_batch[b], &p0[k], &p1[k], 1, threshold) == 0) {
+                    continue;
+                }
+            }
 
-            double dx = points1[j][0] - pp[0];
-            double dy = points1[j][1] - pp[1];
-            double squared_diff = (dx * dx) + (dy * dy);
+            count_batch[b] = countHomographyInliers(H_batch[b], p0, p1, n, threshold, bestCount);
+        }
 
-            if(squared_diff < threshold) {
-                tmp_inliers.push_back(j);
+        //the first best hypothesis of the batch wins
+        int bestB = -1;
+
+        for(int b = 0; b < nb; b++) {
+            if(count_batch[b] > bestCount) {
+                bestCount = count_batch[b];
+                bestB = b;
             }
         }
 
-        //get the inliers
-        if(tmp_inliers.size() > inliers.size()) {
-            H = tmpH;
-            inliers.clear();
-            inliers.assign(tmp_inliers.begin(), tmp_inliers.end());
+        if(bestB > -1) {
+            H = H_batch[bestB];
+            nIterations = getRansacIterations(double(bestCount) / double(n),
+                                              bPreTest ? (nSubSet + 1) : nSubSet,
+                                              confidence, maxIterations);
         }
     }
 
+    if(bestCount > 0) {
+        countHomographyInliers(H, p0, p1, n, threshold, 0, &inliers);
+    }
+
     //improve estimate with inliers only
     if(inliers.size() > 3) {
         #ifdef PIC_DEBUG
@@ -20,6 +20,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "../util/matrix_3_x_3.hpp"
 #include "../util/nelder_mead_opt_base.hpp"
+#include "../util/warp_map.hpp"
 
 #ifndef PIC_DISABLE_EIGEN
 #ifndef PIC_EIGEN_NOT_BUNDLED
@@ -31,6 +32,95 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 namespace pic {
 
+/**
+ * @brief The RadialUndistortion struct maps a pixel of an undistorted image
+ * to its position in the distorted image, using the one-parameter model of
+ * NelderMeadOptRadialDistortion. It is a functor for WarpMap::compute.
+ */
+struct RadialUndistortion
+{
+    float lambda, fx, fy, cx, cy;
+
+    /**
+     * @brief RadialUndistortion
+     * @param lambda
+     * @param fx
+     * @param fy
+     * @param cx
+     * @param cy
+     */
+    RadialUndistortion(float lambda, float fx, float fy, float cx, float cy)
+    {
+        this->lambda = lambda;
+        this->fx = fx;
+        this->fy = fy;
+        this->cx = cx;
+        this->cy = cy;
+    }
+
+    /**
+     * @brief operator ()
+     * @param x
+     * @param y
+     * @param xs
+     * @param ys
+     * @return
+     */
+    bool operator()(float x, float y, float &xs, float &ys)
+    {
+        float x_cx = x - cx;
+        float y_cy = y - cy;
+
+        float dx = x_cx / fx;
+        float dy = y_cy / fy;
+        float rho_sq = dx * dx + dy * dy;
+
+        float den = 1.0f + rho_sq * lambda;
+
+        if(den <= 0.0f) {
+            return false;
+        }
+
+        xs = x_cx / den + cx;
+        ys = y_cy / den + cy;
+
+        return true;
+    }
+};
+
+/**
+ * @brief computeRadialUndistortionMap computes the map that removes radial
+ * distortion from images of size width x height; the model is evaluated on
+ * a grid of step gridStep and interpolated. The map is applied to frames
+ * with FilterRemap.
+ * @param lambda
+ * @param fx
+ * @param fy
+ * @param cx
+ * @param cy
+ * @param width
+ * @param height
+ * @param map
+ * @param gridStep
+ * @return
+ */
+PIC_INLINE WarpMap *computeRadialUndistortionMap(float lambda,
+                                                 float fx, float fy,
+                                                 float cx, float cy,
+                                                 int width, int height,
+                                                 WarpMap *map = NULL,
+                                                 int gridStep = 8)
+{
+    if(map == NULL) {
+        map = new WarpMap();
+    }
+
+    RadialUndistortion func(lambda, fx, fy, cx, cy);
+    map->compute(func, width, height, width, height, gridStep);
+
+    return map;
+}
+
 #ifndef PIC_DISABLE_EIGEN
 
 class NelderMeadOptRadialDistortion: public NelderMeadOptBase<float>
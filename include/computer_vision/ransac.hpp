@@ -0,0 +1,114 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_COMPUTER_VISION_RANSAC_HPP
+#define PIC_COMPUTER_VISION_RANSAC_HPP
+
+#include <random>
+#include <math.h>
+
+#include "../base.hpp"
+#include "../util/math.hpp"
+
+namespace pic {
+
+/**
+ * @brief getRansacIterations computes the number of RANSAC iterations
+ * needed to draw, with a given confidence, at least one sample made of inliers only.
+ * @param inlierRatio is the current estimate of the ratio of inliers.
+ * @param sampleSize is the number of points that have to be inliers
+ * for a hypothesis to be accepted.
+ * @param confidence is the probability of success.
+ * @param maxIterations is the maximum number of iterations.
+ * @return It returns the number of iterations.
+ */
+PIC_INLINE unsigned int getRansacIterations(double inlierRatio, int sampleSize,
+                                            double confidence,
+                                            unsigned int maxIterations)
+{
+    double w = pow(inlierRatio, double(sampleSize));
+
+    if(w <= 0.0) {
+        return maxIterations;
+    }
+
+    if(w >= 1.0) {
+        return 1;
+    }
+
+    double k = ceil(log(1.0 - confidence) / log(1.0 - w));
+
+    if(k >= double(maxIterations)) {
+        return maxIterations;
+    }
+
+    return MAX((unsigned int) k, 1);
+}
+
+/**
+ * @brief getRansacGenerator returns a random number generator for
+ * a given RANSAC iteration. The generator only depends on the seed and on
+ * the iteration, so hypotheses do not change with the number of threads.
+ * @param seed
+ * @param iteration
+ * @return
+ */
+PIC_INLINE std::minstd_rand getRansacGenerator(unsigned int seed, unsigned int iteration)
+{
+    unsigned int h = seed * 2654435761u ^ (iteration + 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+
+    //minstd_rand cannot be seeded with 0
+    return std::minstd_rand((h % 2147483646u) + 1);
+}
+
+/**
+ * @brief getRansacSample draws nSubSet distinct indices in [0, n).
+ * @param m is a random number generator.
+ * @param subSet is the output array of nSubSet elements.
+ * @param nSubSet is the size of the sample.
+ * @param n is the number of points; it has to be greater than nSubSet.
+ */
+PIC_INLINE void getRansacSample(std::minstd_rand &m, unsigned int *subSet,
+                                int nSubSet, unsigned int n)
+{
+    int index = 0;
+
+    while(index < nSubSet) {
+        unsigned int tmp = m() % n;
+
+        bool bFound = false;
+
+        for(int i = 0; i < index; i++) {
+            if(subSet[i] == tmp) {
+                bFound = true;
+                break;
+            }
+        }
+
+        if(!bFound) {
+            subSet[index] = tmp;
+            index++;
+        }
+    }
+}
+
+} // end namespace pic
+
+#endif // PIC_COMPUTER_VISION_RANSAC_HPP
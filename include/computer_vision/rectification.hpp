@@ -29,6 +29,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../image_vec.hpp"
 
 #include "../filtering/filter_warp_2d.hpp"
+#include "../util/warp_map.hpp"
 
 #include "../computer_vision/camera_matrix.hpp"
 
@@ -49,34 +50,24 @@ namespace pic {
 #ifndef PIC_DISABLE_EIGEN
 
 /**
- * @brief computeImageRectificationWarp
+ * @brief setImageRectificationBoundingBoxes sets the common bounding boxes
+ * of the warps of a rectified pair.
  * @param img0
  * @param img1
- * @param T0
- * @param T1
- * @param out
- * @return
+ * @param warp0
+ * @param warp1
+ * @param H0
+ * @param H1
+ * @param bPartial
  */
-PIC_INLINE ImageVec *computeImageRectificationWarp(Image *img0,
+PIC_INLINE void setImageRectificationBoundingBoxes(Image *img0,
                                                    Image *img1,
-                                                   Eigen::Matrix3d &T0,
-                                                   Eigen::Matrix3d &T1,
-                                                   ImageVec *out,
-                                                   bool bPartial = true)
+                                                   FilterWarp2D &warp0,
+                                                   FilterWarp2D &warp1,
+                                                   Matrix3x3 &H0,
+                                                   Matrix3x3 &H1,
+                                                   bool bPartial)
 {
-    if(img0 == NULL || img1 == NULL) {
-        return out;
-    }
-
-    if(out == NULL) {
-        out = new ImageVec();
-    }
-
-    auto H0 = MatrixConvert(T0);
-    auto H1 = MatrixConvert(T1);
-    FilterWarp2D warp0(H0);
-    FilterWarp2D warp1(H1);
-
     int bmin0[2], bmin1[2], bmax0[2], bmax1[2];
 
     FilterWarp2D::computeBoundingBox(H0, warp0.getBCentroid(), img0->widthf, img0->heightf, bmin0, bmax0);
@@ -100,6 +91,38 @@ PIC_INLINE ImageVec *computeImageRectificationWarp(Image *img0,
 
     warp0.SetBoundingBox(bmin0, bmax0);
     warp1.SetBoundingBox(bmin1, bmax1);
+}
+
+/**
+ * @brief computeImageRectificationWarp
+ * @param img0
+ * @param img1
+ * @param T0
+ * @param T1
+ * @param out
+ * @return
+ */
+PIC_INLINE ImageVec *computeImageRectificationWarp(Image *img0,
+                                                   Image *img1,
+                                                   Eigen::Matrix3d &T0,
+                                                   Eigen::Matrix3d &T1,
+                                                   ImageVec *out,
+                                                   bool bPartial = true)
+{
+    if(img0 == NULL || img1 == NULL) {
+        return out;
+    }
+
+    if(out == NULL) {
+        out = new ImageVec();
+    }
+
+    auto H0 = MatrixConvert(T0);
+    auto H1 = MatrixConvert(T1);
+    FilterWarp2D warp0(H0);
+    FilterWarp2D warp1(H1);
+
+    setImageRectificationBoundingBoxes(img0, img1, warp0, warp1, H0, H1, bPartial);
 
     Image *img0_r = NULL;
     Image *img1_r = NULL;
@@ -122,31 +145,59 @@ PIC_INLINE ImageVec *computeImageRectificationWarp(Image *img0,
 }
 
 /**
- * @brief computeImageRectification
+ * @brief computeImageRectificationWarpMaps computes the maps of the
+ * rectification warps; these can be applied to every pair of frames of the
+ * same size with FilterRemap.
  * @param img0
  * @param img1
- * @param M0
- * @param M1
+ * @param T0
+ * @param T1
+ * @param map0
+ * @param map1
+ * @param bPartial
  * @return
  */
-PIC_INLINE ImageVec *computeImageRectification(Image *img0,
-                                               Image *img1,
-                                               Eigen::Matrix34d &M0,
-                                               Eigen::Matrix34d &M1,
-                                               ImageVec *out = NULL,
-                                               bool bPartial = true)
+PIC_INLINE bool computeImageRectificationWarpMaps(Image *img0,
+                                                  Image *img1,
+                                                  Eigen::Matrix3d &T0,
+                                                  Eigen::Matrix3d &T1,
+                                                  WarpMap *map0,
+                                                  WarpMap *map1,
+                                                  bool bPartial = true)
 {
-    //NOTE: we should check that img0 and img1 are valid...
-    if(img0 == NULL || img1 == NULL) {
-        return out;
+    if(img0 == NULL || img1 == NULL || map0 == NULL || map1 == NULL) {
+        return false;
     }
 
-    if(out == NULL) {
-        out = new ImageVec();
-    }
+    auto H0 = MatrixConvert(T0);
+    auto H1 = MatrixConvert(T1);
+    FilterWarp2D warp0(H0);
+    FilterWarp2D warp1(H1);
 
+    setImageRectificationBoundingBoxes(img0, img1, warp0, warp1, H0, H1, bPartial);
+
+    warp0.computeWarpMap(img0, map0);
+    warp1.computeWarpMap(img1, map1);
+
+    return map0->isValid() && map1->isValid();
+}
+
+/**
+ * @brief computeImageRectificationTransforms computes the rectification
+ * homographies of a pair of cameras, keeping the orientation of img0.
+ * @param img0
+ * @param M0
+ * @param M1
+ * @param T0
+ * @param T1
+ */
+PIC_INLINE void computeImageRectificationTransforms(Image *img0,
+                                                    Eigen::Matrix34d &M0,
+                                                    Eigen::Matrix34d &M1,
+                                                    Eigen::Matrix3d &T0,
+                                                    Eigen::Matrix3d &T1)
+{
     Eigen::Matrix34d M0_r, M1_r;
-    Eigen::Matrix3d T0, T1;
 
     cameraRectify(M0, M1, M0_r, M1_r, T0, T1);
 
@@ -175,12 +226,73 @@ PIC_INLINE ImageVec *computeImageRectification(Image *img0,
     auto H = DiagonalMatrix(Eigen::Vector3d(f_x, f_y, 1));
     T0 = H * T0;
     T1 = H * T1;
+}
+
+/**
+ * @brief computeImageRectification
+ * @param img0
+ * @param img1
+ * @param M0
+ * @param M1
+ * @return
+ */
+PIC_INLINE ImageVec *computeImageRectification(Image *img0,
+                                               Image *img1,
+                                               Eigen::Matrix34d &M0,
+                                               Eigen::Matrix34d &M1,
+                                               ImageVec *out = NULL,
+                                               bool bPartial = true)
+{
+    //NOTE: we should check that img0 and img1 are valid...
+    if(img0 == NULL || img1 == NULL) {
+        return out;
+    }
+
+    if(out == NULL) {
+        out = new ImageVec();
+    }
+
+    Eigen::Matrix3d T0, T1;
+
+    computeImageRectificationTransforms(img0, M0, M1, T0, T1);
 
     out = computeImageRectificationWarp(img0, img1, T0, T1, out, bPartial);
 
     return out;
 }
 
+/**
+ * @brief computeImageRectificationMaps computes the maps of the
+ * rectification of a pair of cameras; these can be applied to every pair
+ * of frames of the same size with FilterRemap.
+ * @param img0
+ * @param img1
+ * @param M0
+ * @param M1
+ * @param map0
+ * @param map1
+ * @param bPartial
+ * @return
+ */
+PIC_INLINE bool computeImageRectificationMaps(Image *img0,
+                                              Image *img1,
+                                              Eigen::Matrix34d &M0,
+                                              Eigen::Matrix34d &M1,
+                                              WarpMap *map0,
+                                              WarpMap *map1,
+                                              bool bPartial = true)
+{
+    if(img0 == NULL || img1 == NULL) {
+        return false;
+    }
+
+    Eigen::Matrix3d T0, T1;
+
+    computeImageRectificationTransforms(img0, M0, M1, T0, T1);
+
+    return computeImageRectificationWarpMaps(img0, img1, T0, T1, map0, map1, bPartial);
+}
+
 /**
  * @brief computeImageRectification
  * @param img0
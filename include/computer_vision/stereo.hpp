@@ -30,6 +30,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../filtering/filter_luminance.hpp"
 #include "../filtering/filter_gradient.hpp"
 
+#include "../computer_vision/stereo_cost_volume.hpp"
+
 #include "../util/math.hpp"
 
 namespace pic {
@@ -53,7 +55,7 @@ PIC_INLINE void checkDisparity(Image *disp_left, Image *disp_right, int threshol
 
             int j_e = int(dR[0]);
 
-            if(std::abs(i - j_e) > threshold) {
+            if(std::abs(j - j_e) > threshold) {
                 dL[0] = 0.0f;
                 dL[1] = -1.0f;
 
@@ -81,17 +83,25 @@ PIC_INLINE void computeLocalDisparity(Image *disp)
 }
 
 /**
- * @brief estimateStereo
+ * @brief estimateStereo computes the disparity maps of a rectified stereo pair
+ * using a cost volume (please see StereoCostVolume). Disparities are searched
+ * in [-max_disparity / 2, max_disparity / 2], and the output maps store
+ * in channel 0 the horizontal offset to the matching pixel in the other view
+ * and in channel 1 the matching cost, which is -1 for invalid pixels.
  * @param img_left
  * @param img_right
  * @param max_disparity
  * @param disparity_cross_check
  * @param disp_left
  * @param disp_right
+ * @param cost
+ * @param aggregation
  */
 PIC_INLINE void estimateStereo(Image *img_left, Image *img_right,
                                int max_disparity, int disparity_cross_check,
-                               Image *disp_left, Image *disp_right)
+                               Image *disp_left, Image *disp_right,
+                               STEREO_COST cost = SC_CENSUS,
+                               STEREO_AGGREGATION aggregation = SA_BOX)
 {
     if(img_left  == NULL || img_right  == NULL ||
        disp_left == NULL || disp_right == NULL) {
@@ -106,23 +116,10 @@ PIC_INLINE void estimateStereo(Image *img_left, Image *img_right,
         disparity_cross_check = 16;
     }
 
-    auto i_l_l = FilterLuminance::Execute(img_left, NULL);
-    auto i_r_l = FilterLuminance::Execute(img_right, NULL);
-
-    auto i_l_g = FilterGradient::Execute(i_l_l, NULL);
-    auto i_r_g = FilterGradient::Execute(i_r_l, NULL);
-
-    FilterDisparity fd(240, 5);
-
-    disp_left  = fd.ProcessP(pic::Quad(img_left, img_right, i_l_g, i_r_g), disp_left);
-    disp_left  = fd.ProcessP(pic::Quad(img_right, img_left, i_r_g, i_l_g), disp_left);
-
-    checkDisparity(disp_left, disp_right, disparity_cross_check);
-    checkDisparity(disp_right, disp_left, disparity_cross_check);
-
-    computeLocalDisparity(disp_left);
-    computeLocalDisparity(disp_right);
+    int halfMaxDisparity = max_disparity >> 1;
 
+    StereoCostVolume scv(-halfMaxDisparity, halfMaxDisparity, cost, aggregation, 2);
+    scv.execute(img_left, img_right, disp_left, disp_right, disparity_cross_check);
 }
 
 } // end namespace pic
@@ -0,0 +1,598 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_COMPUTER_VISION_STEREO_COST_VOLUME_HPP
+#define PIC_COMPUTER_VISION_STEREO_COST_VOLUME_HPP
+
+#include <vector>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "../base.hpp"
+
+#include "../image.hpp"
+
+#include "../filtering/filter_luminance.hpp"
+
+#include "../util/math.hpp"
+#include "../util/std_util.hpp"
+
+namespace pic {
+
+/**
+ * @brief The STEREO_COST enum lists the matching costs: absolute
+ * differences of luminance and horizontal gradient, or the Hamming distance
+ * of 7x7 census transforms.
+ */
+enum STEREO_COST {SC_AD_GRADIENT, SC_CENSUS};
+
+/**
+ * @brief The STEREO_AGGREGATION enum lists how costs are aggregated: with
+ * a box filter, or with semi-global matching along four paths.
+ */
+enum STEREO_AGGREGATION {SA_BOX, SA_SGM};
+
+/**
+ * @brief The StereoCostVolume class computes disparity maps of a rectified
+ * stereo pair. A pixel (x, y) of the left image matches the pixel
+ * (x + d, y) of the right image, with d in [dMin, dMax].
+ *
+ * Costs are small integers in [0, 48]. Box aggregation sweeps disparities
+ * one at a time with running sums, so it costs O(1) per pixel and disparity
+ * and needs no cost volume; it is meant for large images. SGM stores a
+ * 16-bit aggregated volume of width * height * (dMax - dMin + 1) values.
+ * Both disparity maps are extracted from the same costs, so the left-right
+ * check does not need a second matching pass.
+ */
+class StereoCostVolume
+{
+protected:
+    int width, height, nDisparities;
+
+    std::vector<unsigned long long> census_l, census_r;
+    std::vector<float> lum_l, lum_r, grad_l, grad_r;
+
+    std::vector<int> best_cost_l, best_cost_r, best_d_l, best_d_r;
+
+    /**
+     * @brief computeFeatures computes per-pixel features used by the cost.
+     * @param img
+     * @param census
+     * @param lum
+     * @param grad
+     */
+    void computeFeatures(Image *img, std::vector<unsigned long long> &census,
+                         std::vector<float> &lum, std::vector<float> &grad)
+    {
+        Image *L = FilterLuminance::Execute(img, NULL, LT_CIE_LUMINANCE);
+
+        int n = width * height;
+        lum.assign(L->data, L->data + n);
+
+        delete L;
+
+        if(cost == SC_CENSUS) {
+            census.resize(n);
+
+            #pragma omp parallel for
+
+            for(int y = 0; y < height; y++) {
+                for(int x = 0; x < width; x++) {
+                    float center = lum[y * width + x];
+                    unsigned long long code = 0;
+
+                    for(int j = -3; j <= 3; j++) {
+                        float *row = &lum[CLAMPi(y + j, 0, height - 1) * width];
+
+                        for(int i = -3; i <= 3; i++) {
+                            if(i != 0 || j != 0) {
+                                code = (code << 1) | (row[CLAMPi(x + i, 0, width - 1)] < center ? 1 : 0);
+                            }
+                        }
+                    }
+
+                    census[y * width + x] = code;
+                }
+            }
+        } else {
+            grad.resize(n);
+
+            #pragma omp parallel for
+
+            for(int y = 0; y < height; y++) {
+                float *row = &lum[y * width];
+
+                for(int x = 0; x < width; x++) {
+                    int x0 = MAX(x - 1, 0);
+                    int x1 = MIN(x + 1, width - 1);
+                    grad[y * width + x] = (row[x1] - row[x0]) * 0.5f;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief computeCostRow computes the costs of a row for a disparity.
+     * @param y
+     * @param d
+     * @param out is an array of width values; pixels matching outside
+     * the right image get the maximum cost.
+     */
+    void computeCostRow(int y, int d, int *out)
+    {
+        int x0 = MAX(0, -d);
+        int x1 = MIN(width, width - d);
+
+        for(int x = 0; x < x0; x++) {
+            out[x] = maxCost;
+        }
+
+        for(int x = MAX(x1, x0); x < width; x++) {
+            out[x] = maxCost;
+        }
+
+        int offset = y * width;
+
+        if(cost == SC_CENSUS) {
+            unsigned long long *cl = &census_l[offset];
+            unsigned long long *cr = &census_r[offset + d];
+
+            for(int x = x0; x < x1; x++) {
+                out[x] = popcount64(cl[x] ^ cr[x]);
+            }
+        } else {
+            float *ll = &lum_l[offset];
+            float *lr = &lum_r[offset + d];
+            float *gl = &grad_l[offset];
+            float *gr = &grad_r[offset + d];
+
+            float wc = float(maxCost) * (1.0f - alpha) / tauColor;
+            float wg = float(maxCost) * alpha / tauGradient;
+
+            for(int x = x0; x < x1; x++) {
+                float dc = MIN(fabsf(ll[x] - lr[x]), tauColor);
+                float dg = MIN(fabsf(gl[x] - gr[x]), tauGradient);
+                out[x] = int(dc * wc + dg * wg);
+            }
+        }
+    }
+
+    /**
+     * @brief executeBox sweeps disparities aggregating costs with a
+     * (2 * radius + 1)^2 box filter; rows are processed in bands.
+     */
+    void executeBox()
+    {
+        const int bandSize = 32;
+        int nBands = (height + bandSize - 1) / bandSize;
+
+        #pragma omp parallel for schedule(dynamic)
+
+        for(int b = 0; b < nBands; b++) {
+            int y0 = b * bandSize;
+            int y1 = MIN(y0 + bandSize, height);
+
+            int h0 = MAX(y0 - radius, 0);
+            int h1 = MIN(y1 + radius, height);
+
+            std::vector<int> costRow(width);
+            std::vector<int> prefix(width + 1);
+            std::vector<int> hSum((h1 - h0) * width);
+            std::vector<int> vSum(width);
+
+            for(int d = dMin; d <= dMax; d++) {
+                //horizontal running sums
+                for(int y = h0; y < h1; y++) {
+                    computeCostRow(y, d, &costRow[0]);
+
+                    prefix[0] = 0;
+
+                    for(int x = 0; x < width; x++) {
+                        prefix[x + 1] = prefix[x] + costRow[x];
+                    }
+
+                    int *h = &hSum[(y - h0) * width];
+
+                    for(int x = 0; x < width; x++) {
+                        h[x] = prefix[MIN(x + radius + 1, width)] - prefix[MAX(x - radius, 0)];
+                    }
+                }
+
+                //vertical running sums
+                for(int x = 0; x < width; x++) {
+                    vSum[x] = 0;
+                }
+
+                for(int y = h0; y < MIN(y0 + radius + 1, height); y++) {
+                    int *h = &hSum[(y - h0) * width];
+
+                    for(int x = 0; x < width; x++) {
+                        vSum[x] += h[x];
+                    }
+                }
+
+                for(int y = y0; y < y1; y++) {
+                    if(y > y0) {
+                        int yAdd = y + radius;
+                        int ySub = y - radius - 1;
+
+                        if(yAdd < height) {
+                            int *h = &hSum[(yAdd - h0) * width];
+
+                            for(int x = 0; x < width; x++) {
+                                vSum[x] += h[x];
+                            }
+                        }
+
+                        if(ySub >= 0) {
+                            int *h = &hSum[(ySub - h0) * width];
+
+                            for(int x = 0; x < width; x++) {
+                                vSum[x] -= h[x];
+                            }
+                        }
+                    }
+
+                    updateBest(y, d, &vSum[0]);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief updateBest updates the best disparities of both views with
+     * the aggregated costs of a row at disparity d.
+     * @param y
+     * @param d
+     * @param agg
+     */
+    void updateBest(int y, int d, int *agg)
+    {
+        int offset = y * width;
+
+        int *bcl = &best_cost_l[offset];
+        int *bdl = &best_d_l[offset];
+
+        for(int x = 0; x < width; x++) {
+            if(agg[x] < bcl[x]) {
+                bcl[x] = agg[x];
+                bdl[x] = d;
+            }
+        }
+
+        //the right pixel x + d matches the left pixel x at disparity -d
+        int x0 = MAX(0, -d);
+        int x1 = MIN(width, width - d);
+
+        int *bcr = &best_cost_r[offset + d];
+        int *bdr = &best_d_r[offset + d];
+
+        for(int x = x0; x < x1; x++) {
+            if(agg[x] < bcr[x]) {
+                bcr[x] = agg[x];
+                bdr[x] = -d;
+            }
+        }
+    }
+
+    /**
+     * @brief aggregatePath adds to S the costs aggregated along a path.
+     * @param C is the cost volume of the current pixel.
+     * @param Lprev is the path cost of the previous pixel along the path;
+     * it is NULL at the first pixel.
+     * @param Lcur is the path cost of the current pixel.
+     * @param S is the aggregated volume of the current pixel.
+     */
+    inline void aggregatePath(unsigned char *C, unsigned short *Lprev,
+                              unsigned short *Lcur, unsigned short *S)
+    {
+        int D = nDisparities;
+
+        if(Lprev == NULL) {
+            for(int d = 0; d < D; d++) {
+                Lcur[d] = C[d];
+                S[d] += C[d];
+            }
+
+            return;
+        }
+
+        int minPrev = Lprev[0];
+
+        for(int d = 1; d < D; d++) {
+            minPrev = MIN(minPrev, int(Lprev[d]));
+        }
+
+        int jump = minPrev + P2;
+
+        for(int d = 0; d < D; d++) {
+            int v = MIN(int(Lprev[d]), jump);
+
+            if(d > 0) {
+                v = MIN(v, int(Lprev[d - 1]) + P1);
+            }
+
+            if(d < (D - 1)) {
+                v = MIN(v, int(Lprev[d + 1]) + P1);
+            }
+
+            v = int(C[d]) + v - minPrev;
+            Lcur[d] = (unsigned short) v;
+            S[d] += (unsigned short) v;
+        }
+    }
+
+    /**
+     * @brief executeSGM computes the cost volume and aggregates it along
+     * horizontal and vertical paths with semi-global matching.
+     */
+    void executeSGM()
+    {
+        int D = nDisparities;
+        long long n = (long long)(width) * height;
+
+        std::vector<unsigned char> C(n * D);
+        std::vector<unsigned short> S(n * D, 0);
+
+        //pixel-wise costs, optionally box-aggregated
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            std::vector<int> costRow(width);
+            std::vector<int> prefix(width + 1);
+
+            for(int d = dMin; d <= dMax; d++) {
+                computeCostRow(y, d, &costRow[0]);
+
+                if(radius > 0) {
+                    prefix[0] = 0;
+
+                    for(int x = 0; x < width; x++) {
+                        prefix[x + 1] = prefix[x] + costRow[x];
+                    }
+
+                    for(int x = 0; x < width; x++) {
+                        int x0 = MAX(x - radius, 0);
+                        int x1 = MIN(x + radius + 1, width);
+                        costRow[x] = (prefix[x1] - prefix[x0]) / (x1 - x0);
+                    }
+                }
+
+                unsigned char *c = &C[(long long)(y) * width * D + (d - dMin)];
+
+                for(int x = 0; x < width; x++) {
+                    c[x * D] = (unsigned char) costRow[x];
+                }
+            }
+        }
+
+        //horizontal paths
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            std::vector<unsigned short> L0(D), L1(D);
+            long long row = (long long)(y) * width;
+
+            for(int x = 0; x < width; x++) {
+                long long i = (row + x) * D;
+                aggregatePath(&C[i], x > 0 ? &L0[0] : NULL, &L1[0], &S[i]);
+                L0.swap(L1);
+            }
+
+            for(int x = width - 1; x >= 0; x--) {
+                long long i = (row + x) * D;
+                aggregatePath(&C[i], x < (width - 1) ? &L0[0] : NULL, &L1[0], &S[i]);
+                L0.swap(L1);
+            }
+        }
+
+        //vertical paths, columns are split in chunks
+        int nChunks = MAX(MIN(getNumberOfThreads(), width), 1);
+
+        #pragma omp parallel for
+
+        for(int k = 0; k < nChunks; k++) {
+            int x0 = (width * k) / nChunks;
+            int x1 = (width * (k + 1)) / nChunks;
+            int w = x1 - x0;
+
+            std::vector<unsigned short> L0(w * D), L1(w * D);
+
+            for(int y = 0; y < height; y++) {
+                for(int x = x0; x < x1; x++) {
+                    long long i = ((long long)(y) * width + x) * D;
+                    int j = (x - x0) * D;
+                    aggregatePath(&C[i], y > 0 ? &L0[j] : NULL, &L1[j], &S[i]);
+                }
+
+                L0.swap(L1);
+            }
+
+            for(int y = height - 1; y >= 0; y--) {
+                for(int x = x0; x < x1; x++) {
+                    long long i = ((long long)(y) * width + x) * D;
+                    int j = (x - x0) * D;
+                    aggregatePath(&C[i], y < (height - 1) ? &L0[j] : NULL, &L1[j], &S[i]);
+                }
+
+                L0.swap(L1);
+            }
+        }
+
+        //winner-takes-all for both views
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            std::vector<int> agg(width);
+
+            for(int d = dMin; d <= dMax; d++) {
+                unsigned short *s = &S[(long long)(y) * width * D + (d - dMin)];
+
+                for(int x = 0; x < width; x++) {
+                    agg[x] = s[x * D];
+                }
+
+                updateBest(y, d, &agg[0]);
+            }
+        }
+    }
+
+    /**
+     * @brief writeOutput writes a disparity map and invalidates pixels
+     * failing the left-right check.
+     * @param best_d is the disparity of the view.
+     * @param best_cost is the cost of the view.
+     * @param best_d_other is the disparity of the other view.
+     * @param disp is the output image.
+     * @param threshold is the maximum left-right difference.
+     */
+    void writeOutput(std::vector<int> &best_d, std::vector<int> &best_cost,
+                     std::vector<int> &best_d_other, Image *disp, int threshold)
+    {
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                int i = y * width + x;
+                float *out = (*disp)(x, y);
+
+                int d = best_d[i];
+                int xo = x + d;
+
+                bool bValid = (best_cost[i] < INT_MAX) && (xo >= 0) && (xo < width);
+
+                if(bValid && threshold >= 0) {
+                    int d_o = best_d_other[y * width + xo];
+                    bValid = std::abs(d + d_o) <= threshold;
+                }
+
+                if(bValid) {
+                    out[0] = float(d);
+                    out[1] = float(best_cost[i]);
+                } else {
+                    out[0] = 0.0f;
+                    out[1] = -1.0f;
+                }
+            }
+        }
+    }
+
+public:
+    STEREO_COST cost;
+    STEREO_AGGREGATION aggregation;
+    int dMin, dMax, radius, maxCost;
+    int P1, P2;
+    float alpha, tauColor, tauGradient;
+
+    /**
+     * @brief StereoCostVolume
+     * @param dMin is the minimum disparity.
+     * @param dMax is the maximum disparity.
+     * @param cost is the matching cost.
+     * @param aggregation is the aggregation method.
+     * @param radius is the radius of the box filter.
+     */
+    StereoCostVolume(int dMin, int dMax, STEREO_COST cost = SC_CENSUS,
+                     STEREO_AGGREGATION aggregation = SA_BOX, int radius = 2)
+    {
+        this->dMin = MIN(dMin, dMax);
+        this->dMax = MAX(dMin, dMax);
+        this->cost = cost;
+        this->aggregation = aggregation;
+        this->radius = MAX(radius, 0);
+
+        maxCost = 48;
+
+        P1 = 4;
+        P2 = 32;
+
+        alpha = 0.9f;
+        tauColor = 0.03f;
+        tauGradient = 0.01f;
+
+        width = 0;
+        height = 0;
+        nDisparities = 0;
+    }
+
+    /**
+     * @brief execute computes the disparity maps of both views.
+     * @param img_left is the left image.
+     * @param img_right is the right image; it has the same size of img_left.
+     * @param disp_left is the left disparity map; channel 0 stores the
+     * disparity, channel 1 the matching cost, or -1 for invalid pixels.
+     * @param disp_right is the right disparity map.
+     * @param threshold is the maximum difference of the left-right check;
+     * if it is negative no check is applied.
+     */
+    void execute(Image *img_left, Image *img_right,
+                 Image *disp_left, Image *disp_right, int threshold = 1)
+    {
+        if(img_left == NULL || img_right == NULL ||
+           disp_left == NULL || disp_right == NULL) {
+            return;
+        }
+
+        if(!img_left->isValid() || !img_right->isValid()) {
+            return;
+        }
+
+        if((img_left->width != img_right->width) ||
+           (img_left->height != img_right->height)) {
+            return;
+        }
+
+        width = img_left->width;
+        height = img_left->height;
+        nDisparities = dMax - dMin + 1;
+
+        if(!disp_left->isValid()) {
+            disp_left->allocate(width, height, 2, 1);
+        }
+
+        if(!disp_right->isValid()) {
+            disp_right->allocate(width, height, 2, 1);
+        }
+
+        if(disp_left->width != width || disp_left->height != height || disp_left->channels < 2 ||
+           disp_right->width != width || disp_right->height != height || disp_right->channels < 2) {
+            return;
+        }
+
+        computeFeatures(img_left,  census_l, lum_l, grad_l);
+        computeFeatures(img_right, census_r, lum_r, grad_r);
+
+        int n = width * height;
+        best_cost_l.assign(n, INT_MAX);
+        best_cost_r.assign(n, INT_MAX);
+        best_d_l.assign(n, 0);
+        best_d_r.assign(n, 0);
+
+        if(aggregation == SA_SGM) {
+            executeSGM();
+        } else {
+            executeBox();
+        }
+
+        writeOutput(best_d_l, best_cost_l, best_d_r, disp_left, threshold);
+        writeOutput(best_d_r, best_cost_r, best_d_l, disp_right, threshold);
+    }
+};
+
+} // end namespace pic
+
+#endif // PIC_COMPUTER_VISION_STEREO_COST_VOLUME_HPP
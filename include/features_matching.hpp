@@ -37,11 +37,13 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "features_matching/dense_sift.hpp"
 #include "features_matching/patch_comp.hpp"
 #include "features_matching/transform_data.hpp"
+#include "features_matching/patch_match.hpp"
 
 #include "features_matching/ward_alignment.hpp"
 #include "features_matching/motion_estimation.hpp"
 
 //binary feature matcher
+#include "features_matching/binary_descriptor_matrix.hpp"
 #include "features_matching/binary_feature_matcher.hpp"
 #include "features_matching/binary_feature_brute_force_matcher.hpp"
 #include "features_matching/binary_feature_lsh_matcher.hpp"
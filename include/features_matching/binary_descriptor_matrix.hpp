@@ -0,0 +1,168 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_FEATURES_MATCHING_BINARY_DESCRIPTOR_MATRIX_HPP
+#define PIC_FEATURES_MATCHING_BINARY_DESCRIPTOR_MATRIX_HPP
+
+#include <vector>
+#include <string.h>
+
+#include "../base.hpp"
+#include "../util/math.hpp"
+
+namespace pic {
+
+/**
+ * @brief The BinaryDescriptorMatrix class stores a set of binary descriptors
+ * contiguously, one row per descriptor. Rows are padded to 64-bit words
+ * such that Hamming distances are computed with 64-bit popcounts.
+ */
+class BinaryDescriptorMatrix
+{
+protected:
+
+    /**
+     * @brief release
+     */
+    void release()
+    {
+        if(data != NULL) {
+            delete[] data;
+            data = NULL;
+        }
+
+        valid.clear();
+        n = 0;
+    }
+
+public:
+    unsigned long long          *data;
+    std::vector<unsigned char>  valid;
+    int                         n, desc_size, stride;
+
+    /**
+     * @brief BinaryDescriptorMatrix
+     */
+    BinaryDescriptorMatrix()
+    {
+        data = NULL;
+        n = 0;
+        desc_size = 0;
+        stride = 0;
+    }
+
+    /**
+     * @brief BinaryDescriptorMatrix
+     * @param descs is a vector of descriptors; NULL descriptors are
+     * marked as not valid.
+     * @param desc_size is the size of a descriptor in 32-bit words.
+     */
+    BinaryDescriptorMatrix(std::vector<unsigned int *> &descs, unsigned int desc_size)
+    {
+        data = NULL;
+        n = 0;
+        set(descs, desc_size);
+    }
+
+    ~BinaryDescriptorMatrix()
+    {
+        release();
+    }
+
+    /**
+     * @brief set copies descriptors into the matrix.
+     * @param descs is a vector of descriptors; NULL descriptors are
+     * marked as not valid.
+     * @param desc_size is the size of a descriptor in 32-bit words.
+     */
+    void set(std::vector<unsigned int *> &descs, unsigned int desc_size)
+    {
+        release();
+
+        this->n = int(descs.size());
+        this->desc_size = int(desc_size);
+        this->stride = (int(desc_size) + 1) >> 1;
+
+        data = new unsigned long long[MAX(n * stride, 1)];
+        valid.resize(n);
+
+        for(int i = 0; i < n; i++) {
+            unsigned long long *row = (*this)(i);
+            row[stride - 1] = 0;
+
+            valid[i] = (descs[i] != NULL) ? 1 : 0;
+
+            if(valid[i]) {
+                for(unsigned int j = 0; j < desc_size; j++) {
+                    unsigned long long word = descs[i][j];
+                    int k = j >> 1;
+
+                    if((j & 1) == 0) {
+                        row[k] = word;
+                    } else {
+                        row[k] |= (word << 32);
+                    }
+                }
+            } else {
+                memset(row, 0, sizeof(unsigned long long) * stride);
+            }
+        }
+    }
+
+    /**
+     * @brief operator () returns the i-th descriptor.
+     * @param i
+     * @return
+     */
+    inline unsigned long long *operator()(int i)
+    {
+        return data + i * stride;
+    }
+
+    /**
+     * @brief nBits
+     * @return It returns the number of bits of a descriptor.
+     */
+    inline unsigned int nBits()
+    {
+        return (unsigned int)(desc_size * sizeof(unsigned int) * 8);
+    }
+
+    /**
+     * @brief hammingDistance computes the Hamming distance between two rows.
+     * @param a
+     * @param b
+     * @param stride is the number of 64-bit words of a row.
+     * @return
+     */
+    static inline unsigned int hammingDistance(const unsigned long long *a,
+                                               const unsigned long long *b,
+                                               int stride)
+    {
+        unsigned int ret = 0;
+
+        for(int i = 0; i < stride; i++) {
+            ret += popcount64(a[i] ^ b[i]);
+        }
+
+        return ret;
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_FEATURES_MATCHING_BINARY_DESCRIPTOR_MATRIX_HPP */
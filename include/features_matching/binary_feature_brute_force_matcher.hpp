@@ -20,6 +20,9 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <vector>
 
+#include "../util/std_util.hpp"
+#include "../features_matching/brief_descriptor.hpp"
+#include "../features_matching/binary_descriptor_matrix.hpp"
 #include "../features_matching/binary_feature_matcher.hpp"
 
 namespace pic{
@@ -31,6 +34,9 @@ namespace pic{
  */
 class BinaryFeatureBruteForceMatcher : public BinaryFeatureMatcher
 {
+protected:
+    BinaryDescriptorMatrix descs_mtx;
+
 public:
 
     /**
@@ -40,6 +46,7 @@ public:
      */
     BinaryFeatureBruteForceMatcher(std::vector<unsigned int *> *descs, unsigned int desc_size) : BinaryFeatureMatcher(descs, desc_size)
     {
+        descs_mtx.set(*descs, desc_size);
     }
 
     /**
@@ -73,6 +80,112 @@ public:
 
         return ((dist_1 * 100 > dist_2 * 105) && matched_j != -1);
     }
+
+    /**
+     * @brief getAllTopTwo computes, for each descriptor in q, the best
+     * and the second best scores (number of equal bits) against all
+     * descriptors in t. Queries are processed in blocks in parallel, and
+     * each block of queries is matched against cache-sized blocks of t.
+     * @param q is a matrix of query descriptors.
+     * @param t is a matrix of train descriptors.
+     * @param matched_j is an array of q.n elements where the index of the
+     * best match is stored (-1 if there is no match).
+     * @param dist_1 is an array of q.n elements for the best scores.
+     * @param dist_2 is an array of q.n elements for the second best scores.
+     */
+    static void getAllTopTwo(BinaryDescriptorMatrix &q, BinaryDescriptorMatrix &t,
+                             int *matched_j, unsigned int *dist_1, unsigned int *dist_2)
+    {
+        const int q_block = 16;
+        const int t_block = 512;
+
+        int nBlocks = (q.n + q_block - 1) / q_block;
+        int stride = MIN(q.stride, t.stride);
+        unsigned int nBits = q.nBits();
+
+        #pragma omp parallel for schedule(dynamic)
+
+        for(int b = 0; b < nBlocks; b++) {
+            int i0 = b * q_block;
+            int i1 = MIN(i0 + q_block, q.n);
+
+            for(int i = i0; i < i1; i++) {
+                matched_j[i] = -1;
+                dist_1[i] = 0;
+                dist_2[i] = 0;
+            }
+
+            for(int j0 = 0; j0 < t.n; j0 += t_block) {
+                int j1 = MIN(j0 + t_block, t.n);
+
+                for(int i = i0; i < i1; i++) {
+                    if(!q.valid[i]) {
+                        continue;
+                    }
+
+                    unsigned long long *a = q(i);
+                    unsigned int d1 = dist_1[i];
+                    unsigned int d2 = dist_2[i];
+                    int mj = matched_j[i];
+
+                    for(int j = j0; j < j1; j++) {
+                        if(!t.valid[j]) {
+                            continue;
+                        }
+
+                        unsigned int dist = nBits - BinaryDescriptorMatrix::hammingDistance(a, t(j), stride);
+
+                        if(dist > d1) {
+                            d2 = d1;
+                            d1 = dist;
+                            mj = j;
+                        } else {
+                            if(dist > d2) {
+                                d2 = dist;
+                            }
+                        }
+                    }
+
+                    matched_j[i] = mj;
+                    dist_1[i] = d1;
+                    dist_2[i] = d2;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief getAllMatches matches all descriptors in descs0 using
+     * the blocked and multi-threaded matcher.
+     * @param descs0
+     * @param matches
+     */
+    void getAllMatches(std::vector<unsigned int *> &descs0, std::vector< Eigen::Vector3i > &matches)
+    {
+        matches.clear();
+
+        BinaryDescriptorMatrix q(descs0, desc_size);
+
+        if(q.n < 1) {
+            return;
+        }
+
+        int *matched_j = new int[q.n];
+        unsigned int *dist_1 = new unsigned int[q.n];
+        unsigned int *dist_2 = new unsigned int[q.n];
+
+        getAllTopTwo(q, descs_mtx, matched_j, dist_1, dist_2);
+
+        for(int i = 0; i < q.n; i++) {
+            if((dist_1[i] * 100 > dist_2[i] * 105) && matched_j[i] != -1) {
+                matches.push_back(Eigen::Vector3i(i, matched_j[i], dist_1[i]));
+            }
+        }
+
+        delete[] matched_j;
+        delete[] dist_1;
+        delete[] dist_2;
+    }
 };
 
 #endif
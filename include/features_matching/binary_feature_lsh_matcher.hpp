@@ -19,7 +19,9 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FEATURES_MATCHING_BINARY_FEATURE_LSH_MATCHER_HPP
 
 #include <vector>
+#include <algorithm>
 
+#include "../util/std_util.hpp"
 #include "../features_matching/hash_table_lsh.hpp"
 #include "../features_matching/binary_feature_matcher.hpp"
 
@@ -28,20 +30,67 @@ namespace pic {
 #ifndef PIC_DISABLE_EIGEN
 
 /**
- * @brief The LSH class
+ * @brief The LSH class; queries use multi-probing, which visits
+ * the buckets near the query's key, so far fewer tables are needed
+ * for the same recall.
  */
 class BinaryFeatureLSHMatcher: public BinaryFeatureMatcher
 {
 protected:
     std::vector< HashTableLSH* > tables;
+    unsigned int probeRadius;
+
+    std::vector< unsigned int > visited;
+    unsigned int stamp;
+
+    /**
+     * @brief getMatchAux
+     * @param desc
+     * @param matched_j
+     * @param dist_1
+     * @param visited
+     * @param stamp
+     * @return
+     */
+    bool getMatchAux(unsigned int *desc, int &matched_j, unsigned int &dist_1,
+                     unsigned int *visited, unsigned int stamp)
+    {
+        unsigned int dist_2 = 0;
+
+        dist_1 = R;
+        matched_j = -1;
+
+        if(desc == NULL) {
+            return false;
+        }
+
+        for(unsigned int i=0; i<tables.size(); i++) {
+            tables[i]->getNearest(desc, matched_j, dist_1, dist_2, probeRadius, visited, stamp);
+        }
+
+        return (matched_j != -1);// && (dist_1 * 100 > dist_2 * 105);
+    }
 
 public:
 
     /**
      * @brief LSH
+     * @param descs
+     * @param desc_size
+     * @param nTables
+     * @param hash_size
+     * @param probeRadius is the maximum Hamming distance (0, 1, or 2)
+     * between the key of a query and the keys of the probed buckets; with
+     * multi-probing, fewer tables (e.g., 8 with probeRadius = 1) give a
+     * similar recall with less memory.
      */
-    BinaryFeatureLSHMatcher(std::vector< unsigned int *> *descs, unsigned int desc_size, unsigned int nTables = 32, unsigned int hash_size = 8) : BinaryFeatureMatcher(descs, desc_size)
+    BinaryFeatureLSHMatcher(std::vector< unsigned int *> *descs, unsigned int desc_size, unsigned int nTables = 32, unsigned int hash_size = 8, unsigned int probeRadius = 0) : BinaryFeatureMatcher(descs, desc_size)
     {
+        this->probeRadius = MIN(probeRadius, 2);
+
+        visited.assign(descs->size(), 0);
+        stamp = 0;
+
         std::mt19937 m_rnd(1);
 
         for(unsigned int i=0; i < nTables; i++) {
@@ -52,6 +101,16 @@ public:
         }
     }
 
+    ~BinaryFeatureLSHMatcher()
+    {
+        for(unsigned int i = 0; i < tables.size(); i++) {
+            delete[] tables[i]->g_f;
+            delete tables[i];
+        }
+
+        tables.clear();
+    }
+
     /**
      * @brief getHash
      * @param dim
@@ -92,16 +151,62 @@ public:
      */
     bool getMatch(unsigned int *desc, int &matched_j, unsigned int &dist_1)
     {
-        unsigned int dist_2 = 0;
+        stamp++;
 
-        dist_1 = R;
-        matched_j = -1;
+        if(stamp == 0) {
+            std::fill(visited.begin(), visited.end(), 0);
+            stamp = 1;
+        }
 
-        for(unsigned int i=0; i<tables.size(); i++) {
-            tables[i]->getNearest(desc, matched_j, dist_1, dist_2);
+        return getMatchAux(desc, matched_j, dist_1, visited.data(), stamp);
+    }
+
+    /**
+     * @brief getAllMatches runs queries in parallel; queries are split
+     * into chunks and each chunk has its own visited buffer.
+     * @param descs0
+     * @param matches
+     */
+    void getAllMatches(std::vector<unsigned int *> &descs0, std::vector< Eigen::Vector3i > &matches)
+    {
+        matches.clear();
+
+        int n = int(descs0.size());
+
+        if(n < 1) {
+            return;
         }
 
-        return (matched_j != -1);// && (dist_1 * 100 > dist_2 * 105);
+        int *matched_j = new int[n];
+        unsigned int *dist_1 = new unsigned int[n];
+        bool *bMatched = new bool[n];
+
+        int nChunks = MIN(getNumberOfThreads(), n);
+        unsigned int nDescs = (unsigned int)(descs->size());
+
+        #pragma omp parallel for
+
+        for(int c = 0; c < nChunks; c++) {
+            int i0 = (n * c) / nChunks;
+            int i1 = (n * (c + 1)) / nChunks;
+
+            std::vector< unsigned int > visited_c(nDescs, 0);
+
+            for(int i = i0; i < i1; i++) {
+                bMatched[i] = getMatchAux(descs0[i], matched_j[i], dist_1[i],
+                                          visited_c.data(), (unsigned int)(i - i0 + 1));
+            }
+        }
+
+        for(int i = 0; i < n; i++) {
+            if(bMatched[i]) {
+                matches.push_back(Eigen::Vector3i(i, matched_j[i], dist_1[i]));
+            }
+        }
+
+        delete[] matched_j;
+        delete[] dist_1;
+        delete[] bMatched;
     }
 };
 
@@ -69,7 +69,12 @@ public:
     }
 
 #ifndef PIC_DISABLE_EIGEN
-    void getAllMatches(std::vector<unsigned int *> &descs0, std::vector< Eigen::Vector3i > &matches)
+    /**
+     * @brief getAllMatches
+     * @param descs0
+     * @param matches
+     */
+    virtual void getAllMatches(std::vector<unsigned int *> &descs0, std::vector< Eigen::Vector3i > &matches)
     {
         matches.clear();
 
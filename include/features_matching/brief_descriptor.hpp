@@ -92,17 +92,7 @@ protected:
      */
     static unsigned int countZeros(unsigned int x)
     {
-        unsigned int n = sizeof(unsigned int) * 8;
-
-        unsigned int ret = 0;
-
-        for(unsigned int i = 0; i < n; i++) {
-            if((x & (1 << i)) == 0) {
-                ret++;
-            }
-        }
-
-        return ret;
+        return (sizeof(unsigned int) * 8) - popcount(x);
     }
 
     /**
@@ -269,10 +259,10 @@ public:
         unsigned int ret = 0;
 
         for(unsigned int i = 0; i < nfv; i++) {
-            ret += countZeros(fv0[i] ^ fv1[i]);
+            ret += popcount(fv0[i] ^ fv1[i]);
         }
 
-        return ret;
+        return nfv * sizeof(unsigned int) * 8 - ret;
     }
 };
 
@@ -216,10 +216,8 @@ public:
         if(threshold < 0.0f) { //the best i-th points
             int bestPoints = int(-threshold);
 
-            ret->sort();
-
             int n = ret->size();
-            threshold = ret->dataTMP[n - 1 - bestPoints];
+            threshold = getKthValue(ret->data, n, MAX(n - 1 - bestPoints, 0));
         }
 
         for(int i = 0; i < height; i++) {
@@ -21,6 +21,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <vector>
 #include <math.h>
 #include <set>
+#include <string.h>
 
 #include "../features_matching/brief_descriptor.hpp"
 
@@ -29,15 +30,21 @@ namespace pic {
 #ifndef PIC_DISABLE_EIGEN
 
 /**
- * @brief The Hash class
+ * @brief The HashTableLSH class is a hash table for binary descriptors, where
+ * the key of a descriptor is a subset of its bits. Buckets are packed in
+ * a compressed sparse row (CSR) layout: the indices of the descriptors
+ * in bucket k are stored in indices[offsets[k]] ... indices[offsets[k + 1] - 1].
  */
 class HashTableLSH
 {
+protected:
+    unsigned int *g_block, *g_shift;
+
 public:
     unsigned int *g_f;
 
     std::vector< unsigned int *> *descs;
-    std::vector< unsigned int > *table;
+    unsigned int    *offsets, *indices;
     unsigned int    nTable;
     unsigned int    hash_size, desc_size, size_ui;
 
@@ -49,7 +56,6 @@ public:
         this->hash_size = hash_size;
 
         nTable = 1 << hash_size;
-        table = new std::vector< unsigned int >[nTable];
 
         //hash function
         this->g_f = g_f;
@@ -59,10 +65,64 @@ public:
         this->desc_size = desc_size;
         size_ui = sizeof(unsigned int) * 8;
 
-        for(unsigned int i = 0; i < descs->size();  i++) {
-            unsigned int address = getAddress(descs->at(i));
-            table[address].push_back(i);
+        //word and bit position of each bit of the key
+        g_block = new unsigned int[hash_size];
+        g_shift = new unsigned int[hash_size];
+
+        for(unsigned int i = 0; i < hash_size; i++) {
+            g_block[i] = g_f[i] / size_ui;
+            g_shift[i] = g_f[i] % size_ui;
+        }
+
+        int n = int(descs->size());
+        unsigned int *address = new unsigned int[MAX(n, 1)];
+
+        #pragma omp parallel for
+
+        for(int i = 0; i < n; i++) {
+            unsigned int *desc = descs->at(i);
+            address[i] = (desc != NULL) ? getAddress(desc) : nTable;
+        }
+
+        //build the CSR layout
+        offsets = new unsigned int[nTable + 1];
+
+        for(unsigned int i = 0; i <= nTable; i++) {
+            offsets[i] = 0;
+        }
+
+        for(int i = 0; i < n; i++) {
+            if(address[i] < nTable) {
+                offsets[address[i] + 1]++;
+            }
+        }
+
+        for(unsigned int i = 0; i < nTable; i++) {
+            offsets[i + 1] += offsets[i];
         }
+
+        indices = new unsigned int[MAX(offsets[nTable], 1)];
+
+        unsigned int *pos = new unsigned int[nTable];
+        memcpy(pos, offsets, sizeof(unsigned int) * nTable);
+
+        for(int i = 0; i < n; i++) {
+            if(address[i] < nTable) {
+                indices[pos[address[i]]] = i;
+                pos[address[i]]++;
+            }
+        }
+
+        delete[] pos;
+        delete[] address;
+    }
+
+    ~HashTableLSH()
+    {
+        delete[] g_block;
+        delete[] g_shift;
+        delete[] offsets;
+        delete[] indices;
     }
 
     /**
@@ -73,35 +133,39 @@ public:
     unsigned int getAddress(unsigned int *desc)
     {
         unsigned int address = 0;
-        for(unsigned int i=0; i<hash_size; i++) {
-            unsigned int pos = g_f[i];
 
-            unsigned int block = pos / size_ui;
-            unsigned int pos_block = pos % size_ui;
-
-            unsigned int bit = (desc[block] >> pos_block) & 0x1;
-
-            if(bit == 1) {
-                address += (1 << i);
-            }
+        for(unsigned int i = 0; i < hash_size; i++) {
+            address |= ((desc[g_block[i]] >> g_shift[i]) & 0x1) << i;
         }
 
         return address;
     }
 
     /**
-     * @brief getNearest
+     * @brief searchBucket
      * @param desc
+     * @param address
      * @param matched_j
      * @param dist_1
      * @param dist_2
+     * @param visited
+     * @param stamp
      */
-    void getNearest(unsigned int * desc, int &matched_j, unsigned int &dist_1, unsigned int &dist_2)
+    void searchBucket(unsigned int *desc, unsigned int address,
+                      int &matched_j, unsigned int &dist_1, unsigned int &dist_2,
+                      unsigned int *visited, unsigned int stamp)
     {
-        unsigned int address = getAddress(desc);
+        for(unsigned int i = offsets[address]; i < offsets[address + 1]; i++) {
+            unsigned int j = indices[i];
+
+            if(visited != NULL) {
+                if(visited[j] == stamp) {
+                    continue;
+                }
+
+                visited[j] = stamp;
+            }
 
-        for(unsigned int i=0; i<table[address].size(); i++) {
-            unsigned int j = table[address].at(i);
             unsigned int dist = BRIEFDescriptor::match(desc, descs->at(j), desc_size);
 
             if(dist > dist_1) {
@@ -115,6 +179,45 @@ public:
             }
         }
     }
+
+    /**
+     * @brief getNearest searches the bucket of desc and, with multi-probing,
+     * all buckets whose keys are within Hamming distance probeRadius
+     * (up to 2) of the key of desc.
+     * @param desc
+     * @param matched_j
+     * @param dist_1
+     * @param dist_2
+     * @param probeRadius
+     * @param visited is an optional array with an element for each descriptor
+     * in the table; descriptors with visited[j] == stamp are skipped.
+     * @param stamp
+     */
+    void getNearest(unsigned int * desc, int &matched_j, unsigned int &dist_1, unsigned int &dist_2,
+                    unsigned int probeRadius = 0, unsigned int *visited = NULL, unsigned int stamp = 0)
+    {
+        unsigned int address = getAddress(desc);
+
+        searchBucket(desc, address, matched_j, dist_1, dist_2, visited, stamp);
+
+        if(probeRadius < 1) {
+            return;
+        }
+
+        for(unsigned int a = 0; a < hash_size; a++) {
+            unsigned int address_a = address ^ (1 << a);
+
+            searchBucket(desc, address_a, matched_j, dist_1, dist_2, visited, stamp);
+
+            if(probeRadius < 2) {
+                continue;
+            }
+
+            for(unsigned int b = a + 1; b < hash_size; b++) {
+                searchBucket(desc, address_a ^ (1 << b), matched_j, dist_1, dist_2, visited, stamp);
+            }
+        }
+    }
 };
 
 #endif
@@ -19,13 +19,26 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FEATURES_MATCHING_MOTION_ESTIMATION_HPP
 
 #include <functional>
+#include <vector>
+#include <stdlib.h>
+#include <limits.h>
 
 #include "../image.hpp"
 
 #include "../features_matching/patch_comp.hpp"
+#include "../features_matching/patch_match.hpp"
+
+#include "../filtering/filter_luminance.hpp"
 
 namespace pic {
 
+/**
+ * @brief The MOTION_ESTIMATION_MODE enum: exhaustive block search with
+ * SSD, coarse-to-fine predictive search with byte SAD, or PatchMatch
+ * with SSD.
+ */
+enum MOTION_ESTIMATION_MODE {MEM_EXHAUSTIVE, MEM_HIERARCHICAL, MEM_PATCHMATCH};
+
 /**
  * @brief The MotionEstimation class
  */
@@ -35,6 +48,385 @@ protected:
     int         shift, blockSize, halfBlockSize;
     int         width, height;
     PatchComp   *pmc;
+    Image       *img0, *img1;
+
+    MOTION_ESTIMATION_MODE mode;
+
+    //pyramids of 8-bit luminance
+    std::vector< std::vector<unsigned char> > pyr0, pyr1;
+    std::vector<int> pyr_width, pyr_height;
+
+    //motion vectors of the last call; they are temporal predictors
+    std::vector<int> mvx_prev, mvy_prev;
+
+    /**
+     * @brief getLuminance8 converts an image into 8-bit luminance; values are
+     * scaled so that the mean maps to 128, which makes frames with different
+     * exposures comparable.
+     * @param img
+     * @param out
+     */
+    static void getLuminance8(Image *img, std::vector<unsigned char> &out)
+    {
+        Image *L = FilterLuminance::Execute(img, NULL, LT_CIE_LUMINANCE);
+
+        int n = L->width * L->height;
+
+        float meanVal = 0.0f;
+        L->getMeanVal(NULL, &meanVal);
+        float scale = meanVal > 0.0f ? (128.0f / meanVal) : 255.0f;
+
+        out.resize(n);
+
+        #pragma omp parallel for
+
+        for(int i = 0; i < n; i++) {
+            float val = L->data[i] * scale + 0.5f;
+            out[i] = (unsigned char) CLAMPi(val, 0.0f, 255.0f);
+        }
+
+        delete L;
+    }
+
+    /**
+     * @brief downsample halves an 8-bit image with a 2x2 box filter.
+     * @param in
+     * @param w
+     * @param h
+     * @param out
+     */
+    static void downsample(std::vector<unsigned char> &in, int w, int h,
+                           std::vector<unsigned char> &out)
+    {
+        int w2 = w >> 1;
+        int h2 = h >> 1;
+
+        out.resize(w2 * h2);
+
+        #pragma omp parallel for
+
+        for(int y = 0; y < h2; y++) {
+            unsigned char *r0 = &in[(y * 2) * w];
+            unsigned char *r1 = &in[(y * 2 + 1) * w];
+            unsigned char *o = &out[y * w2];
+
+            for(int x = 0; x < w2; x++) {
+                int sum = r0[x * 2] + r0[x * 2 + 1] + r1[x * 2] + r1[x * 2 + 1];
+                o[x] = (unsigned char)((sum + 2) >> 2);
+            }
+        }
+    }
+
+    /**
+     * @brief getSAD computes the sum of absolute differences of two blocks;
+     * it stops after the first row where the partial sum reaches bestSAD.
+     * @param a
+     * @param b
+     * @param stride
+     * @param bw
+     * @param bh
+     * @param bestSAD
+     * @return
+     */
+    static inline int getSAD(const unsigned char *a, const unsigned char *b,
+                             int stride, int bw, int bh, int bestSAD)
+    {
+        int sad = 0;
+
+        for(int j = 0; j < bh; j++) {
+            int rowSAD = 0;
+
+            for(int i = 0; i < bw; i++) {
+                rowSAD += abs(int(a[i]) - int(b[i]));
+            }
+
+            sad += rowSAD;
+
+            if(sad >= bestSAD) {
+                return sad;
+            }
+
+            a += stride;
+            b += stride;
+        }
+
+        return sad;
+    }
+
+    /**
+     * @brief evaluate computes the SAD of a block for a motion vector
+     * and keeps the vector if it is better than the current one.
+     * @param level
+     * @param x
+     * @param y
+     * @param bw
+     * @param bh
+     * @param range
+     * @param dx
+     * @param dy
+     * @param bx
+     * @param by
+     * @param bs
+     * @return It returns true if the vector was valid and evaluated.
+     */
+    bool evaluate(int level, int x, int y, int bw, int bh, int range,
+                  int dx, int dy, int &bx, int &by, int &bs)
+    {
+        int w = pyr_width[level];
+        int h = pyr_height[level];
+
+        if((std::abs(dx) > range) || (std::abs(dy) > range)) {
+            return false;
+        }
+
+        int x1 = x + dx;
+        int y1 = y + dy;
+
+        if((x1 < 0) || (y1 < 0) || ((x1 + bw) > w) || ((y1 + bh) > h)) {
+            return false;
+        }
+
+        if(dx == bx && dy == by && bs < INT_MAX) {
+            return false;
+        }
+
+        int sad = getSAD(&pyr0[level][y * w + x], &pyr1[level][y1 * w + x1], w, bw, bh, bs);
+
+        if(sad < bs || (sad == bs && (std::abs(dx) + std::abs(dy)) < (std::abs(bx) + std::abs(by)))) {
+            bx = dx;
+            by = dy;
+            bs = sad;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief diamondSearch refines a motion vector with a large diamond
+     * pattern until the center is the best, and then a small one.
+     * @param level
+     * @param x
+     * @param y
+     * @param bw
+     * @param bh
+     * @param range
+     * @param bx
+     * @param by
+     * @param bs
+     */
+    void diamondSearch(int level, int x, int y, int bw, int bh, int range,
+                       int &bx, int &by, int &bs)
+    {
+        static const int LDSP[8][2] = {{0, -2}, {1, -1}, {2, 0}, {1, 1},
+                                       {0, 2}, {-1, 1}, {-2, 0}, {-1, -1}};
+        static const int SDSP[4][2] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+
+        for(int it = 0; it < 32; it++) {
+            int cx = bx;
+            int cy = by;
+
+            for(int k = 0; k < 8; k++) {
+                evaluate(level, x, y, bw, bh, range, cx + LDSP[k][0], cy + LDSP[k][1], bx, by, bs);
+            }
+
+            if(bx == cx && by == cy) {
+                break;
+            }
+        }
+
+        int cx = bx;
+        int cy = by;
+
+        for(int k = 0; k < 4; k++) {
+            evaluate(level, x, y, bw, bh, range, cx + SDSP[k][0], cy + SDSP[k][1], bx, by, bs);
+        }
+    }
+
+    /**
+     * @brief processPatchMatch computes a dense NNF with PatchMatch, with
+     * offsets limited to shift, and it assigns to each block the offset of
+     * its center; this avoids testing all (2 * shift + 1)^2 offsets of the
+     * exhaustive search.
+     * @param imgOut
+     */
+    void processPatchMatch(Image *imgOut)
+    {
+        PatchMatch pm(img0, img1, blockSize, shift);
+        Image *nnf = pm.execute(NULL);
+
+        if(nnf == NULL) {
+            return;
+        }
+
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            int yc = MIN((y / blockSize) * blockSize + halfBlockSize, height - 1);
+
+            for(int x = 0; x < width; x++) {
+                int xc = MIN((x / blockSize) * blockSize + halfBlockSize, width - 1);
+
+                float *src = (*nnf)(xc, yc);
+                float *data = (*imgOut)(x, y);
+                data[0] = src[0];
+                data[1] = src[1];
+                data[2] = src[2];
+            }
+        }
+
+        delete nnf;
+    }
+
+    /**
+     * @brief processHierarchical estimates motion coarse-to-fine. At each
+     * level, every block tests predictors (zero, the coarser level, the
+     * previous call, and already estimated neighbours) and refines the best
+     * one with a diamond search. Blocks are processed in rows in parallel;
+     * a second pass takes predictors from the rows above and below, as they
+     * were at the end of the first pass, so results do not depend on the
+     * number of threads.
+     * @param imgOut
+     */
+    void processHierarchical(Image *imgOut)
+    {
+        //pyramids
+        int nLevels = 1;
+
+        while((nLevels < 6) &&
+              ((shift >> nLevels) >= 2) &&
+              ((width >> nLevels) >= (blockSize * 2)) &&
+              ((height >> nLevels) >= (blockSize * 2))) {
+            nLevels++;
+        }
+
+        pyr0.resize(nLevels);
+        pyr1.resize(nLevels);
+        pyr_width.resize(nLevels);
+        pyr_height.resize(nLevels);
+
+        getLuminance8(img0, pyr0[0]);
+        getLuminance8(img1, pyr1[0]);
+        pyr_width[0] = width;
+        pyr_height[0] = height;
+
+        for(int l = 1; l < nLevels; l++) {
+            downsample(pyr0[l - 1], pyr_width[l - 1], pyr_height[l - 1], pyr0[l]);
+            downsample(pyr1[l - 1], pyr_width[l - 1], pyr_height[l - 1], pyr1[l]);
+            pyr_width[l] = pyr_width[l - 1] >> 1;
+            pyr_height[l] = pyr_height[l - 1] >> 1;
+        }
+
+        std::vector<int> mvx, mvy, sad, mvx_c, mvy_c, mvx_s, mvy_s;
+        int nbx_c = 0;
+        int nbx = 0;
+        int nby = 0;
+
+        for(int l = nLevels - 1; l >= 0; l--) {
+            int w = pyr_width[l];
+            int h = pyr_height[l];
+
+            nbx = (w + blockSize - 1) / blockSize;
+            nby = (h + blockSize - 1) / blockSize;
+
+            int range = MAX(shift >> l, 1);
+
+            bool bTemporal = (l == 0) && (int(mvx_prev.size()) == (nbx * nby));
+
+            mvx.assign(nbx * nby, 0);
+            mvy.assign(nbx * nby, 0);
+            sad.assign(nbx * nby, INT_MAX);
+
+            for(int pass = 0; pass < 2; pass++) {
+                //neighbours of the second pass are read from a snapshot
+                if(pass == 1) {
+                    mvx_s = mvx;
+                    mvy_s = mvy;
+                }
+
+                #pragma omp parallel for schedule(dynamic)
+
+                for(int j = 0; j < nby; j++) {
+                    int y = j * blockSize;
+                    int bh = MIN(blockSize, h - y);
+
+                    for(int i = 0; i < nbx; i++) {
+                        int x = i * blockSize;
+                        int bw = MIN(blockSize, w - x);
+                        int ind = j * nbx + i;
+
+                        int bx = mvx[ind];
+                        int by = mvy[ind];
+                        int bs = sad[ind];
+
+                        if(pass == 0) {
+                            evaluate(l, x, y, bw, bh, range, 0, 0, bx, by, bs);
+
+                            if(!mvx_c.empty()) {
+                                int ic = MIN(j >> 1, int(mvy_c.size() / nbx_c) - 1) * nbx_c +
+                                         MIN(i >> 1, nbx_c - 1);
+                                evaluate(l, x, y, bw, bh, range, mvx_c[ic] * 2, mvy_c[ic] * 2, bx, by, bs);
+                            }
+
+                            if(bTemporal) {
+                                evaluate(l, x, y, bw, bh, range, mvx_prev[ind], mvy_prev[ind], bx, by, bs);
+                            }
+
+                            if(i > 0) {
+                                evaluate(l, x, y, bw, bh, range, mvx[ind - 1], mvy[ind - 1], bx, by, bs);
+                            }
+                        } else {
+                            if(j > 0) {
+                                evaluate(l, x, y, bw, bh, range, mvx_s[ind - nbx], mvy_s[ind - nbx], bx, by, bs);
+                            }
+
+                            if(j < (nby - 1)) {
+                                evaluate(l, x, y, bw, bh, range, mvx_s[ind + nbx], mvy_s[ind + nbx], bx, by, bs);
+                            }
+
+                            if(i < (nbx - 1)) {
+                                evaluate(l, x, y, bw, bh, range, mvx_s[ind + 1], mvy_s[ind + 1], bx, by, bs);
+                            }
+                        }
+
+                        if(bs == INT_MAX) {
+                            bx = 0;
+                            by = 0;
+                            bs = getSAD(&pyr0[l][y * w + x], &pyr1[l][y * w + x], w, bw, bh, INT_MAX);
+                        }
+
+                        diamondSearch(l, x, y, bw, bh, range, bx, by, bs);
+
+                        mvx[ind] = bx;
+                        mvy[ind] = by;
+                        sad[ind] = bs;
+                    }
+                }
+            }
+
+            mvx_c = mvx;
+            mvy_c = mvy;
+            nbx_c = nbx;
+        }
+
+        mvx_prev = mvx;
+        mvy_prev = mvy;
+
+        //output
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            int j = y / blockSize;
+
+            for(int x = 0; x < width; x++) {
+                int ind = j * nbx + x / blockSize;
+
+                float *data = (*imgOut)(x, y);
+                data[0] = float(mvx[ind]);
+                data[1] = float(mvy[ind]);
+                data[2] = float(sad[ind]);
+            }
+        }
+    }
 
     /**
      * @brief processAux
@@ -56,8 +448,8 @@ protected:
                 int y0 = y + halfBlockSize;
 
 
-                int x_e = MAX((x + blockSize), imgOut->width);
-                int y_e = MAX((y + blockSize), imgOut->height);
+                int x_e = MIN((x + blockSize), imgOut->width);
+                int y_e = MIN((y + blockSize), imgOut->height);
 
                 int dx = 0;
                 int dy = 0;
@@ -104,10 +496,15 @@ public:
      * @param img1
      * @param blockSize
      * @param maxRadius
+     * @param mode
      */
-    MotionEstimation(Image *img0, Image *img1, int blockSize, int maxRadius)
+    MotionEstimation(Image *img0, Image *img1, int blockSize, int maxRadius,
+                     MOTION_ESTIMATION_MODE mode = MEM_EXHAUSTIVE)
     {
         pmc = NULL;
+        this->img0 = NULL;
+        this->img1 = NULL;
+        this->mode = mode;
 
         setup(img0, img1, blockSize, maxRadius);
     }
@@ -154,20 +551,46 @@ public:
         this->width = img0->width;
         this->height = img0->height;
 
+        this->img0 = img0;
+        this->img1 = img1;
+
+        if(pmc != NULL) {
+            delete pmc;
+        }
+
         pmc = new PatchComp(img0, img1, blockSize);
     }
 
     /**
-     * @brief execute
+     * @brief process computes a motion field with a vector per block;
+     * channels store (dx, dy, error). The error is the SSD in the exhaustive
+     * and PatchMatch modes, and the 8-bit luminance SAD in the hierarchical
+     * mode. In the hierarchical mode, when the object is set up again with
+     * the next pair of frames, the last field is used as temporal
+     * predictor.
      * @param imgOut
      * @return
      */
     Image *process(Image *imgOut)
     {
+        if(pmc == NULL) {
+            return imgOut;
+        }
+
         if(imgOut == NULL) {
             imgOut = new Image(1, width, height, 3);
         }
 
+        if(mode == MEM_HIERARCHICAL) {
+            processHierarchical(imgOut);
+            return imgOut;
+        }
+
+        if(mode == MEM_PATCHMATCH) {
+            processPatchMatch(imgOut);
+            return imgOut;
+        }
+
         TileList lst(blockSize, width, height);
 
         //create threads
@@ -183,8 +606,11 @@ public:
         //threads join
         for(int i = 0; i < numCores; i++) {
             thrd[i]->join();
+            delete thrd[i];
         }
 
+        delete[] thrd;
+
         return imgOut;
     }
 
@@ -195,11 +621,13 @@ public:
      * @param blockSize
      * @param maxRadius
      * @param imgOut
+     * @param mode
      * @return
      */
-    static Image *execute(Image *img0, Image *img1, int blockSize, int maxRadius, Image *imgOut)
+    static Image *execute(Image *img0, Image *img1, int blockSize, int maxRadius, Image *imgOut,
+                          MOTION_ESTIMATION_MODE mode = MEM_EXHAUSTIVE)
     {
-        MotionEstimation me(img0, img1, blockSize, maxRadius);
+        MotionEstimation me(img0, img1, blockSize, maxRadius, mode);
 
         return me.process(imgOut);
     }
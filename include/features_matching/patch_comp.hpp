@@ -334,18 +334,51 @@ public:
     }
 
     /**
-     * @brief getSSD
+     * @brief getSSD computes the SSD between the patch centered in (x0, y0)
+     * in img0 and the one centered in (x1, y1) in img1. The computation
+     * stops after the first row where the partial sum exceeds threshold.
      * @param x0
      * @param y0
      * @param x1
      * @param y1
+     * @param threshold
      * @return
      */
     float getSSD(int x0, int y0,
-                 int x1, int y1)
+                 int x1, int y1, float threshold = FLT_MAX)
     {
         float val = 0.0f;
 
+        bool bInside = (x0 >= halfPatchSize) && (x0 < (img0->width - halfPatchSize)) &&
+                       (y0 >= halfPatchSize) && (y0 < (img0->height - halfPatchSize)) &&
+                       (x1 >= halfPatchSize) && (x1 < (img1->width - halfPatchSize)) &&
+                       (y1 >= halfPatchSize) && (y1 < (img1->height - halfPatchSize));
+
+        if(bInside) {
+            //patches are fully inside; rows are contiguous
+            int n = patchSize * img0->channels;
+
+            for(int i = -halfPatchSize; i <= halfPatchSize; i++) {
+                float *row0 = (*img0)(x0 - halfPatchSize, y0 + i);
+                float *row1 = (*img1)(x1 - halfPatchSize, y1 + i);
+
+                float rowVal = 0.0f;
+
+                for(int k = 0; k < n; k++) {
+                    float tmp = row0[k] - row1[k];
+                    rowVal += tmp * tmp;
+                }
+
+                val += rowVal;
+
+                if(val > threshold) {
+                    return val;
+                }
+            }
+
+            return val;
+        }
+
         for(int i = -halfPatchSize; i <= halfPatchSize; i++) {
             for(int j = -halfPatchSize; j <= halfPatchSize; j++) {
                 float *tmpData0 = (*img0)(x0 + j, y0 + i);
@@ -356,6 +389,10 @@ public:
                     val += tmp * tmp;
                 }
             }
+
+            if(val > threshold) {
+                return val;
+            }
         }
 
         return val;
@@ -0,0 +1,463 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_FEATURES_MATCHING_PATCH_MATCH_HPP
+#define PIC_FEATURES_MATCHING_PATCH_MATCH_HPP
+
+#include <vector>
+#include <random>
+
+#include "../base.hpp"
+
+#include "../image.hpp"
+
+#include "../features_matching/patch_comp.hpp"
+
+#include "../util/math.hpp"
+#include "../util/std_util.hpp"
+
+namespace pic {
+
+/**
+ * @brief The PatchMatch class computes an approximate nearest-neighbour
+ * field (NNF) from img0 to img1 using PatchMatch: random initialization,
+ * propagation of good offsets from neighbours, and random search in
+ * windows of decreasing size. Distances are PatchComp SSDs, which stop
+ * as soon as they exceed the current best distance.
+ *
+ * Two parallel schemes are available. The default one splits rows into
+ * bands that are scanned independently; band boundaries move at every
+ * iteration so that offsets propagate across them. The jump-flooding
+ * variant reads offsets from the previous pass only, so every pixel can be
+ * processed in parallel; neighbours are visited at steps 8, 4, 2, and 1.
+ */
+class PatchMatch
+{
+protected:
+    Image *img0, *img1;
+    PatchComp *pc;
+
+    int width, height, width1, height1;
+    int patchSize, maxRadius;
+
+    std::vector<int> ox, oy;
+    std::vector<float> dist;
+
+    /**
+     * @brief isValidOffset checks if an offset is allowed for a pixel.
+     * @param x
+     * @param y
+     * @param dx
+     * @param dy
+     * @return
+     */
+    inline bool isValidOffset(int x, int y, int dx, int dy)
+    {
+        int x1 = x + dx;
+        int y1 = y + dy;
+
+        if((x1 < 0) || (x1 >= width1) || (y1 < 0) || (y1 >= height1)) {
+            return false;
+        }
+
+        if(maxRadius > 0) {
+            return (std::abs(dx) <= maxRadius) && (std::abs(dy) <= maxRadius);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief tryOffset evaluates an offset for a pixel and keeps it if
+     * it improves the current one.
+     * @param x
+     * @param y
+     * @param dx
+     * @param dy
+     * @param bx is the current best offset.
+     * @param by is the current best offset.
+     * @param bd is the current best distance.
+     */
+    inline void tryOffset(int x, int y, int dx, int dy, int &bx, int &by, float &bd)
+    {
+        if((dx == bx && dy == by) || !isValidOffset(x, y, dx, dy)) {
+            return;
+        }
+
+        float d = pc->getSSD(x, y, x + dx, y + dy, bd);
+
+        if(d < bd) {
+            bx = dx;
+            by = dy;
+            bd = d;
+        }
+    }
+
+    /**
+     * @brief randomSearch samples offsets around the current best one in
+     * windows of halving size.
+     * @param x
+     * @param y
+     * @param bx
+     * @param by
+     * @param bd
+     * @param m
+     */
+    void randomSearch(int x, int y, int &bx, int &by, float &bd, std::minstd_rand &m)
+    {
+        int w = maxRadius > 0 ? maxRadius : MAX(width1, height1);
+        std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+
+        while(w >= 1) {
+            int dx = bx + int(lround(u(m) * float(w)));
+            int dy = by + int(lround(u(m) * float(w)));
+
+            tryOffset(x, y, dx, dy, bx, by, bd);
+
+            w >>= 1;
+        }
+    }
+
+    /**
+     * @brief initialize sets offsets up randomly, or from an input NNF.
+     * @param nnf_init
+     * @param seed
+     */
+    void initialize(Image *nnf_init, unsigned int seed)
+    {
+        int n = width * height;
+
+        ox.resize(n);
+        oy.resize(n);
+        dist.resize(n);
+
+        bool bInit = false;
+
+        if(nnf_init != NULL) {
+            bInit = nnf_init->isValid() && (nnf_init->width == width) &&
+                    (nnf_init->height == height) && (nnf_init->channels >= 2);
+        }
+
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            std::minstd_rand m(seed * 2654435761u + y + 1);
+
+            int rx = maxRadius > 0 ? maxRadius : width1;
+            int ry = maxRadius > 0 ? maxRadius : height1;
+
+            for(int x = 0; x < width; x++) {
+                int i = y * width + x;
+                int dx = 0;
+                int dy = 0;
+
+                if(bInit) {
+                    float *tmp = (*nnf_init)(x, y);
+                    dx = int(lround(tmp[0]));
+                    dy = int(lround(tmp[1]));
+                }
+
+                if(!bInit || !isValidOffset(x, y, dx, dy)) {
+                    int counter = 0;
+
+                    do {
+                        if(maxRadius > 0) {
+                            dx = int(m() % (2 * rx + 1)) - rx;
+                            dy = int(m() % (2 * ry + 1)) - ry;
+                        } else {
+                            dx = int(m() % rx) - x;
+                            dy = int(m() % ry) - y;
+                        }
+
+                        counter++;
+                    } while(!isValidOffset(x, y, dx, dy) && (counter < 16));
+
+                    if(!isValidOffset(x, y, dx, dy)) {
+                        dx = MIN(x, width1 - 1) - x;
+                        dy = MIN(y, height1 - 1) - y;
+                    }
+                }
+
+                ox[i] = dx;
+                oy[i] = dy;
+                dist[i] = pc->getSSD(x, y, x + dx, y + dy);
+            }
+        }
+    }
+
+    /**
+     * @brief iterationScanline runs an iteration of PatchMatch over bands of rows.
+     * @param iteration
+     * @param seed
+     */
+    void iterationScanline(int iteration, unsigned int seed)
+    {
+        bool bReverse = (iteration % 2) == 1;
+        int sign = bReverse ? 1 : -1;
+
+        int nBands = MAX(MIN(getNumberOfThreads(), height / 16), 1);
+        int bandSize = (height + nBands - 1) / nBands;
+
+        //shifting band boundaries lets offsets cross them
+        int bandShift = (iteration % 2) * (bandSize >> 1);
+        int nBandsShifted = (height + bandShift + bandSize - 1) / bandSize;
+
+        #pragma omp parallel for
+
+        for(int b = 0; b < nBandsShifted; b++) {
+            int y0 = MAX(b * bandSize - bandShift, 0);
+            int y1 = MIN((b + 1) * bandSize - bandShift, height);
+
+            std::minstd_rand m(seed * 2654435761u + iteration * 7919u + b + 1);
+
+            for(int yi = y0; yi < y1; yi++) {
+                int y = bReverse ? (y1 - 1 - (yi - y0)) : yi;
+
+                for(int xi = 0; xi < width; xi++) {
+                    int x = bReverse ? (width - 1 - xi) : xi;
+                    int i = y * width + x;
+
+                    int bx = ox[i];
+                    int by = oy[i];
+                    float bd = dist[i];
+
+                    //propagation
+                    int xn = x + sign;
+
+                    if(xn >= 0 && xn < width) {
+                        int j = y * width + xn;
+                        tryOffset(x, y, ox[j], oy[j], bx, by, bd);
+                    }
+
+                    int yn = y + sign;
+
+                    if(yn >= y0 && yn < y1) {
+                        int j = yn * width + x;
+                        tryOffset(x, y, ox[j], oy[j], bx, by, bd);
+                    }
+
+                    randomSearch(x, y, bx, by, bd, m);
+
+                    ox[i] = bx;
+                    oy[i] = by;
+                    dist[i] = bd;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief iterationJumpFlooding runs an iteration of jump-flooding
+     * PatchMatch; every pass reads offsets of the previous one.
+     * @param iteration
+     * @param seed
+     */
+    void iterationJumpFlooding(int iteration, unsigned int seed)
+    {
+        int n = width * height;
+        std::vector<int> ox_prev(n), oy_prev(n);
+
+        for(int step = 8; step >= 1; step >>= 1) {
+            ox_prev.assign(ox.begin(), ox.end());
+            oy_prev.assign(oy.begin(), oy.end());
+
+            bool bLast = (step == 1);
+
+            #pragma omp parallel for
+
+            for(int y = 0; y < height; y++) {
+                std::minstd_rand m(seed * 2654435761u + iteration * 7919u + step * 104729u + y + 1);
+
+                for(int x = 0; x < width; x++) {
+                    int i = y * width + x;
+
+                    int bx = ox[i];
+                    int by = oy[i];
+                    float bd = dist[i];
+
+                    for(int j = -1; j <= 1; j++) {
+                        int yn = y + j * step;
+
+                        if(yn < 0 || yn >= height) {
+                            continue;
+                        }
+
+                        for(int k = -1; k <= 1; k++) {
+                            int xn = x + k * step;
+
+                            if((xn < 0) || (xn >= width) || (j == 0 && k == 0)) {
+                                continue;
+                            }
+
+                            int l = yn * width + xn;
+                            tryOffset(x, y, ox_prev[l], oy_prev[l], bx, by, bd);
+                        }
+                    }
+
+                    if(bLast) {
+                        randomSearch(x, y, bx, by, bd, m);
+                    }
+
+                    ox[i] = bx;
+                    oy[i] = by;
+                    dist[i] = bd;
+                }
+            }
+        }
+    }
+
+public:
+
+    /**
+     * @brief PatchMatch
+     * @param img0 is the image for which the NNF is computed.
+     * @param img1 is the image where patches are searched; it has the
+     * same number of channels of img0.
+     * @param patchSize is the size of a patch.
+     * @param maxRadius is the maximum offset in each coordinate; if it is
+     * lower than 1 the whole img1 is searched.
+     */
+    PatchMatch(Image *img0, Image *img1, int patchSize, int maxRadius = -1)
+    {
+        pc = NULL;
+        this->img0 = NULL;
+        this->img1 = NULL;
+
+        setup(img0, img1, patchSize, maxRadius);
+    }
+
+    ~PatchMatch()
+    {
+        if(pc != NULL) {
+            delete pc;
+            pc = NULL;
+        }
+    }
+
+    /**
+     * @brief setup
+     * @param img0
+     * @param img1
+     * @param patchSize
+     * @param maxRadius
+     */
+    void setup(Image *img0, Image *img1, int patchSize, int maxRadius = -1)
+    {
+        if(img0 == NULL || img1 == NULL) {
+            return;
+        }
+
+        if(!img0->isValid() || !img1->isValid() || (img0->channels != img1->channels)) {
+            return;
+        }
+
+        if(pc != NULL) {
+            delete pc;
+        }
+
+        this->img0 = img0;
+        this->img1 = img1;
+
+        width = img0->width;
+        height = img0->height;
+        width1 = img1->width;
+        height1 = img1->height;
+
+        this->patchSize = MAX(patchSize, 1);
+        this->maxRadius = maxRadius;
+
+        pc = new PatchComp(img0, img1, this->patchSize);
+    }
+
+    /**
+     * @brief execute computes the NNF.
+     * @param nnf is the output NNF with three channels: the offset (dx, dy)
+     * to the matching patch in img1 and its SSD. If it is set to NULL an
+     * image will be allocated. If it is a valid NNF of the same size, its
+     * offsets are used for initialization; e.g. from a coarser level.
+     * @param iterations is the number of iterations.
+     * @param bJumpFlooding selects the jump-flooding variant.
+     * @param seed is the seed of the random number generators.
+     * @return It returns the NNF.
+     */
+    Image *execute(Image *nnf, int iterations = 5, bool bJumpFlooding = false,
+                   unsigned int seed = 1)
+    {
+        if(pc == NULL) {
+            return nnf;
+        }
+
+        if(nnf == NULL) {
+            nnf = new Image(1, width, height, 3);
+            initialize(NULL, seed);
+        } else {
+            initialize(nnf, seed);
+
+            if(!nnf->isValid()) {
+                nnf->allocate(width, height, 3, 1);
+            }
+
+            if((nnf->width != width) || (nnf->height != height) || (nnf->channels < 3)) {
+                return nnf;
+            }
+        }
+
+        for(int i = 0; i < iterations; i++) {
+            if(bJumpFlooding) {
+                iterationJumpFlooding(i, seed);
+            } else {
+                iterationScanline(i, seed);
+            }
+        }
+
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                int i = y * width + x;
+                float *tmp = (*nnf)(x, y);
+
+                tmp[0] = float(ox[i]);
+                tmp[1] = float(oy[i]);
+                tmp[2] = dist[i];
+            }
+        }
+
+        return nnf;
+    }
+
+    /**
+     * @brief execute
+     * @param img0
+     * @param img1
+     * @param nnf
+     * @param patchSize
+     * @param iterations
+     * @param maxRadius
+     * @return
+     */
+    static Image *execute(Image *img0, Image *img1, Image *nnf, int patchSize = 7,
+                          int iterations = 5, int maxRadius = -1)
+    {
+        PatchMatch pm(img0, img1, patchSize, maxRadius);
+        return pm.execute(nnf, iterations);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_FEATURES_MATCHING_PATCH_MATCH_HPP */
@@ -19,8 +19,11 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FEATURES_MATCHING_WARD_ALIGNMENT_HPP
 
 #include <vector>
+#include <algorithm>
 
 #include "../image.hpp"
+#include "../util/math.hpp"
+#include "../util/order_statistics.hpp"
 #include "../util/vec.hpp"
 #include "../image_samplers/image_sampler_bilinear.hpp"
 #include "../filtering/filter_downsampler_2d.hpp"
@@ -38,9 +41,75 @@ class WardAlignment
 protected:
     float tolerance, percentile;
 
+    /**
+     * @brief getWord returns 64 bits of a bit-packed row starting
+     * from bit position pos; bits outside the row are set to zero.
+     * @param row
+     * @param words is the number of words of a row.
+     * @param pos
+     * @return
+     */
+    static inline unsigned long long getWord(unsigned long long *row, int words, int pos)
+    {
+        int k = (pos >= 0) ? (pos >> 6) : -((63 - pos) >> 6);
+        int r = pos - k * 64;
+
+        unsigned long long lo = ((k > -1) && (k < words)) ? row[k] : 0;
+
+        if(r == 0) {
+            return lo;
+        }
+
+        unsigned long long hi = ((k + 1 > -1) && (k + 1 < words)) ? row[k + 1] : 0;
+
+        return (lo >> r) | (hi << (64 - r));
+    }
+
+    /**
+     * @brief getShiftError counts the pixels that are different in the two
+     * bit-packed median threshold bitmaps and are not excluded; the second
+     * bitmap is shifted by (xs, ys).
+     * @param mtb1
+     * @param mtb2
+     * @param height
+     * @param words
+     * @param xs
+     * @param ys
+     * @return
+     */
+    static int getShiftError(unsigned long long *mtb1, unsigned long long *mtb2,
+                             int height, int words, int xs, int ys)
+    {
+        int n = height * words;
+
+        unsigned long long *tb1 = mtb1;
+        unsigned long long *eb1 = &mtb1[n];
+        unsigned long long *tb2 = mtb2;
+        unsigned long long *eb2 = &mtb2[n];
+
+        int y0 = MAX(0, -ys);
+        int y1 = MIN(height, height - ys);
+
+        int err = 0;
+
+        for(int y = y0; y < y1; y++) {
+            int r1 = y * words;
+            int r2 = (y + ys) * words;
+
+            for(int w = 0; w < words; w++) {
+                int pos = (w << 6) + xs;
+                unsigned long long t2 = getWord(&tb2[r2], words, pos);
+                unsigned long long e2 = getWord(&eb2[r2], words, pos);
+
+                err += popcount64((tb1[r1 + w] ^ t2) & eb1[r1 + w] & e2);
+            }
+        }
+
+        return err;
+    }
+
 public:
     ImageVec img1_v, img2_v, luminance;
-    std::vector< bool* > tb1_v, tb2_v, eb2_shifted_v, tb2_shifted_v;
 
     /**
      * @brief WardAlignment
@@ -63,22 +132,6 @@ public:
         for(unsigned int i=0; i< img2_v.size(); i++) {
             delete img2_v[i];
         }
-
-        for(unsigned int i=0; i< tb1_v.size(); i++) {
-            delete[] tb1_v[i];
-        }
-
-        for(unsigned int i=0; i< tb2_v.size(); i++) {
-            delete[] tb2_v[i];
-        }
-
-        for(unsigned int i=0; i< eb2_shifted_v.size(); i++) {
-            delete[] eb2_shifted_v[i];
-        }
-
-        for(unsigned int i=0; i<tb2_shifted_v.size(); i++) {
-            delete[] tb2_shifted_v[i];
-        }
     }
 
     /**
@@ -122,7 +175,7 @@ public:
         bool *maskThr = new bool[n * 2];
         bool *maskEb = &maskThr[n];
 
-        float medVal = L->getPercentileVal(percentile);
+        float medVal = getPercentile(L->data, n, percentile);
 
         float A = medVal - tolerance;
         float B = medVal + tolerance;
@@ -139,6 +192,59 @@ public:
         return maskThr;
     }
 
+    /**
+     * @brief MTBPacked computes the median threshold bitmap and the exclusion
+     * bitmap of a luminance image. Both are bit-packed with 64 pixels per word,
+     * and each row is padded with zeros to a whole number of words.
+     * @param L is a single channel image.
+     * @param words is the number of words of a row.
+     * @return It returns a buffer of 2 * L->height * words words: the threshold
+     * bitmap followed by the exclusion bitmap.
+     */
+    unsigned long long *MTBPacked(Image *L, int &words)
+    {
+        int width = L->width;
+        int height = L->height;
+
+        words = (width + 63) >> 6;
+        int n = height * words;
+
+        unsigned long long *tb = new unsigned long long[n * 2];
+        unsigned long long *eb = &tb[n];
+
+        float medVal = getPercentile(L->data, width * height, percentile);
+
+        float A = medVal - tolerance;
+        float B = medVal + tolerance;
+
+        #pragma omp parallel for
+
+        for(int y = 0; y < height; y++) {
+            float *row = &L->data[y * width];
+
+            for(int w = 0; w < words; w++) {
+                int x0 = w << 6;
+                int x1 = MIN(x0 + 64, width);
+
+                unsigned long long t = 0;
+                unsigned long long e = 0;
+
+                for(int x = x0; x < x1; x++) {
+                    float val = row[x];
+                    unsigned long long bit = 1ull << (x - x0);
+
+                    t |= (val > medVal) ? bit : 0;
+                    e |= ((val >= A) && (val <= B)) ? 0 : bit;
+                }
+
+                tb[y * words + w] = t;
+                eb[y * words + w] = e;
+            }
+        }
+
+        return tb;
+    }
+
     /**
      * @brief getExpShift computes the shift vector for moving an img1 onto img2
      * @param img1
@@ -204,56 +310,37 @@ public:
 
             int width  = sml_img1->width;
             int height = sml_img1->height;
-            int n = width * height;
 
-             //compute the median threshold mask
-            bool *tb1 = MTB(sml_img1, NULL);
-            bool *eb1  = &tb1[n];
+            //compute the bit-packed median threshold masks
+            int words;
+            unsigned long long *mtb1 = MTBPacked(sml_img1, words);
+            unsigned long long *mtb2 = MTBPacked(sml_img2, words);
 
-            bool *tb2 = MTB(sml_img2, NULL);
-            bool *eb2  = &tb2[n];
+            //evaluate the nine shifts in parallel
+            int err[9];
 
-            //track memory
-            tb1_v.push_back(tb1);
-            tb2_v.push_back(tb2);
-            
-            int min_err = n;
+            #pragma omp parallel for
 
-            bool *tb2_shifted = new bool[n];
-            bool *eb2_shifted = new bool[n];
+            for(int k = 0; k < 9; k++) {
+                int xs = cur_shift[0] + (k / 3) - 1;
+                int ys = cur_shift[1] + (k % 3) - 1;
 
-            tb2_shifted_v.push_back(tb2_shifted);
-            eb2_shifted_v.push_back(eb2_shifted);
-
-            for(int i = -1; i <= 1; i++) {
-
-                for(int j = -1; j <= 1; j++) {
-
-                    int xs = cur_shift[0] + i;
-                    int ys = cur_shift[1] + j;
-
-                    Buffer<bool>::shift(tb2_shifted, tb2, xs, ys, width, height, 1, 1);
-                    Buffer<bool>::shift(eb2_shifted, eb2, xs, ys, width, height, 1, 1);
-
-                    int err = 0;
-                    for(int k=0; k<n; k++) {
-                        bool diff_b = tb1[k] ^ tb2_shifted[k];
-                        diff_b = diff_b & eb1[k];
-                        diff_b = diff_b & eb2_shifted[k];
+                err[k] = getShiftError(mtb1, mtb2, height, words, xs, ys);
+            }
 
-                        if(diff_b) {
-                            err++;
-                        }
-                    }
+            int min_err = width * height;
 
-                    if(err < min_err) {
-                        ret_shift[0] = xs;
-                        ret_shift[1] = ys;
-                        min_err = err;
-                    }
+            for(int k = 0; k < 9; k++) {
+                if(err[k] < min_err) {
+                    ret_shift[0] = cur_shift[0] + (k / 3) - 1;
+                    ret_shift[1] = cur_shift[1] + (k % 3) - 1;
+                    min_err = err[k];
                 }
             }
 
+            delete[] mtb1;
+            delete[] mtb2;
+
             shift_bits--;
 
             cur_shift[0] = ret_shift[0] * 2;
@@ -27,6 +27,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "filtering/filter_reconstruct.hpp"
 #include "filtering/filter_local_extrema.hpp"
 #include "filtering/filter_warp_2d.hpp"
+#include "filtering/filter_remap.hpp"
 #include "filtering/filter_absolute_difference.hpp"
 #include "filtering/filter_anisotropic_diffusion.hpp"
 #include "filtering/filter_assemble_hdr.hpp"
@@ -70,6 +71,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "filtering/filter_med.hpp"
 #include "filtering/filter_med_vec.hpp"
 #include "filtering/filter_min.hpp"
+#include "filtering/filter_morphology.hpp"
 #include "filtering/filter_mosaic.hpp"
 #include "filtering/filter_demosaic.hpp"
 #include "filtering/filter_normal.hpp"
@@ -96,6 +96,13 @@ protected:
      */
     virtual Image *SetupAux(ImageVec imgIn, Image *imgOut);
 
+    /**
+     * @brief decodeRGBE decodes the input images stored as RGBE, so that
+     * ProcessBBox can access their float values.
+     * @param imgIn
+     */
+    static void decodeRGBE(ImageVec imgIn);
+
 public:
     bool cachedOnly;
     std::vector<Filter *> filters;
@@ -228,6 +235,15 @@ PIC_INLINE Image *Filter::SetupAux(ImageVec imgIn, Image *imgOut)
     return imgOut;
 }
 
+PIC_INLINE void Filter::decodeRGBE(ImageVec imgIn)
+{
+    for(unsigned int i = 0; i < imgIn.size(); i++) {
+        if(imgIn[i] != NULL) {
+            imgIn[i]->decodeRGBE();
+        }
+    }
+}
+
 PIC_INLINE std::string Filter::GetOutPutName(std::string nameIn)
 {
     std::string outputName = nameIn;
@@ -278,6 +294,8 @@ PIC_INLINE Image *Filter::Process(ImageVec imgIn, Image *imgOut)
         return NULL;
     }
 
+    decodeRGBE(imgIn);
+
     imgOut = SetupAux(imgIn, imgOut);
 
     //convolve
@@ -314,6 +332,8 @@ PIC_INLINE Image *Filter::ProcessP(ImageVec imgIn, Image *imgOut)
         return NULL;
     }
 
+    decodeRGBE(imgIn);
+
     imgOut = SetupAux(imgIn, imgOut);
 
     if(imgOut == NULL) {
@@ -46,122 +46,235 @@ protected:
     CRF_WEIGHT              weight_type;
     float                   delta_value;
 
+    int                     lut_bits;
+
+    //streaming state: accumulated values, total weight, and saturation value
+    Image                   *imgAcc;
+    float                   t_min_stream;
+
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief getMergeValue maps a camera value into the merging domain.
+     * @param x
+     * @param channel
+     * @param exposure
+     * @return
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    inline float getMergeValue(float x, int channel, float exposure)
     {
-        int width = dst->width;
-        int channels = dst->channels;
+        return getMergeValueLinear(crf->Remove(x, channel), exposure);
+    }
 
-        int n = int(src.size());
+    /**
+     * @brief getMergeValueLinear maps a linearized value into the merging domain.
+     * @param x_lin
+     * @param exposure
+     * @return
+     */
+    inline float getMergeValueLinear(float x_lin, float exposure)
+    {
+        switch(domain) {
+            case HRD_LIN: {
+                return x_lin / exposure;
+            } break;
+
+            case HRD_LOG: {
+                return logf(x_lin + delta_value) - logf(exposure);
+            } break;
+
+            case HRD_SQ: {
+                return x_lin * exposure;
+            } break;
+        }
 
-        float t_min = FLT_MAX;
-        int index = -1;
-        for(int j = 0; j < n; j++) {
-            if(src[j]->exposure < t_min) {
-                t_min = src[j]->exposure;
-                index = j;
+        return x_lin;
+    }
+
+    /**
+     * @brief getExposureWeight
+     * @param exposure
+     * @return
+     */
+    inline float getExposureWeight(float exposure)
+    {
+        return (domain == HRD_SQ) ? (exposure * exposure) : 1.0f;
+    }
+
+    /**
+     * @brief computeLUT computes the tables of an exposure: weights indexed by
+     * the sum of quantized channels, and merging values indexed by channel
+     * and quantized value.
+     * @param exposure
+     * @param channels
+     * @param lut_w
+     * @param lut_v
+     */
+    void computeLUT(float exposure, int channels, std::vector<float> &lut_w,
+                    std::vector<float> &lut_v)
+    {
+        int L1 = (1 << lut_bits) - 1;
+        int nW = channels * L1 + 1;
+
+        lut_w.resize(nW);
+        lut_v.resize(channels * (L1 + 1));
+
+        float s = getExposureWeight(exposure);
+        float nW_1 = float(nW - 1);
+
+        for(int q = 0; q < nW; q++) {
+            lut_w[q] = weightFunction(float(q) / nW_1, weight_type) * s;
+        }
+
+        for(int k = 0; k < channels; k++) {
+            for(int q = 0; q <= L1; q++) {
+                lut_v[k * (L1 + 1) + q] = getMergeValue(float(q) / float(L1), k, exposure);
             }
-        }        
+        }
+    }
 
+    /**
+     * @brief accumulateRow adds an exposure to the accumulators of a row;
+     * each pixel of acc has channels values, the total weight, and the
+     * value used if the pixel is saturated in all exposures.
+     * @param src
+     * @param src_lin is src linearized by the CRF; it is used only
+     * when bLUT is false.
+     * @param acc
+     * @param width
+     * @param channels
+     * @param exposure
+     * @param lut_w
+     * @param lut_v
+     * @param bMinExposure
+     */
+    template<bool bLUT>
+    void accumulateRow(float *src, float *src_lin, float *acc, int width,
+                       int channels, float exposure, float *lut_w,
+                       float *lut_v, bool bMinExposure)
+    {
+        int L1 = (1 << lut_bits) - 1;
+        float L1f = float(L1);
         float channelsf = float(channels);
+        float s = getExposureWeight(exposure);
+        int stride = channels + 2;
 
-        float *acc = new float[channels];
-        float *totWeight = new float[channels];
+        for(int i = 0; i < width; i++) {
+            float *tmp_src = &src[i * channels];
+            float *tmp_acc = &acc[i * stride];
 
-        for(int j = box->y0; j < box->y1; j++) {
-            int ind = j * width;
+            float x = 0.0f;
+            for(int k = 0; k < channels; k++) {
+                x += tmp_src[k];
+            }
+            x /= channelsf;
 
-            for(int i = box->x0; i < box->x1; i++) {
-                int c = (ind + i) * channels;
+            float weight;
 
+            if(bLUT) {
+                int q_sum = 0;
                 for(int k = 0; k < channels; k++) {
-                    acc[k] = 0.0f;
-                    totWeight[k] = 0.0f;
+                    q_sum += CLAMPi(int(tmp_src[k] * L1f + 0.5f), 0, L1);
                 }
 
-                float max_val_saturation = 1.0f;
-
-                //for each exposure...
-                for(int l = 0; l < n; l++) {
-
-                    float x = 0.0f;
-                    for(int k = 0; k < channels; k++) {
-                        x += src[l]->data[c + k];
-                    }
-                    x /= channelsf;
+                weight = lut_w[q_sum];
 
+                for(int k = 0; k < channels; k++) {
+                    int q = CLAMPi(int(tmp_src[k] * L1f + 0.5f), 0, L1);
+                    tmp_acc[k] += weight * lut_v[k * (L1 + 1) + q];
+                }
+            } else {
+                weight = weightFunction(x, weight_type) * s;
 
-                    if(l == index) {
-                        max_val_saturation = x / t_min;
-                    }
+                float *tmp_lin = &src_lin[i * channels];
 
-                    float weight = weightFunction(x, weight_type);
+                for(int k = 0; k < channels; k++) {
+                    tmp_acc[k] += weight * getMergeValueLinear(tmp_lin[k], exposure);
+                }
+            }
 
-                    if(domain == HRD_SQ) {
-                        weight *= (src[l]->exposure * src[l]->exposure);
-                    }
+            tmp_acc[channels] += weight;
 
-                    for(int k = 0; k < channels; k++) {
-                        float x_lin = crf->Remove(src[l]->data[c + k], k);
+            if(bMinExposure) {
+                tmp_acc[channels + 1] = x / exposure;
+            }
+        }
+    }
 
-                        //merge HDR pixels
-                        switch(domain) {
-                            case HRD_LIN: {
-                                acc[k] += (weight * x_lin) / src[l]->exposure;
-                            } break;
+    /**
+     * @brief accumulateExposure adds the j-th row of an exposure to the
+     * accumulators of that row.
+     * @param img
+     * @param acc
+     * @param src_lin is a scratch row of img->width * img->channels values;
+     * it is not used when merging with lookup tables.
+     * @param j
+     * @param lut_w
+     * @param lut_v
+     * @param bMinExposure
+     */
+    void accumulateExposure(Image *img, float *acc, float *src_lin, int j,
+                            float *lut_w, float *lut_v, bool bMinExposure)
+    {
+        float *src = &img->data[j * img->ystride];
+
+        if(lut_bits > 0) {
+            accumulateRow<true>(src, NULL, acc, img->width, img->channels,
+                                img->exposure, lut_w, lut_v, bMinExposure);
+        } else {
+            //the CRF is removed from the whole row at once
+            crf->Remove(src, src_lin, img->width, img->channels);
+
+            accumulateRow<false>(src, src_lin, acc, img->width,
+                                 img->channels, img->exposure, lut_w, lut_v,
+                                 bMinExposure);
+        }
+    }
 
-                            case HRD_LOG: {
-                                acc[k] += weight * (logf(x_lin + delta_value) - logf(src[l]->exposure));
-                            } break;
+    /**
+     * @brief finalizeRow
+     * @param acc
+     * @param dst
+     * @param width
+     * @param channels
+     */
+    void finalizeRow(float *acc, float *dst, int width, int channels)
+    {
+        int stride = channels + 2;
 
-                            case HRD_SQ: {
-                                acc[k] += (weight * x_lin) * src[l]->exposure;
-                            } break;
-                        }
+        for(int i = 0; i < width; i++) {
+            float *tmp_acc = &acc[i * stride];
+            float *tmp_dst = &dst[i * channels];
 
-                        totWeight[k] += weight;
-                    }
-                }
+            float totWeight = tmp_acc[channels];
 
-                bool bSaturated = false;
+            if(totWeight < 1e-4f) {
                 for(int k = 0; k < channels; k++) {
-                    bSaturated = bSaturated || (totWeight[k] < 1e-4f);
+                    tmp_dst[k] = tmp_acc[channels + 1];
                 }
+            } else {
+                for(int k = 0; k < channels; k++) {
+                    float val = tmp_acc[k] / totWeight;
 
-                if(!bSaturated) {
-                    for(int k = 0; k < channels; k++) {
-                        acc[k] /= totWeight[k];
-                        if(domain == HRD_LOG) {
-                            acc[k] = expf(acc[k]);
-                        }
-                        dst->data[c + k] = acc[k];
-                    }
-                } else {
-                    for(int k = 0; k < channels; k++) {
-                        dst->data[c + k] = max_val_saturation;
+                    if(domain == HRD_LOG) {
+                        val = expf(val);
                     }
+
+                    tmp_dst[k] = val;
                 }
             }
         }
-
-        delete[] totWeight;
-        delete[] acc;
     }
 
 public:
 
     /**
      * @brief FilterAssembleHDR
+     * @param crf
      * @param weight_type
-     * @param linearization_type
-     * @param icrf
+     * @param domain
+     * @param lut_bits is the bit depth of inputs for merging with lookup
+     * tables; 0 means that inputs are merged without quantization.
      */
-    FilterAssembleHDR(CameraResponseFunction *crf, CRF_WEIGHT weight_type = CW_DEB97, HDR_REC_DOMAIN domain = HRD_LOG)
+    FilterAssembleHDR(CameraResponseFunction *crf, CRF_WEIGHT weight_type = CW_DEB97, HDR_REC_DOMAIN domain = HRD_LOG, int lut_bits = 0)
     {        
         this->crf = crf;
 
@@ -171,6 +284,195 @@ public:
 
         //a numerical stability value when assembling images in the log-domain
         this->delta_value = 1.0 / 65536.0f;
+
+        this->lut_bits = CLAMPi(lut_bits, 0, 16);
+
+        imgAcc = NULL;
+        t_min_stream = FLT_MAX;
+    }
+
+    ~FilterAssembleHDR()
+    {
+        if(imgAcc != NULL) {
+            delete imgAcc;
+        }
+    }
+
+    /**
+     * @brief Process merges a stack of exposures; all exposures are
+     * accumulated for a row at a time.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(imgIn.empty()) {
+            return imgOut;
+        }
+
+        if(imgIn[0] == NULL) {
+            return imgOut;
+        }
+
+        imgOut = SetupAux(imgIn, imgOut);
+
+        int n = int(imgIn.size());
+        int width = imgOut->width;
+        int height = imgOut->height;
+        int channels = imgOut->channels;
+
+        float t_min = FLT_MAX;
+        int index = -1;
+        for(int l = 0; l < n; l++) {
+            if(imgIn[l]->exposure < t_min) {
+                t_min = imgIn[l]->exposure;
+                index = l;
+            }
+        }
+
+        std::vector< std::vector<float> > lut_w(n), lut_v(n);
+
+        if(lut_bits > 0) {
+            for(int l = 0; l < n; l++) {
+                computeLUT(imgIn[l]->exposure, channels, lut_w[l], lut_v[l]);
+            }
+        }
+
+        #pragma omp parallel
+        {
+            std::vector<float> acc(width * (channels + 2));
+            std::vector<float> src_lin(lut_bits > 0 ? 0 : width * channels);
+
+            #pragma omp for
+
+            for(int j = 0; j < height; j++) {
+                std::fill(acc.begin(), acc.end(), 0.0f);
+
+                for(int l = 0; l < n; l++) {
+                    accumulateExposure(imgIn[l], acc.data(), src_lin.data(), j,
+                                       lut_w[l].data(), lut_v[l].data(),
+                                       l == index);
+                }
+
+                finalizeRow(acc.data(), &imgOut->data[j * imgOut->ystride],
+                            width, channels);
+            }
+        }
+
+        return imgOut;
+    }
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
+    {
+        return Process(imgIn, imgOut);
+    }
+
+    /**
+     * @brief reset clears the accumulators of streaming merging.
+     */
+    void reset()
+    {
+        if(imgAcc != NULL) {
+            delete imgAcc;
+        }
+
+        imgAcc = NULL;
+        t_min_stream = FLT_MAX;
+    }
+
+    /**
+     * @brief accumulate adds an exposure to streaming merging; only the
+     * accumulators are kept in memory, so the exposure can be released
+     * after this call.
+     * @param img
+     * @return It returns true if img is compatible with the accumulated exposures.
+     */
+    bool accumulate(Image *img)
+    {
+        if(img == NULL) {
+            return false;
+        }
+
+        if(!img->isValid()) {
+            return false;
+        }
+
+        if(imgAcc == NULL) {
+            imgAcc = new Image(img->width, img->height, img->channels + 2);
+            imgAcc->setZero();
+        } else {
+            if((imgAcc->width != img->width) || (imgAcc->height != img->height) ||
+               (imgAcc->channels != (img->channels + 2))) {
+                return false;
+            }
+        }
+
+        bool bMinExposure = img->exposure < t_min_stream;
+
+        if(bMinExposure) {
+            t_min_stream = img->exposure;
+        }
+
+        std::vector<float> lut_w, lut_v;
+
+        if(lut_bits > 0) {
+            computeLUT(img->exposure, img->channels, lut_w, lut_v);
+        }
+
+        #pragma omp parallel
+        {
+            std::vector<float> src_lin(lut_bits > 0 ? 0 : img->width * img->channels);
+
+            #pragma omp for
+
+            for(int j = 0; j < img->height; j++) {
+                accumulateExposure(img, &imgAcc->data[j * imgAcc->ystride],
+                                   src_lin.data(), j, lut_w.data(), lut_v.data(),
+                                   bMinExposure);
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief getHDR returns the result of streaming merging.
+     * @param imgOut
+     * @return
+     */
+    Image *getHDR(Image *imgOut)
+    {
+        if(imgAcc == NULL) {
+            return imgOut;
+        }
+
+        int channels = imgAcc->channels - 2;
+
+        if(imgOut == NULL) {
+            imgOut = new Image(imgAcc->width, imgAcc->height, channels);
+        } else {
+            if((imgOut->width != imgAcc->width) || (imgOut->height != imgAcc->height) ||
+               (imgOut->channels != channels)) {
+                imgOut = new Image(imgAcc->width, imgAcc->height, channels);
+            }
+        }
+
+        #pragma omp parallel for
+
+        for(int j = 0; j < imgAcc->height; j++) {
+            finalizeRow(&imgAcc->data[j * imgAcc->ystride],
+                        &imgOut->data[j * imgOut->ystride],
+                        imgAcc->width, channels);
+        }
+
+        return imgOut;
     }
 };
 
@@ -32,6 +32,18 @@ struct ColorConvTransform
     bool bDirection;
 };
 
+/**
+ * @brief The ColorConvStep struct is a step of the conversion plan; in fast
+ * mode, adjacent linear conversions are composed into a single matrix.
+ */
+struct ColorConvStep
+{
+    ColorConv *f;
+    bool bDirection;
+    bool bMatrix;
+    float mtx[9];
+};
+
 /**
  * @brief The FilterColorConv class
  */
@@ -39,59 +51,82 @@ class FilterColorConv: public Filter
 {
 protected:
     std::vector<ColorConvTransform> list;
-    bool bDirection;
-    unsigned int n;
-    bool bEven;
+    std::vector<ColorConvStep> plan;
+    bool bDirection, bFast;
 
     /**
-     * @brief ProcessBBox
+     * @brief ProcessBBox converts a row at a time; the first step reads
+     * from src and the following ones work in place on dst.
      * @param dst
      * @param src
      * @param box
      */
     void ProcessBBox(Image *dst, ImageVec src, BBox *box)
     {
-        if(n < 1) {
+        if(plan.empty()) {
             return;
         }
 
         int channels = src[0]->channels;
-
-        float *tmpCol = new float [channels];
-        float *tmp[2];
-
-        tmp[1] = tmpCol;
+        int width = box->x1 - box->x0;
 
         for(int j = box->y0; j < box->y1; j++) {
+            float *dataIn  = (*src[0]) (box->x0, j);
+            float *dataOut = (*dst)    (box->x0, j);
 
-            for(int i = box->x0; i < box->x1; i++) {
-
-                float *dataIn  = (*src[0]) (i, j);
-                float *dataOut = (*dst)    (i, j);
+            for(unsigned int k = 0; k < plan.size(); k++) {
+                ColorConvStep &step = plan[k];
+                float *in = (k == 0) ? dataIn : dataOut;
 
-                if(bEven) {
-                    tmp[1] = dataOut;
-                    tmp[0] = tmpCol;
+                if(step.bMatrix) {
+                    ColorConv::applySpan(step.mtx, in, dataOut, width, channels);
                 } else {
-                    tmp[0] = dataOut;
-                    tmp[1] = tmpCol;
+                    step.f->transformSpan(in, dataOut, width, channels,
+                                          step.bDirection, bFast);
                 }
+            }
+        }
+    }
 
-                if(bDirection) { //direct color transform
-                    list[0].f->transform(dataIn, tmp[0], list[0].bDirection);
-                    for(unsigned int k = 1; k < n; k++) {
-                        list[k].f->transform(tmp[(k + 1) % 2], tmp[k % 2], list[k].bDirection);
-                    }
-                } else { //inverse color transform
-                    list[n - 1].f->transform(dataIn, tmp[0], !list[n - 1].bDirection);
-                    for(unsigned int k = 1; k < n; k++) {
-                        list[n - k - 1].f->transform(tmp[(k + 1) % 2], tmp[k % 2], !list[n - k - 1].bDirection);
-                    }
-                }
+    /**
+     * @brief updatePlan lists the conversions in the order of application.
+     * In fast mode, runs of linear conversions are composed into a matrix;
+     * this saves passes, but the product rounds differently from applying
+     * the matrices one after the other.
+     */
+    void updatePlan()
+    {
+        plan.clear();
+
+        int n = int(list.size());
+
+        for(int i = 0; i < n; i++) {
+            ColorConvTransform &t = bDirection ? list[i] : list[n - i - 1];
+
+            ColorConvStep step;
+            step.f = t.f;
+            step.bDirection = bDirection ? t.bDirection : !t.bDirection;
+            step.bMatrix = step.f->getMatrix(step.mtx, step.bDirection);
+
+            if(bFast && step.bMatrix && !plan.empty() && plan.back().bMatrix) {
+                //step is applied after the previous one
+                ColorConv::multiply(step.mtx, plan.back().mtx, plan.back().mtx);
+            } else {
+                plan.push_back(step);
             }
         }
+    }
 
-        delete[] tmpCol;
+    /**
+     * @brief SetupAux
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *SetupAux(ImageVec imgIn, Image *imgOut)
+    {
+        updatePlan();
+        return Filter::SetupAux(imgIn, imgOut);
     }
 
 public:
@@ -102,7 +137,7 @@ public:
     FilterColorConv()
     {
         this->bDirection = true;
-        n = -1;
+        this->bFast = false;
     }
 
     /**
@@ -119,9 +154,18 @@ public:
 
             list.push_back(entry);
         }
+    }
 
-        n = int(list.size());
-        bEven = (n % 2) == 0;
+    /**
+     * @brief setFast enables approximated transcendental functions
+     * (e.g., polynomial cubic roots, powers, and logarithms, and tabulated
+     * sRGB curves; see the directSpan of each ColorConv), and the
+     * composition of adjacent linear conversions.
+     * @param bFast
+     */
+    void setFast(bool bFast)
+    {
+        this->bFast = bFast;
     }
 
     /**
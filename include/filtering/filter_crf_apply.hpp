@@ -34,18 +34,46 @@ protected:
     CameraResponseFunction *crf;
 
     /**
-     * @brief f
-     * @param data
+     * @brief ProcessBBox processes a row at a time with the batched
+     * Apply of the CRF.
+     * @param dst
+     * @param src
+     * @param box
      */
-    virtual void f(FilterFData *data)
+    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
     {
-        float *tmp_src = (*data->src[0])(data->x, data->y);
+        int channels = src[0]->channels;
+        int n = box->x1 - box->x0;
 
-        for(int k = 0; k < data->src[0]->channels; k++) {
-            data->out[k] = crf->Apply(tmp_src[k], k);
+        for(int k = box->z0; k < box->z1; k++) {
+            for(int j = box->y0; j < box->y1; j++) {
+                float *tmp_src = &src[0]->data[k * src[0]->tstride + j * src[0]->ystride + box->x0 * channels];
+                float *tmp_dst = &dst->data[k * dst->tstride + j * dst->ystride + box->x0 * channels];
+
+                crf->Apply(tmp_src, tmp_dst, n, channels);
+            }
         }
     }
 
+    /**
+     * @brief SetupAux refreshes the inverse LUTs of the CRF before
+     * processing tiles in parallel.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *SetupAux(ImageVec imgIn, Image *imgOut)
+    {
+        for(int k = 0; k < imgIn[0]->channels; k++) {
+            if(!crf->isInverseLUTValid(k)) {
+                crf->computeInverseLUT();
+                break;
+            }
+        }
+
+        return Filter::SetupAux(imgIn, imgOut);
+    }
+
 public:
 
     /**
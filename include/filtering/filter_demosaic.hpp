@@ -18,16 +18,31 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_DEMOSAIC_HPP
 #define PIC_FILTERING_FILTER_DEMOSAIC_HPP
 
+#include <vector>
+
 #include "../filtering/filter.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterDemosaic class
+ * @brief The BAYER_PATTERN enum is the color of the 2x2 top-left block
+ * of a Bayer sensor, in row order.
+ */
+enum BAYER_PATTERN {BP_RGGB, BP_BGGR, BP_GRBG, BP_GBRG};
+
+/**
+ * @brief The FilterDemosaic class demosaics Bayer images using Malvar et al.'s
+ * linear interpolation with gradient correction. The image is processed in
+ * tiles: a tile and its 2-pixel halo are copied into a small buffer, so that
+ * all interpolation masks run on cache-resident data without border checks.
  */
 class FilterDemosaic: public Filter
 {
 protected:
+    int ox, oy;
+
+    static const int tileWidth  = 256;
+    static const int tileHeight = 32;
 
     /**
      * @brief SetupAux
@@ -38,208 +53,213 @@ protected:
     Image *SetupAux(ImageVec imgIn, Image *imgOut)
     {
         if(imgOut == NULL) {
-            imgOut = new Image(1, imgIn[0]->width, imgIn[0]->height, 3);
+            imgOut = new Image(imgIn[0]->width, imgIn[0]->height, 3);
         }
 
         return imgOut;
     }
 
-    //Linear upsampling of green channel with gradient correction
-    void LinearUpSamplingGCGreen(Image *imgIn, Image *imgOut)
+    /**
+     * @brief interpolateGreen interpolates green at red and blue sites.
+     * @param c
+     * @param s is the stride between rows.
+     * @return
+     */
+    static inline float interpolateGreen(float *c, int s)
     {
-        int height = imgIn->height;
-        int width = imgIn->width;
-
-        float *dataIn = imgIn->data;
-        float *dataOut = imgOut->data;
-
-        //Copying the original Green pixels into the U16RGB buffer
-        for(int j = 0; j < height; j++) {
-            int tmp = j * width;
-            for(int i = ((j + 1) % 2); i < width; i += 2) {
-                int current = tmp + i;
-                dataOut[current * 3 + 1] = dataIn[current];
-            }
-        }
-
-        //Edge-aware interpolation for the missing Green pixels
-        //#pragma omp parallel for
-        for(int k = 0; k < 2; k++) {
-            for(int j = k; j < (height); j += 2) {
-                float tmpG, sum, Grad, final;
-
-                int tmp = j * width;
+        //    -1
+        //     2
+        //-1 2 4 2 -1
+        //     2
+        //    -1
+        float tmpG = (c[1] + c[-1] + c[s] + c[-s]) * 0.25f;
+        float sum  = (c[2] + c[-2] + c[2 * s] + c[-2 * s]);
+        float Grad = c[0] - sum * 0.25f;
+
+        return CLAMPi(tmpG + Grad * 0.5f, 0.0f, 1.0f);
+    }
 
-                for(int i = k; i < (width); i += 2) {
-                    //    -1
-                    //     2
-                    //-1 2 4 2 -1
-                    //     2
-                    //    -1
+    /**
+     * @brief interpolateHorizontal interpolates red or blue at green sites
+     * whose horizontal neighbors have that color.
+     * @param c
+     * @param s is the stride between rows.
+     * @return
+     */
+    static inline float interpolateHorizontal(float *c, int s)
+    {
+        //
+        //		    0.5
+        //      -1   0  -1
+        //  -1   4   5   4   -1
+        //      -1   0  -1
+        //		    0.5
+        //
+        float tmp = 5.0f * c[0] +
+                    4.0f * (c[1] + c[-1]) +
+                    0.5f * (c[2 * s] + c[-2 * s]) -
+                    (c[s + 1] + c[-s + 1] + c[s - 1] + c[-s - 1] + c[-2] + c[2]);
+
+        return CLAMPi(tmp / 8.0f, 0.0f, 1.0f);
+    }
 
-                    int current = tmp + i;
+    /**
+     * @brief interpolateVertical interpolates red or blue at green sites
+     * whose vertical neighbors have that color.
+     * @param c
+     * @param s is the stride between rows.
+     * @return
+     */
+    static inline float interpolateVertical(float *c, int s)
+    {
+        //
+        //		     -1
+        //       -1   4  -1
+        //  0.5   0   5   0   0.5
+        //       -1   4  -1
+        //		     -1
+        //
+        float tmp = 5.0f * c[0] +
+                    4.0f * (c[s] + c[-s]) +
+                    0.5f * (c[-2] + c[2]) -
+                    (c[s + 1] + c[-s + 1] + c[s - 1] + c[-s - 1] + c[2 * s] + c[-2 * s]);
+
+        return CLAMPi(tmp / 8.0f, 0.0f, 1.0f);
+    }
 
-                    tmpG  = (dataIn[imgIn->getAddress(i + 1, j)] +
-                             dataIn[imgIn->getAddress(i - 1, j)] +
-                             dataIn[imgIn->getAddress(i, j + 1)] +
-                             dataIn[imgIn->getAddress(i, j - 1)]) * 0.25f;
+    /**
+     * @brief interpolateDiagonal interpolates red at blue sites and
+     * blue at red sites.
+     * @param c
+     * @param s is the stride between rows.
+     * @return
+     */
+    static inline float interpolateDiagonal(float *c, int s)
+    {
+        //
+        //		     -3/2
+        //         2   0   2
+        //  -3/2   0   6   0   -3/2
+        //         2   0   2
+        //		     -3/2
+        //
+        float tmp = 6.0f * c[0] +
+                    2.0f * (c[s + 1] + c[-s + 1] + c[s - 1] + c[-s - 1]) -
+                    1.5f * (c[2] + c[-2] + c[2 * s] + c[-2 * s]);
+
+        return CLAMPi(tmp / 8.0f, 0.0f, 1.0f);
+    }
 
-                    sum  = (dataIn[imgIn->getAddress(i + 2, j)] +
-                            dataIn[imgIn->getAddress(i - 2, j)] +
-                            dataIn[imgIn->getAddress(i, j + 2)] +
-                            dataIn[imgIn->getAddress(i, j - 2)]);
+    /**
+     * @brief demosaicPixel
+     * @param c
+     * @param s is the stride between rows.
+     * @param out
+     */
+    template<int phase>
+    static inline void demosaicPixel(float *c, int s, float *out)
+    {
+        switch(phase) {
+            case 0: { //red
+                out[0] = c[0];
+                out[1] = interpolateGreen(c, s);
+                out[2] = interpolateDiagonal(c, s);
+            } break;
+
+            case 1: { //green in a red row
+                out[0] = interpolateHorizontal(c, s);
+                out[1] = c[0];
+                out[2] = interpolateVertical(c, s);
+            } break;
+
+            case 2: { //green in a blue row
+                out[0] = interpolateVertical(c, s);
+                out[1] = c[0];
+                out[2] = interpolateHorizontal(c, s);
+            } break;
+
+            case 3: { //blue
+                out[0] = interpolateDiagonal(c, s);
+                out[1] = interpolateGreen(c, s);
+                out[2] = c[0];
+            } break;
+        }
+    }
 
-                    Grad = dataIn[current] - sum * 0.25f;
+    /**
+     * @brief demosaicRow processes a row by pairs of pixels, so that
+     * the site type is a compile-time constant in the inner loop.
+     * @param c
+     * @param s is the stride between rows.
+     * @param out
+     * @param n
+     */
+    template<int phase0, int phase1>
+    static void demosaicRow(float *c, int s, float *out, int n)
+    {
+        int i = 0;
 
-                    final = tmpG + Grad * 0.5f;
+        for(; i < (n - 1); i += 2) {
+            demosaicPixel<phase0>(&c[i    ], s, &out[ i      * 3]);
+            demosaicPixel<phase1>(&c[i + 1], s, &out[(i + 1) * 3]);
+        }
 
-                    dataOut[current * 3 + 1] = CLAMPi(final, 0.0f, 1.0f);
-                }
-            }
+        if(i < n) {
+            demosaicPixel<phase0>(&c[i], s, &out[i * 3]);
         }
     }
 
-    //Linear UpSampling with gradients: Red and Blue channels
-    void LinearUpSamplingGCRB(Image *imgIn, Image *imgOut, int sx,
-                                         int sy)
+    /**
+     * @brief ProcessTile demosaics the tile [x0, x1) x [y0, y1).
+     * @param imgIn
+     * @param imgOut
+     * @param x0
+     * @param y0
+     * @param x1
+     * @param y1
+     * @param buffer is a buffer of size (tileWidth + 4) * (tileHeight + 4).
+     */
+    void ProcessTile(Image *imgIn, Image *imgOut, int x0, int y0, int x1,
+                     int y1, float *buffer)
     {
-        int i, j;
-        int shifter = sx + sy;
-
-        int height = imgIn->height;
         int width = imgIn->width;
-        float *dataIn = imgIn->data;
-        float *data = imgOut->data;
-
-        //Copying the original pixels!
-        //#pragma omp parallel for
-        for(j = sy; j < height; j += 2) {
-            for(i = sx; i < width; i += 2) {
-                int current = j * width + i;
-                data[current * 3 + shifter] = dataIn[current];
-            }
-        }
+        int height = imgIn->height;
 
-        //Edge-aware interpolation for the missing Green pixels
-        int ssx = 0;
-        int ssy = 0;
+        //copying the tile and its halo; borders are clamped
+        int s = x1 - x0 + 4;
 
-        if(shifter == 0) {
-            ssx = 1;
-            ssy = 0;
-        }
+        for(int j = 0; j < (y1 - y0 + 4); j++) {
+            float *row = &imgIn->data[CLAMP(y0 + j - 2, height) * imgIn->ystride];
+            float *tmp = &buffer[j * s];
 
-        if(shifter == 2) {
-            ssx = 0;
-            ssy = 1;
-        }
-
-        //First Mask
-        //#pragma omp parallel for
-        for(j = ssy; j < (height); j += 2) {
-            float tmp;
-
-            for(i = ssx; i < (width); i += 2) {
-                //
-                //		    0.5
-                //      -1   0  -1
-                //  -1   4   5   4   -1
-                //      -1   0  -1
-                //		    0.5
-                //
-                int current = j * width + i;
-
-                tmp =	5.0f *	dataIn[current] +
-                        4.0f * (dataIn[imgIn->getAddress(i + 1, j)] +	dataIn[imgIn->getAddress(i - 1,
-                                j)]) +
-                        0.5f * (dataIn[imgIn->getAddress(i, j + 2)] +	dataIn[imgIn->getAddress(i,
-                                j - 2)]) -
-                        (dataIn[imgIn->getAddress(i + 1, j + 1)] +	dataIn[imgIn->getAddress(i + 1,
-                                j - 1)] +
-                         dataIn[imgIn->getAddress(i - 1, j + 1)] +	dataIn[imgIn->getAddress(i - 1,
-                                 j - 1)] +
-                         dataIn[imgIn->getAddress(i - 2, j)] +	dataIn[imgIn->getAddress(i + 2, j)]);
-                tmp /= 8.0f;
-                data[current * 3 + shifter] = CLAMPi(tmp, 0.0f, 1.0f);
+            for(int i = 0; i < s; i++) {
+                tmp[i] = row[CLAMP(x0 + i - 2, width)];
             }
         }
 
-        //Second Mask
-        if(shifter == 0) {
-            ssx = 0;
-            ssy = 1;
-        }
+        for(int j = y0; j < y1; j++) {
+            float *c = &buffer[(j - y0 + 2) * s + 2];
+            float *out = &imgOut->data[j * imgOut->ystride + x0 * 3];
 
-        if(shifter == 2) {
-            ssx = 1;
-            ssy = 0;
-        }
+            int n = x1 - x0;
+            int phase = ((j + oy) & 1) * 2 + ((x0 + ox) & 1);
 
-        //#pragma omp parallel for
-        for(j = ssy; j < (height); j += 2) {
-            float tmp;
-
-            for(i = ssx; i < (width); i += 2) {
-                //
-                //		     -1
-                //       -1   4  -1
-                //  0.5   0   5   0   0.5
-                //       -1   4  -1
-                //		     -1
-                //
-                int current = j * width + i;
-
-                tmp =	5.0f * dataIn[current] +
-                        4.0f * (dataIn[imgIn->getAddress(i, j + 1)] +	dataIn[imgIn->getAddress(i,
-                                j - 1)]) +
-                        +0.5f * (dataIn[imgIn->getAddress(i - 2, j)] +	dataIn[imgIn->getAddress(i + 2,
-                                 j)]) -
-                        (dataIn[imgIn->getAddress(i + 1, j + 1)] +	dataIn[imgIn->getAddress(i + 1,
-                                j - 1)] +
-                         dataIn[imgIn->getAddress(i - 1, j + 1)] +	dataIn[imgIn->getAddress(i - 1,
-                                 j - 1)] +
-                         dataIn[imgIn->getAddress(i, j + 2)] +	dataIn[imgIn->getAddress(i, j - 2)]);
-
-                tmp /= 8.0f;
-                data[current * 3 + shifter] = CLAMPi(tmp, 0.0f, 1.0f);
-            }
-        }
+            switch(phase) {
+                case 0: {
+                    demosaicRow<0, 1>(c, s, out, n);
+                } break;
 
-        //Third Mask
-        if(shifter == 0) {
-            ssx = 1;
-            ssy = 1;
-        }
+                case 1: {
+                    demosaicRow<1, 0>(c, s, out, n);
+                } break;
 
-        if(shifter == 2) {
-            ssx = 0;
-            ssy = 0;
-        }
+                case 2: {
+                    demosaicRow<2, 3>(c, s, out, n);
+                } break;
 
-        //#pragma omp parallel for
-        for(j = ssy; j < (height); j += 2) {
-            float tmp;
-
-            for(i = ssx; i < (width); i += 2) {
-                //
-                //		     -3/2
-                //         2   0   2
-                //  -3/2   0   6   0   -3/2
-                //         2   0   2
-                //		     -3/2
-                //
-                int current = j * width + i;
-                tmp =	6.0f *	dataIn[current] +
-                        2.0f * (dataIn[imgIn->getAddress(i + 1, j + 1)] +	dataIn[imgIn->getAddress(i + 1,
-                                j - 1)] +
-                                dataIn[imgIn->getAddress(i - 1, j + 1)] +	dataIn[imgIn->getAddress(i - 1,
-                                        j - 1)]) -
-                        1.5f * (dataIn[imgIn->getAddress(i + 2, j)] +	dataIn[imgIn->getAddress(i - 2,
-                                j)] +
-                                dataIn[imgIn->getAddress(i, j + 2)] +	dataIn[imgIn->getAddress(i, j - 2)]);
-
-                tmp /= 8.0f;
-                data[current * 3 + shifter] = CLAMPi(tmp, 0.0f, 1.0f);
+                case 3: {
+                    demosaicRow<3, 2>(c, s, out, n);
+                } break;
             }
         }
     }
@@ -248,10 +268,41 @@ public:
 
     /**
      * @brief FilterDemosaic
-     * @param type
+     * @param pattern
+     */
+    FilterDemosaic(BAYER_PATTERN pattern = BP_RGGB) : Filter()
+    {
+        update(pattern);
+    }
+
+    /**
+     * @brief update
+     * @param pattern
      */
-    FilterDemosaic() : Filter()
+    void update(BAYER_PATTERN pattern)
     {
+        //offsets of the red site from the top-left corner
+        switch(pattern) {
+            case BP_RGGB: {
+                ox = 0;
+                oy = 0;
+            } break;
+
+            case BP_BGGR: {
+                ox = 1;
+                oy = 1;
+            } break;
+
+            case BP_GRBG: {
+                ox = 1;
+                oy = 0;
+            } break;
+
+            case BP_GBRG: {
+                ox = 0;
+                oy = 1;
+            } break;
+        }
     }
 
     /**
@@ -270,7 +321,6 @@ public:
         frames      = imgIn->frames;
     }
 
-
     /**
       * @brief Filter::Process
       * @param imgIn
@@ -279,20 +329,41 @@ public:
       */
     Image *Process(ImageVec imgIn, Image *imgOut)
     {
+        if(imgIn.empty()) {
+            return imgOut;
+        }
+
         if(imgIn[0] == NULL) {
             return NULL;
         }
 
-        if((!imgIn[0]->isValid()) && (imgIn[0]->channels != 1)) {
+        if((!imgIn[0]->isValid()) || (imgIn[0]->channels != 1)) {
             return imgOut;
         }
 
         imgOut = SetupAux(imgIn, imgOut);
 
+        int width = imgIn[0]->width;
+        int height = imgIn[0]->height;
+
+        int nx = (width + tileWidth - 1) / tileWidth;
+        int ny = (height + tileHeight - 1) / tileHeight;
+
+        #pragma omp parallel
+        {
+            std::vector<float> buffer((tileWidth + 4) * (tileHeight + 4));
 
-        LinearUpSamplingGCGreen(imgIn[0], imgOut);
-        LinearUpSamplingGCRB(imgIn[0], imgOut, 0, 0);
-        LinearUpSamplingGCRB(imgIn[0], imgOut, 1, 1);
+            #pragma omp for
+
+            for(int t = 0; t < (nx * ny); t++) {
+                int x0 = (t % nx) * tileWidth;
+                int y0 = (t / nx) * tileHeight;
+
+                ProcessTile(imgIn[0], imgOut, x0, y0,
+                            MIN(x0 + tileWidth, width),
+                            MIN(y0 + tileHeight, height), buffer.data());
+            }
+        }
 
         return imgOut;
     }
@@ -312,11 +383,12 @@ public:
      * @brief Execute
      * @param imgIn
      * @param imgOut
+     * @param pattern
      * @return
      */
-    static Image *Execute(Image *imgIn, Image *imgOut)
+    static Image *Execute(Image *imgIn, Image *imgOut, BAYER_PATTERN pattern = BP_RGGB)
     {
-        FilterDemosaic flt;
+        FilterDemosaic flt(pattern);
         return flt.Process(Single(imgIn), imgOut);
     }
 };
@@ -21,9 +21,71 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../filtering/filter.hpp"
 
 #include "../util/math.hpp"
+#include "../util/summed_area_table.hpp"
 
 namespace pic {
 
+/**
+ * @brief The GuidedFilterMoments struct generates a row at a time the values
+ * summed by FilterGuided: I, p, I * p, and I * I (all pairs of channels).
+ */
+struct GuidedFilterMoments
+{
+    Image *I, *p;
+    int offset_p, offset_Ip, offset_II, nMoments;
+
+    GuidedFilterMoments(Image *I, Image *p)
+    {
+        this->I = I;
+        this->p = p;
+
+        offset_p = I->channels;
+        offset_Ip = offset_p + p->channels;
+        offset_II = offset_Ip + I->channels * p->channels;
+        nMoments = offset_II + (I->channels * (I->channels + 1)) / 2;
+    }
+
+    float *getRow(int j, float *buffer)
+    {
+        int cI = I->channels;
+        int cP = p->channels;
+
+        float *tmpI = &I->data[j * I->ystride];
+        float *tmpP = &p->data[j * p->ystride];
+        float *out = buffer;
+
+        for(int i = 0; i < I->width; i++) {
+            for(int n = 0; n < cI; n++) {
+                out[n] = tmpI[n];
+            }
+
+            for(int c = 0; c < cP; c++) {
+                out[offset_p + c] = tmpP[c];
+            }
+
+            for(int n = 0; n < cI; n++) {
+                for(int c = 0; c < cP; c++) {
+                    out[offset_Ip + n * cP + c] = tmpI[n] * tmpP[c];
+                }
+            }
+
+            int k = offset_II;
+            for(int n = 0; n < cI; n++) {
+                for(int m = n; m < cI; m++) {
+                    out[k] = tmpI[n] * tmpI[m];
+                    k++;
+                }
+            }
+
+            tmpI += cI;
+            tmpP += cP;
+            out += nMoments;
+        }
+
+        return buffer;
+    }
+};
+
 /**
  * @brief The FilterGuided class
  */
@@ -31,26 +93,56 @@ class FilterGuided: public Filter
 {
 protected:
 
-    int radius;
-    float e_regularization, nPixels;
+    int radius, subsampling;
+    float e_regularization;
+
+    SummedAreaTable sat;
+    int offset_p, offset_Ip, offset_II;
 
     /**
-     * @brief Process1Channel
+     * @brief getGuideAndInput
+     * @param src
      * @param I
      * @param p
-     * @param q
-     * @param box
      */
-    void Process1Channel(Image *I, Image *p, Image *q, BBox *box);
+    void getGuideAndInput(ImageVec src, Image *&I, Image *&p)
+    {
+        if(src.size() == 2) {
+            p = src[0];
+
+            if(src[1] != NULL) {
+                I = src[1];
+            } else {
+                I = src[0];
+            }
+        } else {
+            I = src[0];
+            p = src[0];
+        }
+    }
 
     /**
-     * @brief Process3Channel
+     * @brief computeMoments computes a single summed-area table of I, p,
+     * I * p, and I * I (all pairs of channels) for getting all window
+     * statistics in O(1).
      * @param I
      * @param p
-     * @param q
-     * @param box
+     * @param radius
      */
-    void Process3Channel(Image *I, Image *p, Image *q, BBox *box);
+    void computeMoments(Image *I, Image *p, int radius);
+
+    /**
+     * @brief getCoefficients computes the linear coefficients of the window
+     * centered at (i, j); for each channel of p, these are the channels of
+     * I followed by the offset.
+     * @param i
+     * @param j
+     * @param radius
+     * @param channels is the number of channels of I.
+     * @param S is a buffer of size sat.channels.
+     * @param coeff
+     */
+    void getCoefficients(int i, int j, int radius, int channels, double *S, float *coeff);
 
     /**
      * @brief ProcessBBox
@@ -60,6 +152,38 @@ protected:
      */
     void ProcessBBox(Image *dst, ImageVec src, BBox *box);
 
+    /**
+     * @brief ProcessFast computes the coefficients on subsampled images, and
+     * it upsamples them with bilinear interpolation.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessFast(ImageVec imgIn, Image *imgOut);
+
+    /**
+     * @brief applyCoefficients
+     * @param I
+     * @param coeff
+     * @param channels_I
+     * @param channels_q
+     * @param q
+     */
+    static inline void applyCoefficients(float *I, float *coeff, int channels_I,
+                                         int channels_q, float *q)
+    {
+        for(int c = 0; c < channels_q; c++) {
+            float *a = &coeff[c * (channels_I + 1)];
+            float val = a[channels_I];
+
+            for(int n = 0; n < channels_I; n++) {
+                val += a[n] * I[n];
+            }
+
+            q[c] = val;
+        }
+    }
+
 public:
 
     /**
@@ -74,18 +198,68 @@ public:
      * @brief FilterGuided
      * @param radius
      * @param e_regularization
+     * @param subsampling is the subsampling factor of the fast guided
+     * filter; 1 means full resolution.
      */
-    FilterGuided(int radius, float e_regularization)
+    FilterGuided(int radius, float e_regularization, int subsampling = 1)
     {
-        Update(radius, e_regularization);
+        Update(radius, e_regularization, subsampling);
     }
 
     /**
      * @brief Update
      * @param radius
      * @param e_regularization
+     * @param subsampling is the subsampling factor of the fast guided
+     * filter; 1 means full resolution.
+     */
+    void Update(int radius, float e_regularization, int subsampling = 1);
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(subsampling > 1) {
+            return ProcessFast(imgIn, imgOut);
+        }
+
+        Image *I, *p;
+        getGuideAndInput(imgIn, I, p);
+        computeMoments(I, p, radius);
+
+        return Filter::Process(imgIn, imgOut);
+    }
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
+    {
+        if(subsampling > 1) {
+            return ProcessFast(imgIn, imgOut);
+        }
+
+        Image *I, *p;
+        getGuideAndInput(imgIn, I, p);
+        computeMoments(I, p, radius);
+
+        return Filter::ProcessP(imgIn, imgOut);
+    }
+
+    /**
+     * @brief downsampleMean averages blocks of factor x factor pixels.
+     * @param img
+     * @param factor
+     * @return
      */
-    void Update(int radius, float e_regularization);
+    static Image *downsampleMean(Image *img, int factor);
 
     /**
      * @brief Execute
@@ -94,168 +268,269 @@ public:
      * @param imgOut
      * @param radius
      * @param e_regularization
+     * @param subsampling is the subsampling factor of the fast guided
+     * filter; 1 means full resolution.
      * @return
      */
     static Image *Execute(Image *imgIn, Image *guide, Image *imgOut,
-                             int radius, float e_regularization)
+                             int radius, float e_regularization,
+                             int subsampling = 1)
     {
-        FilterGuided filter(radius, e_regularization);
+        FilterGuided filter(radius, e_regularization, subsampling);
         return filter.ProcessP(Double(imgIn, guide), imgOut);
     }
 };
 
-PIC_INLINE void FilterGuided::Update(int radius, float e_regularization)
+PIC_INLINE void FilterGuided::Update(int radius, float e_regularization,
+                                     int subsampling)
 {
     this->radius = radius;
     this->e_regularization = e_regularization;
-    nPixels = float(radius * radius * 4);
+    this->subsampling = MAX(subsampling, 1);
 }
 
-PIC_INLINE void FilterGuided::Process1Channel(Image *I, Image *p, Image *q,
-                                   BBox *box)
+PIC_INLINE void FilterGuided::computeMoments(Image *I, Image *p, int radius)
 {
-    float I_mean, I_var;
-    float *p_mean = new float [p->channels];
+    if(I == NULL || p == NULL) {
+        return;
+    }
 
-    for(int j = box->y0; j < box->y1; j++) {
-        for(int i = box->x0; i < box->x1; i++) {
-            float *tmpQ = (*q)(i, j);
-            float *tmpI   = (*I)(i, j);
+    GuidedFilterMoments moments(I, p);
 
-            BBox tmpBox(i - radius, i + radius, j - radius, j + radius);
+    offset_p = moments.offset_p;
+    offset_Ip = moments.offset_Ip;
+    offset_II = moments.offset_II;
 
-            I->getMeanVal(&tmpBox, &I_mean);
-            I->getVarianceVal(&I_mean, &tmpBox, &I_var);
+    sat.computeFromRows(moments, I->width, I->height, moments.nMoments, radius);
+}
 
-            p->getMeanVal(&tmpBox, p_mean);
+PIC_INLINE void FilterGuided::getCoefficients(int i, int j, int radius,
+                                              int channels, double *S,
+                                              float *coeff)
+{
+    int channels_p = offset_Ip - offset_p;
 
-            for(int c = 0; c < p->channels; c++) {
-                float I_mean_p_mean = I_mean * p_mean[c];
-                float a = 0.0f;
+    //window statistics in O(1)
+    sat.getSum(i - radius, j - radius, i + radius, j + radius, S);
 
-                for(int k = -radius; k < radius; k++) {
-                    for(int l = -radius; l < radius; l++) {
-                        float *I_i = (*I)(i + l, j + k);
-                        float *p_i = (*p)(i + l, j + k);
-                        a += I_i[0] * p_i[c] - I_mean_p_mean;
-                    }
-                }
+    double n = double(radius * radius * 4);
+    double n_1 = MAX(n - 1.0, 1.0);
 
-                a /= (nPixels * (I_var + e_regularization));
-                float b = p_mean[c] - a * I_mean;
-                tmpQ[c] = a * tmpI[0] + b;
-            }
+    if(channels == 1) {
+        float I_mean = float(S[0] / n);
+        float I_var = float((S[offset_II] - n * double(I_mean) * double(I_mean)) / n_1);
+
+        for(int c = 0; c < channels_p; c++) {
+            float p_mean = float(S[offset_p + c] / n);
+            float a = float(S[offset_Ip + c] / n) - I_mean * p_mean;
+
+            a /= (I_var + e_regularization);
+
+            coeff[c * 2    ] = a;
+            coeff[c * 2 + 1] = p_mean - a * I_mean;
         }
     }
 
-    delete[] p_mean;
-}
+    if(channels == 3) {
+        float I_mean[3], tmp_A[3];
 
-PIC_INLINE void FilterGuided::Process3Channel(Image *I, Image *p,
-        Image *q, BBox *box)
-{
-    int channels = p->channels;
+        for(int k = 0; k < 3; k++) {
+            I_mean[k] = float(S[k] / n);
+        }
 
-    float *buf = new float [channels * 4];
+        Matrix3x3 cov, inv;
 
-    float *I_mean	= &buf[0];
-    float *p_mean	= &buf[channels    ];
-    float *a		= &buf[channels * 2];
-    float *tmp_A	= &buf[channels * 3];
+        int k = offset_II;
+        for(int l = 0; l < 3; l++) {
+            for(int m = l; m < 3; m++) {
+                float tmp = float((S[k] - n * double(I_mean[l]) * double(I_mean[m])) / n_1);
+                cov.data[l * 3 + m] = tmp;
+                cov.data[m * 3 + l] = tmp;
+                k++;
+            }
+        }
 
-    Matrix3x3 cov, inv;
+        //regularization
+        cov.Add(e_regularization);
+        //invert matrix
+        cov.Inverse(&inv);
 
-    for(int j = box->y0; j < box->y1; j++) {
-        for(int i = box->x0; i < box->x1; i++) {
-            float *tmpQ = (*q)(i, j);
-            float *tmpI = (*I)(i, j);
+        for(int c = 0; c < channels_p; c++) {
+            float p_mean = float(S[offset_p + c] / n);
 
-            BBox tmpBox(i - radius, i + radius, j - radius, j + radius);
+            for(int l = 0; l < 3; l++) {
+                tmp_A[l] = float(S[offset_Ip + l * channels_p + c] / n) - I_mean[l] * p_mean;
+            }
 
-            I->getMeanVal(&tmpBox, I_mean);
-            I->getCovMtxVal(I_mean, &tmpBox, cov.data);
+            float *a = &coeff[c * 4];
 
-            //regularization
-            cov.Add(e_regularization);
-            //invert matrix
-            cov.Inverse(&inv);
+            //multiply for inverted matrix
+            inv.Mul(tmp_A, a);
 
-            p->getMeanVal(&tmpBox, p_mean);
+            a[3] = p_mean - (a[0] * I_mean[0] + a[1] * I_mean[1] + a[2] * I_mean[2]);
+        }
+    }
+}
 
-            for(int c = 0; c < channels; c++) {
+PIC_INLINE void FilterGuided::ProcessBBox(Image *dst, ImageVec src,
+        BBox *box)
+{
+    Image *I, *p;
+    getGuideAndInput(src, I, p);
 
-                for(int n = 0; n < channels; n++) {
-                    tmp_A[n] = 0.0f;
-                }
+    if((I->channels != 1) && (I->channels != 3)) {
+        return;
+    }
 
-                for(int k = -radius; k < radius; k++) {
-                    for(int l = -radius; l < radius; l++) {
-                        float *I_i = (*I)(i + l, j + k);
-                        float *p_i = (*p)(i + l, j + k);
+    double *S = new double [sat.channels];
+    float *coeff = new float [p->channels * (I->channels + 1)];
 
-                        for(int n = 0; n < channels; n++) {
-                            tmp_A[n] += I_i[n] * p_i[c] - I_mean[n] * p_mean[c];
-                        }
-                    }
-                }
+    for(int j = box->y0; j < box->y1; j++) {
+        for(int i = box->x0; i < box->x1; i++) {
+            getCoefficients(i, j, radius, I->channels, S, coeff);
+            applyCoefficients((*I)(i, j), coeff, I->channels, p->channels, (*dst)(i, j));
+        }
+    }
 
-                for(int n = 0; n < channels; n++) {
-                    tmp_A[n] /= nPixels;
-                }
+    delete[] S;
+    delete[] coeff;
+}
 
-                //multiply for inverted matrix
-                inv.Mul(tmp_A, a);
+PIC_INLINE Image *FilterGuided::downsampleMean(Image *img, int factor)
+{
+    int width = (img->width + factor - 1) / factor;
+    int height = (img->height + factor - 1) / factor;
+    int channels = img->channels;
 
-                float a_dot_I_mean = 0.0f;
+    Image *out = new Image(width, height, channels);
 
-                for(int n = 0; n < channels; n++) {
-                    a_dot_I_mean += a[n] * I_mean[n];
-                }
+    #pragma omp parallel for
+
+    for(int j = 0; j < height; j++) {
+        int y0 = j * factor;
+        int y1 = MIN(y0 + factor, img->height);
 
-                float b = p_mean[c] - a_dot_I_mean;
+        for(int i = 0; i < width; i++) {
+            int x0 = i * factor;
+            int x1 = MIN(x0 + factor, img->width);
 
-                float a_dot_I = 0.0f;
+            float *tmp_out = (*out)(i, j);
+
+            for(int c = 0; c < channels; c++) {
+                tmp_out[c] = 0.0f;
+            }
 
-                for(int n = 0; n < channels; n++) {
-                    a_dot_I += a[n] * tmpI[n];
+            for(int y = y0; y < y1; y++) {
+                for(int x = x0; x < x1; x++) {
+                    float *tmp = (*img)(x, y);
+
+                    for(int c = 0; c < channels; c++) {
+                        tmp_out[c] += tmp[c];
+                    }
                 }
+            }
 
-                tmpQ[c] = a_dot_I + b;
+            float norm = 1.0f / float((y1 - y0) * (x1 - x0));
+
+            for(int c = 0; c < channels; c++) {
+                tmp_out[c] *= norm;
             }
         }
     }
 
-    delete[] buf;
+    return out;
 }
 
-PIC_INLINE void FilterGuided::ProcessBBox(Image *dst, ImageVec src,
-        BBox *box)
+PIC_INLINE Image *FilterGuided::ProcessFast(ImageVec imgIn, Image *imgOut)
 {
+    if(imgIn.empty()) {
+        return imgOut;
+    }
+
+    if(imgIn[0] == NULL) {
+        return imgOut;
+    }
+
     Image *I, *p;
+    getGuideAndInput(imgIn, I, p);
 
-    if(src.size() == 2) {
-        p = src[0];
+    int channels_I = I->channels;
+    int channels_p = p->channels;
 
-        if(src[1] != NULL) {
-            I = src[1];
-        } else {
-            I = src[0];
+    if((channels_I != 1) && (channels_I != 3)) {
+        return imgOut;
+    }
+
+    imgOut = SetupAux(imgIn, imgOut);
+
+    int s = subsampling;
+
+    Image *I_low = downsampleMean(I, s);
+    Image *p_low = (p == I) ? I_low : downsampleMean(p, s);
+
+    int radius_low = MAX(int(lround(float(radius) / float(s))), 1);
+
+    computeMoments(I_low, p_low, radius_low);
+
+    //coefficients at low resolution
+    int nCoeff = channels_p * (channels_I + 1);
+    Image coeff(I_low->width, I_low->height, nCoeff);
+
+    #pragma omp parallel for
+
+    for(int j = 0; j < coeff.height; j++) {
+        std::vector<double> S(sat.channels);
+
+        for(int i = 0; i < coeff.width; i++) {
+            getCoefficients(i, j, radius_low, channels_I, S.data(), coeff(i, j));
         }
-    } else {
-        I = src[0];
-        p = src[0];
     }
 
-    if(I->channels == 1) {
-        Process1Channel(I, p, dst, box);
+    //bilinear upsampling of the coefficients, and output
+    float s_inv = 1.0f / float(s);
+
+    #pragma omp parallel for
+
+    for(int j = 0; j < imgOut->height; j++) {
+        std::vector<float> tmp(nCoeff);
+
+        float y = (float(j) + 0.5f) * s_inv - 0.5f;
+        y = CLAMPi(y, 0.0f, float(coeff.height - 1));
+        int y0 = int(y);
+        int y1 = MIN(y0 + 1, coeff.height - 1);
+        float dy = y - float(y0);
+
+        for(int i = 0; i < imgOut->width; i++) {
+            float x = (float(i) + 0.5f) * s_inv - 0.5f;
+            x = CLAMPi(x, 0.0f, float(coeff.width - 1));
+            int x0 = int(x);
+            int x1 = MIN(x0 + 1, coeff.width - 1);
+            float dx = x - float(x0);
+
+            float *c00 = coeff(x0, y0);
+            float *c10 = coeff(x1, y0);
+            float *c01 = coeff(x0, y1);
+            float *c11 = coeff(x1, y1);
+
+            for(int k = 0; k < nCoeff; k++) {
+                float top = c00[k] + dx * (c10[k] - c00[k]);
+                float bottom = c01[k] + dx * (c11[k] - c01[k]);
+                tmp[k] = top + dy * (bottom - top);
+            }
+
+            applyCoefficients((*I)(i, j), tmp.data(), channels_I, channels_p, (*imgOut)(i, j));
+        }
     }
 
-    if(I->channels == 3) {
-        Process3Channel(I, p, dst, box);
+    if(p_low != I_low) {
+        delete p_low;
     }
+
+    delete I_low;
+
+    return imgOut;
 }
 
 } // end namespace pic
 
 #endif /* PIC_FILTERING_FILTER_GUIDED_HPP */
-
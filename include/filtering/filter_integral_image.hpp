@@ -19,6 +19,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FILTERING_FILTER_INTEGRAL_IMAGE
 
 #include "../filtering/filter.hpp"
+#include "../util/summed_area_table.hpp"
 
 namespace pic {
 
@@ -54,50 +55,22 @@ public:
 
         imgOut = SetupAux(imgIn, imgOut);
 
-        int width = imgIn[0]->width;
-        int height = imgIn[0]->height;
-        int channels = imgIn[0]->channels;
+        SummedAreaTable sat;
 
-        //set up the first pixel (0,0)
-        for(int k=0; k<channels; k++) {
-            imgOut->data[k] = imgIn[0]->data[k];
-        }
+        for(int f = 0; f < imgIn[0]->frames; f++) {
+            sat.compute(imgIn[0], 0, false, f);
 
-        //set up the first row
-        for(int j=1; j<width; j++) {
-            int ind1 = j * channels;
-            int ind2 = ind1 - channels;
+            float *out = imgOut->data + f * imgOut->tstride;
 
-            for(int k=0; k<channels; k++) {
-                imgOut->data[ind1 + k] = imgIn[0]->data[ind1 + k] + imgOut->data[ind2 + k];
-            }
-        }
+            //the table has an extra zero row and column
+            #pragma omp parallel for
 
-        //setting up the first column
-        int c1 = width * channels;
-        for(int i=1; i<height; i++){
-            int ind1 = i * c1;
-            int ind2 = ind1 - c1;
-            for(int k=0; k<channels; k++) {
-                imgOut->data[ind1 + k] = imgIn[0]->data[ind1 + k] + imgOut->data[ind2 + k];
-            }
-        }
+            for(int j = 0; j < sat.height; j++) {
+                double *row = &sat.data[(j + 1) * sat.ystride + sat.channels];
+                float *tmp = &out[j * imgOut->ystride];
 
-        int c2 = (width + 1) * channels;
-
-        for(int i=1; i<height; i++) {
-            int ind = i * width;
-            for(int j=1; j<width; j++) {
-                int ind1 = (ind + j) * channels;
-                int ind2 = ind1 - channels;
-                int ind3 = ind1 - c1;
-                int ind4 = ind1 - c2;
-
-                for(int k=0; k<channels; k++) {
-                    imgOut->data[ind1 + k] = imgIn[0]->data[ind1 + k] +
-                                             imgOut->data[ind2 + k] +
-                                             imgOut->data[ind3 + k] -
-                                             imgOut->data[ind4 + k];
+                for(int i = 0; i < imgOut->ystride; i++) {
+                    tmp[i] = float(row[i]);
                 }
             }
         }
@@ -32,42 +32,30 @@ protected:
     /**
      * @brief ProcessBBox
      * @param dst
-     * @param src
      * @param box
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    void ProcessBBox(Image *dst, ImageVec, BBox *box)
     {
-        Image *img  = src[0];
-
-        int channels = dst->channels;
+        int width = imgSum->width;
+        int height = imgSum->height;
 
         for(int j = box->y0; j < box->y1; j++) {
             for(int i = box->x0; i < box->x1; i++) {
                 float *dst_data = (*dst)(i, j);
 
-                float *img_data  = (*img)(i, j);
-
-                float val = 0.0f;
-
-                for(int c = 0; c < channels; c++) {
-                    val += img_data[c];
-                }
+                float val = imgSum->data[j * width + i];
 
                 int counter_higher = 0;
                 int counter_lower = 0;
                 for(int k = -halfKernelSize; k <= halfKernelSize; k++) {
+                    float *row = &imgSum->data[CLAMP(j + k, height) * width];
+
                     for(int l = -halfKernelSize; l <= halfKernelSize; l++) {
-                        if(l == k) {
+                        if((l == 0) && (k == 0)) {
                             continue;
                         }
 
-                        float *img_data_lk  = (*img)(i + l, j + k);
-
-                        //accumulation
-                        float val_lk = 0.0f;
-                        for(int c = 0; c < channels; c++) {
-                            val_lk += img_data_lk[c];
-                        }
+                        float val_lk = row[CLAMP(i + l, width)];
 
                         if(val_lk >= val) {
                             counter_higher++;
@@ -92,6 +80,52 @@ protected:
         }
     }
 
+    /**
+     * @brief computeSum accumulates the channels of the input once, instead
+     * of once per window.
+     * @param imgIn
+     */
+    void computeSum(ImageVec imgIn)
+    {
+        if(imgIn.size() < 1) {
+            return;
+        }
+
+        Image *img = imgIn[0];
+
+        if(img == NULL) {
+            return;
+        }
+
+        if(imgSum != NULL) {
+            if((imgSum->width != img->width) || (imgSum->height != img->height)) {
+                delete imgSum;
+                imgSum = NULL;
+            }
+        }
+
+        if(imgSum == NULL) {
+            imgSum = new Image(img->width, img->height, 1);
+        }
+
+        int n = img->nPixels();
+        int channels = img->channels;
+
+        #pragma omp parallel for
+
+        for(int i = 0; i < n; i++) {
+            float *tmp = &img->data[i * channels];
+            float val = 0.0f;
+
+            for(int c = 0; c < channels; c++) {
+                val += tmp[c];
+            }
+
+            imgSum->data[i] = val;
+        }
+    }
+
+    Image *imgSum;
     int kernelSize, halfKernelSize;
 
     /**
@@ -132,6 +166,39 @@ public:
 
         this->kernelSize = kernelSize;
         this->halfKernelSize = kernelSize >> 1;
+
+        imgSum = NULL;
+    }
+
+    ~FilterLocalExtrema()
+    {
+        if(imgSum != NULL) {
+            delete imgSum;
+        }
+    }
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        computeSum(imgIn);
+        return Filter::Process(imgIn, imgOut);
+    }
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
+    {
+        computeSum(imgIn);
+        return Filter::ProcessP(imgIn, imgOut);
     }
 
     /**
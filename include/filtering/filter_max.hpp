@@ -19,6 +19,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FILTERING_FILTER_MAX_HPP
 
 #include "../filtering/filter.hpp"
+#include "../util/running_min_max.hpp"
 
 namespace pic {
 
@@ -30,53 +31,40 @@ class FilterMax: public Filter
 protected:
     int halfSize;
 
+public:
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief FilterMax
+     * @param size
+     */
+    FilterMax(int size)
+    {
+        this->halfSize = checkHalfSize(size);
+    }
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    Image *Process(ImageVec imgIn, Image *imgOut)
     {
-        int width = dst->width;
-        int channels = dst->channels;
-
-        float *data = src[0]->data;
-        
-        for(int j = box->y0; j < box->y1; j++) {
-            int ind = j * width;
-
-            for(int i = box->x0; i < box->x1; i++) {
-                //Central weight
-                int c = (ind + i) * channels;
-
-                for(int ch = 0; ch < channels; ch++) {
-                    float maxVal = -FLT_MAX;
-
-                    for(int k = -halfSize; k <= halfSize; k++) {
-                        int ci = CLAMP((i + k), dst->width);
-
-                        for(int l = -halfSize; l <= halfSize; l++) {
-                            int cj = CLAMP((j + l), dst->height);
-                            float tmp = data[(cj * width + ci) * channels + ch];
-                            maxVal = maxVal > tmp ? maxVal : tmp;
-                        }
-                    }
-
-                    dst->data[c + ch] = maxVal;
-                }
-            }
+        if(imgIn.size() < 1) {
+            return imgOut;
         }
+
+        return runningMinMax<RunningMax>(imgIn[0], imgOut, halfSize, halfSize);
     }
 
-public:
     /**
-     * @brief FilterMax
-     * @param size
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
      */
-    FilterMax(int size)
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
     {
-        this->halfSize = checkHalfSize(size);
+        return Process(imgIn, imgOut);
     }
 
     /**
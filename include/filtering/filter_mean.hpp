@@ -19,6 +19,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FILTERING_FILTER_MEAN_HPP
 
 #include "../filtering/filter_npasses.hpp"
+#include "../filtering/filter_conv_1d.hpp"
+#include "../util/summed_area_table.hpp"
 
 namespace pic {
 
@@ -27,12 +29,48 @@ namespace pic {
  */
 class FilterMean: public FilterNPasses
 {
-protected:
-
 protected:
     FilterConv1D    *filter;
     float           *data;
-    int             size;    
+    int             size;
+
+    /**
+     * @brief useSummedAreaTable checks if a summed-area table is cheaper
+     * than two 1D convolution passes.
+     * @param imgIn
+     * @return
+     */
+    bool useSummedAreaTable(ImageVec imgIn)
+    {
+        if(imgIn.size() < 1) {
+            return false;
+        }
+
+        if(imgIn[0] == NULL) {
+            return false;
+        }
+
+        return (size >= sizeSAT) && (imgIn[0]->frames == 1);
+    }
+
+    /**
+     * @brief ProcessSAT
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessSAT(ImageVec imgIn, Image *imgOut)
+    {
+        imgOut = SetupAux(imgIn, imgOut);
+
+        int halfSize = size >> 1;
+
+        SummedAreaTable sat(imgIn[0], halfSize);
+        return sat.getBoxMean(imgOut, halfSize);
+    }
+
+public:
+    int sizeSAT;
 
 public:
 
@@ -43,11 +81,13 @@ public:
     FilterMean(int size) : FilterNPasses()
     {
         data = NULL;
+        filter = NULL;
         this->size = -1;
+        sizeSAT = 5;
 
         Update(size);
 
-        filter = new FilterConv1D(data, size);
+        filter = new FilterConv1D(data, this->size);
 
         InsertFilter(filter);
         InsertFilter(filter);
@@ -72,11 +112,15 @@ public:
      */
     void Update(int size)
     {
-        if(size < 1)
-        {
+        //same rounding of FilterConv1D::getKernelMean
+        if(size < 3) {
             size = 3;
         }
 
+        if((size % 2) == 0) {
+            size++;
+        }
+
         if(this->size != size)
         {
             this->size = size;
@@ -84,7 +128,26 @@ public:
                 delete[] data;
 
             data = FilterConv1D::getKernelMean(size);
-        }        
+
+            if(filter != NULL) {
+                filter->Init(data, size, 0);
+            }
+        }
+    }
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
+    {
+        if(useSummedAreaTable(imgIn)) {
+            return ProcessSAT(imgIn, imgOut);
+        }
+
+        return FilterNPasses::ProcessP(imgIn, imgOut);
     }
 
     /**
@@ -19,6 +19,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FILTERING_FILTER_MIN_HPP
 
 #include "../filtering/filter.hpp"
+#include "../util/running_min_max.hpp"
 
 namespace pic {
 
@@ -30,51 +31,41 @@ class FilterMin: public Filter
 protected:
     int halfSize;
 
+public:
+
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief FilterMin
+     * @param size
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    FilterMin(int size)
     {
-        int width = dst->width;
-        int channels = dst->channels;
-
-        float *data = src[0]->data;
-
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                int c = (j * width + i) * channels;
-
-                for(int ch = 0; ch < channels; ch++) {
-                    float minVal = FLT_MAX;
-
-                    for(int k = -halfSize; k <= halfSize; k++) {
-                        int ci = CLAMP((i + k), dst->width);
-
-                        for(int l = -halfSize; l <= halfSize; l++) {
-                            int cj = CLAMP((j + l), dst->height);
-                            float tmp = data[(cj * width + ci) * channels + ch];
-                            minVal = minVal > tmp ? tmp : minVal;
-                        }
-                    }
+        this->halfSize = checkHalfSize(size);
+    }
 
-                    dst->data[c + ch] = minVal;
-                }
-            }
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(imgIn.size() < 1) {
+            return imgOut;
         }
-    }
 
-public:
+        return runningMinMax<RunningMin>(imgIn[0], imgOut, halfSize, halfSize);
+    }
 
     /**
-     * @brief FilterMin
-     * @param size
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
      */
-    FilterMin(int size)
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
     {
-        this->halfSize = checkHalfSize(size);
+        return Process(imgIn, imgOut);
     }
 
     /**
@@ -86,7 +77,7 @@ public:
      */
     static Image *Execute(Image *imgIn, Image *imgOut, int size)
     {
-        FilterMed filter(size);
+        FilterMin filter(size);
         return filter.ProcessP(Single(imgIn), imgOut);
     }
 
@@ -0,0 +1,180 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_FILTERING_FILTER_MORPHOLOGY_HPP
+#define PIC_FILTERING_FILTER_MORPHOLOGY_HPP
+
+#include "../filtering/filter.hpp"
+#include "../util/running_min_max.hpp"
+
+namespace pic {
+
+enum MORPHOLOGY_OPERATION {MO_ERODE, MO_DILATE, MO_OPEN, MO_CLOSE};
+
+/**
+ * @brief The FilterMorphology class applies grayscale morphological
+ * operators with a square structuring element; each erosion or dilation
+ * costs a constant number of comparisons per pixel regardless of size.
+ */
+class FilterMorphology: public Filter
+{
+protected:
+    int halfSize;
+    MORPHOLOGY_OPERATION operation;
+
+public:
+
+    /**
+     * @brief FilterMorphology
+     * @param size is the side of the structuring element.
+     * @param operation
+     */
+    FilterMorphology(int size, MORPHOLOGY_OPERATION operation = MO_ERODE)
+    {
+        Update(size, operation);
+    }
+
+    /**
+     * @brief Update
+     * @param size is the side of the structuring element.
+     * @param operation
+     */
+    void Update(int size, MORPHOLOGY_OPERATION operation)
+    {
+        this->halfSize = checkHalfSize(size);
+        this->operation = operation;
+    }
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(imgIn.size() < 1) {
+            return imgOut;
+        }
+
+        if(imgIn[0] == NULL) {
+            return imgOut;
+        }
+
+        switch(operation) {
+        case MO_ERODE: {
+            imgOut = runningMinMax<RunningMin>(imgIn[0], imgOut, halfSize, halfSize);
+        } break;
+
+        case MO_DILATE: {
+            imgOut = runningMinMax<RunningMax>(imgIn[0], imgOut, halfSize, halfSize);
+        } break;
+
+        case MO_OPEN: {
+            Image *tmp = runningMinMax<RunningMin>(imgIn[0], NULL, halfSize, halfSize);
+            imgOut = runningMinMax<RunningMax>(tmp, imgOut, halfSize, halfSize);
+            delete tmp;
+        } break;
+
+        case MO_CLOSE: {
+            Image *tmp = runningMinMax<RunningMax>(imgIn[0], NULL, halfSize, halfSize);
+            imgOut = runningMinMax<RunningMin>(tmp, imgOut, halfSize, halfSize);
+            delete tmp;
+        } break;
+        }
+
+        return imgOut;
+    }
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
+    {
+        return Process(imgIn, imgOut);
+    }
+
+    /**
+     * @brief Execute
+     * @param imgIn
+     * @param imgOut
+     * @param size is the side of the structuring element.
+     * @param operation
+     * @return
+     */
+    static Image *Execute(Image *imgIn, Image *imgOut, int size,
+                          MORPHOLOGY_OPERATION operation)
+    {
+        FilterMorphology filter(size, operation);
+        return filter.ProcessP(Single(imgIn), imgOut);
+    }
+
+    /**
+     * @brief Erode
+     * @param imgIn
+     * @param imgOut
+     * @param size
+     * @return
+     */
+    static Image *Erode(Image *imgIn, Image *imgOut, int size)
+    {
+        return Execute(imgIn, imgOut, size, MO_ERODE);
+    }
+
+    /**
+     * @brief Dilate
+     * @param imgIn
+     * @param imgOut
+     * @param size
+     * @return
+     */
+    static Image *Dilate(Image *imgIn, Image *imgOut, int size)
+    {
+        return Execute(imgIn, imgOut, size, MO_DILATE);
+    }
+
+    /**
+     * @brief Open
+     * @param imgIn
+     * @param imgOut
+     * @param size
+     * @return
+     */
+    static Image *Open(Image *imgIn, Image *imgOut, int size)
+    {
+        return Execute(imgIn, imgOut, size, MO_OPEN);
+    }
+
+    /**
+     * @brief Close
+     * @param imgIn
+     * @param imgOut
+     * @param size
+     * @return
+     */
+    static Image *Close(Image *imgIn, Image *imgOut, int size)
+    {
+        return Execute(imgIn, imgOut, size, MO_CLOSE);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_FILTERING_FILTER_MORPHOLOGY_HPP */
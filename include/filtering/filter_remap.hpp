@@ -0,0 +1,169 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_FILTERING_FILTER_REMAP_HPP
+#define PIC_FILTERING_FILTER_REMAP_HPP
+
+#include "../filtering/filter.hpp"
+#include "../util/warp_map.hpp"
+
+namespace pic {
+
+/**
+ * @brief The FilterRemap class applies a precomputed WarpMap to an image;
+ * e.g., the maps of FilterWarp2D::computeWarpMap or of a lens undistortion.
+ * The geometry is not evaluated per frame: each tile is only a gather with
+ * bilinear interpolation.
+ */
+class FilterRemap: public Filter
+{
+protected:
+    WarpMap *map;
+
+    /**
+     * @brief ProcessBBox
+     * @param dst
+     * @param src
+     * @param box
+     */
+    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    {
+        map->remap(src[0], dst, box);
+    }
+
+    /**
+     * @brief SetupAux
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *SetupAux(ImageVec imgIn, Image *imgOut)
+    {
+        if(imgOut == NULL) {
+            imgOut = new Image(imgIn[0]->frames, map->width, map->height, imgIn[0]->channels);
+        } else {
+            if(imgOut->width != map->width || imgOut->height != map->height ||
+               imgOut->channels != imgIn[0]->channels) {
+                imgOut = new Image(imgIn[0]->frames, map->width, map->height, imgIn[0]->channels);
+            }
+        }
+
+        return imgOut;
+    }
+
+public:
+
+    /**
+     * @brief FilterRemap
+     * @param map
+     */
+    FilterRemap(WarpMap *map) : Filter()
+    {
+        Update(map);
+    }
+
+    /**
+     * @brief Update
+     * @param map
+     */
+    void Update(WarpMap *map)
+    {
+        this->map = map;
+    }
+
+    /**
+     * @brief OutputSize
+     * @param imgIn
+     * @param width
+     * @param height
+     * @param channels
+     * @param frames
+     */
+    void OutputSize(Image *imgIn, int &width, int &height, int &channels, int &frames)
+    {
+        width    = map->width;
+        height   = map->height;
+        channels = imgIn->channels;
+        frames   = imgIn->frames;
+    }
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
+    {
+        if(!isValidInput(imgIn)) {
+            return imgOut;
+        }
+
+        return Filter::ProcessP(imgIn, imgOut);
+    }
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(!isValidInput(imgIn)) {
+            return imgOut;
+        }
+
+        return Filter::Process(imgIn, imgOut);
+    }
+
+    /**
+     * @brief isValidInput checks that the map can be applied to imgIn.
+     * @param imgIn
+     * @return
+     */
+    bool isValidInput(ImageVec &imgIn)
+    {
+        if(map == NULL || imgIn.empty()) {
+            return false;
+        }
+
+        if(imgIn[0] == NULL || !map->isValid()) {
+            return false;
+        }
+
+        return (imgIn[0]->width == map->srcWidth) &&
+               (imgIn[0]->height == map->srcHeight);
+    }
+
+    /**
+     * @brief Execute
+     * @param imgIn
+     * @param imgOut
+     * @param map
+     * @return
+     */
+    static Image *Execute(Image *imgIn, Image *imgOut, WarpMap *map)
+    {
+        FilterRemap flt(map);
+        return flt.ProcessP(Single(imgIn), imgOut);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_FILTERING_FILTER_REMAP_HPP */
@@ -23,6 +23,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../image_samplers/image_sampler_bsplines.hpp"
 #include "../image_samplers/image_sampler_gaussian.hpp"
 #include "../image_samplers/image_sampler_nearest.hpp"
+#include "../image_samplers/separable_resampler.hpp"
 
 namespace pic {
 
@@ -37,6 +38,8 @@ protected:
     int				width, height;
     bool			swh;
 
+    SeparableResampler resampler;
+
     /**
      * @brief ProcessBBox
      * @param dst
@@ -99,6 +102,23 @@ public:
         frames      = imgIn->frames;
     }
 
+    /**
+     * @brief Process resizes with SeparableResampler when the sampler
+     * is separable; otherwise, each output pixel is sampled.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut);
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut);
+
     /**
      * @brief Execute
      * @param imgIn
@@ -230,13 +250,47 @@ PIC_INLINE Image *FilterSampler2D::SetupAux(ImageVec imgIn,
     return imgOut;
 }
 
+PIC_INLINE Image *FilterSampler2D::Process(ImageVec imgIn, Image *imgOut)
+{
+    if(imgIn.empty()) {
+        return imgOut;
+    }
+
+    if(imgIn[0] == NULL) {
+        return imgOut;
+    }
+
+    if(!SeparableResampler::isSeparable(isb) || (imgOut == imgIn[0])) {
+        return Filter::Process(imgIn, imgOut);
+    }
+
+    imgOut = SetupAux(imgIn, imgOut);
+
+    if(resampler.update(isb, imgIn[0]->width, imgIn[0]->height,
+                        imgOut->width, imgOut->height)) {
+        resampler.Process(imgIn[0], imgOut);
+    }
+
+    return imgOut;
+}
+
+PIC_INLINE Image *FilterSampler2D::ProcessP(ImageVec imgIn, Image *imgOut)
+{
+    if(SeparableResampler::isSeparable(isb)) {
+        return Process(imgIn, imgOut);
+    }
+
+    return Filter::ProcessP(imgIn, imgOut);
+}
+
 PIC_INLINE void FilterSampler2D::ProcessBBox(Image *dst, ImageVec src,
         BBox *box)
 {
     Image *source = src[0];
 
-    float inv_height1f = 1.0f / float(box->height - 1);
-    float inv_width1f = 1.0f / float(box->width - 1);
+    //coordinates are relative to the whole output, as in SeparableResampler
+    float inv_height1f = dst->height > 1 ? 1.0f / float(dst->height - 1) : 0.0f;
+    float inv_width1f = dst->width > 1 ? 1.0f / float(dst->width - 1) : 0.0f;
 
     for(int j = box->y0; j < box->y1; j++) {
         float y = float(j) * inv_height1f;
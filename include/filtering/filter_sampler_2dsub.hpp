@@ -20,6 +20,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "../filtering/filter.hpp"
 #include "../image_samplers/image_sampler_bilinear.hpp"
+#include "../image_samplers/separable_resampler.hpp"
 
 namespace pic {
 
@@ -56,6 +57,24 @@ public:
      */
     void Update(ImageSampler *isb);
 
+    /**
+     * @brief Process resamples both inputs with SeparableResampler and
+     * subtracts them when the sampler is separable; otherwise, each output pixel
+     * is sampled.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut);
+
+    /**
+     * @brief ProcessP
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut);
+
     /**
      * @brief Execute
      * @param imgIn
@@ -111,6 +130,44 @@ PIC_INLINE void FilterSampler2DSub::Update(ImageSampler *isb)
     bIsb = false;
 }
 
+PIC_INLINE Image *FilterSampler2DSub::Process(ImageVec imgIn, Image *imgOut)
+{
+    if(imgIn.size() != 2) {
+        return imgOut;
+    }
+
+    if(imgIn[0] == NULL || imgIn[1] == NULL) {
+        return imgOut;
+    }
+
+    if(!SeparableResampler::isSeparable(isb) ||
+       (imgOut == imgIn[0]) || (imgOut == imgIn[1])) {
+        return Filter::Process(imgIn, imgOut);
+    }
+
+    imgOut = SetupAux(imgIn, imgOut);
+
+    Image *tmp = imgOut->allocateSimilarOne();
+
+    SeparableResampler::execute(imgIn[0], imgOut, isb);
+    SeparableResampler::execute(imgIn[1], tmp, isb);
+
+    *imgOut -= *tmp;
+
+    delete tmp;
+
+    return imgOut;
+}
+
+PIC_INLINE Image *FilterSampler2DSub::ProcessP(ImageVec imgIn, Image *imgOut)
+{
+    if(SeparableResampler::isSeparable(isb)) {
+        return Process(imgIn, imgOut);
+    }
+
+    return Filter::ProcessP(imgIn, imgOut);
+}
+
 PIC_INLINE void FilterSampler2DSub::ProcessBBox(Image *dst, ImageVec src, BBox *box)
 {
     if(src.size() != 2) {
@@ -126,8 +183,9 @@ PIC_INLINE void FilterSampler2DSub::ProcessBBox(Image *dst, ImageVec src, BBox *
     float *vOut  = &tmp_mem[0];
     float *vsrc0 = &tmp_mem[channels];
 
-    float inv_height1f = 1.0f / float(box->height - 1);
-    float inv_width1f = 1.0f / float(box->width - 1);
+    //coordinates are relative to the whole output, as in SeparableResampler
+    float inv_height1f = dst->height > 1 ? 1.0f / float(dst->height - 1) : 0.0f;
+    float inv_width1f = dst->width > 1 ? 1.0f / float(dst->width - 1) : 0.0f;
 
     for(int j = box->y0; j < box->y1; j++) {
         float y = float(j) * inv_height1f;
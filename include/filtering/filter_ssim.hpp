@@ -46,25 +46,9 @@ protected:
             for(int i = box->x0; i < box->x1; i++) {
                 int ind = (c + i) *  channels;
 
-                float mu1_sq = src[0]->data[ind];
-                mu1_sq *= mu1_sq;
-                float mu2_sq = src[1]->data[ind];
-                mu2_sq *= mu2_sq;
-
-                float sigma1_sq = src[2]->data[ind] - mu1_sq;
-                float sigma2_sq = src[3]->data[ind] - mu2_sq;
-                float mu1_mu2 = src[0]->data[ind] * src[1]->data[ind];
-                float sigma1_sigma2 = src[4]->data[ind] - mu1_mu2;
-
-                //numerator
-               float tmp1 = (mu1_mu2 * 2.0f + C0) *
-                            (sigma1_sigma2 * 2.0f + C1);
-
-               //denominator
-               float tmp2 = (mu1_sq + mu2_sq + C0 ) *
-                            (sigma1_sq + sigma2_sq + C1);
-
-               dst->data[ind] = tmp1 / tmp2;
+                dst->data[ind] = getSSIM(src[0]->data[ind], src[1]->data[ind],
+                                         src[2]->data[ind], src[3]->data[ind],
+                                         src[4]->data[ind], C0, C1);
             }
         }
     }
@@ -83,6 +67,39 @@ public:
         this->C1 = C1;
     }
 
+    /**
+     * @brief getSSIM computes the SSIM index from window statistics.
+     * @param mu1 is the mean of the first signal.
+     * @param mu2 is the mean of the second signal.
+     * @param mu1_sq_w is the mean of the squared first signal.
+     * @param mu2_sq_w is the mean of the squared second signal.
+     * @param mu12_w is the mean of the product of the two signals.
+     * @param C0
+     * @param C1
+     * @return
+     */
+    static inline float getSSIM(float mu1, float mu2, float mu1_sq_w,
+                                float mu2_sq_w, float mu12_w, float C0, float C1)
+    {
+        float mu1_sq = mu1 * mu1;
+        float mu2_sq = mu2 * mu2;
+
+        float sigma1_sq = mu1_sq_w - mu1_sq;
+        float sigma2_sq = mu2_sq_w - mu2_sq;
+        float mu1_mu2 = mu1 * mu2;
+        float sigma1_sigma2 = mu12_w - mu1_mu2;
+
+        //numerator
+        float tmp1 = (mu1_mu2 * 2.0f + C0) *
+                     (sigma1_sigma2 * 2.0f + C1);
+
+        //denominator
+        float tmp2 = (mu1_sq + mu2_sq + C0 ) *
+                     (sigma1_sq + sigma2_sq + C1);
+
+        return tmp1 / tmp2;
+    }
+
 };
 
 } // end namespace pic
@@ -21,7 +21,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../util/matrix_3_x_3.hpp"
 
 #include "../filtering/filter.hpp"
-#include "../image_samplers/image_sampler_bilinear.hpp"
+#include "../util/image_sampler.hpp"
+#include "../util/warp_map.hpp"
 
 namespace pic {
 
@@ -31,11 +32,292 @@ namespace pic {
 class FilterWarp2D: public Filter
 {
 protected:
-    ImageSamplerBilinear isb;
     Matrix3x3 h, h_inv;
     int bmin[2], bmax[2], mid[2];
     bool bComputeBoundingBox;
 
+    bool bBicubic;
+
+    /**
+     * @brief isInside checks if the output pixel (i, j) is projected
+     * inside the source image.
+     * @param i
+     * @param j
+     * @param width1f
+     * @param height1f
+     * @return
+     */
+    inline bool isInside(int i, int j, float width1f, float height1f)
+    {
+        float pos[2], pos_out[2];
+
+        pos[0] = float(i + bmin[0]) - mid[0];
+        pos[1] = float(j + bmin[1]) - mid[1];
+
+        h_inv.Projection(pos, pos_out);
+
+        pos_out[0] += mid[0];
+        pos_out[1] += mid[1];
+
+        return (pos_out[0] >= 0.0f) && (pos_out[0] <= width1f) &&
+               (pos_out[1] >= 0.0f) && (pos_out[1] <= height1f);
+    }
+
+    /**
+     * @brief clipSpan clips [k0, k1] to the values of k where a + b * k >= 0.
+     * @param a
+     * @param b
+     * @param k0
+     * @param k1
+     */
+    static inline void clipSpan(double a, double b, double &k0, double &k1)
+    {
+        if(b > 0.0) {
+            k0 = MAX(k0, -a / b);
+        } else {
+            if(b < 0.0) {
+                k1 = MIN(k1, -a / b);
+            } else {
+                if(a < 0.0) {
+                    k1 = -1.0;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief getSpan computes the range [k0, k1) of the n pixels of a
+     * scanline, starting at the pixel (i, j) and at (X, Y, W) in homogeneous
+     * coordinates with step (dX, dY, dW), that are projected inside the
+     * source image with W > 0. A projective map keeps a line straight, so
+     * these pixels are contiguous. Pixels with W <= 0 come from behind the
+     * centre of projection and they are left black.
+     * @param i
+     * @param j
+     * @param X
+     * @param Y
+     * @param W
+     * @param dX
+     * @param dY
+     * @param dW
+     * @param n
+     * @param width1f
+     * @param height1f
+     * @param k0
+     * @param k1
+     */
+    void getSpan(int i, int j, double X, double Y, double W,
+                 double dX, double dY, double dW,
+                 int n, float width1f, float height1f, int &k0, int &k1)
+    {
+        //the source image is enlarged by a pixel, and the span is refined below
+        double lx = -double(mid[0]) - 1.0;
+        double hx = double(width1f) - double(mid[0]) + 1.0;
+        double ly = -double(mid[1]) - 1.0;
+        double hy = double(height1f) - double(mid[1]) + 1.0;
+
+        double t0 = 0.0;
+        double t1 = double(n - 1);
+
+        //W > 0 and the four sides of the source image
+        clipSpan(W - 1e-9, dW, t0, t1);
+        clipSpan(X - lx * W, dX - lx * dW, t0, t1);
+        clipSpan(hx * W - X, hx * dW - dX, t0, t1);
+        clipSpan(Y - ly * W, dY - ly * dW, t0, t1);
+        clipSpan(hy * W - Y, hy * dW - dY, t0, t1);
+
+        if(t0 > t1) {
+            k0 = k1 = 0;
+            return;
+        }
+
+        k0 = CLAMPi(int(ceil(t0)), 0, n);
+        k1 = CLAMPi(int(floor(t1)) + 1, k0, n);
+
+        //the analytic bounds are refined with the per-pixel test
+        while((k0 < k1) && !isInside(i + k0, j, width1f, height1f)) {
+            k0++;
+        }
+
+        while((k1 > k0) && !isInside(i + k1 - 1, j, width1f, height1f)) {
+            k1--;
+        }
+
+        if(k0 == k1) {
+            return;
+        }
+
+        while((k0 > 0) && isInside(i + k0 - 1, j, width1f, height1f)) {
+            k0--;
+        }
+
+        while((k1 < n) && isInside(i + k1, j, width1f, height1f)) {
+            k1++;
+        }
+    }
+
+    /**
+     * @brief warpSpanBilinear samples n pixels of a scanline with bilinear
+     * interpolation; homogeneous coordinates are stepped with additions only.
+     * Channels are a template parameter for the common cases, so the inner
+     * loop is unrolled; C = 0 uses the channels of src.
+     * @param src
+     * @param out
+     * @param n
+     * @param X
+     * @param Y
+     * @param W
+     * @param dX
+     * @param dY
+     * @param dW
+     */
+    template<int C>
+    void warpSpanBilinear(Image *src, float *out, int n,
+                          double X, double Y, double W,
+                          double dX, double dY, double dW)
+    {
+        int channels = src->channels;
+
+        if(C > 0) {
+            channels = C;
+        }
+
+        int width = src->width;
+        int height = src->height;
+        int ystride = src->ystride;
+        float width1f = src->width1f;
+        float height1f = src->height1f;
+        float mid_x = float(mid[0]);
+        float mid_y = float(mid[1]);
+        float *data = src->data;
+
+        for(int k = 0; k < n; k++) {
+            double W_inv = 1.0 / W;
+            float x = CLAMPi(float(X * W_inv) + mid_x, 0.0f, width1f);
+            float y = CLAMPi(float(Y * W_inv) + mid_y, 0.0f, height1f);
+
+            //coordinates are not negative, so truncation is floor
+            int ix = int(x);
+            int iy = int(y);
+            float dx = x - float(ix);
+            float dy = y - float(iy);
+
+            int ix1 = MIN(ix + 1, width - 1);
+            int iy1 = MIN(iy + 1, height - 1);
+
+            float *p0 = &data[iy  * ystride + ix  * channels];
+            float *p1 = &data[iy  * ystride + ix1 * channels];
+            float *p2 = &data[iy1 * ystride + ix  * channels];
+            float *p3 = &data[iy1 * ystride + ix1 * channels];
+
+            for(int c = 0; c < channels; c++) {
+                float px0 = p0[c] + dy * (p2[c] - p0[c]);
+                float px1 = p1[c] + dy * (p3[c] - p1[c]);
+                out[c] = px0 + dx * (px1 - px0);
+            }
+
+            out += channels;
+
+            X += dX;
+            Y += dY;
+            W += dW;
+        }
+    }
+
+    /**
+     * @brief warpSpanBicubic samples n pixels of a scanline with bicubic
+     * interpolation; homogeneous coordinates are stepped with additions only.
+     * @param src
+     * @param out
+     * @param n
+     * @param X
+     * @param Y
+     * @param W
+     * @param dX
+     * @param dY
+     * @param dW
+     */
+    void warpSpanBicubic(Image *src, float *out, int n,
+                         double X, double Y, double W,
+                         double dX, double dY, double dW)
+    {
+        int channels = src->channels;
+        int width = src->width;
+        int height = src->height;
+        int ystride = src->ystride;
+        float width1f = src->width1f;
+        float height1f = src->height1f;
+        float mid_x = float(mid[0]);
+        float mid_y = float(mid[1]);
+        float *data = src->data;
+
+        float rx[4], ry[4];
+        int ex[4], ey[4];
+
+        for(int k = 0; k < n; k++) {
+            double W_inv = 1.0 / W;
+            float x = CLAMPi(float(X * W_inv) + mid_x, 0.0f, width1f);
+            float y = CLAMPi(float(Y * W_inv) + mid_y, 0.0f, height1f);
+
+            //coordinates are not negative, so truncation is floor
+            int ix = int(x);
+            int iy = int(y);
+            float dx = x - float(ix);
+            float dy = y - float(iy);
+
+            for(int t = 0; t < 4; t++) {
+                rx[t] = Bicubic(dx - float(t - 1));
+                ry[t] = Bicubic(float(t - 1) - dy);
+                ex[t] = CLAMP(ix + t - 1, width) * channels;
+                ey[t] = CLAMP(iy + t - 1, height) * ystride;
+            }
+
+            for(int c = 0; c < channels; c++) {
+                out[c] = 0.0f;
+            }
+
+            for(int j = 0; j < 4; j++) {
+                float *row = &data[ey[j]];
+
+                for(int i = 0; i < 4; i++) {
+                    float *p = &row[ex[i]];
+                    float w = rx[i] * ry[j];
+
+                    for(int c = 0; c < channels; c++) {
+                        out[c] += p[c] * w;
+                    }
+                }
+            }
+
+            out += channels;
+
+            X += dX;
+            Y += dY;
+            W += dW;
+        }
+    }
+
+    /**
+     * @brief getHomogeneous computes the homogeneous coordinates of the
+     * projection of the output pixel (i, j) in the source image.
+     * @param i
+     * @param j
+     * @param X
+     * @param Y
+     * @param W
+     */
+    inline void getHomogeneous(int i, int j, double &X, double &Y, double &W)
+    {
+        float *m = h_inv.data;
+
+        double px = double(i + bmin[0]) - double(mid[0]);
+        double py = double(j + bmin[1]) - double(mid[1]);
+
+        X = double(m[0]) * px + double(m[1]) * py + double(m[2]);
+        Y = double(m[3]) * px + double(m[4]) * py + double(m[5]);
+        W = double(m[6]) * px + double(m[7]) * py + double(m[8]);
+    }
+
     /**
      * @brief ProcessBBox
      * @param dst
@@ -46,28 +328,65 @@ protected:
     {
         int channels = src[0]->channels;
 
-        float pos[2], pos_out[2];
+        float *m = h_inv.data;
+
+        float width1f = src[0]->width1f;
+        float height1f = src[0]->height1f;
+
+        //steps of homogeneous coordinates along a scanline
+        double dX = double(m[0]);
+        double dY = double(m[3]);
+        double dW = double(m[6]);
+
+        int n = box->x1 - box->x0;
 
         for(int j = box->y0; j < box->y1; j++) {
-            pos[1] = float(j + bmin[1]) - mid[1];
+            double X, Y, W;
+            getHomogeneous(box->x0, j, X, Y, W);
 
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmp_dst = (*dst)(i, j);
+            int k0, k1;
+            getSpan(box->x0, j, X, Y, W, dX, dY, dW, n, width1f, height1f, k0, k1);
 
-                pos[0] = float(i + bmin[0] ) - mid[0];
+            float *out = (*dst)(box->x0, j);
 
-                h_inv.Projection(pos, pos_out);
+            for(int i = 0; i < (k0 * channels); i++) {
+                out[i] = 0.0f;
+            }
 
-                pos_out[0] += mid[0];
-                pos_out[1] += mid[1];
+            for(int i = (k1 * channels); i < (n * channels); i++) {
+                out[i] = 0.0f;
+            }
 
-                if(pos_out[0] >= 0.0f && pos_out[0] <= src[0]->width1f &&
-                   pos_out[1] >= 0.0f && pos_out[1] <= src[0]->height1f) {
-                    isb.SampleImageUC(src[0], pos_out[0], pos_out[1], tmp_dst);
-                } else {
-                    for(int k=0; k<channels; k++) {
-                        tmp_dst[k] = 0.0f;
-                    }
+            if(k0 == k1) {
+                continue;
+            }
+
+            X += k0 * dX;
+            Y += k0 * dY;
+            W += k0 * dW;
+
+            float *span = &out[k0 * channels];
+            int nSpan = k1 - k0;
+
+            if(bBicubic) {
+                warpSpanBicubic(src[0], span, nSpan, X, Y, W, dX, dY, dW);
+            } else {
+                switch(channels) {
+                case 1: {
+                    warpSpanBilinear<1>(src[0], span, nSpan, X, Y, W, dX, dY, dW);
+                } break;
+
+                case 3: {
+                    warpSpanBilinear<3>(src[0], span, nSpan, X, Y, W, dX, dY, dW);
+                } break;
+
+                case 4: {
+                    warpSpanBilinear<4>(src[0], span, nSpan, X, Y, W, dX, dY, dW);
+                } break;
+
+                default: {
+                    warpSpanBilinear<0>(src[0], span, nSpan, X, Y, W, dX, dY, dW);
+                } break;
                 }
             }
         }
@@ -81,13 +400,25 @@ protected:
      */
     Image *SetupAux(ImageVec imgIn, Image *imgOut)
     {
-        if(imgOut != NULL) {
-            return imgOut;
+        computeGeometry(imgIn[0]);
+
+        if(imgOut == NULL) {
+            imgOut = new Image(1, bmax[0] - bmin[0], bmax[1] - bmin[1], imgIn[0]->channels);
         }
 
+        return imgOut;
+    }
+
+    /**
+     * @brief computeGeometry computes the center and the bounding box of
+     * the warp of imgIn.
+     * @param imgIn
+     */
+    void computeGeometry(Image *imgIn)
+    {
         if(bCentroid) {
-            mid[0] = imgIn[0]->widthf  * 0.5f;
-            mid[1] = imgIn[0]->heightf * 0.5f;
+            mid[0] = imgIn->widthf  * 0.5f;
+            mid[1] = imgIn->heightf * 0.5f;
         } else {
             mid[0] = 0.0f;
             mid[1] = 0.0f;
@@ -96,23 +427,17 @@ protected:
         if(!bSameSize) {
             if(this->bComputeBoundingBox) {
                 computeBoundingBox(h, bCentroid,
-                                   imgIn[0]->widthf, imgIn[0]->heightf,
+                                   imgIn->widthf, imgIn->heightf,
                                    bmin, bmax);
             }
-
-            imgOut = new Image(1, bmax[0] - bmin[0], bmax[1] - bmin[1], imgIn[0]->channels);
         } else {
             bmin[0] = 0;
             bmin[1] = 0;
 
-            bmax[0] = imgIn[0]->width;
-            bmax[1] = imgIn[0]->height;
-
-            imgOut = new Image(1, imgIn[0]->width, imgIn[0]->height, imgIn[0]->channels);
+            bmax[0] = imgIn->width;
+            bmax[1] = imgIn->height;
         }
-
-        return imgOut;
-    }    
+    }
 
     bool bSameSize, bCentroid;
 
@@ -123,6 +448,7 @@ public:
      */
     FilterWarp2D() : Filter()
     {
+        this->bBicubic = false;
         this->bComputeBoundingBox = true;
         this->bCentroid = false;
         this->bSameSize = false;
@@ -139,9 +465,19 @@ public:
      */
     FilterWarp2D(Matrix3x3 h, bool bSameSize = false, bool bCentroid = false)
     {
+        this->bBicubic = false;
         Update(h, bSameSize, bCentroid);
     }
 
+    /**
+     * @brief SetBicubic sets bicubic interpolation instead of bilinear.
+     * @param bBicubic
+     */
+    void SetBicubic(bool bBicubic)
+    {
+        this->bBicubic = bBicubic;
+    }
+
     /**
      * @brief getBCentroid
      * @return
@@ -280,6 +616,68 @@ public:
         channels = imgIn->channels;
     }
 
+    /**
+     * @brief computeWarpMap computes the map of the warp for images of the
+     * size of imgIn; the map can be applied to every frame of that size with
+     * FilterRemap without evaluating the homography again.
+     * @param imgIn
+     * @param map
+     * @return
+     */
+    WarpMap *computeWarpMap(Image *imgIn, WarpMap *map = NULL)
+    {
+        if(imgIn == NULL) {
+            return map;
+        }
+
+        if(map == NULL) {
+            map = new WarpMap();
+        }
+
+        computeGeometry(imgIn);
+
+        int width = bmax[0] - bmin[0];
+        int height = bmax[1] - bmin[1];
+
+        map->allocate(width, height, imgIn->width, imgIn->height);
+
+        if(!map->isValid()) {
+            return map;
+        }
+
+        float *m = h_inv.data;
+        double dX = double(m[0]);
+        double dY = double(m[3]);
+        double dW = double(m[6]);
+
+        #pragma omp parallel for
+
+        for(int j = 0; j < height; j++) {
+            double X, Y, W;
+            getHomogeneous(0, j, X, Y, W);
+
+            int k0, k1;
+            getSpan(0, j, X, Y, W, dX, dY, dW, width,
+                    imgIn->width1f, imgIn->height1f, k0, k1);
+
+            for(int i = 0; i < width; i++) {
+                if((i >= k0) && (i < k1)) {
+                    double W_inv = 1.0 / W;
+                    map->set(i, j, float(X * W_inv) + float(mid[0]),
+                                   float(Y * W_inv) + float(mid[1]));
+                } else {
+                    map->setInvalid(i, j);
+                }
+
+                X += dX;
+                Y += dY;
+                W += dW;
+            }
+        }
+
+        return map;
+    }
+
     /**
      * @brief Execute
      * @param img
@@ -287,11 +685,13 @@ public:
      * @param h
      * @param bSameSize
      * @param bCentroid
+     * @param bBicubic
      * @return
      */
-    static Image *Execute(Image *img, Image *imgOut, Matrix3x3 h, bool bSameSize = false, bool bCentroid = false)
+    static Image *Execute(Image *img, Image *imgOut, Matrix3x3 h, bool bSameSize = false, bool bCentroid = false, bool bBicubic = false)
     {
         FilterWarp2D flt(h, bSameSize, bCentroid);
+        flt.SetBicubic(bBicubic);
         imgOut = flt.ProcessP(Single(img), imgOut);
         return imgOut;
     }
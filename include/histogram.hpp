@@ -21,6 +21,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "image.hpp"
 #include "util/array.hpp"
 #include "util/math.hpp"
+#include "util/std_util.hpp"
 
 namespace pic {
 
@@ -104,6 +105,184 @@ protected:
         return x;
     }
 
+    /**
+     * @brief projectDomainT is projectDomain with the domain resolved at
+     * compile time, so that it can be hoisted out of inner loops.
+     * @param x is an input value.
+     * @param epsilon
+     * @return x is converted into the histogram domain.
+     */
+    template<VALUE_SPACE T>
+    static inline float projectDomainT(float x, float epsilon)
+    {
+        switch(T) {
+            case VS_LOG_2: {
+                return logf(x + epsilon) * C_INV_LOG_NAT_2;
+            }
+
+            case VS_LOG_E: {
+                return logf(x + epsilon);
+            }
+
+            case VS_LOG_10: {
+                return log10f(x + epsilon);
+            }
+
+            default: {
+                return x;
+            }
+        }
+    }
+
+    /**
+     * @brief accumulateT adds rows of an image to a set of histograms.
+     * @param data is the first value of the first row.
+     * @param n is the number of pixels.
+     * @param channels is the number of channels of the image.
+     * @param h is an array of nChannels histograms; h[i] is the
+     * histogram of channel channel0 + i.
+     * @param channel0
+     * @param nChannels
+     * @param out is an array of nChannels * nBin counters.
+     */
+    template<VALUE_SPACE T>
+    static void accumulateT(float *data, int n, int channels, Histogram *h,
+                            int channel0, int nChannels, unsigned int *out)
+    {
+        int nBin = h[0].nBin;
+        float epsilon = h[0].epsilon;
+
+        for(int c = 0; c < nChannels; c++) {
+            float *ptr = &data[channel0 + c];
+            unsigned int *out_c = &out[c * nBin];
+
+            float fMin = h[c].fMin;
+            float nBinf = h[c].nBinf;
+            float deltaMaxMin = h[c].deltaMaxMin;
+
+            if(!(deltaMaxMin > 0.0f)) {
+                out_c[0] += n;
+                continue;
+            }
+
+            for(int i = 0; i < n; i++) {
+                float val = projectDomainT<T>(ptr[i * channels], epsilon);
+                int indx = int(((val - fMin) * nBinf) / deltaMaxMin);
+                out_c[CLAMP(indx, nBin)]++;
+            }
+        }
+    }
+
+    /**
+     * @brief calculateAux computes histograms of consecutive channels of an
+     * image in a single parallel pass; each thread fills its own
+     * sub-histograms, which are merged at the end.
+     * @param imgIn is the input image.
+     * @param type is the domain space for histogram computations.
+     * @param nBin is the number of bins of each Histogram.
+     * @param h is an array of nChannels histograms.
+     * @param channel0 is the first channel.
+     * @param nChannels is the number of channels.
+     */
+    static void calculateAux(Image *imgIn, VALUE_SPACE type, int nBin,
+                             Histogram *h, int channel0, int nChannels)
+    {
+        if(nBin < 1) {
+            nBin = 256;
+        }
+
+        if(type == VS_LDR) {
+            nBin = 256;
+        }
+
+        //statistics
+        BBox box(imgIn->width, imgIn->height);
+        ImageStatistics stats;
+        imgIn->getStatistics(IS_MIN | IS_MAX, &box, &stats);
+
+        for(int c = 0; c < nChannels; c++) {
+            Histogram &hc = h[c];
+
+            if(hc.bin != NULL && hc.nBin != nBin) {
+                delete[] hc.bin;
+                hc.bin = NULL;
+            }
+
+            if(hc.bin == NULL) {
+                hc.bin = new unsigned int[nBin];
+            }
+
+            memset((void *)hc.bin, 0, nBin * sizeof(unsigned int));
+
+            hc.nBin = nBin;
+            hc.type = type;
+
+            hc.fMin = hc.projectDomain(stats.minVal[channel0 + c]);
+            hc.fMax = hc.projectDomain(stats.maxVal[channel0 + c]);
+
+            hc.deltaMaxMin = (hc.fMax - hc.fMin);
+            hc.nBinf = float(nBin - 1);
+        }
+
+        //histogram calculation
+        int width = imgIn->width;
+        int height = imgIn->height;
+        int channels = imgIn->channels;
+
+        int nBands = ((width * height) < 65536) ? 1 : MAX(MIN(getNumberOfThreads(), height), 1);
+        int nH = nChannels * nBin;
+
+        std::vector<unsigned int> partials(nBands * nH, 0);
+
+        #pragma omp parallel for
+
+        for(int b = 0; b < nBands; b++) {
+            int y0 = (height * b) / nBands;
+            int y1 = (height * (b + 1)) / nBands;
+
+            unsigned int *out = &partials[b * nH];
+
+            //row by row, so that all channels are read while in cache
+            for(int y = y0; y < y1; y++) {
+                float *data = &imgIn->data[y * imgIn->ystride];
+
+                switch(type) {
+                    case VS_LOG_2: {
+                        accumulateT<VS_LOG_2>(data, width, channels, h, channel0, nChannels, out);
+                    }
+                    break;
+
+                    case VS_LOG_E: {
+                        accumulateT<VS_LOG_E>(data, width, channels, h, channel0, nChannels, out);
+                    }
+                    break;
+
+                    case VS_LOG_10: {
+                        accumulateT<VS_LOG_10>(data, width, channels, h, channel0, nChannels, out);
+                    }
+                    break;
+
+                    default: {
+                        accumulateT<VS_LIN>(data, width, channels, h, channel0, nChannels, out);
+                    }
+                    break;
+                }
+            }
+        }
+
+        for(int b = 0; b < nBands; b++) {
+            unsigned int *out = &partials[b * nH];
+
+            for(int c = 0; c < nChannels; c++) {
+                unsigned int *bin = h[c].bin;
+
+                for(int i = 0; i < nBin; i++) {
+                    bin[i] += out[c * nBin + i];
+                }
+            }
+        }
+    }
+
 public:
     unsigned int	*bin, *bin_work;
 
@@ -164,7 +343,7 @@ public:
         }
 
         if(bin_nor != NULL) {
-            delete [] bin;
+            delete [] bin_nor;
             bin_nor = NULL;
         }
 
@@ -203,53 +382,155 @@ public:
             return;
         }
 
-        if(nBin < 1) {
-            nBin = 256;
+        calculateAux(imgIn, type, nBin, this, channel, 1);
+    }
+
+    /**
+     * @brief calculateAll computes the histograms of all color channels
+     * of an input image in a single pass.
+     * @param imgIn is the input image for which histograms need to be computed.
+     * @param type is the domain space for histogram computations (please see calculate()).
+     * @param nBin is the number of bins of each Histogram.
+     * @param ret is an array of imgIn->channels histograms. If it is set to NULL
+     * an array will be allocated.
+     * @return It returns an array of histograms, one for each color channel.
+     */
+    static Histogram *calculateAll(Image *imgIn, VALUE_SPACE type, int nBin,
+                                   Histogram *ret = NULL)
+    {
+        if(imgIn == NULL) {
+            return ret;
         }
 
-        if(type == VS_LDR) {
-            nBin = 256;
+        if(ret == NULL) {
+            ret = new Histogram[imgIn->channels];
         }
 
-        bin = new unsigned int[nBin];
-        memset((void *)bin, 0, nBin * sizeof(unsigned int));
+        calculateAux(imgIn, type, nBin, ret, 0, imgIn->channels);
 
-        this->nBin = nBin;
-        this->type = type;
+        return ret;
+    }
 
-        int size = imgIn->width * imgIn->height * imgIn->channels;
-        int channels = imgIn->channels;
+    /**
+     * @brief calculateJoint computes the joint 2D histogram of two color channels;
+     * e.g. of two exposures for selecting CRF samples, or of a source and a target
+     * image for histogram matching. Channels are binned as in calculate().
+     * @param imgX is the first input image.
+     * @param channelX is the color channel of imgX.
+     * @param imgY is the second input image; it has the same size of imgX.
+     * @param channelY is the color channel of imgY.
+     * @param type is the domain space for histogram computations.
+     * @param nBin is the number of bins per dimension.
+     * @param ret is an array of nBin * nBin counters, where ret[y * nBin + x]
+     * counts pixels in the bin x of imgX and in the bin y of imgY. If it is set
+     * to NULL an array will be allocated.
+     * @return It returns the joint histogram.
+     */
+    static unsigned int *calculateJoint(Image *imgX, int channelX, Image *imgY, int channelY,
+                                        VALUE_SPACE type, int nBin, unsigned int *ret = NULL)
+    {
+        if(imgX == NULL || imgY == NULL) {
+            return ret;
+        }
 
-        //Statistics
-        fMin =  FLT_MAX;
-        fMax = -FLT_MAX;
+        if((imgX->width != imgY->width) || (imgX->height != imgY->height)) {
+            return ret;
+        }
 
-        for(int i = channel; i < size; i += channels) {
-            float val = imgIn->data[i];
-            fMin = MIN(fMin, val);
-            fMax = MAX(fMax, val);
+        if((channelX < 0) || (channelX >= imgX->channels) ||
+           (channelY < 0) || (channelY >= imgY->channels)) {
+            return ret;
         }
 
-        fMin = projectDomain(fMin);
-        fMax = projectDomain(fMax);
+        if(nBin < 1 || type == VS_LDR) {
+            nBin = 256;
+        }
 
-        deltaMaxMin = (fMax - fMin);
-        nBinf = float(nBin - 1);
+        //set up ranges without counting
+        Histogram h[2];
+        h[0].setRange(imgX, type, nBin, channelX);
+        h[1].setRange(imgY, type, nBin, channelY);
 
-        //histogram calculation
-        for(int i = channel; i < size; i += channels) {           
-            float val = projectDomain(imgIn->data[i]);
+        int nH = nBin * nBin;
 
-            int indx = int(((val - fMin) * nBinf) / deltaMaxMin);
+        if(ret == NULL) {
+            ret = new unsigned int[nH];
+        }
 
-            #ifdef PIC_DEBUG
-            if((indx >= nBin) || (indx < 0)) {
-                printf("Error in Calculate %d.\n",indx);
+        int width = imgX->width;
+        int height = imgX->height;
+        int n = width * height;
+
+        int nBands = (n < 65536) ? 1 : MAX(MIN(getNumberOfThreads(), height), 1);
+
+        std::vector<unsigned int> partials(nBands * nH, 0);
+
+        #pragma omp parallel for
+
+        for(int b = 0; b < nBands; b++) {
+            unsigned int *out = &partials[b * nH];
+
+            int i0 = (height * b) / nBands * width;
+            int i1 = (height * (b + 1)) / nBands * width;
+
+            for(int i = i0; i < i1; i++) {
+                int x = h[0].projectClamped(imgX->data[i * imgX->channels + channelX]);
+                int y = h[1].projectClamped(imgY->data[i * imgY->channels + channelY]);
+
+                out[y * nBin + x]++;
             }
-            #endif
+        }
+
+        for(int i = 0; i < nH; i++) {
+            unsigned int count = 0;
+
+            for(int b = 0; b < nBands; b++) {
+                count += partials[b * nH + i];
+            }
+
+            ret[i] = count;
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief setRange sets the domain and the range of the Histogram
+     * from an image channel without counting values.
+     * @param imgIn
+     * @param type
+     * @param nBin
+     * @param channel
+     */
+    void setRange(Image *imgIn, VALUE_SPACE type, int nBin, int channel)
+    {
+        BBox box(imgIn->width, imgIn->height);
+        ImageStatistics stats;
+        imgIn->getStatistics(IS_MIN | IS_MAX, &box, &stats);
 
-            bin[CLAMP(indx, nBin)]++;
+        this->nBin = nBin;
+        this->type = type;
+
+        fMin = projectDomain(stats.minVal[channel]);
+        fMax = projectDomain(stats.maxVal[channel]);
+
+        deltaMaxMin = (fMax - fMin);
+        nBinf = float(nBin - 1);
+    }
+
+    /**
+     * @brief projectClamped converts an input value in a valid bin index.
+     * @param x is an input value.
+     * @return x is projected in the histogram domain.
+     */
+    inline int projectClamped(float x)
+    {
+        if(!(deltaMaxMin > 0.0f)) {
+            return 0;
         }
+
+        int indx = project(x);
+        return CLAMP(indx, nBin);
     }
 
     /**
@@ -33,6 +33,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "util/buffer.hpp"
 #include "util/low_dynamic_range.hpp"
 #include "util/math.hpp"
+#include "util/order_statistics.hpp"
+#include "util/image_statistics.hpp"
 
 //IO formats
 #include "io/bmp.hpp"
@@ -314,6 +316,26 @@ public:
      */
     void applyFunction(float(*func)(float));
 
+    /**
+     * @brief getStatistics computes a set of statistics in a single parallel
+     * pass; each thread accumulates its own partials in double precision.
+     * Variance and covariance are computed in the same pass from moments
+     * centered on a shift value.
+     * @param flags is a combination of IMAGE_STATISTICS values.
+     * @param box is the bounding box where to compute the function. If it
+     * is set to NULL the function will be computed on the entire image.
+     * @param ret is where the function computations are stored. If it
+     * is set to NULL an ImageStatistics will be allocated.
+     * @param meanVal is an optional mean; if it is not NULL variance and
+     * covariance are computed with respect to it.
+     * @param bCompensated is a flag; if it is true sums and log-sums are
+     * accumulated per row and combined with Kahan summation.
+     * @return This function returns where the function computations
+     * are stored.
+     */
+    ImageStatistics *getStatistics(int flags, BBox *box, ImageStatistics *ret,
+                                   float *meanVal, bool bCompensated);
+
     /**
      * @brief getMaxVal computes the maximum value for the current Image.
      * @param box is the bounding box where to compute the function. If it
@@ -406,9 +428,24 @@ public:
     /**
      * @brief getPercentileVal computes the n-th value given a percentile.
      * @param perCent is the percentile.
+     * @param bApprox is a flag; if it is true the value is approximated
+     * from a histogram in the log domain, otherwise it is exact.
      * @return This function returns the n-value given a percentile.
      */
-    float getPercentileVal(float perCent);
+    float getPercentileVal(float perCent, bool bApprox);
+
+    /**
+     * @brief getPercentileVals computes several percentiles at once sharing
+     * the same passes over data.
+     * @param perCent is an array of percentiles.
+     * @param n is the number of percentiles.
+     * @param ret is an array where the function computations are stored. If it
+     * is set to NULL an array will be allocated.
+     * @param bApprox is a flag; if it is true values are approximated
+     * from a histogram in the log domain, otherwise they are exact.
+     * @return This function returns an array with the n values.
+     */
+    float *getPercentileVals(float *perCent, int n, float *ret, bool bApprox);
 
     /**
      * @brief getMedVal computes the median value.
@@ -424,7 +461,7 @@ public:
     float getGT(float val);
 
     /**
-     * @brief sort sorts values in data and stores them into dataTMP.
+     * @brief sort copies values of data into dataTMP and sorts them.
      */
     void sort();
 
@@ -640,7 +677,8 @@ public:
     void *allocateSimilarTo(Image *img);
 
     /**
-     * @brief Clone creates a deep copy of the calling instance.
+     * @brief Clone creates a deep copy of the calling instance; the copy of
+     * an Image stored as RGBE is decoded.
      * @return This returns a deep copy of the calling instance.
      */
     Image *clone() const;
@@ -680,6 +718,52 @@ public:
      */
     bool Write(std::string nameFile, LDR_type typeWrite, int writerCounter);
 
+    /**
+     * @brief ReadRGBE reads a .hdr/.pic file keeping its RGBE encoding in
+     * dataRGBE; float values are decoded by decodeRGBE, clone,
+     * Filter::Process/ProcessP, or when a Write needs them. data is NULL
+     * until then, so callers must call decodeRGBE before accessing pixels
+     * with operator() or data.
+     * @param nameFile is the file name.
+     * @return This returns true if the reading succeeds, false otherwise.
+     */
+    bool ReadRGBE(std::string nameFile);
+
+    /**
+     * @brief WriteRGBE saves an Image into a .hdr/.pic file; RGBE values are
+     * written as they are when the Image has not been decoded.
+     * @param nameFile is the file name.
+     * @return This returns true if the writing succeeds, false otherwise.
+     */
+    bool WriteRGBE(std::string nameFile);
+
+    /**
+     * @brief isRGBE checks if the Image is stored only as RGBE.
+     * @return
+     */
+    bool isRGBE()
+    {
+        return (data == NULL) && (dataRGBE != NULL);
+    }
+
+    /**
+     * @brief decodeRGBE decodes RGBE values into data, and it releases
+     * dataRGBE. It does nothing if the Image is not stored as RGBE.
+     * @return This returns true if the Image is valid.
+     */
+    bool decodeRGBE();
+
+    /**
+     * @brief cropRGBE crops an Image stored as RGBE without decoding it.
+     * @param x0
+     * @param y0
+     * @param width
+     * @param height
+     * @return It returns a new Image stored as RGBE, or NULL if the
+     * Image is not stored as RGBE.
+     */
+    Image *cropRGBE(int x0, int y0, int width, int height);
+
 
     /**
      * @brief changeOwnership
@@ -1174,27 +1258,41 @@ PIC_INLINE void Image::sort()
 
     if(dataTMP == NULL) {
         dataTMP = new float[size];
-        memcpy(dataTMP, data, sizeof(float) * size);
     }
 
+    //data may have changed since the last call
+    memcpy(dataTMP, data, sizeof(float) * size);
+
     std::sort(dataTMP, dataTMP + size);
 }
 
-PIC_INLINE float Image::getPercentileVal(float perCent = 0.5f)
+PIC_INLINE float Image::getPercentileVal(float perCent = 0.5f, bool bApprox = false)
 {
     if(!isValid()) {
         return -1.0f;
     }
 
-    if(dataTMP == NULL) {
-        sort();
+    float ret;
+    getPercentileVals(&perCent, 1, &ret, bApprox);
+    return ret;
+}
+
+PIC_INLINE float *Image::getPercentileVals(float *perCent, int n, float *ret, bool bApprox = false)
+{
+    if(!isValid() || perCent == NULL || n < 1) {
+        return ret;
     }
 
     int size = frames * width * height * channels;
-    size--;
-    float index_f = perCent * float(size);
-    int index = MIN(int(index_f), size);
-    return dataTMP[index];
+
+    if(bApprox) {
+        float minVal, maxVal;
+        getMinMaxParallel(data, size, minVal, maxVal);
+        return getPercentilesApprox(data, size, perCent, n, ret, minVal, maxVal,
+                                    4096, minVal > 0.0f);
+    } else {
+        return getPercentiles(data, size, perCent, n, ret);
+    }
 }
 
 PIC_INLINE float Image::getMedVal()
@@ -1208,19 +1306,17 @@ PIC_INLINE float Image::getGT(float val)
         return -1.0f;
     }
 
-    if(dataTMP == NULL) {
-        sort();
-    }
-
     int size = frames * width * height * channels;
 
+    float ret = FLT_MAX;
+
     for(int i = 0; i < size; i++) {
-        if(dataTMP[i] > val) {
-            return dataTMP[i];
+        if(data[i] > val && data[i] < ret) {
+            ret = data[i];
         }
     }
 
-    return -1.0f;
+    return (ret < FLT_MAX) ? ret : -1.0f;
 }
 
 PIC_INLINE void Image::blend(Image *img, Image *weight)
@@ -1313,65 +1409,253 @@ PIC_INLINE void Image::setRand(unsigned int seed = 1)
     }
 }
 
-PIC_INLINE float *Image::getMaxVal(BBox *box = NULL, float *ret = NULL)
+PIC_INLINE ImageStatistics *Image::getStatistics(int flags, BBox *box = NULL,
+                                                 ImageStatistics *ret = NULL,
+                                                 float *meanVal = NULL,
+                                                 bool bCompensated = false)
 {
     if(!isValid()) {
         return ret;
     }
 
     if(box == NULL) {
-        box = new BBox(width, height, frames);
+        box = &fullBox;
     }
 
     if(ret == NULL) {
-        ret = new float[channels];
+        ret = new ImageStatistics();
     }
 
-    for(int l = 0; l < channels; l++) {
-        ret[l] = -FLT_MAX;
+    ret->allocate(channels, flags);
+    ret->count = box->Size();
+
+    if(ret->count < 1) {
+        return ret;
+    }
+
+    bool bMin = (flags & IS_MIN) != 0;
+    bool bMax = (flags & IS_MAX) != 0;
+    bool bLog = (flags & IS_LOG_MEAN) != 0;
+    bool bCov = (flags & IS_COV_MTX) != 0;
+    bool bSq  = ((flags & IS_VARIANCE) != 0) && !bCov;
+    bool bSum = (flags & (IS_SUM | IS_MEAN | IS_VARIANCE | IS_COV_MTX)) != 0;
+
+    //values are shifted for computing centered moments in one pass
+    std::vector<double> shift(channels, 0.0);
+
+    if(bSq || bCov) {
+        float *first = (*this)(box->x0, box->y0, box->z0);
+
+        for(int l = 0; l < channels; l++) {
+            shift[l] = (meanVal != NULL) ? meanVal[l] : first[l];
+        }
     }
 
-    for(int k = box->z0; k < box->z1; k++) {
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmp_data = (*this)(i, j, k);
+    int bw = box->x1 - box->x0;
+    int bh = box->y1 - box->y0;
+    bool bInside = (box->x0 >= 0) && (box->x1 <= width) &&
+                   (box->y0 >= 0) && (box->y1 <= height) &&
+                   (box->z0 >= 0) && (box->z1 <= frames);
+    int nRows = bh * (box->z1 - box->z0);
+    int nBands = (ret->count < 65536) ? 1 : MAX(MIN(getNumberOfThreads(), nRows), 1);
+
+    //partials: sum, sum compensation, log-sum, log-sum compensation, squares, covariance
+    int oLog = channels * 2;
+    int oSq = channels * 4;
+    int oCov = channels * 5;
+    int stride = channels * 5 + channels * channels;
+
+    std::vector<double> partials(nBands * stride, 0.0);
+    std::vector<float> partialsMin(nBands * channels, FLT_MAX);
+    std::vector<float> partialsMax(nBands * channels, -FLT_MAX);
+
+    #pragma omp parallel for
+
+    for(int b = 0; b < nBands; b++) {
+        double *acc = &partials[b * stride];
+        float *minB = &partialsMin[b * channels];
+        float *maxB = &partialsMax[b * channels];
+
+        std::vector<double> rowAcc(channels * 2);
+        std::vector<double> d(channels);
+        std::vector<float> rowClamped(bInside ? 0 : bw * channels);
+
+        int r0 = (nRows * b) / nBands;
+        int r1 = (nRows * (b + 1)) / nBands;
+
+        for(int r = r0; r < r1; r++) {
+            int k = box->z0 + r / bh;
+            int j = box->y0 + r % bh;
+
+            float *row;
+            int n = bw * channels;
+
+            if(bInside) {
+                row = &data[k * tstride + j * ystride + box->x0 * xstride];
+            } else {
+                //out-of-bounds pixels are clamped as in operator()
+                for(int i = 0; i < bw; i++) {
+                    float *tmp = (*this)(box->x0 + i, j, k);
+
+                    for(int l = 0; l < channels; l++) {
+                        rowClamped[i * channels + l] = tmp[l];
+                    }
+                }
+
+                row = rowClamped.data();
+            }
+
+            if(bMin) {
+                for(int i = 0; i < n; i += channels) {
+                    for(int l = 0; l < channels; l++) {
+                        minB[l] = minB[l] > row[i + l] ? row[i + l] : minB[l];
+                    }
+                }
+            }
+
+            if(bMax) {
+                for(int i = 0; i < n; i += channels) {
+                    for(int l = 0; l < channels; l++) {
+                        maxB[l] = maxB[l] < row[i + l] ? row[i + l] : maxB[l];
+                    }
+                }
+            }
+
+            if(bSum || bLog) {
+                for(int l = 0; l < (channels * 2); l++) {
+                    rowAcc[l] = 0.0;
+                }
+
+                if(bSum) {
+                    for(int i = 0; i < n; i += channels) {
+                        for(int l = 0; l < channels; l++) {
+                            rowAcc[l] += double(row[i + l]) - shift[l];
+                        }
+                    }
+                }
+
+                if(bLog) {
+                    for(int i = 0; i < n; i += channels) {
+                        for(int l = 0; l < channels; l++) {
+                            rowAcc[channels + l] += logf(row[i + l] + 1e-6f);
+                        }
+                    }
+                }
 
                 for(int l = 0; l < channels; l++) {
-                    ret[l] = ret[l] < tmp_data[l] ? tmp_data[l] : ret[l];
+                    if(bCompensated) {
+                        kahanAdd(acc[l], acc[channels + l], rowAcc[l]);
+                        kahanAdd(acc[oLog + l], acc[oLog + channels + l], rowAcc[channels + l]);
+                    } else {
+                        acc[l] += rowAcc[l];
+                        acc[oLog + l] += rowAcc[channels + l];
+                    }
+                }
+            }
+
+            if(bSq) {
+                for(int i = 0; i < n; i += channels) {
+                    for(int l = 0; l < channels; l++) {
+                        double tmp = double(row[i + l]) - shift[l];
+                        acc[oSq + l] += tmp * tmp;
+                    }
+                }
+            }
+
+            if(bCov) {
+                for(int i = 0; i < n; i += channels) {
+                    for(int l = 0; l < channels; l++) {
+                        d[l] = double(row[i + l]) - shift[l];
+                    }
+
+                    for(int l = 0; l < channels; l++) {
+                        double *cov_l = &acc[oCov + l * channels];
+
+                        for(int m = l; m < channels; m++) {
+                            cov_l[m] += d[l] * d[m];
+                        }
+                    }
                 }
             }
         }
     }
 
-    return ret;
-}
+    //reduce partials
+    std::vector<double> total(stride, 0.0);
 
-PIC_INLINE float *Image::getMinVal(BBox *box = NULL, float *ret = NULL)
-{
-    if(!isValid()) {
-        return ret;
-    }
+    for(int b = 0; b < nBands; b++) {
+        double *acc = &partials[b * stride];
 
-    if(box == NULL) {
-        box = new BBox(width, height, frames);
-    }
+        for(int l = 0; l < channels; l++) {
+            if(bCompensated) {
+                kahanAdd(total[l], total[channels + l], acc[l]);
+                kahanAdd(total[oLog + l], total[oLog + channels + l], acc[oLog + l]);
+            } else {
+                total[l] += acc[l];
+                total[oLog + l] += acc[oLog + l];
+            }
+        }
 
-    if(ret == NULL) {
-        ret = new float[channels];
+        for(int l = oSq; l < stride; l++) {
+            total[l] += acc[l];
+        }
     }
 
+    double n = double(ret->count);
+    double n_1 = double(MAX(ret->count - 1, 1));
+
     for(int l = 0; l < channels; l++) {
-        ret[l] = FLT_MAX;
+        float minV = FLT_MAX;
+        float maxV = -FLT_MAX;
+
+        for(int b = 0; b < nBands; b++) {
+            minV = MIN(minV, partialsMin[b * channels + l]);
+            maxV = MAX(maxV, partialsMax[b * channels + l]);
+        }
+
+        double sum = total[l] + n * shift[l];
+
+        if(bMin) {
+            ret->minVal[l] = minV;
+        }
+
+        if(bMax) {
+            ret->maxVal[l] = maxV;
+        }
+
+        if(flags & IS_SUM) {
+            ret->sumVal[l] = float(sum);
+        }
+
+        if(flags & IS_MEAN) {
+            ret->meanVal[l] = float(sum / n);
+        }
+
+        if(bLog) {
+            ret->logMeanVal[l] = float(exp(total[oLog + l] / n));
+        }
     }
 
-    for(int k = box->z0; k < box->z1; k++) {
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmp_data = (*this)(i, j, k);
+    //centered moments; without an input mean they are corrected for the sample mean
+    double c = (meanVal == NULL) ? 1.0 / n : 0.0;
 
-                for(int l = 0; l < channels; l++) {
-                    ret[l] = ret[l] > tmp_data[l] ? tmp_data[l] : ret[l];
-                }
+    if(bSq) {
+        for(int l = 0; l < channels; l++) {
+            ret->varianceVal[l] = float((total[oSq + l] - total[l] * total[l] * c) / n_1);
+        }
+    }
+
+    if(bCov) {
+        for(int l = 0; l < channels; l++) {
+            for(int m = l; m < channels; m++) {
+                double cov = (total[oCov + l * channels + m] - total[l] * total[m] * c) / n_1;
+
+                ret->covMtxVal[l * channels + m] = float(cov);
+                ret->covMtxVal[m * channels + l] = float(cov);
+            }
+
+            if(flags & IS_VARIANCE) {
+                ret->varianceVal[l] = ret->covMtxVal[l * channels + l];
             }
         }
     }
@@ -1379,57 +1663,71 @@ PIC_INLINE float *Image::getMinVal(BBox *box = NULL, float *ret = NULL)
     return ret;
 }
 
-PIC_INLINE float *Image::getSumVal(BBox *box = NULL, float *ret = NULL)
+PIC_INLINE float *Image::getMaxVal(BBox *box = NULL, float *ret = NULL)
 {
     if(!isValid()) {
         return ret;
     }
 
-    if(box == NULL) {
-        box = new BBox(width, height, frames);
-    }
-
     if(ret == NULL) {
         ret = new float[channels];
     }
 
-    for(int l = 0; l < channels; l++) {
-        ret[l] = 0.0f;
-    }
+    ImageStatistics stats;
+    getStatistics(IS_MAX, box, &stats);
+    memcpy(ret, stats.maxVal, sizeof(float) * channels);
 
-    for(int k = box->z0; k < box->z1; k++) {
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmp_data = (*this)(i, j, k);
+    return ret;
+}
 
-                for(int l = 0; l < channels; l++) {
-                    ret[l] += tmp_data[l];
-                }
-            }
-        }
+PIC_INLINE float *Image::getMinVal(BBox *box = NULL, float *ret = NULL)
+{
+    if(!isValid()) {
+        return ret;
+    }
+
+    if(ret == NULL) {
+        ret = new float[channels];
     }
 
+    ImageStatistics stats;
+    getStatistics(IS_MIN, box, &stats);
+    memcpy(ret, stats.minVal, sizeof(float) * channels);
+
     return ret;
 }
 
-PIC_INLINE float *Image::getMeanVal(BBox *box = NULL, float *ret = NULL)
+PIC_INLINE float *Image::getSumVal(BBox *box = NULL, float *ret = NULL)
 {
     if(!isValid()) {
         return ret;
     }
 
-    if(box == NULL) {
-        box = &fullBox;
+    if(ret == NULL) {
+        ret = new float[channels];
     }
 
-    ret = getSumVal(box, ret);
+    ImageStatistics stats;
+    getStatistics(IS_SUM, box, &stats);
+    memcpy(ret, stats.sumVal, sizeof(float) * channels);
 
-    float totf = float(box->Size());
+    return ret;
+}
 
-    for(int l = 0; l < channels; l++) {
-        ret[l] /= totf;
+PIC_INLINE float *Image::getMeanVal(BBox *box = NULL, float *ret = NULL)
+{
+    if(!isValid()) {
+        return ret;
     }
 
+    if(ret == NULL) {
+        ret = new float[channels];
+    }
+
+    ImageStatistics stats;
+    getStatistics(IS_MEAN, box, &stats);
+    memcpy(ret, stats.meanVal, sizeof(float) * channels);
+
     return ret;
 }
 
@@ -1474,92 +1772,32 @@ PIC_INLINE float *Image::getVarianceVal(float *meanVal = NULL, BBox *box = NULL,
         return ret;
     }
 
-    if(box == NULL) {
-        box = &fullBox;
-    }
-
-    if(meanVal == NULL) {
-        meanVal = getMeanVal(box);
-    }
-
     if(ret == NULL) {
         ret = new float[channels];
     }
 
-    for(int l = 0; l < channels; l++) {
-        ret[l] = 0.0f;
-    }
-
-    for(int k = box->z0; k < box->z1; k++) {
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmp_data = (*this)(i, j, k);
-
-                for(int l = 0; l < channels; l++) {
-                    float tmp = tmp_data[l] - meanVal[l];
-                    ret[l] += tmp * tmp;
-                }
-            }
-        }
-    }
-
-    float totf = float(box->Size() - 1);
-
-    for(int l = 0; l < channels; l++) {
-        ret[l] /= totf;
-    }
+    ImageStatistics stats;
+    getStatistics(IS_VARIANCE, box, &stats, meanVal);
+    memcpy(ret, stats.varianceVal, sizeof(float) * channels);
 
     return ret;
 }
 
-
 PIC_INLINE float *Image::getCovMtxVal(float *meanVal, BBox *box, float *ret)
 {
     if(!isValid()) {
         return ret;
     }
 
-    if(box == NULL) {
-        box = &fullBox;
-    }
-
-    if(meanVal == NULL) {
-        meanVal = getMeanVal(box);
-    }
-
     int n = channels * channels;
 
     if(ret == NULL) {
         ret = new float[n];
     }
 
-    for(int l = 0; l < n; l++) {
-        ret[l] = 0.0f;
-    }
-
-    for(int k = box->z0; k < box->z1; k++) {
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmp_data = (*this)(i, j, k);
-
-                for(int l = 0; l < channels; l++) {
-                    float tmp1 = (tmp_data[l] - meanVal[l]);
-
-                    for(int m = 0; m < channels; m++) {
-                        float tmp2 = (tmp_data[m] - meanVal[m]);
-
-                        ret[l * channels + m] += tmp1 * tmp2;
-                    }
-                }
-            }
-        }
-    }
-
-    float totf = float(box->Size() - 1);
-
-    for(int l = 0; l < n; l++) {
-        ret[l] /= totf;
-    }
+    ImageStatistics stats;
+    getStatistics(IS_COV_MTX, box, &stats, meanVal);
+    memcpy(ret, stats.covMtxVal, sizeof(float) * n);
 
     return ret;
 }
@@ -1570,35 +1808,13 @@ PIC_INLINE float *Image::getLogMeanVal(BBox *box = NULL, float *ret = NULL)
         return ret;
     }
 
-    if(box == NULL) {
-        box = &fullBox;
-    }
-
     if(ret == NULL) {
         ret = new float[channels];
     }
 
-    for(int l = 0; l < channels; l++) {
-        ret[l] = 0.0f;
-    }
-
-    for(int k = box->z0; k < box->z1; k++) {
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmp_data = (*this)(i, j, k);
-
-                for(int l = 0; l < channels; l++) {
-                    ret[l] += logf(tmp_data[l] + 1e-6f);
-                }
-            }
-        }
-    }
-
-    float tot = float(box->Size());
-
-    for(int l = 0; l < channels; l++) {
-        ret[l] = expf(ret[l] / tot);
-    }
+    ImageStatistics stats;
+    getStatistics(IS_LOG_MEAN, box, &stats);
+    memcpy(ret, stats.logMeanVal, sizeof(float) * channels);
 
     return ret;
 }
@@ -1753,29 +1969,30 @@ PIC_INLINE bool Image::Read(std::string nameFile,
     } else {
         //read the image using an LDR codec
         label = getLabelLDRExtension(nameFile);
-        unsigned char *dataReader = NULL;
         unsigned char *tmp = NULL;
         bool bExt = false;
 
-        if(dataUC != NULL) {
-            dataReader = dataUC;
-        }
+        //readers decode into their own 8-bit buffer, so a file that does
+        //not match an allocated image is rejected before its frame is written
+        int width_old = width;
+        int height_old = height;
+        int channels_old = channels;
 
         switch(label) {
         case IO_BMP:
-            tmp = ReadBMP(nameFile, dataReader, width, height, channels);
+            tmp = ReadBMP(nameFile, NULL, width, height, channels);
             break;
 
         case IO_PPM:
-            tmp = ReadPPM(nameFile, dataReader, width, height, channels);
+            tmp = ReadPPM(nameFile, NULL, width, height, channels);
             break;
 
         case IO_PGM:
-            tmp = ReadPGM(nameFile, dataUC, width, height, channels);
+            tmp = ReadPGM(nameFile, NULL, width, height, channels);
             break;
 
         case IO_TGA:
-            tmp = ReadTGA(nameFile, dataReader, width, height, channels);
+            tmp = ReadTGA(nameFile, NULL, width, height, channels);
             break;
 
         case IO_JPG:
@@ -1794,21 +2011,41 @@ PIC_INLINE bool Image::Read(std::string nameFile,
              tmp = ReadSTB(nameFile, width, height, channels);
          }
 
-         if(tmp != NULL) { //move the handle where it's trackable
-             if(dataUC == NULL) {
-                 dataUC = tmp;
-             }
-         }
-
          float *tmpFloat = NULL;
 
          if(data != NULL) {
              tmpFloat = &data[tstride * readerCounter];
+
+             if((tmp == NULL) || (width != width_old) ||
+                (height != height_old) || (channels != channels_old)) {
+                 width = width_old;
+                 height = height_old;
+                 channels = channels_old;
+
+                 if(tmp != NULL) {
+                     if(bExt) {
+                         stbi_image_free(tmp);
+                     } else {
+                         delete[] tmp;
+                     }
+                 }
+
+                 tmp = NULL;
+             }
          }
 
          float *tmpConv = convertLDR2HDR(tmp, tmpFloat, width * height * channels,
                                          typeLoad);
 
+         //8-bit buffers allocated by readers are not kept
+         if(tmp != NULL) {
+             if(bExt) {
+                 stbi_image_free(tmp);
+             } else {
+                 delete[] tmp;
+             }
+         }
+
          if(tmpConv != NULL) {
              if(data == NULL) {
                  data = tmpConv;
@@ -1834,6 +2071,15 @@ PIC_INLINE bool Image::Read(std::string nameFile,
 PIC_INLINE bool Image::Write(std::string nameFile, LDR_type typeWrite = LT_NOR_GAMMA,
                                 int writerCounter = 0)
 {
+    if(isRGBE()) {
+        //RGBE values are saved as they are into .hdr files
+        if(getLabelHDRExtension(nameFile) == IO_HDR) {
+            return WriteRGBE(nameFile);
+        }
+
+        decodeRGBE();
+    }
+
     if(!isValid()) {
         return false;
     }
@@ -1942,6 +2188,99 @@ PIC_INLINE bool Image::Write(std::string nameFile, LDR_type typeWrite = LT_NOR_G
     }
 }
 
+PIC_INLINE bool Image::ReadRGBE(std::string nameFile)
+{
+    int w, h;
+    unsigned char *tmp = ReadHDRRGBE(nameFile, NULL, w, h);
+
+    if(tmp == NULL) {
+        return false;
+    }
+
+    Destroy();
+
+    this->nameFile = nameFile;
+    this->typeLoad = LT_NONE;
+
+    width = w;
+    height = h;
+    channels = 3;
+    frames = 1;
+    dataRGBE = tmp;
+
+    allocateAux();
+
+    return true;
+}
+
+PIC_INLINE bool Image::WriteRGBE(std::string nameFile)
+{
+    if(isRGBE()) {
+        return WriteHDRRGBE(nameFile, dataRGBE, width, height);
+    }
+
+    if(!isValid()) {
+        return false;
+    }
+
+    return WriteHDR(nameFile, data, width, height, channels);
+}
+
+PIC_INLINE bool Image::decodeRGBE()
+{
+    if(!isRGBE()) {
+        return isValid();
+    }
+
+    unsigned char *tmp = dataRGBE;
+    dataRGBE = NULL;
+
+    allocate(width, height, 3, 1);
+
+    #pragma omp parallel for
+
+    for(int j = 0; j < height; j++) {
+        convertRGBEToFloat(&tmp[j * width * 4], &data[j * ystride], width, 3);
+    }
+
+    delete[] tmp;
+
+    return isValid();
+}
+
+PIC_INLINE Image *Image::cropRGBE(int x0, int y0, int width, int height)
+{
+    if(!isRGBE()) {
+        return NULL;
+    }
+
+    x0 = CLAMP(x0, this->width);
+    y0 = CLAMP(y0, this->height);
+    width = MIN(width, this->width - x0);
+    height = MIN(height, this->height - y0);
+
+    if(width < 1 || height < 1) {
+        return NULL;
+    }
+
+    Image *ret = new Image();
+    ret->width = width;
+    ret->height = height;
+    ret->channels = 3;
+    ret->frames = 1;
+    ret->exposure = exposure;
+    ret->dataRGBE = new unsigned char[width * height * 4];
+    ret->allocateAux();
+
+    for(int j = 0; j < height; j++) {
+        memcpy(&ret->dataRGBE[j * width * 4],
+               &dataRGBE[((y0 + j) * this->width + x0) * 4],
+               width * 4 * sizeof(unsigned char));
+    }
+
+    return ret;
+}
+
 PIC_INLINE Image *Image::allocateSimilarOne()
 {
     Image *ret = new Image(frames, width, height, channels);
@@ -1968,7 +2307,16 @@ PIC_INLINE Image *Image::clone() const
     ret->alpha = alpha;
     ret->typeLoad = typeLoad;
 
-    memcpy(ret->data, data, width * height * channels * sizeof(float));
+    if((data == NULL) && (dataRGBE != NULL)) {
+        //the clone is decoded; this Image keeps its RGBE values
+        #pragma omp parallel for
+
+        for(int j = 0; j < height; j++) {
+            convertRGBEToFloat(&dataRGBE[j * width * 4], &ret->data[j * ret->ystride], width, 3);
+        }
+    } else {
+        memcpy(ret->data, data, width * height * channels * sizeof(float));
+    }
 
     return ret;
 }
@@ -26,6 +26,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "image_samplers/image_sampler_gaussian.hpp"
 #include "image_samplers/image_sampler_lanczos.hpp"
 #include "image_samplers/image_sampler_nearest.hpp"
+#include "image_samplers/separable_resampler.hpp"
 
 #endif /* PIC_IMAGE_SAMPLERS_HPP */
 
@@ -74,6 +74,30 @@ public:
      * @param vOut
      */
     virtual void SampleImage(Image *img, float x, float y, float t, float *vOut) {}
+
+    /**
+     * @brief getTaps1D returns the number of taps of the 1D kernel of a
+     * separable sampler.
+     * @return It returns 0 if the sampler is not separable.
+     */
+    virtual int getTaps1D()
+    {
+        return 0;
+    }
+
+    /**
+     * @brief getWeights1D computes the 1D kernel of a separable sampler
+     * for a sample of a line of n values; indices are clamped as in SampleImage.
+     * @param x is the sample position in uniform coordinates.
+     * @param n is the number of values of the line.
+     * @param index is an array of getTaps1D() values.
+     * @param weights is an array of getTaps1D() values.
+     * @return It returns the number of taps.
+     */
+    virtual int getWeights1D(float, int, int *, float *)
+    {
+        return 0;
+    }
 };
 
 } // end namespace pic
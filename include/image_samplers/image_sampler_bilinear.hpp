@@ -153,6 +153,39 @@ public:
             vOut[i] = val[0] + deltay * (val[1] - val[0]);
         }
     }
+
+    /**
+     * @brief getTaps1D
+     * @return
+     */
+    int getTaps1D()
+    {
+        return 2;
+    }
+
+    /**
+     * @brief getWeights1D
+     * @param x
+     * @param n
+     * @param index
+     * @param weights
+     * @return
+     */
+    int getWeights1D(float x, int n, int *index, float *weights)
+    {
+        x = CLAMPi(x, 0.0f, 1.0f) * float(n - 1);
+
+        float xx = floorf(x);
+        float dx = x - xx;
+        int ix = int(xx);
+
+        index[0] = ix;
+        index[1] = CLAMP(ix + 1, n);
+        weights[0] = 1.0f - dx;
+        weights[1] = dx;
+
+        return 2;
+    }
 };
 
 } // end namespace pic
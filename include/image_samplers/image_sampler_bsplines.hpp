@@ -85,6 +85,39 @@ public:
             }
         }
     }
+
+    /**
+     * @brief getTaps1D
+     * @return
+     */
+    int getTaps1D()
+    {
+        return 4;
+    }
+
+    /**
+     * @brief getWeights1D
+     * @param x
+     * @param n
+     * @param index
+     * @param weights
+     * @return
+     */
+    int getWeights1D(float x, int n, int *index, float *weights)
+    {
+        x *= float(n - 1);
+
+        float xx = floorf(x);
+        float dx = x - xx;
+        int ix = int(xx);
+
+        for(int i = -1; i < 3; i++) {
+            index[i + 1] = CLAMP(ix + i, n);
+            weights[i + 1] = Rx(float(i) - dx);
+        }
+
+        return 4;
+    }
 };
 
 } // end namespace pic
@@ -101,6 +101,40 @@ public:
             }
         }
     }
+
+    /**
+     * @brief getTaps1D
+     * @return
+     */
+    int getTaps1D()
+    {
+        return a_i * 2;
+    }
+
+    /**
+     * @brief getWeights1D
+     * @param x
+     * @param n
+     * @param index
+     * @param weights
+     * @return
+     */
+    int getWeights1D(float x, int n, int *index, float *weights)
+    {
+        x *= float(n - 1);
+
+        float xx = floorf(x);
+        float dx = x - xx;
+        int ix = int(xx);
+
+        for(int i = - a_i + 1; i <= a_i; i++) {
+            int c = i + a_i - 1;
+            index[c] = CLAMP(ix + i, n);
+            weights[c] = Lanczos(dx - float(i), a);
+        }
+
+        return a_i * 2;
+    }
 };
 
 } // end namespace pic
@@ -104,6 +104,33 @@ public:
             vOut[i] = img->data[ind + i];
         }
     }
+
+    /**
+     * @brief getTaps1D
+     * @return
+     */
+    int getTaps1D()
+    {
+        return 1;
+    }
+
+    /**
+     * @brief getWeights1D
+     * @param x
+     * @param n
+     * @param index
+     * @param weights
+     * @return
+     */
+    int getWeights1D(float x, int n, int *index, float *weights)
+    {
+        x = CLAMPi(x, 0.0f, 1.0f) * float(n - 1);
+
+        index[0] = CLAMP(int(x), n);
+        weights[0] = 1.0f;
+
+        return 1;
+    }
 };
 
 } // end namespace pic
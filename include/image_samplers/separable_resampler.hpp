@@ -0,0 +1,329 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_IMAGE_SAMPLERS_SEPARABLE_RESAMPLER_HPP
+#define PIC_IMAGE_SAMPLERS_SEPARABLE_RESAMPLER_HPP
+
+#include <vector>
+
+#include "../base.hpp"
+#include "../image.hpp"
+#include "../image_samplers/image_sampler.hpp"
+
+namespace pic {
+
+/**
+ * @brief The SeparableResampler class resizes images with a separable
+ * ImageSampler. The 1D kernels of each output column and row are computed
+ * once per resize; then, each block of output rows is computed with a
+ * horizontal pass on the input rows it references, and a vertical pass on
+ * the resulting rows. Results match ImageSampler::SampleImage on the output
+ * grid (i / (width - 1), j / (height - 1)) up to floating-point rounding.
+ */
+class SeparableResampler
+{
+protected:
+    ImageSampler *isb;
+    int widthIn, heightIn, widthOut, heightOut;
+
+    int tapsX, tapsY;
+    std::vector<int> indexX, indexY;
+    std::vector<float> weightsX, weightsY;
+
+    /**
+     * @brief computeTable computes the taps of each output sample of a line.
+     * @param isb
+     * @param nIn
+     * @param nOut
+     * @param index
+     * @param weights
+     * @return It returns the number of taps per sample.
+     */
+    static int computeTable(ImageSampler *isb, int nIn, int nOut,
+                            std::vector<int> &index, std::vector<float> &weights)
+    {
+        int taps = isb->getTaps1D();
+
+        index.assign(nOut * taps, 0);
+        weights.assign(nOut * taps, 0.0f);
+
+        float inv_n1f = nOut > 1 ? 1.0f / float(nOut - 1) : 0.0f;
+
+        for(int i = 0; i < nOut; i++) {
+            int *i_index = &index[i * taps];
+            float *i_weights = &weights[i * taps];
+
+            int n = isb->getWeights1D(float(i) * inv_n1f, nIn, i_index, i_weights);
+
+            //unused taps point to the first one with a zero weight
+            for(int t = n; t < taps; t++) {
+                i_index[t] = i_index[0];
+                i_weights[t] = 0.0f;
+            }
+        }
+
+        return taps;
+    }
+
+    /**
+     * @brief horizontalPass resamples a row; channels are a template
+     * parameter for the common cases, so the inner loops are unrolled.
+     * @param src
+     * @param dst
+     * @param channels
+     */
+    template<int C>
+    void horizontalPass(float *src, float *dst, int channels)
+    {
+        if(C > 0) {
+            channels = C;
+        }
+
+        for(int i = 0; i < widthOut; i++) {
+            int *index = &indexX[i * tapsX];
+            float *weights = &weightsX[i * tapsX];
+            float *out = &dst[i * channels];
+
+            float *in = &src[index[0] * channels];
+            float w = weights[0];
+
+            for(int k = 0; k < channels; k++) {
+                out[k] = in[k] * w;
+            }
+
+            for(int t = 1; t < tapsX; t++) {
+                in = &src[index[t] * channels];
+                w = weights[t];
+
+                for(int k = 0; k < channels; k++) {
+                    out[k] += in[k] * w;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief horizontalPass
+     * @param src
+     * @param dst
+     * @param channels
+     */
+    void horizontalPass(float *src, float *dst, int channels)
+    {
+        switch(channels) {
+        case 1: {
+            horizontalPass<1>(src, dst, channels);
+        } break;
+
+        case 3: {
+            horizontalPass<3>(src, dst, channels);
+        } break;
+
+        case 4: {
+            horizontalPass<4>(src, dst, channels);
+        } break;
+
+        default: {
+            horizontalPass<0>(src, dst, channels);
+        } break;
+        }
+    }
+
+public:
+
+    /**
+     * @brief SeparableResampler
+     */
+    SeparableResampler()
+    {
+        isb = NULL;
+        widthIn = heightIn = widthOut = heightOut = -1;
+        tapsX = tapsY = 0;
+    }
+
+    /**
+     * @brief isSeparable
+     * @param isb
+     * @return It returns true if isb can be used by SeparableResampler.
+     */
+    static bool isSeparable(ImageSampler *isb)
+    {
+        if(isb == NULL) {
+            return false;
+        }
+
+        return isb->getTaps1D() > 0;
+    }
+
+    /**
+     * @brief update computes the kernels tables. They are recomputed at
+     * every call, because the parameters of isb may have changed in place;
+     * this costs O(widthOut + heightOut) kernel evaluations and the memory
+     * of the tables is reused.
+     * @param isb
+     * @param widthIn
+     * @param heightIn
+     * @param widthOut
+     * @param heightOut
+     * @return It returns true if the resampler is ready.
+     */
+    bool update(ImageSampler *isb, int widthIn, int heightIn, int widthOut,
+                int heightOut)
+    {
+        if(!isSeparable(isb) || widthIn < 1 || heightIn < 1 ||
+           widthOut < 1 || heightOut < 1) {
+            this->isb = NULL;
+            return false;
+        }
+
+        this->isb = isb;
+        this->widthIn = widthIn;
+        this->heightIn = heightIn;
+        this->widthOut = widthOut;
+        this->heightOut = heightOut;
+
+        tapsX = computeTable(isb, widthIn, widthOut, indexX, weightsX);
+        tapsY = computeTable(isb, heightIn, heightOut, indexY, weightsY);
+
+        return true;
+    }
+
+    /**
+     * @brief isValid
+     * @return
+     */
+    bool isValid()
+    {
+        return isb != NULL;
+    }
+
+    /**
+     * @brief Process resamples imgIn into imgOut; the tables have to be
+     * computed for the sizes of imgIn and imgOut with update.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(Image *imgIn, Image *imgOut)
+    {
+        if(!isValid() || imgIn == NULL || imgOut == NULL) {
+            return imgOut;
+        }
+
+        if(imgIn->width != widthIn || imgIn->height != heightIn ||
+           imgOut->width != widthOut || imgOut->height != heightOut ||
+           imgIn->channels != imgOut->channels) {
+            return imgOut;
+        }
+
+        int channels = imgIn->channels;
+        int rowSize = widthOut * channels;
+
+        int blockSize = 64;
+        int nBlocks = (heightOut + blockSize - 1) / blockSize;
+
+        for(int f = 0; f < imgOut->frames; f++) {
+            float *src = imgIn->data + CLAMP(f, imgIn->frames) * imgIn->tstride;
+            float *dst = imgOut->data + f * imgOut->tstride;
+
+            #pragma omp parallel for
+
+            for(int b = 0; b < nBlocks; b++) {
+                int j0 = b * blockSize;
+                int j1 = MIN(j0 + blockSize, heightOut);
+
+                //input rows referenced by the block
+                int r0 = heightIn;
+                int r1 = -1;
+
+                for(int i = j0 * tapsY; i < j1 * tapsY; i++) {
+                    r0 = MIN(r0, indexY[i]);
+                    r1 = MAX(r1, indexY[i]);
+                }
+
+                int nRows = r1 - r0 + 1;
+                std::vector<bool> used(nRows, false);
+
+                for(int i = j0 * tapsY; i < j1 * tapsY; i++) {
+                    used[indexY[i] - r0] = true;
+                }
+
+                //horizontal pass
+                std::vector<float> tmp(nRows * rowSize);
+
+                for(int r = 0; r < nRows; r++) {
+                    if(used[r]) {
+                        horizontalPass(&src[(r0 + r) * imgIn->ystride],
+                                       &tmp[r * rowSize], channels);
+                    }
+                }
+
+                //vertical pass
+                for(int j = j0; j < j1; j++) {
+                    int *index = &indexY[j * tapsY];
+                    float *weights = &weightsY[j * tapsY];
+                    float *out = &dst[j * imgOut->ystride];
+
+                    float *in = &tmp[(index[0] - r0) * rowSize];
+                    float w = weights[0];
+
+                    for(int i = 0; i < rowSize; i++) {
+                        out[i] = in[i] * w;
+                    }
+
+                    for(int t = 1; t < tapsY; t++) {
+                        in = &tmp[(index[t] - r0) * rowSize];
+                        w = weights[t];
+
+                        for(int i = 0; i < rowSize; i++) {
+                            out[i] += in[i] * w;
+                        }
+                    }
+                }
+            }
+        }
+
+        return imgOut;
+    }
+
+    /**
+     * @brief execute resamples imgIn to the size of imgOut.
+     * @param imgIn
+     * @param imgOut
+     * @param isb is a separable sampler.
+     * @return It returns NULL if isb is not separable.
+     */
+    static Image *execute(Image *imgIn, Image *imgOut, ImageSampler *isb)
+    {
+        if(imgIn == NULL || imgOut == NULL) {
+            return NULL;
+        }
+
+        SeparableResampler rs;
+
+        if(!rs.update(isb, imgIn->width, imgIn->height,
+                      imgOut->width, imgOut->height)) {
+            return NULL;
+        }
+
+        return rs.Process(imgIn, imgOut);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_IMAGE_SAMPLERS_SEPARABLE_RESAMPLER_HPP */
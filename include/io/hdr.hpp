@@ -28,15 +28,14 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 namespace pic {
 
 /**
- * @brief ReadHDR reads a .hdr/.pic file.
+ * @brief ReadHDRHeader opens a .hdr/.pic file and reads its header.
  * @param nameFile
- * @param data
  * @param width
  * @param height
- * @return
+ * @return It returns the file at the beginning of the scanlines,
+ * or NULL if the header is not valid.
  */
-PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
-                          int &height)
+PIC_INLINE FILE *ReadHDRHeader(std::string nameFile, int &width, int &height)
 {
     FILE *file = fopen(nameFile.c_str(), "rb");
 
@@ -50,6 +49,7 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
     fscanf(file, "%s\n", tmp);
 
     if(strcmp(tmp, "#?RADIANCE") != 0) {
+        fclose(file);
         return NULL;
     }
 
@@ -60,6 +60,7 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
             char *tmp2 = fgets(tmp, 512, file);
 
             if(tmp2 == NULL) {
+                fclose(file);
                 return NULL;
             }
 
@@ -78,6 +79,7 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
         //Properties:
         if(line.find("FORMAT") != std::string::npos) { //Format
             if(line.find("32-bit_rle_rgbe") == std::string::npos) {
+                fclose(file);
                 return NULL;
             }
         }
@@ -91,10 +93,23 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
     fscanf(file, "-Y %d +X %d", &height, &width);
     fgetc(file);
 
-    if(data == NULL) {
-        data = new float[width * height * 3];
-    }
+    return file;
+}
 
+/**
+ * @brief ReadHDRScanlines reads the scanlines of a .hdr/.pic file; each
+ * scanline is stored as RGBE in dataRGBE, and/or it is decoded as float
+ * in data.
+ * @param file
+ * @param width
+ * @param height
+ * @param dataRGBE is an array of width * height * 4 values, or NULL.
+ * @param data is an array of width * height * 3 values, or NULL.
+ * @return
+ */
+PIC_INLINE bool ReadHDRScanlines(FILE *file, int width, int height,
+                                 unsigned char *dataRGBE, float *data)
+{
     //File size
     long int s_cur = ftell(file);
     fseek(file, 0 , SEEK_END);
@@ -106,97 +121,194 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
     printf("%d %d\n", total, width * height * 4);
 #endif
 
+    int line_width3 = width * 3;
+    int line_width4 = width * 4;
+
     //Compressed?
     if(total == (width * height * 4)) { //uncompressed
-        unsigned char colRGBE[4];
+        unsigned char *buffer = dataRGBE;
 
-        int c = 0;
+        if(buffer == NULL) {
+            buffer = new unsigned char[total];
+        }
 
-        for(int i = 0; i < width; i++) {
-            for(int j = 0; j < height; j++) {
-                fread(colRGBE, 1, 4, file);
-                fromRGBEToFloat(colRGBE, &data[c]);
-                c += 3;
-            }
+        fread(buffer, sizeof(unsigned char) * total, 1, file);
+
+        //From RGBE to Float
+        if(data != NULL) {
+            convertRGBEToFloat(buffer, data, width * height, 3);
         }
-    } else { //RLE compressed
-        unsigned char *buffer = new unsigned char[total];
-        fread(buffer, sizeof(unsigned char)*total, 1, file);
 
-        int line_width3 = width * 3;
-        int line_width4 = width * 4;
+        if(buffer != dataRGBE) {
+            delete[] buffer;
+        }
 
-        unsigned char *buffer_line_start;
-        unsigned char *buffer_line = new unsigned char[line_width4];
-        int c = 4;
-        int c_buffer_line = 0;
+        return true;
+    }
 
-        //for each line
-        for(int i = 0; i < height; i++) {
-            buffer_line_start = &buffer[c - 4];
+    //RLE compressed
+    unsigned char *buffer = new unsigned char[total];
+    fread(buffer, sizeof(unsigned char)*total, 1, file);
 
-            int width_check  = buffer_line_start[2];
-            int width_check2 = buffer_line_start[3];
+    unsigned char *buffer_line_start;
+    unsigned char *buffer_line_tmp = NULL;
 
-            bool b1 = buffer_line_start[0] != 2;
-            bool b2 = buffer_line_start[1] != 2;
-            bool b3 = width_check  != (width >> 8); 
-            bool b4 = width_check2 != (width & 0xFF);
+    if(dataRGBE == NULL) {
+        buffer_line_tmp = new unsigned char[line_width4];
+    }
 
-            if(b1 || b2 || b3 || b4) {
-                #ifdef PIC_DEBUG
-                    printf("ReadHDR ERROR: the file is not a RLE encoded .hdr file.\n");
-                #endif
+    int c = 4;
 
-                fclose(file);
+    //for each line
+    for(int i = 0; i < height; i++) {
+        unsigned char *buffer_line = (dataRGBE != NULL) ?
+                                     &dataRGBE[i * line_width4] : buffer_line_tmp;
 
-                return NULL;
+        buffer_line_start = &buffer[c - 4];
+
+        int width_check  = buffer_line_start[2];
+        int width_check2 = buffer_line_start[3];
+
+        bool b1 = buffer_line_start[0] != 2;
+        bool b2 = buffer_line_start[1] != 2;
+        bool b3 = width_check  != (width >> 8);
+        bool b4 = width_check2 != (width & 0xFF);
+
+        if(b1 || b2 || b3 || b4) {
+            #ifdef PIC_DEBUG
+                printf("ReadHDR ERROR: the file is not a RLE encoded .hdr file.\n");
+            #endif
+
+            if(buffer_line_tmp != NULL) {
+                delete[] buffer_line_tmp;
             }
 
-            for(int j = 0; j < 4; j++) {
-                int k = 0;
+            delete[] buffer;
 
-                //decompression of a single channel line
-                while(k < width) {
-                    int num = buffer[c];
+            return false;
+        }
 
-                    if(num > 128) {
-                        num -= 128;
+        for(int j = 0; j < 4; j++) {
+            int k = 0;
 
-                        for(int l = k; l < (k + num); l++) {
-                            buffer_line[l * 4 + j] = buffer[c + 1];
-                        }
+            //decompression of a single channel line
+            while(k < width) {
+                int num = buffer[c];
 
-                        c += 2;
-                        k += num;
-                    } else {
-                        for(int l = 0; l < num; l++) {
-                            buffer_line[(l + k) * 4 + j] = buffer[c + 1 + l];
-                        }
+                if(num > 128) {
+                    num -= 128;
 
-                        c += num + 1;
-                        k += num;
+                    for(int l = k; l < (k + num); l++) {
+                        buffer_line[l * 4 + j] = buffer[c + 1];
+                    }
+
+                    c += 2;
+                    k += num;
+                } else {
+                    for(int l = 0; l < num; l++) {
+                        buffer_line[(l + k) * 4 + j] = buffer[c + 1 + l];
                     }
-                }
-            }
 
-            //From RGBE to Float
-            for(int j = 0; j < width; j++) {
-                fromRGBEToFloat(&buffer_line[j * 4], &data[c_buffer_line + j * 3]);
+                    c += num + 1;
+                    k += num;
+                }
             }
+        }
 
-            c += 4;
-            c_buffer_line += line_width3;
+        //From RGBE to Float
+        if(data != NULL) {
+            convertRGBEToFloat(buffer_line, &data[i * line_width3], width, 3);
         }
 
-        delete[] buffer_line;
-        delete[] buffer;
+        c += 4;
+    }
+
+    if(buffer_line_tmp != NULL) {
+        delete[] buffer_line_tmp;
     }
 
+    delete[] buffer;
+
+    return true;
+}
+
+/**
+ * @brief ReadHDR reads a .hdr/.pic file.
+ * @param nameFile
+ * @param data
+ * @param width
+ * @param height
+ * @return
+ */
+PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
+                          int &height)
+{
+    FILE *file = ReadHDRHeader(nameFile, width, height);
+
+    if(file == NULL) {
+        return NULL;
+    }
+
+    bool bAllocated = (data == NULL);
+
+    if(bAllocated) {
+        data = new float[width * height * 3];
+    }
+
+    bool bRet = ReadHDRScanlines(file, width, height, NULL, data);
+
     fclose(file);
+
+    if(!bRet) {
+        if(bAllocated) {
+            delete[] data;
+        }
+
+        return NULL;
+    }
+
     return data;
 }
 
+/**
+ * @brief ReadHDRRGBE reads a .hdr/.pic file keeping the RGBE encoding;
+ * i.e., without decoding its values as float.
+ * @param nameFile
+ * @param dataRGBE
+ * @param width
+ * @param height
+ * @return It returns an array of width * height * 4 values.
+ */
+PIC_INLINE unsigned char *ReadHDRRGBE(std::string nameFile, unsigned char *dataRGBE,
+                                      int &width, int &height)
+{
+    FILE *file = ReadHDRHeader(nameFile, width, height);
+
+    if(file == NULL) {
+        return NULL;
+    }
+
+    bool bAllocated = (dataRGBE == NULL);
+
+    if(bAllocated) {
+        dataRGBE = new unsigned char[width * height * 4];
+    }
+
+    bool bRet = ReadHDRScanlines(file, width, height, dataRGBE, NULL);
+
+    fclose(file);
+
+    if(!bRet) {
+        if(bAllocated) {
+            delete[] dataRGBE;
+        }
+
+        return NULL;
+    }
+
+    return dataRGBE;
+}
+
 /**
  * @brief WriteLineHDR writes a scanline of an image using RLE and RGBE encoding.
  * @param file
@@ -218,6 +330,11 @@ PIC_INLINE void WriteLineHDR(FILE *file, unsigned char *buffer_line, int width)
             run_start += run_length;
             run_length_old = run_length;
 
+            if(run_start >= width) {
+                run_length = 0;
+                break;
+            }
+
             int start = (run_start + 1);
             int end = MIN(run_start + 127, width); 
             unsigned char tmp = buffer_line[run_start];
@@ -274,6 +391,69 @@ PIC_INLINE void WriteLineHDR(FILE *file, unsigned char *buffer_line, int width)
     }
 }
 
+/**
+ * @brief WriteHDRHeader writes the header of a .hdr/.pic file.
+ * @param file
+ * @param width
+ * @param height
+ * @param appliedExposure
+ */
+PIC_INLINE void WriteHDRHeader(FILE *file, int width, int height,
+                               float appliedExposure = 1.0f)
+{
+    fprintf(file, "#?RADIANCE\n");
+    fprintf(file, "#Spiced by Piccante\n");
+    fprintf(file, "FORMAT=32-bit_rle_rgbe\n");
+    fprintf(file, "EXPOSURE= %f\n\n", appliedExposure);
+    fprintf(file, "-Y %d +X %d\n", height, width);
+}
+
+/**
+ * @brief WriteHDRScanline writes a scanline of RGBE pixels.
+ * @param file
+ * @param line_rgbe is an array of width * 4 values.
+ * @param width
+ * @param bRLE
+ * @param buffer_line is a buffer of width * 4 values, which is used
+ * when bRLE is true.
+ */
+PIC_INLINE void WriteHDRScanline(FILE *file, unsigned char *line_rgbe, int width,
+                                 bool bRLE, unsigned char *buffer_line)
+{
+    if(!bRLE) {
+        fwrite(line_rgbe, sizeof(unsigned char), width * 4, file);
+        return;
+    }
+
+    //new line start "header"
+    unsigned char buffer_line_start[4];
+    buffer_line_start[0] = 2;
+    buffer_line_start[1] = 2;
+    buffer_line_start[2] = width >> 8;
+    buffer_line_start[3] = width & 0xFF;
+
+    int width2 = width * 2;
+    int width3 = width * 3;
+
+    //splitting the line into its four components
+    for(int j = 0; j < width; j++) {
+        unsigned char *buffer_rgbe = &line_rgbe[j * 4];
+
+        buffer_line[         j] = buffer_rgbe[0];
+        buffer_line[width  + j] = buffer_rgbe[1];
+        buffer_line[width2 + j] = buffer_rgbe[2];
+        buffer_line[width3 + j] = buffer_rgbe[3];
+    }
+
+    //Here a new line start
+    fwrite(buffer_line_start, sizeof(unsigned char)*4, 1, file);
+
+    //RLE encoding for each line
+    for(int j=0; j<4; j++) {
+        WriteLineHDR(file, &buffer_line[j * width], width);
+    }
+}
+
 /**
  * @brief WriteHDR  writes a .hdr/.pic file
  * @param nameFile
@@ -293,92 +473,82 @@ PIC_INLINE bool WriteHDR(std::string nameFile, float *data, int width,
     if(data==NULL) {
         return false;
     }
-    
-    file = fopen(nameFile.c_str(), "wb");
 
-    if( file == NULL) {
+    if((channels == 2) || (channels < 1)) {
         return false;
     }
 
-    if((channels == 2) || (channels == 0)) {
+    file = fopen(nameFile.c_str(), "wb");
+
+    if( file == NULL) {
         return false;
     }
 
     //writing the header...
-    fprintf(file, "#?RADIANCE\n");
-    fprintf(file, "#Spiced by Piccante\n");
-    fprintf(file, "FORMAT=32-bit_rle_rgbe\n");
-    fprintf(file, "EXPOSURE= %f\n\n", appliedExposure);
-    fprintf(file, "-Y %d +X %d\n", height, width);
+    WriteHDRHeader(file, width, height, appliedExposure);
 
     //RLE encoding is not allowed in some cases
     if(((width < 8) || (width > 32767)) && bRLE) {
         bRLE = false;
     }
 
-    if(bRLE) {
-        //buffers
-        unsigned char *buffer_line = new unsigned char[width * 4];
-        unsigned char buffer_rgbe[4];
-        unsigned char buffer_line_start[4];
+    //buffers
+    unsigned char *line_rgbe = new unsigned char[width * 4];
+    unsigned char *buffer_line = new unsigned char[width * 4];
 
-        //new line start "header"
-        buffer_line_start[0] = 2;
-        buffer_line_start[1] = 2;
-        buffer_line_start[2] = width >> 8;
-        buffer_line_start[3] = width & 0xFF;
+    for(int i = 0; i < height; i++) {
+        //Converting the line data into the RGBE format
+        convertFloatToRGBE(&data[i * width * channels], line_rgbe, width, channels);
 
-        int width2 = width * 2;
-        int width3 = width * 3;
-
-        for(int i=0; i<height; i++) {
-            int ind = i * width;
+        WriteHDRScanline(file, line_rgbe, width, bRLE, buffer_line);
+    }
 
-            //Converting the line data into the RGBE format
-            for(int j = 0; j < width; j++) {
-                int ind2 = (ind + j) * channels;
+    delete[] buffer_line;
+    delete[] line_rgbe;
 
-                if(channels == 1) {
-                    fromSingleFloatToRGBE(&data[ind2], buffer_rgbe);
-                } else {
-                    fromFloatToRGBE(&data[ind2], buffer_rgbe);
-                }
+    fclose(file);
+    return true;
+}
 
-                buffer_line[         j] = buffer_rgbe[0];
-                buffer_line[width  + j] = buffer_rgbe[1];
-                buffer_line[width2 + j] = buffer_rgbe[2];
-                buffer_line[width3 + j] = buffer_rgbe[3];
-            }
+/**
+ * @brief WriteHDRRGBE writes a .hdr/.pic file from RGBE values;
+ * i.e., without encoding float values.
+ * @param nameFile
+ * @param dataRGBE is an array of width * height * 4 values.
+ * @param width
+ * @param height
+ * @param appliedExposure
+ * @param bRLE
+ * @return
+ */
+PIC_INLINE bool WriteHDRRGBE(std::string nameFile, unsigned char *dataRGBE, int width,
+                             int height, float appliedExposure = 1.0f, bool bRLE = true)
+{
+    if(dataRGBE == NULL) {
+        return false;
+    }
 
-            //Here a new line start
-            fwrite(buffer_line_start, sizeof(unsigned char)*4, 1, file);
+    FILE *file = fopen(nameFile.c_str(), "wb");
 
-            //RLE encoding for each line
-            for(int j=0; j<4; j++) {
-                WriteLineHDR(file, &buffer_line[j * width], width);
-            }
-        }
+    if(file == NULL) {
+        return false;
+    }
 
-    } else {
-        unsigned char colRGBE[4];
-        for(int j = 0; j < height; j++) {
-            int ind = j * width;
+    WriteHDRHeader(file, width, height, appliedExposure);
 
-            for(int i = 0; i < width; i++) {
-                int c = (ind + i);
+    //RLE encoding is not allowed in some cases
+    if(((width < 8) || (width > 32767)) && bRLE) {
+        bRLE = false;
+    }
 
-                if(channels == 3) {
-                    c *= 3;
-                    fromFloatToRGBE(&data[c], colRGBE);
-                } else {
-                    fromSingleFloatToRGBE(&data[c], colRGBE);
-                }
+    unsigned char *buffer_line = new unsigned char[width * 4];
 
-                fwrite(colRGBE, 1, 4 * sizeof(unsigned char), file);
-            }
-        }
+    for(int i = 0; i < height; i++) {
+        WriteHDRScanline(file, &dataRGBE[i * width * 4], width, bRLE, buffer_line);
     }
 
+    delete[] buffer_line;
+
     fclose(file);
     return true;
 }
@@ -427,25 +597,18 @@ PIC_INLINE bool WriteHDRBlock(std::string nameFile, float *buffer_line, int widt
     fprintf(file, "EXPOSURE= 1.0\n\n");
     fprintf(file, "-Y %d +X %d\n", height, blockWidth);
 
-    unsigned char colRGBE[4];
+    unsigned char *line_rgbe = new unsigned char[blockWidth * 4];
 
     for(int j = 0; j < height; j++) {
-        int ind = j * width;
+        int c = (j * width + xStart) * channels;
 
-        for(int i = xStart; i < xEnd; i++) {
-            int c = (ind + i);
+        convertFloatToRGBE(&buffer_line[c], line_rgbe, blockWidth, channels);
 
-            if(channels == 3) {
-                c *= 3;
-                fromFloatToRGBE(&buffer_line[c], colRGBE);
-            } else {
-                fromSingleFloatToRGBE(&buffer_line[c], colRGBE);
-            }
-
-            fwrite(colRGBE, 1, 4 * sizeof(unsigned char), file);
-        }
+        fwrite(line_rgbe, 1, blockWidth * 4 * sizeof(unsigned char), file);
     }
 
+    delete[] line_rgbe;
+
     fclose(file);
     return true;
 }
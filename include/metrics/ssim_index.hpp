@@ -29,6 +29,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../filtering/filter_gaussian_2d.hpp"
 #include "../filtering/filter_downsampler_2d.hpp"
 #include "../filtering/filter_ssim.hpp"
+#include "../util/summed_area_table.hpp"
 
 namespace pic {
 
@@ -43,10 +44,14 @@ namespace pic {
  * @param sigma_window
  * @param dynamic_range
  * @param bDownsampling
+ * @param box_radius is the radius of a box window; when it is positive, it
+ * replaces the Gaussian window and statistics are computed with a summed-area
+ * table in O(1) per pixel.
  * @return
  */
 PIC_INLINE Image* SSIMIndex(Image *ori, Image *cmp, float &ssim_index, Image *ssim_map = NULL, float K0 = 0.01f, float K1 = 0.03f,
-                 float sigma_window = 1.5f, float dynamic_range = -1.0f, bool bDownsampling = false)
+                 float sigma_window = 1.5f, float dynamic_range = -1.0f, bool bDownsampling = false,
+                 int box_radius = -1)
 {
     if(ori == NULL || cmp == NULL) {
         return NULL;
@@ -103,19 +108,59 @@ PIC_INLINE Image* SSIMIndex(Image *ori, Image *cmp, float &ssim_index, Image *ss
     float C1 = K1 * dynamic_range;
     C1 = C1 * C1;
 
-    Image *img_mu1 = FilterGaussian2D::Execute(L_ori, NULL, sigma_window);
-    Image *img_mu2 = FilterGaussian2D::Execute(L_cmp, NULL, sigma_window);
+    if(box_radius > 0) {
+        //moments: L_ori, L_cmp, L_ori^2, L_cmp^2, L_ori * L_cmp
+        Image moments(L_ori->width, L_ori->height, 5);
 
-    Image img_ori_cmp = (*L_ori) * (*L_cmp);
+        int n = L_ori->nPixels();
 
-    (*L_ori) *= (*L_ori);
-    (*L_cmp) *= (*L_cmp);
+        #pragma omp parallel for
 
-    Image *img_sigma1_sq = FilterGaussian2D::Execute(L_ori, NULL, sigma_window);
-    Image *img_sigma2_sq = FilterGaussian2D::Execute(L_cmp, NULL, sigma_window);
-    Image *img_sigma1_sigma2 = FilterGaussian2D::Execute(&img_ori_cmp, NULL, sigma_window);
+        for(int i = 0; i < n; i++) {
+            float v1 = L_ori->data[i];
+            float v2 = L_cmp->data[i];
+            float *out = &moments.data[i * 5];
+
+            out[0] = v1;
+            out[1] = v2;
+            out[2] = v1 * v1;
+            out[3] = v2 * v2;
+            out[4] = v1 * v2;
+        }
+
+        SummedAreaTable sat(&moments, box_radius);
+
+        if(ssim_map == NULL) {
+            ssim_map = L_ori->allocateSimilarOne();
+        }
+
+        #pragma omp parallel for
+
+        for(int j = 0; j < L_ori->height; j++) {
+            double m[5];
+
+            for(int i = 0; i < L_ori->width; i++) {
+                sat.getMean(i - box_radius, j - box_radius,
+                            i + box_radius + 1, j + box_radius + 1, m);
+
+                (*ssim_map)(i, j)[0] = FilterSSIM::getSSIM(float(m[0]), float(m[1]),
+                                                            float(m[2]), float(m[3]),
+                                                            float(m[4]), C0, C1);
+            }
+        }
+    } else {
+        Image *img_mu1 = FilterGaussian2D::Execute(L_ori, NULL, sigma_window);
+        Image *img_mu2 = FilterGaussian2D::Execute(L_cmp, NULL, sigma_window);
+
+        Image img_ori_cmp = (*L_ori) * (*L_cmp);
+
+        (*L_ori) *= (*L_ori);
+        (*L_cmp) *= (*L_cmp);
+
+        Image *img_sigma1_sq = FilterGaussian2D::Execute(L_ori, NULL, sigma_window);
+        Image *img_sigma2_sq = FilterGaussian2D::Execute(L_cmp, NULL, sigma_window);
+        Image *img_sigma1_sigma2 = FilterGaussian2D::Execute(&img_ori_cmp, NULL, sigma_window);
 
-    if(C0 > 0.0f && C1 > 0.0f) {
         FilterSSIM flt_ssim(C0, C1);
 
         ImageVec src;
@@ -126,8 +171,18 @@ PIC_INLINE Image* SSIMIndex(Image *ori, Image *cmp, float &ssim_index, Image *ss
         src.push_back(img_sigma1_sigma2);
 
         ssim_map = flt_ssim.ProcessP(src, ssim_map);
-    } else {
 
+        for(unsigned int i = 0; i < src.size(); i++) {
+            delete src[i];
+        }
+    }
+
+    delete L_ori;
+    delete L_cmp;
+
+    if(ori_d != NULL) {
+        delete ori_d;
+        delete cmp_d;
     }
 
     ssim_map->getMeanVal(NULL, &ssim_index);
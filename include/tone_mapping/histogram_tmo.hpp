@@ -40,16 +40,18 @@ PIC_INLINE Image *HistogramTMO(Image *imgOut, Image *imgIn)
 
     Image *lum    = FilterLuminance::Execute(imgIn, NULL, LT_CIE_LUMINANCE);	//Luminance
     Image *lumOld = lum->clone();
-    lum->sort();
 
     int size = lum->width * lum->height * lum->frames;
 
     float table[257];
+    float perCent[256];
 
     for(int i = 1; i <= 256; i++) {
-        table[i] = lum->getPercentileVal(float(i) / 256.0f);
+        perCent[i - 1] = float(i) / 256.0f;
     }
 
+    lum->getPercentileVals(perCent, 256, &table[1]);
+
     table[0] = lum->getMinVal()[0];
 
     std::vector<float> v(table, table + 257);
@@ -46,9 +46,12 @@ PIC_INLINE Image *LischinskiTMO(Image *imgIn, Image *imgOut = NULL, float alpha
     FilterLuminance fltLum;
     Image *lum = fltLum.ProcessP(Single(imgIn), NULL);
 
-    float maxL = lum->getMaxVal()[0];
-    float minL = lum->getMinVal()[0];
-    float Lav = lum->getLogMeanVal()[0];
+    ImageStatistics stats;
+    lum->getStatistics(IS_MIN | IS_MAX | IS_LOG_MEAN, NULL, &stats);
+
+    float maxL = stats.maxVal[0];
+    float minL = stats.minVal[0];
+    float Lav = stats.logMeanVal[0];
     float maxL_log = log2fPlusEpsilon(maxL);
     float minL_log = log2fPlusEpsilon(minL);
 
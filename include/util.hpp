@@ -48,6 +48,10 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "util/image_sampler.hpp"
 #include "util/io.hpp"
 #include "util/math.hpp"
+#include "util/order_statistics.hpp"
+#include "util/summed_area_table.hpp"
+#include "util/warp_map.hpp"
+#include "util/running_min_max.hpp"
 #include "util/polynomial.hpp"
 #include "util/matrix_3_x_3.hpp"
 #include "util/eigen_util.hpp"
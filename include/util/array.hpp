@@ -88,6 +88,24 @@ public:
         return sqrtf(norm);
     }
 
+    /**
+     * @brief dot
+     * @param a0
+     * @param a1
+     * @param n
+     * @return
+     */
+    static inline T dot(T *a0, T *a1, int n)
+    {
+        T out = T(0);
+
+        for(int k = 0; k < n; k++) {
+            out += a0[k] * a1[k];
+        }
+
+        return out;
+    }
+
     /**
      * @brief distanceSq
      * @param a0
@@ -0,0 +1,128 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_IMAGE_STATISTICS_HPP
+#define PIC_UTIL_IMAGE_STATISTICS_HPP
+
+#include "../base.hpp"
+
+namespace pic {
+
+/**
+ * @brief The IMAGE_STATISTICS enum lists the reductions that can be
+ * computed in a single pass; values can be combined with a bitwise or.
+ */
+enum IMAGE_STATISTICS {IS_MIN = 1, IS_MAX = 2, IS_SUM = 4, IS_MEAN = 8,
+                       IS_LOG_MEAN = 16, IS_VARIANCE = 32, IS_COV_MTX = 64};
+
+/**
+ * @brief kahanAdd adds a value to a sum using Kahan compensated summation.
+ * @param sum
+ * @param c is the running compensation.
+ * @param val
+ */
+inline void kahanAdd(double &sum, double &c, double val)
+{
+    double y = val - c;
+    double t = sum + y;
+    c = (t - sum) - y;
+    sum = t;
+}
+
+/**
+ * @brief The ImageStatistics class stores per-channel reductions of an Image;
+ * only buffers of requested statistics are allocated.
+ */
+class ImageStatistics
+{
+protected:
+
+    /**
+     * @brief allocateBuffer
+     * @param buffer
+     * @param n
+     * @param bAllocate
+     */
+    void allocateBuffer(float *&buffer, int n, bool bAllocate)
+    {
+        if(buffer != NULL) {
+            delete[] buffer;
+            buffer = NULL;
+        }
+
+        if(bAllocate) {
+            buffer = new float[n];
+        }
+    }
+
+public:
+    int flags, channels;
+    int count;
+
+    float *minVal, *maxVal, *sumVal, *meanVal, *logMeanVal;
+    float *varianceVal, *covMtxVal;
+
+    /**
+     * @brief ImageStatistics
+     */
+    ImageStatistics()
+    {
+        flags = 0;
+        channels = 0;
+        count = 0;
+
+        minVal = NULL;
+        maxVal = NULL;
+        sumVal = NULL;
+        meanVal = NULL;
+        logMeanVal = NULL;
+        varianceVal = NULL;
+        covMtxVal = NULL;
+    }
+
+    ~ImageStatistics()
+    {
+        allocate(0, 0);
+    }
+
+    /**
+     * @brief allocate allocates buffers for a set of statistics.
+     * @param channels is the number of color channels.
+     * @param flags is a combination of IMAGE_STATISTICS values.
+     */
+    void allocate(int channels, int flags)
+    {
+        if((this->channels == channels) && (this->flags == flags)) {
+            return;
+        }
+
+        this->channels = channels;
+        this->flags = flags;
+
+        allocateBuffer(minVal, channels, (flags & IS_MIN) != 0);
+        allocateBuffer(maxVal, channels, (flags & IS_MAX) != 0);
+        allocateBuffer(sumVal, channels, (flags & IS_SUM) != 0);
+        allocateBuffer(meanVal, channels, (flags & IS_MEAN) != 0);
+        allocateBuffer(logMeanVal, channels, (flags & IS_LOG_MEAN) != 0);
+        allocateBuffer(varianceVal, channels, (flags & IS_VARIANCE) != 0);
+        allocateBuffer(covMtxVal, channels * channels, (flags & IS_COV_MTX) != 0);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_IMAGE_STATISTICS_HPP */
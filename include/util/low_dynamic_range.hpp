@@ -18,6 +18,10 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_UTIL_LOW_DYNAMIC_RANGE_HPP
 #define PIC_UTIL_LOW_DYNAMIC_RANGE_HPP
 
+#include <math.h>
+#include <string.h>
+#include <vector>
+
 #include "../base.hpp"
 
 namespace pic {
@@ -47,6 +51,122 @@ PIC_INLINE bool checkNormalized(const float *data, int size, float delta = 1e-6f
     return true;
 }
 
+/**
+ * @brief The LDREncoder class quantizes float values into 8-bit with gamma
+ * correction and correct rounding, without evaluating powf per value.
+ * thresholds[k] is the smallest float that is mapped to k; a table of about
+ * 4K entries, indexed by the exponent and the leading bits of the mantissa,
+ * gives the code at the beginning of each bucket, and it is refined with
+ * (typically one) comparison.
+ */
+class LDREncoder
+{
+protected:
+    float thresholds[257];
+    std::vector<unsigned char> base;
+    int bitsLow, shift, nBuckets;
+
+public:
+
+    /**
+     * @brief LDREncoder
+     * @param gamma
+     */
+    LDREncoder(float gamma)
+    {
+        if(gamma <= 0.0f) {
+            gamma = 2.2f;
+        }
+
+        //k is the output for values in [thresholds[k], thresholds[k + 1])
+        thresholds[0] = 0.0f;
+        for(int k = 1; k < 256; k++) {
+            double th = pow((double(k) - 0.5) / 255.0, double(gamma));
+            float th_f = float(th);
+
+            if(double(th_f) < th) {
+                th_f = nextafterf(th_f, 2.0f);
+            }
+
+            thresholds[k] = th_f;
+        }
+        thresholds[256] = FLT_MAX;
+
+        //buckets cover [2^e, 1] where 2^e <= thresholds[1]
+        int e;
+        frexpf(thresholds[1], &e);
+        e = MAX(e - 1, -125);
+        int nOctaves = -e;
+
+        float low = ldexpf(1.0f, e);
+        memcpy(&bitsLow, &low, sizeof(float));
+
+        int mantissaBits = 0;
+        while((mantissaBits < 23) && ((nOctaves << (mantissaBits + 1)) <= 4096)) {
+            mantissaBits++;
+        }
+
+        shift = 23 - mantissaBits;
+        nBuckets = (nOctaves << mantissaBits) + 1;
+
+        base.resize(nBuckets);
+
+        int k = 0;
+        for(int i = 0; i < nBuckets; i++) {
+            int bits = bitsLow + (i << shift);
+            float x;
+            memcpy(&x, &bits, sizeof(float));
+
+            while(x >= thresholds[k + 1]) {
+                k++;
+            }
+
+            base[i] = k;
+        }
+    }
+
+    /**
+     * @brief encode
+     * @param x
+     * @return It returns round(255 * x^(1 / gamma)) clamped in [0, 255];
+     * NaN is mapped to 0.
+     */
+    inline unsigned char encode(float x) const
+    {
+        x = (x > 0.0f) ? x : 0.0f;
+        x = (x < 1.0f) ? x : 1.0f;
+
+        int bits;
+        memcpy(&bits, &x, sizeof(float));
+
+        int index = (bits > bitsLow) ? ((bits - bitsLow) >> shift) : 0;
+        index = MIN(index, nBuckets - 1);
+
+        int k = base[index];
+        while(x >= thresholds[k + 1]) {
+            k++;
+        }
+
+        return (unsigned char) k;
+    }
+};
+
+/**
+ * @brief roundToLDR rounds a value to the nearest integer in [0, 255], with
+ * halves rounded up as lround; NaN is mapped to 0.
+ * @param x
+ * @return
+ */
+PIC_INLINE unsigned char roundToLDR(float x)
+{
+    x = (x > 0.0f) ? x : 0.0f;
+    x = (x < 255.0f) ? x : 255.0f;
+
+    int i = int(x);
+    i += (x - float(i)) >= 0.5f ? 1 : 0;
+    return (unsigned char) i;
+}
+
 /**
  * @brief convertLDR2HDR converts a buffer of unsigned char into float.
  * @param dataIn
@@ -90,6 +210,7 @@ PIC_INLINE float *convertLDR2HDR(unsigned char *dataIn, float *dataOut,
     }
 
     #pragma omp parallel for
+
     for(int i = 0; i < size; i++) {
         dataOut[i] = LUT[dataIn[i]];
     }
@@ -117,35 +238,33 @@ PIC_INLINE unsigned char *convertHDR2LDR(const float *dataIn, unsigned char *dat
         dataOut = new unsigned char[size];
     }
 
-    if(gamma <= 0.0f) {
-        gamma = 2.2f;
-    }
-
-    float invGamma = 1.0f / gamma;
-
     switch(type) {
 
     case LT_NONE: {//simple cast
         #pragma omp parallel for
+
         for(int i = 0; i < size; i++) {
-            dataOut[i] = CLAMPi(int(lround(dataIn[i])), 0, 255);
+            dataOut[i] = roundToLDR(dataIn[i]);
         }
     }
     break;
 
     case LT_NOR: {//convert into 8-bit
         #pragma omp parallel for
+
         for(int i = 0; i < size; i++) {
-            dataOut[i] = CLAMPi(int(lround(dataIn[i] * 255.0f)), 0, 255);
+            dataOut[i] = roundToLDR(dataIn[i] * 255.0f);
         }
     }
     break;
 
     case LT_NOR_GAMMA: {//convert into 8-bit + GAMMA correction application
+        LDREncoder encoder(gamma);
+
         #pragma omp parallel for
+
         for(int i = 0; i < size; i++) {
-            float tmp = powf(dataIn[i], invGamma);
-            dataOut[i] = CLAMPi(int(lround(tmp * 255.0f)), 0, 255);
+            dataOut[i] = encoder.encode(dataIn[i]);
         }
     }
     break;
@@ -21,6 +21,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <math.h>
 #include <random>
 #include <stdlib.h>
+#include <string.h>
 #include <set>
 
 #include "../base.hpp"
@@ -378,6 +379,156 @@ PIC_INLINE float pow2f(float x)
     return powf(2.0f, x);
 }
 
+/**
+ * @brief fastLog2f approximates log2 without branches, so loops calling it
+ * are vectorized by the compiler. The mantissa is reduced to [0.75, 1.5) and
+ * log2(1 + t) is a polynomial of degree 8; the absolute error is below 3e-7
+ * for positive normal values.
+ * @param x
+ * @return
+ */
+PIC_INLINE float fastLog2f(float x)
+{
+    int bits;
+    memcpy(&bits, &x, sizeof(float));
+
+    //exponent such that the mantissa is in [0.75, 1.5); 0x3f400000 is 0.75
+    int e = (bits - 0x3f400000) >> 23;
+    bits -= e * (1 << 23);
+
+    float m;
+    memcpy(&m, &bits, sizeof(float));
+    float t = m - 1.0f;
+
+    float q = -0.09389609669931523f;
+    q = q * t + 0.20207658836431625f;
+    q = q * t - 0.25041443172181166f;
+    q = q * t + 0.29026451574003287f;
+    q = q * t - 0.3603682917720665f;
+    q = q * t + 0.4808426650506742f;
+    q = q * t - 0.721350080407657f;
+    q = q * t + 1.4426952719544248f;
+
+    return float(e) + t * q;
+}
+
+/**
+ * @brief fastPow2f approximates 2^x without branches. x is rounded with the
+ * float magic number 1.5 * 2^23, and 2^f for f in [-0.5, 0.5] is a polynomial
+ * of degree 5; clamping is done on integers, so there are neither float-to-int
+ * conversions nor float selects and loops are vectorized by the compiler.
+ * The relative error is below 3e-7; x is clamped to [-125.5, 127.5].
+ * @param x
+ * @return
+ */
+PIC_INLINE float fastPow2f(float x)
+{
+    //the low bits of t are the integer nearest to x; 0x4b400000 is 1.5 * 2^23
+    float t = x + 12582912.0f;
+    unsigned int ut;
+    memcpy(&ut, &t, sizeof(float));
+    int i = int(ut - 0x4b400000u);
+
+    //clamping |f| to 0.5 for large values of x
+    float f = x - float(i);
+    int fb;
+    memcpy(&fb, &f, sizeof(float));
+    int fm = fb & 0x7fffffff;
+    fb = fm > 0x3f000000 ? ((fb ^ fm) | 0x3f000000) : fb;
+    memcpy(&f, &fb, sizeof(float));
+
+    i = i < -125 ? -125 : i;
+    i = i > 127 ? 127 : i;
+
+    float p = 0.0013390863364533504f;
+    p = p * f + 0.009676031918326564f;
+    p = p * f + 0.05550357114219461f;
+    p = p * f + 0.24022107485308208f;
+    p = p * f + 0.6931471880262287f;
+    p = p * f + 1.0000000754548972f;
+
+    int bits;
+    memcpy(&bits, &p, sizeof(float));
+    bits += i * (1 << 23);
+    memcpy(&p, &bits, sizeof(float));
+
+    return p;
+}
+
+/**
+ * @brief fastPowf approximates x^y as 2^(y * log2(x)) for x > 0; it returns
+ * 0 for x = 0. The relative error is about 2e-7 * (1 + |y * log2(x)|).
+ * @param x
+ * @param y
+ * @return
+ */
+PIC_INLINE float fastPowf(float x, float y)
+{
+    float ret = fastPow2f(y * fastLog2f(x));
+
+    int bits;
+    memcpy(&bits, &ret, sizeof(float));
+    bits &= -int(x > 0.0f);
+    memcpy(&ret, &bits, sizeof(float));
+
+    return ret;
+}
+
+/**
+ * @brief fastLogf approximates the natural logarithm; see fastLog2f.
+ * @param x
+ * @return
+ */
+PIC_INLINE float fastLogf(float x)
+{
+    return fastLog2f(x) * C_LOG_NAT_2;
+}
+
+/**
+ * @brief fastExpf approximates the exponential; see fastPow2f.
+ * @param x
+ * @return
+ */
+PIC_INLINE float fastExpf(float x)
+{
+    return fastPow2f(x * C_INV_LOG_NAT_2);
+}
+
+/**
+ * @brief fastCbrtf approximates the cubic root with an initial guess from
+ * the exponent bits and three Newton iterations; the relative error is
+ * below 2e-7 for normal values.
+ * @param x
+ * @return
+ */
+PIC_INLINE float fastCbrtf(float x)
+{
+    int bits;
+    memcpy(&bits, &x, sizeof(float));
+
+    int sign = bits & ~0x7fffffff;
+    bits &= 0x7fffffff;
+
+    float ax;
+    memcpy(&ax, &bits, sizeof(float));
+
+    bits = bits / 3 + 0x2a5137a0;
+
+    float y;
+    memcpy(&y, &bits, sizeof(float));
+
+    y = (2.0f * y + ax / (y * y)) * (1.0f / 3.0f);
+    y = (2.0f * y + ax / (y * y)) * (1.0f / 3.0f);
+    y = (2.0f * y + ax / (y * y)) * (1.0f / 3.0f);
+
+    memcpy(&bits, &y, sizeof(float));
+    bits &= -int(ax > 0.0f);
+    bits |= sign;
+    memcpy(&y, &bits, sizeof(float));
+
+    return y;
+}
+
 /**
  * @brief powint computes power function for integer values.
  * @param x is the base.
@@ -395,6 +546,41 @@ PIC_INLINE int powint(int x, int b)
     return ret;
 }
 
+/**
+ * @brief popcount counts the number of bits set to 1 in a 32-bit word.
+ * On GCC and clang this maps to the hardware instruction when available.
+ * @param x is a 32-bit unsigned integer.
+ * @return It returns the number of bits set to 1 in x.
+ */
+PIC_INLINE unsigned int popcount(unsigned int x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int) __builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    x = (x + (x >> 4)) & 0x0F0F0F0Fu;
+    return (x * 0x01010101u) >> 24;
+#endif
+}
+
+/**
+ * @brief popcount64 counts the number of bits set to 1 in a 64-bit word.
+ * @param x is a 64-bit unsigned integer.
+ * @return It returns the number of bits set to 1 in x.
+ */
+PIC_INLINE unsigned int popcount64(unsigned long long x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int) __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (unsigned int) ((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
 /**
  * @brief getRandomPermutation computes a random permutation.
  * @param m is a Mersenne Twister random number generator.
@@ -415,6 +601,7 @@ PIC_INLINE void getRandomPermutation(std::mt19937 &m, unsigned int *perm, int nP
         tmp = m() % n;
 
         if(checker.find(tmp) == checker.end()) {
+            checker.insert(tmp);
             perm[index] = tmp;
             index++;
         }
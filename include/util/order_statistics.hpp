@@ -0,0 +1,408 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_ORDER_STATISTICS_HPP
+#define PIC_UTIL_ORDER_STATISTICS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+#include "../base.hpp"
+#include "../util/math.hpp"
+#include "../util/std_util.hpp"
+
+namespace pic {
+
+/**
+ * @brief getPercentileIndex computes the index of a percentile in a sorted
+ * array of n values.
+ * @param n is the number of values.
+ * @param perCent is the percentile in [0, 1].
+ * @return It returns the index of the percentile.
+ */
+PIC_INLINE int getPercentileIndex(int n, float perCent)
+{
+    int index = MIN(int(perCent * float(n - 1)), n - 1);
+    return MAX(index, 0);
+}
+
+/**
+ * @brief getMinMaxParallel computes the minimum and the maximum value
+ * of an array.
+ * @param data
+ * @param n
+ * @param minVal
+ * @param maxVal
+ */
+PIC_INLINE void getMinMaxParallel(float *data, int n, float &minVal, float &maxVal)
+{
+    int nBands = MAX(MIN(getNumberOfThreads(), n >> 16), 1);
+
+    std::vector<float> bandMin(nBands, FLT_MAX);
+    std::vector<float> bandMax(nBands, -FLT_MAX);
+
+    #pragma omp parallel for
+
+    for(int b = 0; b < nBands; b++) {
+        int i0 = int((long long)(n) * b / nBands);
+        int i1 = int((long long)(n) * (b + 1) / nBands);
+
+        float tMin = FLT_MAX;
+        float tMax = -FLT_MAX;
+
+        for(int i = i0; i < i1; i++) {
+            tMin = data[i] < tMin ? data[i] : tMin;
+            tMax = data[i] > tMax ? data[i] : tMax;
+        }
+
+        bandMin[b] = tMin;
+        bandMax[b] = tMax;
+    }
+
+    minVal = bandMin[0];
+    maxVal = bandMax[0];
+
+    for(int b = 1; b < nBands; b++) {
+        minVal = MIN(minVal, bandMin[b]);
+        maxVal = MAX(maxVal, bandMax[b]);
+    }
+}
+
+/**
+ * @brief getHistogramParallel counts the values of an array into nBins
+ * uniform bins; each thread fills its own sub-histogram.
+ * @param data
+ * @param n
+ * @param minVal is the lower bound of the first bin.
+ * @param scale is nBins divided by the range of values.
+ * @param nBins
+ * @param hist is an array of nBins counters.
+ * @param bLog is a flag; if it is true values are binned in the log2 domain.
+ */
+PIC_INLINE void getHistogramParallel(float *data, int n, float minVal, float scale,
+                                     int nBins, unsigned int *hist, bool bLog = false)
+{
+    int nBands = MAX(MIN(getNumberOfThreads(), n >> 16), 1);
+
+    std::vector<unsigned int> partials(nBands * nBins, 0);
+
+    #pragma omp parallel for
+
+    for(int b = 0; b < nBands; b++) {
+        unsigned int *h = &partials[b * nBins];
+
+        int i0 = int((long long)(n) * b / nBands);
+        int i1 = int((long long)(n) * (b + 1) / nBands);
+
+        for(int i = i0; i < i1; i++) {
+            float val = bLog ? log2f(MAX(data[i], 1e-9f)) : data[i];
+            int bin = int((val - minVal) * scale);
+            bin = CLAMPi(bin, 0, nBins - 1);
+            h[bin]++;
+        }
+    }
+
+    for(int i = 0; i < nBins; i++) {
+        unsigned int count = 0;
+
+        for(int b = 0; b < nBands; b++) {
+            count += partials[b * nBins + i];
+        }
+
+        hist[i] = count;
+    }
+}
+
+/**
+ * @brief getRadixKey maps a float to an unsigned int key that has the
+ * same order of the float.
+ * @param val
+ * @return
+ */
+inline unsigned int getRadixKey(float val)
+{
+    unsigned int key;
+    memcpy(&key, &val, sizeof(float));
+    return (key & 0x80000000) ? ~key : (key | 0x80000000);
+}
+
+/**
+ * @brief getKthValues computes the k-th smallest values of an array
+ * without sorting it; the result is exact. This is a radix-select: a
+ * parallel histogram of the upper 16 bits of the order-preserving keys
+ * locates the bucket of each requested rank, then only values of those
+ * buckets are gathered and selected with nth_element. All ranks share the
+ * same two passes over data.
+ * @param data is the input array; it is not modified.
+ * @param n is the number of values.
+ * @param k is an array of nK ranks in [0, n - 1].
+ * @param nK is the number of ranks.
+ * @param ret is an array of nK values where the results are stored. If it
+ * is set to NULL an array will be allocated.
+ * @return It returns the k-th smallest values.
+ */
+PIC_INLINE float *getKthValues(float *data, int n, int *k, int nK, float *ret)
+{
+    if(data == NULL || n < 1 || nK < 1) {
+        return ret;
+    }
+
+    if(ret == NULL) {
+        ret = new float[nK];
+    }
+
+    const int nBins = 65536;
+    int nBands = MAX(MIN(getNumberOfThreads(), n >> 16), 1);
+
+    std::vector<unsigned int> partials(nBands * nBins, 0);
+
+    #pragma omp parallel for
+
+    for(int b = 0; b < nBands; b++) {
+        unsigned int *h = &partials[b * nBins];
+
+        int i0 = int((long long)(n) * b / nBands);
+        int i1 = int((long long)(n) * (b + 1) / nBands);
+
+        for(int i = i0; i < i1; i++) {
+            h[getRadixKey(data[i]) >> 16]++;
+        }
+    }
+
+    for(int b = 1; b < nBands; b++) {
+        unsigned int *h = &partials[b * nBins];
+
+        for(int i = 0; i < nBins; i++) {
+            partials[i] += h[i];
+        }
+    }
+
+    unsigned int *hist = &partials[0];
+
+    //locate the bucket and the rank within the bucket of each request,
+    //visiting ranks in increasing order with a single scan
+    std::vector< std::pair<int, int> > order(nK);
+
+    for(int i = 0; i < nK; i++) {
+        order[i] = std::make_pair(CLAMPi(k[i], 0, n - 1), i);
+    }
+
+    std::sort(order.begin(), order.end());
+
+    std::vector<int> kBin(nK), kRank(nK);
+    std::vector<int> slot(nBins, -1);
+    int nSlots = 0;
+
+    int bin = 0;
+    int cum = 0;
+
+    for(int i = 0; i < nK; i++) {
+        int ki = order[i].first;
+
+        while((cum + int(hist[bin])) <= ki) {
+            cum += hist[bin];
+            bin++;
+        }
+
+        kBin[order[i].second] = bin;
+        kRank[order[i].second] = ki - cum;
+
+        if(slot[bin] < 0) {
+            slot[bin] = nSlots;
+            nSlots++;
+        }
+    }
+
+    //gather the values of the selected buckets
+    std::vector< std::vector<float> > values(nSlots);
+
+    for(int i = 0; i < nBins; i++) {
+        if(slot[i] > -1) {
+            values[slot[i]].reserve(hist[i]);
+        }
+    }
+
+    for(int i = 0; i < n; i++) {
+        int s = slot[getRadixKey(data[i]) >> 16];
+
+        if(s > -1) {
+            values[s].push_back(data[i]);
+        }
+    }
+
+    for(int i = 0; i < nK; i++) {
+        std::vector<float> &v = values[slot[kBin[i]]];
+        std::nth_element(v.begin(), v.begin() + kRank[i], v.end());
+        ret[i] = v[kRank[i]];
+    }
+
+    return ret;
+}
+
+/**
+ * @brief getKthValue computes the k-th smallest value of an array.
+ * @param data
+ * @param n
+ * @param k
+ * @return
+ */
+PIC_INLINE float getKthValue(float *data, int n, int k)
+{
+    float ret = 0.0f;
+    getKthValues(data, n, &k, 1, &ret);
+    return ret;
+}
+
+/**
+ * @brief getPercentiles computes exact percentiles of an array in a
+ * single batch; values are the same of a full sort.
+ * @param data
+ * @param n
+ * @param perCent is an array of nPerCent percentiles in [0, 1].
+ * @param nPerCent
+ * @param ret
+ * @return
+ */
+PIC_INLINE float *getPercentiles(float *data, int n, float *perCent, int nPerCent, float *ret)
+{
+    if(nPerCent < 1) {
+        return ret;
+    }
+
+    std::vector<int> k(nPerCent);
+
+    for(int i = 0; i < nPerCent; i++) {
+        k[i] = getPercentileIndex(n, perCent[i]);
+    }
+
+    return getKthValues(data, n, &k[0], nPerCent, ret);
+}
+
+/**
+ * @brief getPercentile computes an exact percentile of an array.
+ * @param data
+ * @param n
+ * @param perCent
+ * @return
+ */
+PIC_INLINE float getPercentile(float *data, int n, float perCent)
+{
+    float ret = 0.0f;
+    getPercentiles(data, n, &perCent, 1, &ret);
+    return ret;
+}
+
+/**
+ * @brief getPercentilesApprox approximates percentiles of an array from a
+ * histogram with linear interpolation within bins; no copy of the data is
+ * made. This is meant for large HDR images where an exact value is not needed.
+ * @param data
+ * @param n
+ * @param perCent is an array of nPerCent percentiles in [0, 1].
+ * @param nPerCent
+ * @param ret
+ * @param minVal is the minimum value of data.
+ * @param maxVal is the maximum value of data.
+ * @param nBins is the number of bins of the histogram.
+ * @param bLog is a flag; if it is true the histogram is computed in the log2
+ * domain, which better fits HDR luminance.
+ * @return
+ */
+PIC_INLINE float *getPercentilesApprox(float *data, int n, float *perCent, int nPerCent,
+                                       float *ret, float minVal, float maxVal,
+                                       int nBins, bool bLog)
+{
+    if(data == NULL || n < 1 || nPerCent < 1) {
+        return ret;
+    }
+
+    if(ret == NULL) {
+        ret = new float[nPerCent];
+    }
+
+    if(bLog) {
+        minVal = log2f(MAX(minVal, 1e-9f));
+        maxVal = log2f(MAX(maxVal, 1e-9f));
+    }
+
+    float range = maxVal - minVal;
+
+    if(!(range > 0.0f) || !(range < FLT_MAX)) {
+        return getPercentiles(data, n, perCent, nPerCent, ret);
+    }
+
+    float scale = float(nBins) / range;
+
+    std::vector<unsigned int> hist(nBins);
+    getHistogramParallel(data, n, minVal, scale, nBins, &hist[0], bLog);
+
+    for(int i = 0; i < nPerCent; i++) {
+        float k = perCent[i] * float(n - 1);
+        k = CLAMPi(k, 0.0f, float(n - 1));
+
+        int bin = 0;
+        float cum = 0.0f;
+
+        while((bin < (nBins - 1)) && ((cum + float(hist[bin])) <= k)) {
+            cum += float(hist[bin]);
+            bin++;
+        }
+
+        float t = hist[bin] > 0 ? (k - cum + 0.5f) / float(hist[bin]) : 0.5f;
+        t = CLAMPi(t, 0.0f, 1.0f);
+
+        float val = minVal + (float(bin) + t) / scale;
+
+        ret[i] = bLog ? powf(2.0f, val) : val;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief getPercentilesApprox approximates percentiles of an array from a
+ * histogram; the range of the histogram is computed from data.
+ * @param data
+ * @param n
+ * @param perCent is an array of nPerCent percentiles in [0, 1].
+ * @param nPerCent
+ * @param ret
+ * @param nBins is the number of bins of the histogram.
+ * @param bLog is a flag; if it is true the histogram is computed in the log2
+ * domain.
+ * @return
+ */
+PIC_INLINE float *getPercentilesApprox(float *data, int n, float *perCent, int nPerCent,
+                                       float *ret, int nBins = 1024, bool bLog = false)
+{
+    if(data == NULL || n < 1 || nPerCent < 1) {
+        return ret;
+    }
+
+    float minVal, maxVal;
+    getMinMaxParallel(data, n, minVal, maxVal);
+
+    return getPercentilesApprox(data, n, perCent, nPerCent, ret, minVal, maxVal,
+                                nBins, bLog);
+}
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_ORDER_STATISTICS_HPP */
@@ -18,7 +18,13 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_UTIL_RAW_HPP
 #define PIC_UTIL_RAW_HPP
 
+#include <thread>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
 #include "../base.hpp"
+#include "../image.hpp"
 #include "../util/file_lister.hpp"
 #include "../util/string.hpp"
 
@@ -89,7 +95,8 @@ public:
      * @brief Read
      * @param nameFile
      * @param nData
-     * @return
+     * @return It returns false if the file cannot be opened or if it is
+     * shorter than nData values.
      */
     bool Read(std::string nameFile, int nData)
     {
@@ -109,13 +116,18 @@ public:
             nData = length / sizeof(T);
         }
 
-        bool bRet = Allocate(nData);
-
+        if(!Allocate(nData)) {
+            file.close();
+            valid = false;
+            return false;
+        }
 
-        file.read((char *)data, nData * sizeof(T) / sizeof(char));
+        std::streamsize size = std::streamsize(nData) * sizeof(T) / sizeof(char);
+        file.read((char *)data, size);
+        bool bRet = (file.gcount() == size);
         file.close();
 
-        valid = true;
+        valid = bRet;
         return bRet;
 
     }
@@ -204,32 +216,496 @@ template <class T> PIC_INLINE void RAW<T>::Release()
     nData = 0;
 }
 
-//Calculate the mean RAW image
-template <class T> PIC_INLINE RAW<T> *MeanRAWStack(std::vector<RAW<T> > &stack)
+/**
+ * @brief The RAW_STACK_MODE enum selects how RAWStackAccumulator reduces
+ * a stack: the mean, the sigma-clipped mean (two passes), or the median of
+ * the means of groups of frames.
+ */
+enum RAW_STACK_MODE {RSM_MEAN, RSM_SIGMA_CLIPPING, RSM_MEDIAN_OF_MEANS};
+
+/**
+ * @brief The RAWStackAccumulator class reduces a stack of RAW frames
+ * (e.g., for dark frames or flat fields) one frame at a time, so memory does
+ * not depend on the number of frames. Unsigned integer frames of up to 16
+ * bits are summed in 32-bit integers, which the compiler vectorizes, and
+ * flushed into doubles before they can overflow; signed frames are summed in
+ * doubles. The per-pixel variance is computed online with Welford's method.
+ */
+template <class T> class RAWStackAccumulator
 {
-    if(stack.size() <= 0) {
-        return NULL;
+protected:
+    RAW_STACK_MODE mode;
+    int nData, nGroups, pass;
+    float kappa;
+    bool bVariance;
+
+    unsigned int *isum, *count;
+    double *dsum;
+    float *mean, *m2, *range;
+
+    std::vector<int> groupFrames, groupPartialFrames;
+    int nFrames, nFramesPass;
+
+    static const bool bInteger = std::numeric_limits<T>::is_integer && (sizeof(T) <= 2) &&
+                                 !std::numeric_limits<T>::is_signed;
+
+    /**
+     * @brief release
+     */
+    void release()
+    {
+        delete[] isum;
+        delete[] count;
+        delete[] dsum;
+        delete[] mean;
+        delete[] m2;
+        delete[] range;
+
+        isum = count = NULL;
+        dsum = NULL;
+        mean = m2 = range = NULL;
+    }
+
+    /**
+     * @brief flush moves the integer sums of a group into the double sums.
+     * @param g
+     */
+    void flush(int g)
+    {
+        if(!bInteger || groupPartialFrames[g] == 0) {
+            return;
+        }
+
+        if(dsum == NULL) {
+            dsum = new double[nGroups * nData];
+            std::fill(dsum, dsum + nGroups * nData, 0.0);
+        }
+
+        unsigned int *src = &isum[g * nData];
+        double *dst = &dsum[g * nData];
+
+        #pragma omp parallel for
+
+        for(int i = 0; i < nData; i++) {
+            dst[i] += double(src[i]);
+            src[i] = 0;
+        }
+
+        groupPartialFrames[g] = 0;
     }
 
-    int nData = stack[0].nData;
-    RAW<T> *dataOut = new RAW<T>();
-    dataOut->data = new T[nData];
-    dataOut->nData = nData;
+    /**
+     * @brief getSum
+     * @param g
+     * @param i
+     * @return It returns the sum of the group g at pixel i.
+     */
+    inline double getSum(int g, int i)
+    {
+        int index = g * nData + i;
+        double ret = (dsum != NULL) ? dsum[index] : 0.0;
+
+        if(bInteger) {
+            ret += double(isum[index]);
+        }
 
-    int stackSize = stack.size();
+        return ret;
+    }
 
-    for(int i = 0; i < nData; i++) {
-        unsigned long tmpData = 0;
+    /**
+     * @brief resetSums
+     */
+    void resetSums()
+    {
+        if(isum != NULL) {
+            std::fill(isum, isum + nGroups * nData, 0u);
+        }
+
+        if(dsum != NULL) {
+            std::fill(dsum, dsum + nGroups * nData, 0.0);
+        }
+
+        std::fill(groupFrames.begin(), groupFrames.end(), 0);
+        std::fill(groupPartialFrames.begin(), groupPartialFrames.end(), 0);
+    }
+
+public:
+
+    /**
+     * @brief RAWStackAccumulator
+     */
+    RAWStackAccumulator()
+    {
+        isum = count = NULL;
+        dsum = NULL;
+        mean = m2 = range = NULL;
+        nData = 0;
+        nGroups = 1;
+        pass = 0;
+        nFrames = nFramesPass = 0;
+    }
+
+    /**
+     * @brief RAWStackAccumulator
+     * @param nData is the number of values of a frame.
+     * @param mode
+     * @param kappa is the clipping threshold in standard deviations.
+     * @param nGroups is the number of groups for the median of means.
+     * @param bVariance enables the per-pixel variance.
+     */
+    RAWStackAccumulator(int nData, RAW_STACK_MODE mode = RSM_MEAN,
+                        float kappa = 3.0f, int nGroups = 5,
+                        bool bVariance = false)
+    {
+        isum = count = NULL;
+        dsum = NULL;
+        mean = m2 = range = NULL;
+
+        init(nData, mode, kappa, nGroups, bVariance);
+    }
+
+    ~RAWStackAccumulator()
+    {
+        release();
+    }
+
+    /**
+     * @brief init
+     * @param nData is the number of values of a frame.
+     * @param mode
+     * @param kappa is the clipping threshold in standard deviations.
+     * @param nGroups is the number of groups for the median of means;
+     * frame k is assigned to the group k % nGroups.
+     * @param bVariance enables the per-pixel variance.
+     */
+    void init(int nData, RAW_STACK_MODE mode = RSM_MEAN, float kappa = 3.0f,
+              int nGroups = 5, bool bVariance = false)
+    {
+        release();
+
+        this->nData = MAX(nData, 0);
+        this->mode = mode;
+        this->kappa = kappa > 0.0f ? kappa : 3.0f;
+        this->nGroups = (mode == RSM_MEDIAN_OF_MEANS) ? MAX(nGroups, 1) : 1;
+        this->bVariance = bVariance || (mode == RSM_SIGMA_CLIPPING);
+
+        pass = 0;
+        nFrames = nFramesPass = 0;
+
+        groupFrames.assign(this->nGroups, 0);
+        groupPartialFrames.assign(this->nGroups, 0);
+
+        int n = this->nGroups * this->nData;
+
+        if(bInteger) {
+            isum = new unsigned int[n];
+        } else {
+            dsum = new double[n];
+        }
+
+        resetSums();
+
+        if(this->bVariance) {
+            mean = new float[this->nData];
+            m2 = new float[this->nData];
+            std::fill(mean, mean + this->nData, 0.0f);
+            std::fill(m2, m2 + this->nData, 0.0f);
+        }
+    }
+
+    /**
+     * @brief getNumberOfPasses
+     * @return It returns the number of times the stack has to be added.
+     */
+    int getNumberOfPasses()
+    {
+        return (mode == RSM_SIGMA_CLIPPING) ? 2 : 1;
+    }
+
+    /**
+     * @brief add adds a frame to the current pass.
+     * @param data is an array of nData values.
+     */
+    void add(T *data)
+    {
+        if(data == NULL || nData < 1) {
+            return;
+        }
+
+        int g = (pass == 0) ? (nFramesPass % nGroups) : 0;
+
+        //sums of 16-bit values in 32-bit integers cannot overflow before 65536 frames
+        if(bInteger && groupPartialFrames[g] >= 65536) {
+            flush(g);
+        }
+
+        if(pass == 0) {
+            if(bInteger) {
+                unsigned int *s = &isum[g * nData];
+
+                #pragma omp parallel for
+
+                for(int i = 0; i < nData; i++) {
+                    s[i] += (unsigned int)(data[i]);
+                }
+            } else {
+                double *s = &dsum[g * nData];
+
+                #pragma omp parallel for
+
+                for(int i = 0; i < nData; i++) {
+                    s[i] += double(data[i]);
+                }
+            }
+
+            if(bVariance) {
+                float n_inv = 1.0f / float(nFramesPass + 1);
+
+                #pragma omp parallel for
+
+                for(int i = 0; i < nData; i++) {
+                    float x = float(data[i]);
+                    float delta = x - mean[i];
+                    mean[i] += delta * n_inv;
+                    m2[i] += delta * (x - mean[i]);
+                }
+            }
+        } else {
+            //second pass of sigma clipping: values far from the mean are skipped
+            if(bInteger) {
+                unsigned int *s = isum;
+
+                #pragma omp parallel for
+
+                for(int i = 0; i < nData; i++) {
+                    float x = float(data[i]);
+                    bool bIn = fabsf(x - mean[i]) <= range[i];
+                    s[i] += bIn ? (unsigned int)(data[i]) : 0u;
+                    count[i] += bIn ? 1u : 0u;
+                }
+            } else {
+                double *s = dsum;
+
+                #pragma omp parallel for
+
+                for(int i = 0; i < nData; i++) {
+                    float x = float(data[i]);
+                    bool bIn = fabsf(x - mean[i]) <= range[i];
+                    s[i] += bIn ? double(data[i]) : 0.0;
+                    count[i] += bIn ? 1u : 0u;
+                }
+            }
+        }
+
+        groupFrames[g]++;
+        groupPartialFrames[g]++;
+        nFramesPass++;
+
+        if(pass == 0) {
+            nFrames++;
+        }
+    }
+
+    /**
+     * @brief nextPass starts the second pass of sigma clipping; the stack
+     * has to be added again after this call.
+     * @return It returns false if no further pass is needed.
+     */
+    bool nextPass()
+    {
+        if(mode != RSM_SIGMA_CLIPPING || pass > 0 || nFrames < 1) {
+            return false;
+        }
+
+        if(range == NULL) {
+            range = new float[nData];
+            count = new unsigned int[nData];
+        }
+
+        float n1_inv = nFrames > 1 ? 1.0f / float(nFrames - 1) : 0.0f;
+
+        #pragma omp parallel for
+
+        for(int i = 0; i < nData; i++) {
+            range[i] = kappa * sqrtf(MAX(m2[i] * n1_inv, 0.0f));
+            count[i] = 0;
+        }
+
+        resetSums();
+
+        pass = 1;
+        nFramesPass = 0;
+        return true;
+    }
+
+    /**
+     * @brief getNumberOfFrames
+     * @return It returns the number of frames of the first pass.
+     */
+    int getNumberOfFrames()
+    {
+        return nFrames;
+    }
+
+    /**
+     * @brief getMean computes the reduced stack.
+     * @param out is an array of nData values; if it is NULL, it is allocated.
+     * @return
+     */
+    float *getMean(float *out = NULL)
+    {
+        if(nData < 1) {
+            return out;
+        }
+
+        if(out == NULL) {
+            out = new float[nData];
+        }
+
+        if(nFrames < 1) {
+            std::fill(out, out + nData, 0.0f);
+            return out;
+        }
+
+        if(mode == RSM_SIGMA_CLIPPING) {
+            #pragma omp parallel for
+
+            for(int i = 0; i < nData; i++) {
+                if((pass > 0) && (count[i] > 0)) {
+                    out[i] = float(getSum(0, i) / double(count[i]));
+                } else {
+                    out[i] = mean[i];
+                }
+            }
+
+            return out;
+        }
+
+        if(nGroups == 1) {
+            double n_inv = 1.0 / double(groupFrames[0]);
+
+            #pragma omp parallel for
+
+            for(int i = 0; i < nData; i++) {
+                out[i] = float(getSum(0, i) * n_inv);
+            }
+
+            return out;
+        }
+
+        //median of means over the groups with at least a frame
+        std::vector<int> groups;
+
+        for(int g = 0; g < nGroups; g++) {
+            if(groupFrames[g] > 0) {
+                groups.push_back(g);
+            }
+        }
+
+        int nValid = int(groups.size());
+
+        #pragma omp parallel for
+
+        for(int i = 0; i < nData; i++) {
+            float tmp[64];
+            std::vector<float> tmp_v;
+            float *values = tmp;
+
+            if(nValid > 64) {
+                tmp_v.resize(nValid);
+                values = tmp_v.data();
+            }
+
+            for(int k = 0; k < nValid; k++) {
+                int g = groups[k];
+                values[k] = float(getSum(g, i) / double(groupFrames[g]));
+            }
+
+            std::sort(values, values + nValid);
 
-        for(int j = 0; j < stackSize; j++) {
-            tmpData += stack[j].data[i];
+            int h = nValid >> 1;
+            out[i] = (nValid & 1) ? values[h] : (values[h - 1] + values[h]) * 0.5f;
         }
 
-        dataOut->data[i] = tmpData / stackSize;
+        return out;
     }
 
-    dataOut->valid = true;
-    return dataOut;
+    /**
+     * @brief getVariance computes the per-pixel unbiased variance of the
+     * frames of the first pass; it requires bVariance or sigma clipping.
+     * @param out is an array of nData values; if it is NULL, it is allocated.
+     * @return
+     */
+    float *getVariance(float *out = NULL)
+    {
+        if(m2 == NULL) {
+            return out;
+        }
+
+        if(out == NULL) {
+            out = new float[nData];
+        }
+
+        float n1_inv = nFrames > 1 ? 1.0f / float(nFrames - 1) : 0.0f;
+
+        for(int i = 0; i < nData; i++) {
+            out[i] = MAX(m2[i] * n1_inv, 0.0f);
+        }
+
+        return out;
+    }
+
+    /**
+     * @brief getRAW returns the reduced stack as a RAW; integer types are
+     * truncated as in an integer division.
+     * @return
+     */
+    RAW<T> *getRAW()
+    {
+        if(nData < 1) {
+            return NULL;
+        }
+
+        float *tmp = NULL;
+
+        RAW<T> *out = new RAW<T>(nData);
+        out->valid = true;
+
+        if(bInteger && mode == RSM_MEAN) {
+            //exact integer division of the sums
+            double n = double(groupFrames[0]);
+
+            for(int i = 0; i < nData; i++) {
+                out->data[i] = nFrames > 0 ? T(floor(getSum(0, i) / n)) : T(0);
+            }
+        } else {
+            tmp = getMean(NULL);
+
+            for(int i = 0; i < nData; i++) {
+                out->data[i] = T(tmp[i]);
+            }
+
+            delete[] tmp;
+        }
+
+        return out;
+    }
+};
+
+//Calculate the mean RAW image
+template <class T> PIC_INLINE RAW<T> *MeanRAWStack(std::vector<RAW<T> > &stack)
+{
+    if(stack.size() <= 0) {
+        return NULL;
+    }
+
+    RAWStackAccumulator<T> acc(stack[0].nData);
+
+    for(unsigned int i = 0; i < stack.size(); i++) {
+        acc.add(stack[i].data);
+    }
+
+    return acc.getRAW();
 }
 
 //Calculate the mean RAW image
@@ -254,32 +730,119 @@ template <class T> PIC_INLINE unsigned long *MeanRAWIterative(RAW<T> *img,
     return dataAcc;
 }
 
-template <class T> PIC_INLINE RAW<T> *CalculateRAWMeanFromFile(
-    std::string nameDir,
-    std::string nameFilter,
+/**
+ * @brief CalculateRAWMeanFromFiles reduces a list of RAW files with a
+ * RAWStackAccumulator; the next file is read by a separate thread while the
+ * current one is accumulated.
+ * @param vec is the list of files.
+ * @param width
+ * @param height
+ * @param mode
+ * @param kappa is the clipping threshold for RSM_SIGMA_CLIPPING.
+ * @param nGroups is the number of groups for RSM_MEDIAN_OF_MEANS.
+ * @return It returns NULL if a file cannot be read or it is shorter than
+ * width * height values.
+ */
+template <class T> PIC_INLINE RAW<T> *CalculateRAWMeanFromFiles(
+    StringVec &vec,
     int width,
-    int height)
+    int height,
+    RAW_STACK_MODE mode = RSM_MEAN,
+    float kappa = 3.0f,
+    int nGroups = 5)
 {
+    if(vec.empty()) {
+        return NULL;
+    }
 
-    StringVec vec;
+    int nData = width * height;
 
-    FileLister::getList(nameDir, nameFilter, &vec);
+    RAWStackAccumulator<T> acc(nData, mode, kappa, nGroups);
+
+    RAW<T> buffer[2];
+    bool bRead = true;
+
+    for(int p = 0; (p < acc.getNumberOfPasses()) && bRead; p++) {
+        if(p > 0) {
+            acc.nextPass();
+        }
+
+        bRead = buffer[0].Read(vec[0], nData);
+
+        for(unsigned int i = 0; (i < vec.size()) && bRead; i++) {
+            RAW<T> *next = &buffer[(i + 1) % 2];
+            bool bNext = (i + 1) < vec.size();
+
+#ifndef PIC_DISABLE_THREAD
+            std::thread *reader = NULL;
+
+            if(bNext) {
+                //bRead is not accessed until the reader is joined
+                reader = new std::thread([&bRead, next, &vec, i, nData]() {
+                    bRead = next->Read(vec[i + 1], nData);
+                });
+            }
 
-    RAW<T> imgRAW;
-    unsigned long *dataAcc = NULL;
+            acc.add(buffer[i % 2].data);
 
-    for(unsigned int i = 0; i < vec.size(); i++) {
-        imgRAW.Read(vec[i], width * height);
-        dataAcc = MeanRAWIterative<T>(&imgRAW, dataAcc, i == 0);
+            if(reader != NULL) {
+                reader->join();
+                delete reader;
+            }
+#else
+            acc.add(buffer[i % 2].data);
+
+            if(bNext) {
+                bRead = next->Read(vec[i + 1], nData);
+            }
+#endif
+        }
     }
 
-    RAW<T> *imgOut = imgRAW.Copy();
+    //RAW::Release does not free memory
+    for(int k = 0; k < 2; k++) {
+        delete[] buffer[k].data;
+        buffer[k].data = NULL;
+    }
 
-    for(int i = 0; i < imgOut->nData; i++) {
-        imgOut->data[i] = dataAcc[i] / vec.size();
+    if(!bRead) {
+        #ifdef PIC_DEBUG
+            printf("CalculateRAWMeanFromFiles: a file cannot be read.\n");
+        #endif
+        return NULL;
     }
 
-    return imgOut;
+    return acc.getRAW();
+}
+
+/**
+ * @brief CalculateRAWMeanFromFile reduces the RAW files of a folder;
+ * see CalculateRAWMeanFromFiles.
+ * @param nameDir
+ * @param nameFilter
+ * @param width
+ * @param height
+ * @param mode
+ * @param kappa is the clipping threshold for RSM_SIGMA_CLIPPING.
+ * @param nGroups is the number of groups for RSM_MEDIAN_OF_MEANS.
+ * @return
+ */
+template <class T> PIC_INLINE RAW<T> *CalculateRAWMeanFromFile(
+    std::string nameDir,
+    std::string nameFilter,
+    int width,
+    int height,
+    RAW_STACK_MODE mode = RSM_MEAN,
+    float kappa = 3.0f,
+    int nGroups = 5)
+{
+
+    StringVec vec;
+
+    FileLister::getList(nameDir, nameFilter, &vec);
+
+    return CalculateRAWMeanFromFiles<T>(vec, width, height, mode, kappa,
+                                        nGroups);
 }
 
 template <class T> PIC_INLINE void CalculateRAWMeanFromFile(
@@ -289,8 +852,315 @@ template <class T> PIC_INLINE void CalculateRAWMeanFromFile(
     int width,
     int height)
 {
-    (CalculateRAWMeanFromFile<T>(nameDir, nameFilter, width,
-                                 height))->Write(nameOut);
+    RAW<T> *imgOut = CalculateRAWMeanFromFile<T>(nameDir, nameFilter, width,
+                                                 height);
+
+    if(imgOut != NULL) {
+        imgOut->Write(nameOut);
+    }
+}
+
+/**
+ * @brief getPackedRAWSize computes the number of bytes of n packed values.
+ * Values are packed as MIPI CSI-2 RAW10/RAW12/RAW14: groups of 4 (10-bit and
+ * 14-bit) or 2 (12-bit) values store their most significant 8 bits in a byte
+ * each, followed by the bytes with the remaining least significant bits.
+ * @param n
+ * @param bits is 8, 10, 12, 14, or 16.
+ * @return
+ */
+PIC_INLINE int getPackedRAWSize(int n, int bits)
+{
+    switch(bits) {
+        case 8: {
+            return n;
+        } break;
+
+        case 10: {
+            return ((n + 3) / 4) * 5;
+        } break;
+
+        case 12: {
+            return ((n + 1) / 2) * 3;
+        } break;
+
+        case 14: {
+            return ((n + 3) / 4) * 7;
+        } break;
+
+        case 16: {
+            return n * 2;
+        } break;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief UnpackRAWGroup unpacks a group of packed values.
+ * @param src
+ * @param v
+ */
+template<int bits>
+inline void UnpackRAWGroup(unsigned char *src, int *v)
+{
+    switch(bits) {
+        case 8: {
+            v[0] = src[0];
+        } break;
+
+        case 10: {
+            int lsb = src[4];
+            v[0] = (src[0] << 2) | ( lsb       & 0x03);
+            v[1] = (src[1] << 2) | ((lsb >> 2) & 0x03);
+            v[2] = (src[2] << 2) | ((lsb >> 4) & 0x03);
+            v[3] = (src[3] << 2) | ((lsb >> 6) & 0x03);
+        } break;
+
+        case 12: {
+            int lsb = src[2];
+            v[0] = (src[0] << 4) | ( lsb       & 0x0F);
+            v[1] = (src[1] << 4) | ((lsb >> 4) & 0x0F);
+        } break;
+
+        case 14: {
+            int lsb = src[4] | (src[5] << 8) | (src[6] << 16);
+            v[0] = (src[0] << 6) | ( lsb        & 0x3F);
+            v[1] = (src[1] << 6) | ((lsb >>  6) & 0x3F);
+            v[2] = (src[2] << 6) | ((lsb >> 12) & 0x3F);
+            v[3] = (src[3] << 6) | ((lsb >> 18) & 0x3F);
+        } break;
+
+        case 16: {
+            v[0] = src[0] | (src[1] << 8);
+        } break;
+    }
+}
+
+/**
+ * @brief UnpackRAWRow unpacks n values into floats; values are mapped as
+ * (v - blackLevel) * scale.
+ * @param src
+ * @param dst
+ * @param n
+ * @param blackLevel
+ * @param scale
+ */
+template<int bits>
+PIC_INLINE void UnpackRAWRow(unsigned char *src, float *dst, int n,
+                             float blackLevel, float scale)
+{
+    const int groupSize  = (bits == 10 || bits == 14) ? 4 : ((bits == 12) ? 2 : 1);
+    const int groupBytes = (bits == 8) ? 1 : ((bits == 16) ? 2 : (groupSize * bits) / 8);
+
+    int v[4];
+    int nGroups = n / groupSize;
+
+    for(int g = 0; g < nGroups; g++) {
+        UnpackRAWGroup<bits>(&src[g * groupBytes], v);
+
+        float *out = &dst[g * groupSize];
+
+        for(int k = 0; k < groupSize; k++) {
+            out[k] = (float(v[k]) - blackLevel) * scale;
+        }
+    }
+
+    //last partial group; its bytes are copied to avoid reading past src
+    int rem = n - nGroups * groupSize;
+
+    if(rem > 0) {
+        unsigned char tmp[7] = {0, 0, 0, 0, 0, 0, 0};
+        int nBytes = getPackedRAWSize(rem, bits);
+
+        for(int k = 0; k < nBytes; k++) {
+            tmp[k] = src[nGroups * groupBytes + k];
+        }
+
+        UnpackRAWGroup<bits>(tmp, v);
+
+        for(int k = 0; k < rem; k++) {
+            dst[nGroups * groupSize + k] = (float(v[k]) - blackLevel) * scale;
+        }
+    }
+}
+
+/**
+ * @brief ConvertPackedRAWToImage unpacks a packed sensor buffer directly into
+ * a single channel float image; values are normalized as
+ * (v - blackLevel) / (whiteLevel - blackLevel). Rows are unpacked in parallel.
+ * @param src
+ * @param width
+ * @param height
+ * @param bits is 8, 10, 12, 14, or 16 (little endian).
+ * @param imgOut
+ * @param blackLevel
+ * @param whiteLevel is the saturation value; if it is not positive,
+ * it is set to 2^bits - 1.
+ * @param rowStride is the number of bytes of a row, e.g., rows padded to
+ * whole groups as in MIPI CSI-2 lines; if it is not positive, rows are
+ * assumed to be a single continuous stream of values.
+ * @return
+ */
+PIC_INLINE Image *ConvertPackedRAWToImage(unsigned char *src, int width,
+                                          int height, int bits,
+                                          Image *imgOut = NULL,
+                                          float blackLevel = 0.0f,
+                                          float whiteLevel = -1.0f,
+                                          int rowStride = -1)
+{
+    if(src == NULL || width < 1 || height < 1 ||
+       getPackedRAWSize(1, bits) < 1) {
+        return imgOut;
+    }
+
+    if(imgOut == NULL) {
+        imgOut = new Image(width, height, 1);
+    } else {
+        if(imgOut->width != width || imgOut->height != height ||
+           imgOut->channels != 1) {
+            if(!imgOut->isValid()) {
+                imgOut->allocate(width, height, 1, 1);
+            } else {
+                imgOut = new Image(width, height, 1);
+            }
+        }
+    }
+
+    if(whiteLevel <= 0.0f) {
+        whiteLevel = float((1 << bits) - 1);
+    }
+
+    float range = whiteLevel - blackLevel;
+    float scale = range > 0.0f ? 1.0f / range : 0.0f;
+
+    bool bContiguous = (rowStride <= 0);
+
+    #pragma omp parallel for
+
+    for(int j = 0; j < height; j++) {
+        float *dst = &imgOut->data[j * imgOut->ystride];
+
+        //contiguous rows may not start at a group boundary
+        int x = 0;
+        unsigned char *row;
+
+        if(bContiguous) {
+            int groupSize = (bits == 10 || bits == 14) ? 4 : ((bits == 12) ? 2 : 1);
+            int index = j * width;
+            x = index % groupSize;
+            row = &src[getPackedRAWSize(index - x, bits)];
+        } else {
+            row = &src[j * rowStride];
+        }
+
+        if(x == 0) {
+            switch(bits) {
+                case 8: {
+                    UnpackRAWRow<8>(row, dst, width, blackLevel, scale);
+                } break;
+
+                case 10: {
+                    UnpackRAWRow<10>(row, dst, width, blackLevel, scale);
+                } break;
+
+                case 12: {
+                    UnpackRAWRow<12>(row, dst, width, blackLevel, scale);
+                } break;
+
+                case 14: {
+                    UnpackRAWRow<14>(row, dst, width, blackLevel, scale);
+                } break;
+
+                case 16: {
+                    UnpackRAWRow<16>(row, dst, width, blackLevel, scale);
+                } break;
+            }
+        } else {
+            //the row starts inside a group: unpacking the enclosing groups
+            std::vector<float> tmp(width + x);
+
+            switch(bits) {
+                case 10: {
+                    UnpackRAWRow<10>(row, tmp.data(), width + x, blackLevel, scale);
+                } break;
+
+                case 12: {
+                    UnpackRAWRow<12>(row, tmp.data(), width + x, blackLevel, scale);
+                } break;
+
+                case 14: {
+                    UnpackRAWRow<14>(row, tmp.data(), width + x, blackLevel, scale);
+                } break;
+            }
+
+            memcpy(dst, &tmp[x], sizeof(float) * width);
+        }
+    }
+
+    return imgOut;
+}
+
+/**
+ * @brief ConvertRAWToImage converts unpacked sensor values into a single
+ * channel float image; values are normalized as
+ * (v - blackLevel) / (whiteLevel - blackLevel).
+ * @param raw
+ * @param width
+ * @param height
+ * @param imgOut
+ * @param blackLevel
+ * @param whiteLevel is the saturation value; if it is not positive, the
+ * maximum value of T is used.
+ * @return
+ */
+template <class T> PIC_INLINE Image *ConvertRAWToImage(RAW<T> *raw, int width,
+                                                       int height,
+                                                       Image *imgOut = NULL,
+                                                       float blackLevel = 0.0f,
+                                                       float whiteLevel = -1.0f)
+{
+    if(raw == NULL || width < 1 || height < 1) {
+        return imgOut;
+    }
+
+    if(raw->data == NULL || raw->nData < (width * height)) {
+        return imgOut;
+    }
+
+    if(imgOut == NULL) {
+        imgOut = new Image(width, height, 1);
+    } else {
+        if(imgOut->width != width || imgOut->height != height ||
+           imgOut->channels != 1) {
+            if(!imgOut->isValid()) {
+                imgOut->allocate(width, height, 1, 1);
+            } else {
+                imgOut = new Image(width, height, 1);
+            }
+        }
+    }
+
+    if(whiteLevel <= 0.0f) {
+        whiteLevel = std::numeric_limits<T>::is_integer ?
+                     float(std::numeric_limits<T>::max()) : 1.0f;
+    }
+
+    float range = whiteLevel - blackLevel;
+    float scale = range > 0.0f ? 1.0f / range : 0.0f;
+
+    #pragma omp parallel for
+
+    for(int j = 0; j < height; j++) {
+        T *src = &raw->data[j * width];
+        float *dst = &imgOut->data[j * imgOut->ystride];
+
+        for(int i = 0; i < width; i++) {
+            dst[i] = (float(src[i]) - blackLevel) * scale;
+        }
+    }
+
+    return imgOut;
 }
 
 } // end namespace pic
@@ -0,0 +1,247 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_RUNNING_MIN_MAX_HPP
+#define PIC_UTIL_RUNNING_MIN_MAX_HPP
+
+#include <vector>
+
+#include "../base.hpp"
+#include "../image.hpp"
+
+namespace pic {
+
+/**
+ * @brief The RunningMax struct is the max operator for runningMinMax.
+ */
+struct RunningMax
+{
+    static inline float op(float a, float b)
+    {
+        return a > b ? a : b;
+    }
+
+    static inline float neutral()
+    {
+        return -FLT_MAX;
+    }
+};
+
+/**
+ * @brief The RunningMin struct is the min operator for runningMinMax.
+ */
+struct RunningMin
+{
+    static inline float op(float a, float b)
+    {
+        return a < b ? a : b;
+    }
+
+    static inline float neutral()
+    {
+        return FLT_MAX;
+    }
+};
+
+/**
+ * @brief runningMinMaxLines computes the min or max of windows of size
+ * 2 * halfSize + 1 along a set of lines with the van Herk/Gil-Werman
+ * algorithm; i.e., three comparisons per value regardless of halfSize.
+ * Lines are processed together: values of the same line position are
+ * contiguous in memory (nLanes values with stride laneStride), so the inner
+ * loops run across lines and they are vectorized by the compiler.
+ * Windows are cropped at the boundaries, which is equivalent to clamping.
+ * @param src
+ * @param dst
+ * @param n is the length of lines.
+ * @param nLanes is the number of lines.
+ * @param laneStride is the distance between two consecutive line positions.
+ * @param halfSize
+ * @param g is a buffer of size (n + 2 * halfSize) * nLanes.
+ * @param h is a buffer of size (n + 2 * halfSize) * nLanes.
+ */
+template<class T>
+PIC_INLINE void runningMinMaxLines(float *src, float *dst, int n, int nLanes,
+                                   int laneStride, int halfSize,
+                                   float *g, float *h)
+{
+    int w = halfSize * 2 + 1;
+    int nPad = n + halfSize * 2;
+
+    float neutral = T::neutral();
+
+    //forward and backward running values inside blocks of size w;
+    //out-of-bounds values are neutral
+    for(int i = 0; i < nPad; i++) {
+        int s = i - halfSize;
+        float *gi = &g[i * nLanes];
+        bool bInside = (s >= 0) && (s < n);
+        float *si = bInside ? &src[s * laneStride] : NULL;
+
+        if((i % w) == 0) {
+            if(bInside) {
+                for(int k = 0; k < nLanes; k++) {
+                    gi[k] = si[k];
+                }
+            } else {
+                for(int k = 0; k < nLanes; k++) {
+                    gi[k] = neutral;
+                }
+            }
+        } else {
+            float *gp = gi - nLanes;
+
+            if(bInside) {
+                for(int k = 0; k < nLanes; k++) {
+                    gi[k] = T::op(gp[k], si[k]);
+                }
+            } else {
+                for(int k = 0; k < nLanes; k++) {
+                    gi[k] = gp[k];
+                }
+            }
+        }
+    }
+
+    for(int i = nPad - 1; i >= 0; i--) {
+        int s = i - halfSize;
+        float *hi = &h[i * nLanes];
+        bool bInside = (s >= 0) && (s < n);
+        float *si = bInside ? &src[s * laneStride] : NULL;
+
+        if((i == (nPad - 1)) || ((i % w) == (w - 1))) {
+            if(bInside) {
+                for(int k = 0; k < nLanes; k++) {
+                    hi[k] = si[k];
+                }
+            } else {
+                for(int k = 0; k < nLanes; k++) {
+                    hi[k] = neutral;
+                }
+            }
+        } else {
+            float *hn = hi + nLanes;
+
+            if(bInside) {
+                for(int k = 0; k < nLanes; k++) {
+                    hi[k] = T::op(hn[k], si[k]);
+                }
+            } else {
+                for(int k = 0; k < nLanes; k++) {
+                    hi[k] = hn[k];
+                }
+            }
+        }
+    }
+
+    //the window [i - halfSize, i + halfSize] spans at most two blocks
+    for(int i = 0; i < n; i++) {
+        float *hi = &h[i * nLanes];
+        float *gi = &g[(i + halfSize * 2) * nLanes];
+        float *di = &dst[i * laneStride];
+
+        for(int k = 0; k < nLanes; k++) {
+            di[k] = T::op(hi[k], gi[k]);
+        }
+    }
+}
+
+/**
+ * @brief runningMinMax computes a separable min or max filter with a
+ * rectangular window of size (2 * halfSizeX + 1) x (2 * halfSizeY + 1).
+ * The vertical pass processes blocks of columns together; the horizontal
+ * pass processes a row at a time, with its channels as lanes.
+ * @param imgIn
+ * @param imgOut
+ * @param halfSizeX
+ * @param halfSizeY
+ * @return
+ */
+template<class T>
+PIC_INLINE Image *runningMinMax(Image *imgIn, Image *imgOut, int halfSizeX,
+                                int halfSizeY)
+{
+    if(imgIn == NULL) {
+        return imgOut;
+    }
+
+    if(!imgIn->isValid()) {
+        return imgOut;
+    }
+
+    if(imgOut == NULL) {
+        imgOut = imgIn->allocateSimilarOne();
+    } else {
+        if(!imgIn->isSimilarType(imgOut)) {
+            if(!imgOut->isValid()) {
+                imgOut->allocateSimilarTo(imgIn);
+            } else {
+                imgOut = imgIn->allocateSimilarOne();
+            }
+        }
+    }
+
+    halfSizeX = MAX(halfSizeX, 0);
+    halfSizeY = MAX(halfSizeY, 0);
+
+    int width = imgIn->width;
+    int height = imgIn->height;
+    int channels = imgIn->channels;
+    int ystride = imgIn->ystride;
+
+    Image tmp(width, height, channels);
+
+    for(int f = 0; f < imgIn->frames; f++) {
+        float *src = imgIn->data + f * imgIn->tstride;
+        float *dst = imgOut->data + f * imgOut->tstride;
+
+        //vertical pass: blocks of columns are processed as lanes
+        int blockSize = 256;
+        int nBlocks = (ystride + blockSize - 1) / blockSize;
+
+        #pragma omp parallel for
+
+        for(int b = 0; b < nBlocks; b++) {
+            int i0 = b * blockSize;
+            int nLanes = MIN(blockSize, ystride - i0);
+
+            std::vector<float> g((height + halfSizeY * 2) * nLanes);
+            std::vector<float> h((height + halfSizeY * 2) * nLanes);
+
+            runningMinMaxLines<T>(&src[i0], &tmp.data[i0], height, nLanes,
+                                  ystride, halfSizeY, g.data(), h.data());
+        }
+
+        //horizontal pass: a row at a time, channels are lanes
+        #pragma omp parallel for
+
+        for(int j = 0; j < height; j++) {
+            std::vector<float> g((width + halfSizeX * 2) * channels);
+            std::vector<float> h((width + halfSizeX * 2) * channels);
+
+            runningMinMaxLines<T>(&tmp.data[j * ystride], &dst[j * ystride],
+                                  width, channels, channels, halfSizeX,
+                                  g.data(), h.data());
+        }
+    }
+
+    return imgOut;
+}
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_RUNNING_MIN_MAX_HPP */
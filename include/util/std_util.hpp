@@ -20,8 +20,27 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <vector>
 
+#ifndef PIC_DISABLE_THREAD
+#include <thread>
+#endif
+
 namespace pic {
 
+/**
+ * @brief getNumberOfThreads returns the number of hardware threads
+ * available for splitting a workload.
+ * @return This function returns the number of threads (at least 1).
+ */
+inline int getNumberOfThreads()
+{
+#ifndef PIC_DISABLE_THREAD
+    int n = int(std::thread::hardware_concurrency());
+    return n > 0 ? n : 1;
+#else
+    return 1;
+#endif
+}
+
 /**
  * @brief filterInliers
  * @param vec
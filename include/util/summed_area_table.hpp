@@ -0,0 +1,426 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_SUMMED_AREA_TABLE_HPP
+#define PIC_UTIL_SUMMED_AREA_TABLE_HPP
+
+#include "../base.hpp"
+#include "../image.hpp"
+#include "../util/image_statistics.hpp"
+
+namespace pic {
+
+/**
+ * @brief The SummedAreaTableBuffer struct provides the rows of an interleaved
+ * float buffer to SummedAreaTable::computeFromRows.
+ */
+struct SummedAreaTableBuffer
+{
+    float *data;
+    int ystride;
+
+    SummedAreaTableBuffer(float *data, int ystride)
+    {
+        this->data = data;
+        this->ystride = ystride;
+    }
+
+    float *getRow(int j, float *)
+    {
+        return &data[j * ystride];
+    }
+};
+
+/**
+ * @brief The SummedAreaTable class is a summed-area table (integral image)
+ * stored in double precision. The table has an extra zero row and column,
+ * and the input can be padded by replicating its borders; this allows box
+ * sums and means in O(1) per pixel with the same border handling of
+ * Image::operator().
+ */
+class SummedAreaTable
+{
+protected:
+    int nData;
+
+    /**
+     * @brief release
+     */
+    void release()
+    {
+        if(data != NULL) {
+            delete[] data;
+        }
+
+        data = NULL;
+        nData = 0;
+    }
+
+public:
+    double *data;
+    int width, height, channels, padding;
+    int tWidth, tHeight, ystride;
+
+    /**
+     * @brief SummedAreaTable
+     */
+    SummedAreaTable()
+    {
+        data = NULL;
+        nData = 0;
+        width = height = channels = padding = 0;
+        tWidth = tHeight = ystride = 0;
+    }
+
+    /**
+     * @brief SummedAreaTable
+     * @param img
+     * @param padding
+     * @param bCompensated
+     */
+    SummedAreaTable(Image *img, int padding = 0, bool bCompensated = false)
+    {
+        data = NULL;
+        nData = 0;
+        width = height = channels = this->padding = 0;
+        tWidth = tHeight = ystride = 0;
+
+        compute(img, padding, bCompensated);
+    }
+
+    ~SummedAreaTable()
+    {
+        release();
+    }
+
+    /**
+     * @brief compute builds the table of a frame of an Image.
+     * @param img
+     * @param padding is the number of border pixels replicated on each side.
+     * @param bCompensated enables Kahan summation during the scans.
+     * @param frame
+     */
+    void compute(Image *img, int padding = 0, bool bCompensated = false, int frame = 0)
+    {
+        if(img == NULL) {
+            return;
+        }
+
+        if(!img->isValid()) {
+            return;
+        }
+
+        frame = CLAMP(frame, img->frames);
+
+        compute(img->data + frame * img->tstride, img->width, img->height,
+                img->channels, padding, bCompensated);
+    }
+
+    /**
+     * @brief compute builds the table of an interleaved float buffer.
+     * @param src
+     * @param width
+     * @param height
+     * @param channels
+     * @param padding is the number of border pixels replicated on each side.
+     * @param bCompensated enables Kahan summation during the scans.
+     */
+    void compute(float *src, int width, int height, int channels,
+                 int padding = 0, bool bCompensated = false)
+    {
+        if(src == NULL) {
+            return;
+        }
+
+        SummedAreaTableBuffer rows(src, width * channels);
+        computeFromRows(rows, width, height, channels, padding, bCompensated);
+    }
+
+    /**
+     * @brief computeFromRows builds the table of values generated a row at
+     * a time, with a two-pass prefix scan: rows in parallel first, and then
+     * columns in parallel blocks. This allows to sum derived quantities
+     * (e.g. products of channels) without storing them; each thread has its
+     * own row buffer.
+     * @param rows has a method float *getRow(int j, float *buffer) returning
+     * the values of the j-th row; they can be written in buffer, which has
+     * size width * channels.
+     * @param width
+     * @param height
+     * @param channels
+     * @param padding is the number of border pixels replicated on each side.
+     * @param bCompensated enables Kahan summation during the scans.
+     */
+    template<class T>
+    void computeFromRows(T &rows, int width, int height, int channels,
+                         int padding = 0, bool bCompensated = false)
+    {
+        if(width < 1 || height < 1 || channels < 1) {
+            return;
+        }
+
+        this->width = width;
+        this->height = height;
+        this->channels = channels;
+        this->padding = MAX(padding, 0);
+
+        int pw = width + this->padding * 2;
+        int ph = height + this->padding * 2;
+
+        tWidth = pw + 1;
+        tHeight = ph + 1;
+        ystride = tWidth * channels;
+
+        int n = tHeight * ystride;
+
+        if(n != nData) {
+            release();
+            data = new double[n];
+            nData = n;
+        }
+
+        int p = this->padding;
+
+        for(int i = 0; i < ystride; i++) {
+            data[i] = 0.0;
+        }
+
+        //first pass: prefix sums of each row
+        #pragma omp parallel
+        {
+            std::vector<float> buffer(width * channels);
+            std::vector<double> sum(channels);
+            std::vector<double> c(channels);
+
+            #pragma omp for
+
+            for(int j = 0; j < ph; j++) {
+                float *row = rows.getRow(CLAMP(j - p, height), buffer.data());
+                double *out = &data[(j + 1) * ystride];
+
+                for(int k = 0; k < channels; k++) {
+                    out[k] = 0.0;
+                    sum[k] = 0.0;
+                    c[k] = 0.0;
+                }
+
+                for(int i = 0; i < pw; i++) {
+                    float *pixel = &row[CLAMP(i - p, width) * channels];
+                    double *tmp = &out[(i + 1) * channels];
+
+                    if(bCompensated) {
+                        for(int k = 0; k < channels; k++) {
+                            kahanAdd(sum[k], c[k], double(pixel[k]));
+                            tmp[k] = sum[k];
+                        }
+                    } else {
+                        for(int k = 0; k < channels; k++) {
+                            sum[k] += double(pixel[k]);
+                            tmp[k] = sum[k];
+                        }
+                    }
+                }
+            }
+        }
+
+        //second pass: prefix sums of each column, in blocks of columns
+        int blockSize = 256;
+        int nBlocks = (ystride + blockSize - 1) / blockSize;
+
+        #pragma omp parallel for
+
+        for(int b = 0; b < nBlocks; b++) {
+            int i0 = b * blockSize;
+            int i1 = MIN(i0 + blockSize, ystride);
+
+            std::vector<double> c;
+
+            if(bCompensated) {
+                c.assign(i1 - i0, 0.0);
+            }
+
+            for(int j = 2; j < tHeight; j++) {
+                double *prev = &data[(j - 1) * ystride];
+                double *cur = &data[j * ystride];
+
+                if(bCompensated) {
+                    for(int i = i0; i < i1; i++) {
+                        double sum = prev[i];
+                        kahanAdd(sum, c[i - i0], cur[i]);
+                        cur[i] = sum;
+                    }
+                } else {
+                    for(int i = i0; i < i1; i++) {
+                        cur[i] += prev[i];
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief isValid
+     * @return
+     */
+    bool isValid()
+    {
+        return data != NULL;
+    }
+
+    /**
+     * @brief getSum computes the sum of values in [x0, x1) x [y0, y1);
+     * coordinates are in image space and they are clamped to the padded domain.
+     * @param x0
+     * @param y0
+     * @param x1
+     * @param y1
+     * @param ret is an array of size channels.
+     * @return It returns the number of summed pixels.
+     */
+    int getSum(int x0, int y0, int x1, int y1, double *ret)
+    {
+        int X0 = CLAMPi(x0 + padding, 0, tWidth - 1);
+        int X1 = CLAMPi(x1 + padding, 0, tWidth - 1);
+        int Y0 = CLAMPi(y0 + padding, 0, tHeight - 1);
+        int Y1 = CLAMPi(y1 + padding, 0, tHeight - 1);
+
+        if(X1 <= X0 || Y1 <= Y0) {
+            for(int k = 0; k < channels; k++) {
+                ret[k] = 0.0;
+            }
+
+            return 0;
+        }
+
+        double *d00 = &data[Y0 * ystride + X0 * channels];
+        double *d01 = &data[Y0 * ystride + X1 * channels];
+        double *d10 = &data[Y1 * ystride + X0 * channels];
+        double *d11 = &data[Y1 * ystride + X1 * channels];
+
+        for(int k = 0; k < channels; k++) {
+            ret[k] = d11[k] - d01[k] - d10[k] + d00[k];
+        }
+
+        return (X1 - X0) * (Y1 - Y0);
+    }
+
+    /**
+     * @brief getMean computes the mean of values in [x0, x1) x [y0, y1).
+     * @param x0
+     * @param y0
+     * @param x1
+     * @param y1
+     * @param ret is an array of size channels.
+     * @return It returns the number of averaged pixels.
+     */
+    int getMean(int x0, int y0, int x1, int y1, double *ret)
+    {
+        int n = getSum(x0, y0, x1, y1, ret);
+
+        if(n > 0) {
+            double n_inv = 1.0 / double(n);
+
+            for(int k = 0; k < channels; k++) {
+                ret[k] *= n_inv;
+            }
+        }
+
+        return n;
+    }
+
+    /**
+     * @brief getBoxMean computes a box filter; the window of the pixel (x, y)
+     * is [x - left, x + right] x [y - top, y + bottom]. When the padding is
+     * smaller than the window, the mean is taken on the padded domain only.
+     * @param imgOut
+     * @param left
+     * @param right
+     * @param top
+     * @param bottom
+     * @return It returns NULL if imgOut is allocated with a different size
+     * or number of channels than the table.
+     */
+    Image *getBoxMean(Image *imgOut, int left, int right, int top, int bottom)
+    {
+        if(!isValid()) {
+            return imgOut;
+        }
+
+        if(imgOut == NULL) {
+            imgOut = new Image(width, height, channels);
+        } else {
+            if(!imgOut->isValid()) {
+                imgOut->allocate(width, height, channels, 1);
+            }
+
+            if(imgOut->width != width || imgOut->height != height ||
+               imgOut->channels != channels) {
+                return NULL;
+            }
+        }
+
+        #pragma omp parallel for
+
+        for(int j = 0; j < height; j++) {
+            std::vector<double> tmp(channels);
+            float *out = &imgOut->data[j * imgOut->ystride];
+
+            for(int i = 0; i < width; i++) {
+                getMean(i - left, j - top, i + right + 1, j + bottom + 1, tmp.data());
+
+                for(int k = 0; k < channels; k++) {
+                    out[k] = float(tmp[k]);
+                }
+
+                out += channels;
+            }
+        }
+
+        return imgOut;
+    }
+
+    /**
+     * @brief getBoxMean computes a box filter with a window of size
+     * (2 * radius + 1) x (2 * radius + 1).
+     * @param imgOut
+     * @param radius
+     * @return
+     */
+    Image *getBoxMean(Image *imgOut, int radius)
+    {
+        return getBoxMean(imgOut, radius, radius, radius, radius);
+    }
+
+    /**
+     * @brief execute computes a box filter of an Image with replicated borders.
+     * @param imgIn
+     * @param imgOut
+     * @param radius
+     * @param bCompensated
+     * @return It returns NULL if imgOut does not match imgIn; see getBoxMean.
+     */
+    static Image *execute(Image *imgIn, Image *imgOut, int radius,
+                          bool bCompensated = false)
+    {
+        SummedAreaTable sat(imgIn, radius, bCompensated);
+        return sat.getBoxMean(imgOut, radius);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_SUMMED_AREA_TABLE_HPP */
@@ -0,0 +1,461 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_WARP_MAP_HPP
+#define PIC_UTIL_WARP_MAP_HPP
+
+#include <stdio.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+
+#include "../base.hpp"
+#include "../image.hpp"
+#include "../util/bbox.hpp"
+
+namespace pic {
+
+/**
+ * @brief The WARP_MAP_HEADER struct is the header of a WarpMap file.
+ */
+struct WARP_MAP_HEADER {
+    char magic[4];
+    int width, height, srcWidth, srcHeight, fractionBits;
+};
+
+/**
+ * @brief The WarpMap class stores, for each pixel of an output image, the
+ * position of its sample in a source image; positions are in fixed-point
+ * with WarpMap::fractionBits bits of subpixel precision, packed as 16-bit
+ * integer parts and 8-bit fractions (6 bytes per pixel). A map is computed
+ * once for a given geometry (e.g., a rectification or an undistortion),
+ * and then it is applied to every frame with a gather and bilinear
+ * interpolation. Source images can be up to maxSize x maxSize pixels.
+ */
+class WarpMap
+{
+protected:
+    int nData;
+
+    /**
+     * @brief release
+     */
+    void release()
+    {
+        if(data != NULL) {
+            delete[] data;
+        }
+
+        if(fraction != NULL) {
+            delete[] fraction;
+        }
+
+        data = NULL;
+        fraction = NULL;
+        nData = 0;
+    }
+
+    /**
+     * @brief checkData checks that every entry is either invalid or inside
+     * the source image.
+     * @return
+     */
+    bool checkData()
+    {
+        int mx = srcWidth - 1;
+        int my = srcHeight - 1;
+
+        for(int i = 0; i < nData; i += 2) {
+            int ix = data[i];
+            int iy = data[i + 1];
+            int fx = fraction[i];
+            int fy = fraction[i + 1];
+
+            if((ix == -1) && (iy == -1)) {
+                continue;
+            }
+
+            if((ix < 0) || (ix > mx) || (iy < 0) || (iy > my) ||
+               ((ix == mx) && (fx > 0)) || ((iy == my) && (fy > 0))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+public:
+    static const int fractionBits = 8;
+    static const int maxSize = 32768;
+
+    int width, height;
+    int srcWidth, srcHeight;
+
+    //integer parts of (x, y) pairs; -1 marks pixels outside the source image
+    short *data;
+
+    //fractional parts of (x, y) pairs
+    unsigned char *fraction;
+
+    /**
+     * @brief WarpMap
+     */
+    WarpMap()
+    {
+        data = NULL;
+        fraction = NULL;
+        nData = 0;
+        width = height = srcWidth = srcHeight = 0;
+    }
+
+    ~WarpMap()
+    {
+        release();
+    }
+
+    /**
+     * @brief allocate
+     * @param width is the horizontal size of the output image.
+     * @param height is the vertical size of the output image.
+     * @param srcWidth is the horizontal size of the source image.
+     * @param srcHeight is the vertical size of the source image.
+     */
+    void allocate(int width, int height, int srcWidth, int srcHeight)
+    {
+        int n = width * height * 2;
+
+        if(n != nData) {
+            release();
+
+            if(n > 0) {
+                data = new short[n];
+                fraction = new unsigned char[n];
+                nData = n;
+            }
+        }
+
+        this->width = width;
+        this->height = height;
+        this->srcWidth = srcWidth;
+        this->srcHeight = srcHeight;
+    }
+
+    /**
+     * @brief isValid
+     * @return
+     */
+    bool isValid()
+    {
+        return (data != NULL) && (srcWidth > 0) && (srcHeight > 0) &&
+               (srcWidth <= maxSize) && (srcHeight <= maxSize);
+    }
+
+    /**
+     * @brief set stores the source position of the output pixel (i, j);
+     * the position is clamped to the source image.
+     * @param i
+     * @param j
+     * @param x
+     * @param y
+     */
+    inline void set(int i, int j, float x, float y)
+    {
+        float scale = float(1 << fractionBits);
+
+        x = CLAMPi(x, 0.0f, float(srcWidth - 1));
+        y = CLAMPi(y, 0.0f, float(srcHeight - 1));
+
+        int px = int(x * scale + 0.5f);
+        int py = int(y * scale + 0.5f);
+
+        int ind = (j * width + i) * 2;
+        data[ind    ] = short(px >> fractionBits);
+        data[ind + 1] = short(py >> fractionBits);
+        fraction[ind    ] = (unsigned char)(px & ((1 << fractionBits) - 1));
+        fraction[ind + 1] = (unsigned char)(py & ((1 << fractionBits) - 1));
+    }
+
+    /**
+     * @brief setInvalid marks the output pixel (i, j) as outside the source.
+     * @param i
+     * @param j
+     */
+    inline void setInvalid(int i, int j)
+    {
+        int ind = (j * width + i) * 2;
+        data[ind    ] = -1;
+        data[ind + 1] = -1;
+        fraction[ind    ] = 0;
+        fraction[ind + 1] = 0;
+    }
+
+    /**
+     * @brief compute fills the map evaluating func, which is a functor
+     * bool func(float x, float y, float &xs, float &ys) that returns the
+     * source position (xs, ys) of the output pixel (x, y) and whether it is
+     * valid. When gridStep > 1, func is evaluated on a sparse grid and
+     * positions are interpolated bilinearly; pixels close to invalid nodes
+     * are always evaluated. func is called from multiple threads.
+     * @param func
+     * @param width
+     * @param height
+     * @param srcWidth
+     * @param srcHeight
+     * @param gridStep
+     */
+    template<class T>
+    void compute(T &func, int width, int height, int srcWidth,
+                 int srcHeight, int gridStep = 1)
+    {
+        allocate(width, height, srcWidth, srcHeight);
+
+        if(!isValid()) {
+            return;
+        }
+
+        gridStep = MAX(gridStep, 1);
+
+        if(gridStep == 1) {
+            #pragma omp parallel for
+
+            for(int j = 0; j < height; j++) {
+                for(int i = 0; i < width; i++) {
+                    float xs, ys;
+
+                    if(func(float(i), float(j), xs, ys)) {
+                        set(i, j, xs, ys);
+                    } else {
+                        setInvalid(i, j);
+                    }
+                }
+            }
+
+            return;
+        }
+
+        //nodes of the grid; the last column and row are always included
+        int gw = (width  - 1) / gridStep + 2;
+        int gh = (height - 1) / gridStep + 2;
+
+        std::vector<float> grid(gw * gh * 2);
+        std::vector<bool> valid(gw * gh);
+
+        for(int gj = 0; gj < gh; gj++) {
+            int j = MIN(gj * gridStep, height - 1);
+
+            for(int gi = 0; gi < gw; gi++) {
+                int i = MIN(gi * gridStep, width - 1);
+                int ind = gj * gw + gi;
+
+                valid[ind] = func(float(i), float(j), grid[ind * 2], grid[ind * 2 + 1]);
+            }
+        }
+
+        #pragma omp parallel for
+
+        for(int j = 0; j < height; j++) {
+            int gj = MIN(j / gridStep, gh - 2);
+            int j0 = gj * gridStep;
+            int j1 = MIN(j0 + gridStep, height - 1);
+            float dy = j1 > j0 ? float(j - j0) / float(j1 - j0) : 0.0f;
+
+            for(int i = 0; i < width; i++) {
+                int gi = MIN(i / gridStep, gw - 2);
+                int i0 = gi * gridStep;
+                int i1 = MIN(i0 + gridStep, width - 1);
+                float dx = i1 > i0 ? float(i - i0) / float(i1 - i0) : 0.0f;
+
+                int ind0 = gj * gw + gi;
+                int ind2 = ind0 + gw;
+
+                if(valid[ind0] && valid[ind0 + 1] && valid[ind2] && valid[ind2 + 1]) {
+                    float *g0 = &grid[ind0 * 2];
+                    float *g1 = &grid[(ind0 + 1) * 2];
+                    float *g2 = &grid[ind2 * 2];
+                    float *g3 = &grid[(ind2 + 1) * 2];
+
+                    float pos[2];
+                    for(int k = 0; k < 2; k++) {
+                        float px0 = g0[k] + dy * (g2[k] - g0[k]);
+                        float px1 = g1[k] + dy * (g3[k] - g1[k]);
+                        pos[k] = px0 + dx * (px1 - px0);
+                    }
+
+                    set(i, j, pos[0], pos[1]);
+                } else {
+                    float xs, ys;
+
+                    if(func(float(i), float(j), xs, ys)) {
+                        set(i, j, xs, ys);
+                    } else {
+                        setInvalid(i, j);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief remap applies the map to a region of the output image with
+     * bilinear interpolation; pixels outside the source are set to zero.
+     * @param imgIn is an image of size srcWidth x srcHeight.
+     * @param imgOut is an image of size width x height.
+     * @param box is the region of imgOut to compute.
+     */
+    void remap(Image *imgIn, Image *imgOut, BBox *box)
+    {
+        int channels = imgIn->channels;
+        int ystride = imgIn->ystride;
+        int mx = srcWidth - 1;
+        int my = srcHeight - 1;
+
+        float scale = 1.0f / float(1 << fractionBits);
+
+        int frames = MIN(imgIn->frames, imgOut->frames);
+
+        for(int f = 0; f < frames; f++) {
+            float *src = imgIn->data + f * imgIn->tstride;
+
+            for(int j = box->y0; j < box->y1; j++) {
+                int ind = (j * width + box->x0) * 2;
+                short *pos = &data[ind];
+                unsigned char *frac = &fraction[ind];
+                float *out = &imgOut->data[f * imgOut->tstride + j * imgOut->ystride + box->x0 * channels];
+
+                for(int i = box->x0; i < box->x1; i++) {
+                    int ix = pos[0];
+                    int iy = pos[1];
+
+                    if(ix < 0) {
+                        for(int k = 0; k < channels; k++) {
+                            out[k] = 0.0f;
+                        }
+                    } else {
+                        float dx = float(frac[0]) * scale;
+                        float dy = float(frac[1]) * scale;
+
+                        int ix1 = MIN(ix + 1, mx);
+                        int iy1 = MIN(iy + 1, my);
+
+                        float *p0 = &src[iy  * ystride + ix  * channels];
+                        float *p1 = &src[iy  * ystride + ix1 * channels];
+                        float *p2 = &src[iy1 * ystride + ix  * channels];
+                        float *p3 = &src[iy1 * ystride + ix1 * channels];
+
+                        for(int k = 0; k < channels; k++) {
+                            float px0 = p0[k] + dy * (p2[k] - p0[k]);
+                            float px1 = p1[k] + dy * (p3[k] - p1[k]);
+                            out[k] = px0 + dx * (px1 - px0);
+                        }
+                    }
+
+                    pos += 2;
+                    frac += 2;
+                    out += channels;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief write saves the map in a binary file.
+     * @param name
+     * @return
+     */
+    bool write(std::string name)
+    {
+        if(!isValid()) {
+            return false;
+        }
+
+        FILE *file = fopen(name.c_str(), "wb");
+
+        if(file == NULL) {
+            return false;
+        }
+
+        WARP_MAP_HEADER header;
+        header.magic[0] = 'P';
+        header.magic[1] = 'W';
+        header.magic[2] = 'M';
+        header.magic[3] = '1';
+        header.width = width;
+        header.height = height;
+        header.srcWidth = srcWidth;
+        header.srcHeight = srcHeight;
+        header.fractionBits = fractionBits;
+
+        bool bOut = fwrite(&header, sizeof(WARP_MAP_HEADER), 1, file) == 1;
+        bOut = bOut && (fwrite(data, sizeof(short), nData, file) == size_t(nData));
+        bOut = bOut && (fwrite(fraction, sizeof(unsigned char), nData, file) == size_t(nData));
+
+        fclose(file);
+
+        return bOut;
+    }
+
+    /**
+     * @brief read loads a map from a binary file; files with sizes above
+     * maxSize, with trailing data, or with entries outside the source
+     * image are rejected.
+     * @param name
+     * @return
+     */
+    bool read(std::string name)
+    {
+        FILE *file = fopen(name.c_str(), "rb");
+
+        if(file == NULL) {
+            return false;
+        }
+
+        WARP_MAP_HEADER header;
+
+        bool bOut = fread(&header, sizeof(WARP_MAP_HEADER), 1, file) == 1;
+
+        bOut = bOut && (header.magic[0] == 'P') && (header.magic[1] == 'W') &&
+               (header.magic[2] == 'M') && (header.magic[3] == '1') &&
+               (header.fractionBits == fractionBits) &&
+               (header.width > 0) && (header.height > 0) &&
+               (header.width <= maxSize) && (header.height <= maxSize) &&
+               (header.srcWidth > 0) && (header.srcHeight > 0) &&
+               (header.srcWidth <= maxSize) && (header.srcHeight <= maxSize);
+
+        //width * height * 2 entries have to fit in an int
+        bOut = bOut && (header.height <= (INT_MAX / 2) / header.width);
+
+        if(bOut) {
+            allocate(header.width, header.height, header.srcWidth, header.srcHeight);
+            bOut = fread(data, sizeof(short), nData, file) == size_t(nData);
+            bOut = bOut && (fread(fraction, sizeof(unsigned char), nData, file) == size_t(nData));
+            bOut = bOut && (fgetc(file) == EOF);
+            bOut = bOut && checkData();
+        }
+
+        fclose(file);
+
+        if(!bOut) {
+            release();
+        }
+
+        return bOut;
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_WARP_MAP_HPP */